@@ -21,6 +21,7 @@
 @class EAGLView;
 @class ModelListViewController;
 @class RhModelViewController;
+@class RhModelPrefetcher;
 @class UISplitViewController;
 
 
@@ -37,6 +38,7 @@ extern AppDelegate* RhinoApp;
     
   RhModel* currentModel;
   NSMutableArray* models;       // array of RhModel objects
+  RhModelPrefetcher* modelPrefetcher;   // prepares the models after currentModel
   
   BOOL fastDrawing;
 }
@@ -46,6 +48,7 @@ extern AppDelegate* RhinoApp;
 
 @property (nonatomic, readonly) RhModel *currentModel;
 @property (nonatomic, readonly) NSArray* models;
+@property (nonatomic, readonly) RhModelPrefetcher* modelPrefetcher;
 
 @property (assign) BOOL fastDrawing;
 
@@ -58,5 +61,15 @@ extern AppDelegate* RhinoApp;
 
 - (CGFloat) screenScale;
 
+- (BOOL) trustVerifiedModels;           // skip CRC checks on files that already passed them
+
+- (BOOL) traceEnabled;                  // record load and draw timings
+- (void) writeTrace;                    // write the recorded timings to Documents/RhinoViewer Trace.json
+- (BOOL) showFrameStats;                // draw frame rate and render counters over the model
+- (long long) meshMemoryBudget;         // bytes of mesh VBOs a model may keep on the GPU
+- (long long) modelMemoryLimit;         // warn before reading a model expected to need more
+- (long long) prefetchMemoryBudget;     // bytes the models prepared ahead of time may hold
+- (int) prefetchModelCount;             // number of models after the current one to prepare
+
 @end
 
@@ -18,6 +18,8 @@
 #import "RhModelViewController.h"
 #import "RhModelViewControllerPad.h"
 #import "RhModel.h"
+#import "RhModelPrefetcher.h"
+#include "RhTrace.h"
 
 
 
@@ -27,7 +29,7 @@ AppDelegate* RhinoApp;
 
 @implementation AppDelegate
 
-@synthesize window, currentModel, fastDrawing;
+@synthesize window, currentModel, modelPrefetcher, fastDrawing;
 @synthesize navigationController;
 
 - (id)init
@@ -46,6 +48,7 @@ AppDelegate* RhinoApp;
   [navigationController release];
   [currentModel release];
   [models release];
+  [modelPrefetcher release];
   [super dealloc];
 }
 
@@ -72,6 +75,69 @@ AppDelegate* RhinoApp;
   models = [[self modelsFromBundle] retain];
 }
 
+// When YES, a model file whose CRC matches the one recorded after its last
+// clean read is read without verifying the CRC of every chunk.
+- (BOOL) trustVerifiedModels
+{
+  return [[NSUserDefaults standardUserDefaults] boolForKey: @"IRTrustVerifiedModels"];
+}
+
+// When YES, load and draw timings are recorded and written to a Chrome trace
+// file in the Documents directory, where iTunes file sharing can get it.
+- (BOOL) traceEnabled
+{
+  return [[NSUserDefaults standardUserDefaults] boolForKey: @"IRTraceEnabled"];
+}
+
+// When YES, model views show the frame rate and render counters
+- (BOOL) showFrameStats
+{
+  return [[NSUserDefaults standardUserDefaults] boolForKey: @"IRShowFrameStats"];
+}
+
+// The IRMeshMemoryBudget setting is in megabytes.  Without it a model may use a
+// quarter of the physical memory, which the GPU shares with everything else.
+- (long long) meshMemoryBudget
+{
+  long long megabytes = [[NSUserDefaults standardUserDefaults] integerForKey: @"IRMeshMemoryBudget"];
+  if (megabytes > 0)
+    return megabytes*1024*1024;
+  return [[NSProcessInfo processInfo] physicalMemory] / 4;
+}
+
+// iOS stops applications well before they use all of the physical memory
+- (long long) modelMemoryLimit
+{
+  return [[NSProcessInfo processInfo] physicalMemory] / 2;
+}
+
+// The IRPrefetchMemoryBudget setting is in megabytes, 0 turns prefetching off.
+// Without it the models prepared ahead may use an eighth of the physical memory.
+- (long long) prefetchMemoryBudget
+{
+  NSUserDefaults* defaults = [NSUserDefaults standardUserDefaults];
+  if ([defaults objectForKey: @"IRPrefetchMemoryBudget"])
+    return (long long) [defaults integerForKey: @"IRPrefetchMemoryBudget"]*1024*1024;
+  return [[NSProcessInfo processInfo] physicalMemory] / 8;
+}
+
+- (int) prefetchModelCount
+{
+  NSUserDefaults* defaults = [NSUserDefaults standardUserDefaults];
+  if ([defaults objectForKey: @"IRPrefetchModelCount"])
+    return [defaults integerForKey: @"IRPrefetchModelCount"];
+  return 1;
+}
+
+- (void) writeTrace
+{
+  if (!RhTraceIsEnabled())
+    return;
+  NSArray* paths = NSSearchPathForDirectoriesInDomains (NSDocumentDirectory, NSUserDomainMask, YES);
+  NSString* tracePath = [[paths objectAtIndex: 0] stringByAppendingPathComponent: @"RhinoViewer Trace.json"];
+  RhTraceWriteJSON ([tracePath fileSystemRepresentation]);
+}
+
 #pragma mark application delegate methods
 
 - (BOOL)application: (UIApplication*) application didFinishLaunchingWithOptions: (NSDictionary*) launchOptions
@@ -81,10 +147,14 @@ AppDelegate* RhinoApp;
   // initialize OpenNURBS
   ON::Begin();
   
+  RhTraceSetThreadName ("main");
+  RhTraceEnable ([self traceEnabled]);
+  
   // finish initialization
   [self loadModels];
   
   currentModel = [models objectAtIndex: 0];
+  modelPrefetcher = [[RhModelPrefetcher alloc] initWithBudget: [self prefetchMemoryBudget] modelCount: [self prefetchModelCount]];
     
   if (UI_USER_INTERFACE_IDIOM() == UIUserInterfaceIdiomPhone)
     [application setStatusBarStyle: UIStatusBarStyleBlackTranslucent];
@@ -113,6 +183,22 @@ AppDelegate* RhinoApp;
   [self application: application didFinishLaunchingWithOptions: nil];
 }
 
+- (void)applicationDidEnterBackground: (UIApplication*) application
+{
+  [self writeTrace];
+}
+
+- (void)applicationWillTerminate: (UIApplication*) application
+{
+  [self writeTrace];
+}
+
+- (void)applicationDidReceiveMemoryWarning: (UIApplication*) application
+{
+  [modelPrefetcher didReceiveMemoryWarning];
+  [currentModel didReceiveMemoryWarning];
+}
+
 #pragma mark utility methods
 
 - (NSArray*) models
@@ -0,0 +1,80 @@
+/* $NoKeywords: $ */
+
+#include "RhBenchmarkAllocations.h"
+
+#include <stdlib.h>
+#include <new>
+
+
+////////////////////////////////////////////////////////////////
+//
+// Allocation counting
+//
+// The replacement operator new and delete live in a file of their own so the
+// compiler never inlines them into a caller and takes the free() in delete for
+// a mismatched release of memory from new.
+//
+
+static volatile long g_allocation_count = 0;
+
+static inline void CountAllocation()
+{
+  __sync_fetch_and_add( &g_allocation_count, 1 );
+}
+
+long RhBenchmarkAllocationCount()
+{
+  return g_allocation_count;
+}
+
+#if defined(RH_BENCHMARK_WRAP_MALLOC)
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc so every allocation made by
+// openNURBS and zlib is counted, not just C++ new.
+extern "C" void* __real_malloc( size_t );
+extern "C" void* __real_calloc( size_t, size_t );
+extern "C" void* __real_realloc( void*, size_t );
+
+extern "C" void* __wrap_malloc( size_t size )
+{
+  CountAllocation();
+  return __real_malloc( size );
+}
+
+extern "C" void* __wrap_calloc( size_t count, size_t size )
+{
+  CountAllocation();
+  return __real_calloc( count, size );
+}
+
+extern "C" void* __wrap_realloc( void* p, size_t size )
+{
+  CountAllocation();
+  return __real_realloc( p, size );
+}
+#endif
+
+void* operator new( size_t size ) throw(std::bad_alloc)
+{
+#if !defined(RH_BENCHMARK_WRAP_MALLOC)
+  CountAllocation();
+#endif
+  void* p = malloc( size ? size : 1 );
+  if ( !p )
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[]( size_t size ) throw(std::bad_alloc)
+{
+  return operator new( size );
+}
+
+void operator delete( void* p ) throw()
+{
+  free( p );
+}
+
+void operator delete[]( void* p ) throw()
+{
+  free( p );
+}
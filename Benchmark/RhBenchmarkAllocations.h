@@ -0,0 +1,10 @@
+/* $NoKeywords: $ */
+
+#if !defined(RH_BENCHMARK_ALLOCATIONS_INC_)
+#define RH_BENCHMARK_ALLOCATIONS_INC_
+
+// Number of allocations made so far by C++ new and, when the benchmark is
+// linked with RH_BENCHMARK_WRAP_MALLOC, by malloc, calloc and realloc
+long RhBenchmarkAllocationCount();
+
+#endif
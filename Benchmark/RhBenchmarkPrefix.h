@@ -0,0 +1,16 @@
+//
+// Prefix header for the headless load benchmark.  It stands in for RhinoViewer_prefix.pch
+// when the plain C++ parts of the viewer are built outside of Xcode.
+//
+
+#include "opennurbs/opennurbs.h"
+
+// The benchmark measures release builds, so debug logging is always compiled out.
+#define DLog(...) /* */
+
+#if !defined(TRUE)
+#define TRUE 1
+#endif
+#if !defined(FALSE)
+#define FALSE 0
+#endif
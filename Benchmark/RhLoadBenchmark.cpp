@@ -0,0 +1,825 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+//
+// Headless load benchmark.  Loads every 3dm file in a directory the same way the viewer
+// does - EX_ONX_Model::Read(), ShouldKeepObject() and display buffer construction - and
+// reports the time, memory and allocations spent in each phase as JSON.
+//
+// OpenGL uploads are not measured; display buffers are built in memory and thrown away.
+//
+// usage: RhLoadBenchmark [--repeat N] [--skip-crc] [--hash] [--json output.json] [--trace trace.json] [--render directory] directory|file.3dm ...
+//
+// --hash also times RhFileCRC32() of the whole file, which the viewer runs before it
+//   skips the chunk CRCs of a verified file.  The hash is reported as its own phase and
+//   is not part of a file's seconds.
+// --trace writes the RhTrace spans of all runs for chrome://tracing or Perfetto.
+// --render loads each file once more after the timed runs and draws it with
+//   CRhSoftwareRasterizer from the view the viewer starts with, into a .ppm file
+//   named after the model.  The images can be compared between builds.
+//
+
+#include "ONModel.h"
+#include "RhCRC32.h"
+#include "RhDisplayData.h"
+#include "RhCurveTessellator.h"
+#include "RhPointCloudOctree.h"
+#include "RhMemoryUsage.h"
+#include "RhScratchArena.h"
+#include "RhSoftwareRasterizer.h"
+#include "ClippingPlanes.h"
+#include "RhTrace.h"
+#include "RhBenchmarkAllocations.h"
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+
+////////////////////////////////////////////////////////////////
+//
+// Phases and per-file results
+//
+
+enum
+{
+  phase_hash = 0,       // RhFileCRC32() of the whole file with --hash, not part of the total
+  phase_read,           // EX_ONX_Model::Read() less the time spent in the phases below
+  phase_keep,           // ShouldKeepObject() visibility tests and mesh fix ups
+  phase_display,        // mesh partitions, interleaved vertex buffers and index buffers
+  phase_curves,         // CRhCurveTessellator
+  phase_point_clouds,   // CRhPointCloudOctree::Build()
+  phase_audit,          // EX_ONX_Model::AuditInParallel() after the read, as initWithFilename() does
+  phase_count
+};
+
+static const char* PhaseNames[phase_count] =
+{
+  "hash",
+  "read",
+  "keep",
+  "display_buffers",
+  "curves",
+  "point_clouds",
+  "audit"
+};
+
+class CRhBenchmarkFile
+{
+public:
+  CRhBenchmarkFile();
+  void ResetRun();
+
+  ON_String m_path;
+  ON__UINT64 m_bytes;
+  bool m_bOK;
+  int m_run_count;
+
+  // current run
+  double m_seconds[phase_count];
+  long m_allocations[phase_count];
+  int m_object_count;
+  int m_mesh_count;
+  int m_brep_count;
+  int m_curve_count;
+  int m_point_cloud_count;
+  ON__INT64 m_vertex_count;
+  ON__INT64 m_triangle_count;
+  ON__INT64 m_line_segment_count;
+  ON__INT64 m_point_count;
+  ON__INT64 m_display_bytes;
+  ON__INT64 m_model_table_bytes;
+  ON__INT64 m_estimated_bytes;        // CRhLoadEstimate::ModelBytes()
+  ON__INT64 m_estimated_peak_bytes;   // CRhLoadEstimate::PeakBytes()
+
+  // fastest of all runs
+  double m_best_seconds[phase_count];
+  long m_best_allocations[phase_count];
+  double m_best_total_seconds;
+  long m_peak_rss_kb;
+};
+
+CRhBenchmarkFile::CRhBenchmarkFile()
+: m_bytes(0)
+, m_bOK(false)
+, m_run_count(0)
+, m_best_total_seconds(0.0)
+, m_peak_rss_kb(0)
+{
+  for ( int i = 0; i < phase_count; i++ ) {
+    m_best_seconds[i] = 0.0;
+    m_best_allocations[i] = 0;
+  }
+  ResetRun();
+}
+
+void CRhBenchmarkFile::ResetRun()
+{
+  for ( int i = 0; i < phase_count; i++ ) {
+    m_seconds[i] = 0.0;
+    m_allocations[i] = 0;
+  }
+  m_object_count = 0;
+  m_mesh_count = 0;
+  m_brep_count = 0;
+  m_curve_count = 0;
+  m_point_cloud_count = 0;
+  m_vertex_count = 0;
+  m_triangle_count = 0;
+  m_line_segment_count = 0;
+  m_point_count = 0;
+  m_display_bytes = 0;
+  m_model_table_bytes = 0;
+  m_estimated_bytes = 0;
+  m_estimated_peak_bytes = 0;
+}
+
+
+// Times one phase.  Nested timers subtract their time from the enclosing phase, which is how
+// the time ShouldKeepObject() spends building display buffers is kept out of "read".
+class CRhPhaseTimer
+{
+public:
+  CRhPhaseTimer( CRhBenchmarkFile& file, int phase );
+  ~CRhPhaseTimer();
+
+private:
+  static double Seconds();
+
+  CRhBenchmarkFile& m_file;
+  int m_phase;
+  double m_start;
+  long m_start_allocations;
+  CRhPhaseTimer* m_outer;
+
+  static CRhPhaseTimer* m_current;
+};
+
+CRhPhaseTimer* CRhPhaseTimer::m_current = 0;
+
+double CRhPhaseTimer::Seconds()
+{
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return tv.tv_sec + 1.0e-6*tv.tv_usec;
+}
+
+CRhPhaseTimer::CRhPhaseTimer( CRhBenchmarkFile& file, int phase )
+: m_file(file)
+, m_phase(phase)
+, m_outer(m_current)
+{
+  m_current = this;
+  m_start_allocations = RhBenchmarkAllocationCount();
+  m_start = Seconds();
+}
+
+CRhPhaseTimer::~CRhPhaseTimer()
+{
+  const double seconds = Seconds() - m_start;
+  const long allocations = RhBenchmarkAllocationCount() - m_start_allocations;
+  m_file.m_seconds[m_phase] += seconds;
+  m_file.m_allocations[m_phase] += allocations;
+  if ( m_outer ) {
+    m_file.m_seconds[m_outer->m_phase] -= seconds;
+    m_file.m_allocations[m_outer->m_phase] -= allocations;
+  }
+  m_current = m_outer;
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// Peak resident set size
+//
+
+// Resets the kernel's high water mark so each file reports its own peak.  Linux 4.0 and
+// later only; elsewhere the peak is the peak of the whole process.
+static void ResetPeakRSS()
+{
+#if defined(__linux__)
+  FILE* fp = fopen( "/proc/self/clear_refs", "w" );
+  if ( fp ) {
+    fputs( "5", fp );
+    fclose( fp );
+  }
+#endif
+}
+
+static long PeakRSSKilobytes()
+{
+#if defined(__linux__)
+  FILE* fp = fopen( "/proc/self/status", "r" );
+  if ( fp ) {
+    char line[256];
+    long kb = 0;
+    while ( fgets( line, sizeof(line), fp ) ) {
+      if ( 1 == sscanf( line, "VmHWM: %ld kB", &kb ) )
+        break;
+    }
+    fclose( fp );
+    if ( kb > 0 )
+      return kb;
+  }
+#endif
+  struct rusage usage;
+  if ( getrusage( RUSAGE_SELF, &usage ) )
+    return 0;
+#if defined(__APPLE__)
+  return usage.ru_maxrss/1024;    // bytes on Mac OS X
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// The viewer's load path
+//
+
+static CRhBenchmarkFile* g_current_file = 0;
+static ON_String g_points_cache_path;
+static bool g_bSkipCRCCheck = false;
+static bool g_bHash = false;
+
+// Size of the --render images
+static const int RenderWidth = 640;
+static const int RenderHeight = 480;
+
+// Set while a file is loaded for --render
+static CRhRasterScene* g_render_scene = 0;
+static ON_Material g_render_material;
+static ON_Viewport g_render_viewport;
+
+// Same buffers DisplayMesh builds before it hands them to glBufferData(), from the
+// same kind of arena
+static CRhScratchArena g_display_arena;
+
+static void CreateDisplayBuffers( const ON_Mesh* mesh, CRhBenchmarkFile& file )
+{
+  CRhPhaseTimer timer( file, phase_display );
+
+  ON_Mesh* m = const_cast<ON_Mesh*>(mesh);     // CreatePartition() is not const
+  const ON_MeshPartition* partition = m->CreatePartition( USHRT_MAX-3, INT_MAX-3 );
+  if ( !partition )
+    return;     // invalid mesh, ignore
+
+  const bool bHasNormals = mesh->HasVertexNormals();
+  const bool bHasColors = mesh->HasVertexColors();
+  const ON_3fVector offset(0.0f,0.0f,0.0f);
+
+  for ( int idx = 0; idx < partition->m_part.Count(); idx++ ) {
+    const struct ON_MeshPart& part = partition->m_part[idx];
+
+    size_t stride;
+    if ( bHasColors )
+      stride = bHasNormals ? sizeof(VNCData) : sizeof(VCData);
+    else
+      stride = bHasNormals ? sizeof(VertexData) : sizeof(ON_3fPoint);
+
+    void* vertices = g_display_arena.Allocate( stride*part.vertex_count );
+    unsigned short* indexes = (unsigned short*) g_display_arena.Allocate( 3*part.triangle_count*sizeof(unsigned short) );
+    if ( vertices && indexes ) {
+      if ( bHasColors && bHasNormals )
+        RhGetVNCData( *mesh, part, offset, (VNCData*)vertices );
+      else if ( bHasColors )
+        RhGetVCData( *mesh, part, offset, (VCData*)vertices );
+      else if ( bHasNormals )
+        RhGetVertexData( *mesh, part, offset, (VertexData*)vertices );
+      else
+        memcpy( vertices, &mesh->m_V[part.vi[0]], stride*part.vertex_count );
+
+      const int triangle_count = RhGetTriangleIndexes( *mesh, part, indexes );
+      file.m_triangle_count += triangle_count;
+      file.m_vertex_count += part.vertex_count;
+      file.m_display_bytes += stride*part.vertex_count + 3*part.triangle_count*sizeof(unsigned short);
+      if ( g_render_scene )
+        g_render_scene->AddDisplayBuffers( vertices, part.vertex_count, bHasNormals, bHasColors, indexes, triangle_count, offset, g_render_material );
+    }
+    g_display_arena.Reset();
+  }
+}
+
+static void CreatePointCloudCache( ON_PointCloud* cloud, CRhBenchmarkFile& file )
+{
+  CRhPhaseTimer timer( file, phase_point_clouds );
+  if ( CRhPointCloudOctree::Build( *cloud, g_points_cache_path, 0 ) ) {
+    file.m_point_cloud_count++;
+    file.m_point_count += cloud->PointCount();
+  }
+  unlink( g_points_cache_path );
+}
+
+static void CreateDisplayCurves( EX_ONX_Model& model, CRhBenchmarkFile& file )
+{
+  CRhPhaseTimer timer( file, phase_curves );
+
+  ON_BoundingBox bbox = model.BoundingBox();
+  double chordTolerance = bbox.IsValid() ? 0.0005*bbox.Diagonal().Length() : 0.0;
+  CRhCurveTessellator tessellator( chordTolerance );
+
+  ON_Material material;
+  for ( int i = 0; i < model.m_object_table.Count(); i++ ) {
+    const ON_Curve* curve = ON_Curve::Cast( model.m_object_table[i].m_object );
+    if ( !curve )
+      continue;
+    model.GetObjectMaterial( i, material );
+    tessellator.AddCurve( curve, material.Emission() );
+  }
+  file.m_line_segment_count += tessellator.Tessellate();
+}
+
+
+// The viewer's version is in RhModel.mm.  It sets the model ID, which the benchmark does not need.
+void EX_ONX_Model::InspectProperties( ON_3dmProperties& )
+{
+}
+
+
+// The viewer's version is in RhModel.mm.  It warns before loading a model that will not fit.
+int EX_ONX_Model::ShouldReadObjectTable( const CRhLoadEstimate& estimate )
+{
+  CRhBenchmarkFile& file = *g_current_file;
+  file.m_estimated_bytes = estimate.ModelBytes();
+  file.m_estimated_peak_bytes = estimate.PeakBytes();
+  return 1;
+}
+
+
+// The benchmark's side of EX_ONX_Model::KeepObject(), which RhModel.mm uses too
+class CRhBenchmarkObjectReceiver : public CRhObjectReceiver
+{
+public:
+  CRhBenchmarkObjectReceiver( EX_ONX_Model& model, CRhBenchmarkFile& file )
+    : m_model(model), m_file(file)
+  {
+  }
+
+  bool ShouldContinue()
+  {
+    return true;
+  }
+
+  void AddGeometry( const ON_Geometry& )
+  {
+  }
+
+  void AddMesh( ON_Mesh* mesh, ON_3dmObjectAttributes& attr )
+  {
+    m_file.m_mesh_count++;
+    SetRenderMaterial( attr );
+    CreateDisplayBuffers( mesh, m_file );
+  }
+
+  void AddBrep( const ON_Brep*, const ON_Mesh* render_mesh, int, ON_3dmObjectAttributes& attr )
+  {
+    m_file.m_brep_count++;
+    if ( render_mesh ) {
+      SetRenderMaterial( attr );
+      CreateDisplayBuffers( render_mesh, m_file );
+    }
+  }
+
+  void AddCurve( const ON_Curve*, ON_3dmObjectAttributes& )
+  {
+    m_file.m_curve_count++;     // see CreateDisplayCurves()
+  }
+
+  void AddPointCloud( ON_PointCloud* cloud, ON_3dmObjectAttributes& )
+  {
+    CreatePointCloudCache( cloud, m_file );
+  }
+
+  // The benchmark builds the cache of every point cloud
+  bool AddCachedPointCloud( const ON_3dmObjectAttributes&, ON__UINT64, ON__UINT64, ON_BoundingBox& )
+  {
+    return false;
+  }
+
+private:
+  // RhModel addAnyMesh:
+  void SetRenderMaterial( const ON_3dmObjectAttributes& attr )
+  {
+    if ( g_render_scene ) {
+      m_model.GetRenderMaterial( attr, g_render_material );
+      if ( g_render_material.MaterialIndex() < 0 )
+        g_render_material.SetDiffuse( ON_Color( 255, 255, 255 ) );
+    }
+  }
+
+  EX_ONX_Model& m_model;
+  CRhBenchmarkFile& m_file;
+};
+
+bool EX_ONX_Model::ShouldSkipObject( ON::object_type type, const ON_3dmObjectAttributes& attr, ON__UINT64 record_key,
+                                     ON__UINT64 record_bytes )
+{
+  CRhBenchmarkObjectReceiver receiver( *this, *g_current_file );
+  return SkipObject( type, attr, record_key, record_bytes, receiver );
+}
+
+int EX_ONX_Model::ShouldKeepObject( ON_Object* pObject, ON_3dmObjectAttributes& attr )
+{
+  CRhBenchmarkFile& file = *g_current_file;
+  CRhPhaseTimer timer( file, phase_keep );
+  file.m_object_count++;
+
+  CRhBenchmarkObjectReceiver receiver( *this, file );
+  return KeepObject( pObject, attr, receiver );
+}
+
+
+// The view RhModelView setModel: and reshape start with
+static void GetRenderViewport( EX_ONX_Model& model, ON_Viewport& viewport )
+{
+  const ON_BoundingBox bbox = model.BoundingBox();
+  ON_3dmView view;
+  bool bInitialized = false;
+  for ( int i = 0; i < model.m_settings.m_views.Count(); i++ ) {
+    if ( model.m_settings.m_views[i].m_vp.Projection() == ON::perspective_view ) {
+      view = model.m_settings.m_views[i];
+      bInitialized = true;
+    }
+  }
+  if ( !bInitialized )
+    model.GetDefaultView( bbox, view );
+
+  viewport = view.m_vp;
+  viewport.SetTargetPoint( view.m_target );
+  ON_3dVector camDir = viewport.CameraDirection();
+  camDir.Unitize();
+  viewport.SetCameraDirection( camDir );
+  ON_3dVector camUp = viewport.CameraUp();
+  camUp.Unitize();
+  viewport.SetCameraUp( camUp );
+
+  viewport.SetScreenPort( 0, RenderWidth-1, RenderHeight-1, 0, 0, 0xff );
+  viewport.SetFrustumAspect( (double)RenderWidth/(double)RenderHeight );
+  ClippingInfo clipping;
+  clipping.bbox = bbox;
+  if ( iCalcClippingPlanes( viewport, clipping ) )
+    iSetupFrustum( viewport, clipping );
+}
+
+static bool LoadFile( CRhBenchmarkFile& file )
+{
+  file.ResetRun();
+  ResetPeakRSS();
+
+  if ( g_bHash ) {
+    CRhPhaseTimer timer( file, phase_hash );
+    ON__UINT32 crc = 0;
+    if ( !RhFileCRC32( file.m_path, &crc, &file.m_bytes ) )
+      return false;
+  }
+  else {
+    struct stat st;
+    if ( stat( file.m_path, &st ) )
+      return false;
+    file.m_bytes = (ON__UINT64)st.st_size;
+  }
+
+  bool rc;
+  g_current_file = &file;
+  {
+    EX_ONX_Model* model = new EX_ONX_Model;
+    model->m_bSkipCRCCheck = g_bSkipCRCCheck;
+    {
+      CRhPhaseTimer timer( file, phase_read );
+      rc = model->Read( file.m_path ) ? true : false;
+    }
+    if ( rc ) {
+      CRhPhaseTimer timer( file, phase_audit );
+      model->AuditInParallel( true, NULL, NULL, NULL );
+    }
+    if ( rc && file.m_curve_count > 0 )
+      CreateDisplayCurves( *model, file );
+    if ( rc && g_render_scene )
+      GetRenderViewport( *model, g_render_viewport );
+    file.m_model_table_bytes = model->SizeOfTables();
+    delete model;
+  }
+  g_current_file = 0;
+
+  const long peak = PeakRSSKilobytes();
+  if ( peak > file.m_peak_rss_kb )
+    file.m_peak_rss_kb = peak;
+  return rc;
+}
+
+
+static void RunFile( CRhBenchmarkFile& file, int repeat )
+{
+  for ( int run = 0; run < repeat; run++ ) {
+    if ( !LoadFile( file ) ) {
+      file.m_bOK = false;
+      return;
+    }
+
+    double total = 0.0;
+    for ( int i = phase_hash+1; i < phase_count; i++ )
+      total += file.m_seconds[i];
+
+    // keep the fastest run of each phase; timing noise only ever adds time
+    for ( int i = 0; i < phase_count; i++ ) {
+      if ( 0 == run || file.m_seconds[i] < file.m_best_seconds[i] )
+        file.m_best_seconds[i] = file.m_seconds[i];
+      if ( 0 == run || file.m_allocations[i] < file.m_best_allocations[i] )
+        file.m_best_allocations[i] = file.m_allocations[i];
+    }
+    if ( 0 == run || total < file.m_best_total_seconds )
+      file.m_best_total_seconds = total;
+    file.m_run_count++;
+  }
+  file.m_bOK = true;
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// Reference images
+//
+
+static bool WritePPM( const char* path, const CRhSoftwareRasterizer& rasterizer )
+{
+  FILE* fp = fopen( path, "wb" );
+  if ( !fp )
+    return false;
+  fprintf( fp, "P6\n%d %d\n255\n", rasterizer.Width(), rasterizer.Height() );
+  const unsigned char* pixels = rasterizer.Pixels();
+  for ( int i = 0; i < rasterizer.Width()*rasterizer.Height(); i++ )
+    fwrite( pixels + 4*i, 1, 3, fp );
+  return 0 == fclose( fp );
+}
+
+static bool RenderFile( CRhBenchmarkFile& file, const char* directory )
+{
+  // the copy of the meshes is not part of the load
+  const long peak_rss_kb = file.m_peak_rss_kb;
+  CRhRasterScene scene;
+  g_render_scene = &scene;
+  bool rc = LoadFile( file );
+  g_render_scene = 0;
+  file.m_peak_rss_kb = peak_rss_kb;
+  if ( !rc )
+    return false;
+
+  // an opaque white background; the viewer's previews are transparent
+  CRhSoftwareRasterizer rasterizer;
+  if ( !rasterizer.Render( scene, g_render_viewport, RenderWidth, RenderHeight, ON_Color( 255, 255, 255, 255 ) ) )
+    return false;
+
+  const char* name = strrchr( file.m_path.Array(), '/' );
+  name = name ? name+1 : file.m_path.Array();
+  ON_String path;
+  path.Format( "%s/%s.ppm", directory, name );
+  if ( !WritePPM( path, rasterizer ) ) {
+    fprintf( stderr, "RhLoadBenchmark: cannot write %s\n", path.Array() );
+    return false;
+  }
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// Input files
+//
+
+static bool Is3dmFile( const char* name )
+{
+  size_t length = strlen( name );
+  return length > 4 && 0 == on_stricmp( name + length - 4, ".3dm" );
+}
+
+static int ComparePaths( const ON_String* a, const ON_String* b )
+{
+  return strcmp( a->Array(), b->Array() );
+}
+
+static void AddPath( const char* path, ON_ClassArray<ON_String>& paths )
+{
+  struct stat st;
+  if ( stat( path, &st ) ) {
+    fprintf( stderr, "RhLoadBenchmark: cannot find %s\n", path );
+    return;
+  }
+  if ( !S_ISDIR( st.st_mode ) ) {
+    paths.Append( ON_String( path ) );
+    return;
+  }
+
+  DIR* dir = opendir( path );
+  if ( !dir )
+    return;
+  ON_ClassArray<ON_String> found;
+  struct dirent* entry;
+  while ( 0 != (entry = readdir( dir )) ) {
+    if ( Is3dmFile( entry->d_name ) ) {
+      ON_String filePath( path );
+      filePath += "/";
+      filePath += entry->d_name;
+      found.Append( filePath );
+    }
+  }
+  closedir( dir );
+  found.QuickSort( ComparePaths );
+  paths.Append( found.Count(), found.Array() );
+}
+
+
+////////////////////////////////////////////////////////////////
+//
+// JSON report
+//
+
+static void WriteJSONString( FILE* fp, const char* s )
+{
+  fputc( '"', fp );
+  for ( ; *s; s++ ) {
+    const unsigned char c = (unsigned char)*s;
+    if ( c == '"' || c == '\\' )
+      fprintf( fp, "\\%c", c );
+    else if ( c < 0x20 )
+      fprintf( fp, "\\u%04x", c );
+    else
+      fputc( c, fp );
+  }
+  fputc( '"', fp );
+}
+
+static double PerSecond( double count, double seconds )
+{
+  return seconds > 0.0 ? count/seconds : 0.0;
+}
+
+static void WriteReport( FILE* fp, const ON_ClassArray<CRhBenchmarkFile>& files, int repeat )
+{
+  double totalSeconds = 0.0;
+  double totalBytes = 0.0;
+  double totalObjects = 0.0;
+  double totalTriangles = 0.0;
+  long peakRSS = 0;
+  int failed = 0;
+
+  fprintf( fp, "{\n" );
+  fprintf( fp, "  \"benchmark\": \"load\",\n" );
+  fprintf( fp, "  \"opennurbs_version\": %d,\n", ON::Version() );
+  fprintf( fp, "  \"repeat\": %d,\n", repeat );
+  fprintf( fp, "  \"skip_crc_check\": %s,\n", g_bSkipCRCCheck ? "true" : "false" );
+  fprintf( fp, "  \"hash\": %s,\n", g_bHash ? "true" : "false" );
+  fprintf( fp, "  \"files\": [" );
+  for ( int fi = 0; fi < files.Count(); fi++ ) {
+    const CRhBenchmarkFile& file = files[fi];
+    fprintf( fp, "%s\n    {\n      \"path\": ", fi ? "," : "" );
+    WriteJSONString( fp, file.m_path );
+    fprintf( fp, ",\n      \"ok\": %s", file.m_bOK ? "true" : "false" );
+    if ( !file.m_bOK ) {
+      fprintf( fp, "\n    }" );
+      failed++;
+      continue;
+    }
+
+    const double seconds = file.m_best_total_seconds;
+    fprintf( fp, ",\n      \"bytes\": %llu", (unsigned long long)file.m_bytes );
+    fprintf( fp, ",\n      \"objects\": %d", file.m_object_count );
+    fprintf( fp, ",\n      \"meshes\": %d", file.m_mesh_count );
+    fprintf( fp, ",\n      \"breps\": %d", file.m_brep_count );
+    fprintf( fp, ",\n      \"curves\": %d", file.m_curve_count );
+    fprintf( fp, ",\n      \"point_clouds\": %d", file.m_point_cloud_count );
+    fprintf( fp, ",\n      \"vertices\": %lld", (long long)file.m_vertex_count );
+    fprintf( fp, ",\n      \"triangles\": %lld", (long long)file.m_triangle_count );
+    fprintf( fp, ",\n      \"line_segments\": %lld", (long long)file.m_line_segment_count );
+    fprintf( fp, ",\n      \"points\": %lld", (long long)file.m_point_count );
+    fprintf( fp, ",\n      \"display_buffer_bytes\": %lld", (long long)file.m_display_bytes );
+    fprintf( fp, ",\n      \"model_table_bytes\": %lld", (long long)file.m_model_table_bytes );
+    fprintf( fp, ",\n      \"estimated_bytes\": %lld", (long long)file.m_estimated_bytes );
+    fprintf( fp, ",\n      \"estimated_peak_bytes\": %lld", (long long)file.m_estimated_peak_bytes );
+    fprintf( fp, ",\n      \"seconds\": %.6f", seconds );
+    fprintf( fp, ",\n      \"megabytes_per_second\": %.3f", PerSecond( file.m_bytes/1048576.0, seconds ) );
+    fprintf( fp, ",\n      \"objects_per_second\": %.1f", PerSecond( file.m_object_count, seconds ) );
+    fprintf( fp, ",\n      \"triangles_per_second\": %.1f", PerSecond( (double)file.m_triangle_count, seconds ) );
+    fprintf( fp, ",\n      \"peak_rss_kb\": %ld", file.m_peak_rss_kb );
+    fprintf( fp, ",\n      \"phases\": {" );
+    for ( int i = 0; i < phase_count; i++ ) {
+      fprintf( fp, "%s\n        \"%s\": { \"seconds\": %.6f, \"allocations\": %ld }",
+               i ? "," : "", PhaseNames[i], file.m_best_seconds[i], file.m_best_allocations[i] );
+    }
+    fprintf( fp, "\n      }\n    }" );
+
+    totalSeconds += seconds;
+    totalBytes += (double)file.m_bytes;
+    totalObjects += file.m_object_count;
+    totalTriangles += (double)file.m_triangle_count;
+    if ( file.m_peak_rss_kb > peakRSS )
+      peakRSS = file.m_peak_rss_kb;
+  }
+  fprintf( fp, "\n  ],\n" );
+  fprintf( fp, "  \"totals\": {\n" );
+  fprintf( fp, "    \"files\": %d,\n", files.Count() );
+  fprintf( fp, "    \"failed\": %d,\n", failed );
+  fprintf( fp, "    \"bytes\": %.0f,\n", totalBytes );
+  fprintf( fp, "    \"seconds\": %.6f,\n", totalSeconds );
+  fprintf( fp, "    \"megabytes_per_second\": %.3f,\n", PerSecond( totalBytes/1048576.0, totalSeconds ) );
+  fprintf( fp, "    \"objects_per_second\": %.1f,\n", PerSecond( totalObjects, totalSeconds ) );
+  fprintf( fp, "    \"triangles_per_second\": %.1f,\n", PerSecond( totalTriangles, totalSeconds ) );
+  fprintf( fp, "    \"peak_rss_kb\": %ld\n", peakRSS );
+  fprintf( fp, "  }\n" );
+  fprintf( fp, "}\n" );
+}
+
+
+static void Usage()
+{
+  fprintf( stderr, "usage: RhLoadBenchmark [--repeat N] [--skip-crc] [--hash] [--json output.json] [--trace trace.json] [--render directory] directory|file.3dm ...\n" );
+}
+
+int main( int argc, const char* argv[] )
+{
+  int repeat = 1;
+  const char* jsonPath = 0;
+  const char* tracePath = 0;
+  const char* renderDirectory = 0;
+  ON_ClassArray<ON_String> paths;
+
+  for ( int i = 1; i < argc; i++ ) {
+    if ( 0 == strcmp( argv[i], "--repeat" ) && i+1 < argc )
+      repeat = atoi( argv[++i] );
+    else if ( 0 == strcmp( argv[i], "--json" ) && i+1 < argc )
+      jsonPath = argv[++i];
+    else if ( 0 == strcmp( argv[i], "--trace" ) && i+1 < argc )
+      tracePath = argv[++i];
+    else if ( 0 == strcmp( argv[i], "--render" ) && i+1 < argc )
+      renderDirectory = argv[++i];
+    else if ( 0 == strcmp( argv[i], "--skip-crc" ) )
+      g_bSkipCRCCheck = true;
+    else if ( 0 == strcmp( argv[i], "--hash" ) )
+      g_bHash = true;
+    else if ( argv[i][0] == '-' ) {
+      Usage();
+      return 2;
+    }
+    else
+      AddPath( argv[i], paths );
+  }
+  if ( paths.Count() == 0 || repeat < 1 ) {
+    Usage();
+    return 2;
+  }
+
+  ON::Begin();
+  if ( tracePath ) {
+    RhTraceSetThreadName( "main" );
+    RhTraceEnable( true );
+  }
+
+  const char* tmp = getenv( "TMPDIR" );
+  g_points_cache_path.Format( "%s/RhLoadBenchmark-%d.points", (tmp && tmp[0]) ? tmp : "/tmp", (int)getpid() );
+
+  ON_ClassArray<CRhBenchmarkFile> files;
+  files.Reserve( paths.Count() );
+  for ( int i = 0; i < paths.Count(); i++ ) {
+    CRhBenchmarkFile& file = files.AppendNew();
+    file.m_path = paths[i];
+    fprintf( stderr, "%s\n", paths[i].Array() );
+    RunFile( file, repeat );
+    if ( renderDirectory && file.m_bOK && !RenderFile( file, renderDirectory ) )
+      file.m_bOK = false;
+  }
+
+  int failed = 0;
+  for ( int i = 0; i < files.Count(); i++ ) {
+    if ( !files[i].m_bOK )
+      failed++;
+  }
+
+  FILE* fp = jsonPath ? fopen( jsonPath, "w" ) : stdout;
+  if ( !fp ) {
+    fprintf( stderr, "RhLoadBenchmark: cannot write %s\n", jsonPath );
+    return 1;
+  }
+  WriteReport( fp, files, repeat );
+  if ( fp != stdout )
+    fclose( fp );
+
+  if ( tracePath && !RhTraceWriteJSON( tracePath ) )
+    fprintf( stderr, "RhLoadBenchmark: cannot write %s\n", tracePath );
+
+  ON::End();
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+//
+// This class holds an OpenGL vertex buffer object with the tessellated curves of one color
+// and draws them as GL_LINES when requested
+//
+
+@interface DisplayCurves : NSObject {
+
+  ON_Color color;
+
+  // OpenGL vertex buffer, two ON_3fPoint vertices per line segment
+  unsigned int vertexBuffer;
+  unsigned int vertexCount;
+}
+
+@property (nonatomic, readonly) ON_Color color;
+@property (nonatomic, readonly) unsigned int vertexBuffer;
+@property (nonatomic, readonly) unsigned int vertexCount;
+
+- (id) initWithLines: (const ON_SimpleArray<ON_3fPoint>&) lines color: (ON_Color) color;
+- (size_t) gpuBytes;
+
+@end
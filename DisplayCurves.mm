@@ -0,0 +1,78 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#import "DisplayCurves.h"
+
+#import <OpenGLES/EAGL.h>
+#import <OpenGLES/ES1/gl.h>
+#import <OpenGLES/ES1/glext.h>
+
+
+@implementation DisplayCurves
+
+@synthesize color, vertexBuffer, vertexCount;
+
+- (void) makeVBO: (NSValue*) linesValue
+{
+  const ON_SimpleArray<ON_3fPoint>* lines = (const ON_SimpleArray<ON_3fPoint>*)[linesValue pointerValue];
+  
+  while (glGetError())
+    ;   // clear existing errors
+  
+  glGenBuffers(1, &vertexBuffer);
+  glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
+  glBufferData (GL_ARRAY_BUFFER, sizeof(ON_3fPoint)*vertexCount, lines->Array(), GL_STATIC_DRAW);
+  if (glGetError()) {
+    if (vertexBuffer)
+      glDeleteBuffers (1, &vertexBuffer);
+    vertexBuffer = 0;
+  }
+}
+
+- (id) initWithLines: (const ON_SimpleArray<ON_3fPoint>&) lines color: (ON_Color) aColor
+{
+  self = [super init];
+  if (self) {
+    color = aColor;
+    vertexCount = lines.Count();
+    if (vertexCount > 0) {
+      // OpenGL VBOs are created on the main thread unless this thread has a context of its own
+      NSValue* linesValue = [NSValue valueWithPointer: &lines];
+      if ([EAGLContext currentContext])
+        [self makeVBO: linesValue];
+      else
+        [self performSelectorOnMainThread: @selector(makeVBO:) withObject: linesValue waitUntilDone: YES];
+    }
+    if (vertexBuffer == 0) {
+      [self release];
+      return nil;
+    }
+  }
+  return self;
+}
+
+- (void) dealloc
+{
+  if (vertexBuffer)
+    glDeleteBuffers (1, &vertexBuffer);
+  [super dealloc];
+}
+
+- (size_t) gpuBytes
+{
+  return vertexBuffer ? vertexCount*sizeof(ON_3fPoint) : 0;
+}
+
+@end
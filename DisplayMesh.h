@@ -19,23 +19,9 @@
 
 #include "ESRenderer.h"
 
-typedef struct {
-  ON_3fPoint    vertex;
-  ON_3fVector    normal;
-} VertexData;
-
-typedef struct {
-  ON_3fPoint    vertex;
-  ON_3fVector   normal;
-  ON_4fPoint    color;
-} VNCData;
-
-typedef struct {
-  ON_3fPoint    vertex;
-  ON_4fPoint    color;
-} VCData;
-
+#include "RhDisplayData.h"
 
+class CRhRasterScene;
 
 @interface DisplayMesh : NSObject {
 
@@ -59,6 +45,16 @@ typedef struct {
   unsigned int normalBuffer;
   unsigned int indexBuffer;
   
+  // Meshes with identical geometry share the VBOs of the first one created.
+  // Shared VBOs hold vertices relative to the mesh's bounding box corner,
+  // which is drawn at instanceOffset.
+  DisplayMesh* sharedMesh;
+  ON_3fVector instanceOffset;
+  
+  // Meshes that can be evicted keep their VBO data in this file, see RhMeshResidency
+  NSString* cacheFile;
+  unsigned int lastDrawnFrame;
+  
   bool captureVBOData;
   NSData* vertexBufferData;
   NSData* normalBufferData;
@@ -78,8 +74,18 @@ typedef struct {
 
 @property (nonatomic, assign) ON_Color pickColor;
 @property (nonatomic, assign) BOOL selected;
+@property (nonatomic, readonly) ON_3fVector instanceOffset;
+@property (nonatomic, readonly) ON_BoundingBox boundingBox;     // world coordinates, used for view frustum culling
+@property (nonatomic, copy) NSString* cacheFile;
+@property (nonatomic, assign) unsigned int lastDrawnFrame;
 
 - (id) initWithMesh: (const ON_Mesh*) mesh index: (int) index material: (const ON_Material&) material saveVBOData: (BOOL) saveVBOData;
+
+// Meshes that can share VBOs with other meshes of the same shape.  Keys compare
+// equal only when the quantized geometry they hold is equal, see DisplayMesh.mm.
++ (NSData*) geometryKeyForMesh: (const ON_Mesh*) mesh offset: (ON_3fVector*) offset;
+- (id) initWithMesh: (const ON_Mesh*) mesh offset: (const ON_3fVector&) offset material: (const ON_Material&) material saveVBOData: (BOOL) saveVBOData;
+- (id) initWithMesh: (const ON_Mesh*) mesh sharingBuffersOf: (DisplayMesh*) shared offset: (const ON_3fVector&) offset material: (const ON_Material&) material;
 - (void) restoreUsingMesh: (const ON_Mesh*) onMesh material: (const ON_Material&) onMaterial;
 
 - (unsigned int) triangleCount;
@@ -95,4 +101,20 @@ typedef struct {
 - (void) reloadVBOData;
 - (void) deleteVBOData;
 
+// Memory use
+- (DisplayMesh*) bufferOwner;     // the mesh whose OpenGL buffers this mesh draws
+- (BOOL) isResident;              // YES if the OpenGL buffers exist
+- (size_t) gpuBytes;              // size of the OpenGL buffers this mesh owns
+- (size_t) cpuBytes;              // size of the VBO data captured for caches
+
+// Adds the VBO data kept since the mesh was created, or the data of the mesh whose
+// buffers it shares, to scene.  The scene refers to the data until deleteVBOData.
+- (BOOL) addToRasterScene: (CRhRasterScene*) scene;
+
+// Evicted meshes have no OpenGL buffers until they are restored from cacheFile.
+// The OpenGL calls are made on the calling thread.
+- (BOOL) writeBuffersToFile: (NSString*) path;
+- (void) evictBuffers;
+- (BOOL) restoreBuffers;
+
 @end
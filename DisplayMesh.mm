@@ -19,16 +19,140 @@
 #import <OpenGLES/ES1/gl.h>
 #import <OpenGLES/ES1/glext.h>
 
+#include "RhScratchArena.h"
+#include "RhSoftwareRasterizer.h"
+#include <pthread.h>
+
+
+// Vertex and index data that cannot be written to a mapped buffer is only needed until
+// glBufferData() copies it, so it comes from an arena that makeVBOs: resets after each
+// mesh.  VBOs are made on the main thread or on a thread with an upload context, see
+// RhModel, so each thread that makes them has its own arena.
+static pthread_once_t g_arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_arena_key;
+
+static void DeleteArena (void* arena)
+{
+  delete (CRhScratchArena*) arena;
+}
+
+static void CreateArenaKey()
+{
+  pthread_key_create (&g_arena_key, DeleteArena);
+}
+
+static CRhScratchArena& UploadArena()
+{
+  pthread_once (&g_arena_once, CreateArenaKey);
+  CRhScratchArena* arena = (CRhScratchArena*) pthread_getspecific (g_arena_key);
+  if (arena == NULL) {
+    arena = new CRhScratchArena;
+    pthread_setspecific (g_arena_key, arena);
+  }
+  return *arena;
+}
+
+
+// Vertex and index data is written once, straight into the place it ends up: the
+// NSData that is kept when captureVBOData is set, otherwise the OpenGL buffer itself
+// mapped with GL_OES_mapbuffer.  Only when the buffer cannot be mapped is the data
+// written to the arena and copied by glBufferData().
+typedef struct {
+  GLenum target;
+  GLsizeiptr size;
+  NSMutableData* data;        // captured VBO data
+  bool mapped;
+} RhBufferWrite;
+
+static bool CanMapBuffers()
+{
+  static int canMap = -1;
+  if (canMap < 0) {
+    const char* extensions = (const char*) glGetString (GL_EXTENSIONS);
+    canMap = (extensions && strstr (extensions, "GL_OES_mapbuffer")) ? 1 : 0;
+  }
+  return canMap != 0;
+}
+
+// Creates *buffer and returns memory for its size bytes, or NULL if it fails.
+// Mapped memory is write only and write combined; fill it front to back.
+static void* BeginBufferWrite (RhBufferWrite& w, GLenum target, GLuint* buffer, size_t size, bool capture)
+{
+  w.target = target;
+  w.size = (GLsizeiptr) size;
+  w.data = nil;
+  w.mapped = false;
+  if (size == 0)
+    return NULL;
+  
+  while (glGetError())
+    ;   // clear existing errors
+  
+  glGenBuffers (1, buffer);
+  glBindBuffer (target, *buffer);
+  
+  void* bytes = NULL;
+  if (capture) {
+    w.data = [[NSMutableData alloc] initWithLength: size];
+    bytes = [w.data mutableBytes];
+  }
+  else if (CanMapBuffers()) {
+    glBufferData (target, w.size, NULL, GL_STATIC_DRAW);
+    bytes = glMapBufferOES (target, GL_WRITE_ONLY_OES);
+    w.mapped = (bytes != NULL);
+  }
+  if (bytes == NULL)
+    bytes = UploadArena().Allocate (size);
+  
+  if (bytes == NULL || glGetError()) {
+    if (w.mapped)
+      glUnmapBufferOES (target);
+    if (*buffer)
+      glDeleteBuffers (1, buffer);
+    *buffer = 0;
+    [w.data release];
+    w.data = nil;
+    return NULL;
+  }
+  return bytes;
+}
+
+// Finishes the buffer started by BeginBufferWrite().  When the VBO data was captured
+// *capturedData gets it.
+static bool EndBufferWrite (RhBufferWrite& w, GLuint* buffer, const void* bytes, NSData** capturedData)
+{
+  bool rc = true;
+  if (w.mapped)
+    rc = (glUnmapBufferOES (w.target) == GL_TRUE);    // GL_FALSE if the contents were lost
+  else
+    glBufferData (w.target, w.size, bytes, GL_STATIC_DRAW);
+  
+  if (!rc || glGetError()) {
+    if (*buffer)
+      glDeleteBuffers (1, buffer);
+    *buffer = 0;
+    [w.data release];
+    return false;
+  }
+  if (w.data)
+    *capturedData = w.data;
+  return true;
+}
 
 
 @implementation DisplayMesh
 
 @synthesize captureVBOData;
 @synthesize vertexBuffer, normalBuffer, indexBuffer, material, isClosed, hasVertexNormals, hasVertexColors, Stride;
-@synthesize pickColor, selected;
+@synthesize pickColor, selected, instanceOffset, boundingBox, cacheFile, lastDrawnFrame;
 
 - (void) deleteBuffers
 {
+  if (sharedMesh) {
+    // the buffers belong to sharedMesh
+    vertexBuffer = normalBuffer = indexBuffer = 0;
+    return;
+  }
   if (vertexBuffer)
     glDeleteBuffers (1, &vertexBuffer);
   if (normalBuffer)
@@ -54,12 +178,31 @@
 {
   [self deleteBuffers];
   [self deleteVBOData];
+  [sharedMesh release];
+  [cacheFile release];
   [super dealloc];
 }
 
 
 #pragma mark Accessors
 
+// Meshes sharing the VBOs of another mesh draw its current buffers, which
+// change when that mesh is evicted and restored.
+- (unsigned int) vertexBuffer
+{
+  return sharedMesh ? sharedMesh->vertexBuffer : vertexBuffer;
+}
+
+- (unsigned int) normalBuffer
+{
+  return sharedMesh ? sharedMesh->normalBuffer : normalBuffer;
+}
+
+- (unsigned int) indexBuffer
+{
+  return sharedMesh ? sharedMesh->indexBuffer : indexBuffer;
+}
+
 - (BOOL) hasVertexNormals
 {
   return hasVertexNormals;
@@ -96,24 +239,25 @@
 {
   const ON_MeshPartition* partition = mesh->Partition();
   const struct ON_MeshPart& part = partition->m_part[idx];
-
-  while (glGetError())
-    ;   // clear existing errors
   
   stride = sizeof(ON_3fPoint);
-  glGenBuffers(1, &vertexBuffer);
   vertexIndexCount = part.vertex_count;
-  glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
-  glBufferData (GL_ARRAY_BUFFER, stride*vertexIndexCount, &mesh->m_V[part.vi[0]], GL_STATIC_DRAW);
-  if (glGetError()) {
-    if (vertexBuffer)
-      glDeleteBuffers (1, &vertexBuffer);
-    vertexBuffer = 0;
+  
+  RhBufferWrite w;
+  ON_3fPoint* v = (ON_3fPoint*) BeginBufferWrite (w, GL_ARRAY_BUFFER, &vertexBuffer, stride*vertexIndexCount, captureVBOData);
+  if (v == NULL)
     return false;
+  
+  // shared VBOs hold vertices relative to instanceOffset
+  const ON_3fPoint* points = &mesh->m_V[part.vi[0]];
+  if (instanceOffset.x != 0.0f || instanceOffset.y != 0.0f || instanceOffset.z != 0.0f) {
+    for (int idx=0; idx<vertexIndexCount; idx++)
+      v[idx] = points[idx] - instanceOffset;
   }
-  if (captureVBOData)
-    vertexBufferData = [[NSData alloc] initWithBytes: &mesh->m_V[part.vi[0]] length: stride*vertexIndexCount];
-  return true;
+  else
+    memcpy (v, points, stride*vertexIndexCount);
+  
+  return EndBufferWrite (w, &vertexBuffer, v, &vertexBufferData);
 }
 
 
@@ -143,24 +287,15 @@
   const ON_MeshPartition* partition = mesh->Partition();
   const struct ON_MeshPart& part = partition->m_part[idx];
   
-  while (glGetError())
-    ;   // clear existing errors
-  
   stride = sizeof(ON_3fVector);
-  glGenBuffers (1, &normalBuffer);
   vertexIndexCount = part.vertex_count;
-    
-  glBindBuffer (GL_ARRAY_BUFFER, normalBuffer);
-  glBufferData (GL_ARRAY_BUFFER, stride*vertexIndexCount, mesh->m_N[part.vi[0]], GL_STATIC_DRAW);
-  if (glGetError()) {
-    if (normalBuffer)
-      glDeleteBuffers (1, &normalBuffer);
-    normalBuffer = 0;
+  
+  RhBufferWrite w;
+  ON_3fVector* n = (ON_3fVector*) BeginBufferWrite (w, GL_ARRAY_BUFFER, &normalBuffer, stride*vertexIndexCount, captureVBOData);
+  if (n == NULL)
     return false;
-  }
-  if (captureVBOData)
-    normalBufferData = [[NSData alloc] initWithBytes: &mesh->m_N[part.vi[0]] length: stride*vertexIndexCount];
-  return true;
+  memcpy (n, &mesh->m_N[part.vi[0]], stride*vertexIndexCount);
+  return EndBufferWrite (w, &normalBuffer, n, &normalBufferData);
 }
 
 
@@ -189,38 +324,16 @@
   const ON_MeshPartition* partition = mesh->Partition();
   const struct ON_MeshPart& part = partition->m_part[idx];
   
-  // Create a temporary buffer to hold the VertexData array
+  // interleave straight into the buffer
   stride = sizeof(VertexData);
   vertexIndexCount = part.vertex_count;
-  VertexData* v = (VertexData*) calloc (vertexIndexCount, stride);
+  RhBufferWrite w;
+  VertexData* v = (VertexData*) BeginBufferWrite (w, GL_ARRAY_BUFFER, &vertexBuffer, stride*vertexIndexCount, captureVBOData);
   if (v == NULL)
     return false;
-  for (int idx=0; idx<vertexIndexCount; idx++) {
-    v[idx].vertex = mesh->m_V[part.vi[0]+idx];
-    v[idx].normal = mesh->m_N[part.vi[0]+idx];
-  }
-
-  // create VBO
-  while (glGetError())
-    ;   // clear existing errors
-  
-  glGenBuffers (1, &vertexBuffer);
-  glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
-  glBufferData (GL_ARRAY_BUFFER, stride*vertexIndexCount, v, GL_STATIC_DRAW);
-
-  // check for errors
-  if (glGetError()) {
-    if (vertexBuffer)
-      glDeleteBuffers (1, &vertexBuffer);
-    vertexBuffer = 0;
-    free (v);
-    return false;
-  }
+  RhGetVertexData (*mesh, part, instanceOffset, v);
   
-  if (captureVBOData)
-    vertexAndNormalBufferData = [[NSData alloc] initWithBytes: v length: stride*vertexIndexCount];
-  free (v);
-  return true;
+  return EndBufferWrite (w, &vertexBuffer, v, &vertexAndNormalBufferData);
 }
 
 
@@ -249,45 +362,16 @@
   const ON_MeshPartition* partition = mesh->Partition();
   const struct ON_MeshPart& part = partition->m_part[idx];
   
-  // Create a temporary buffer to hold the VertexData array
+  // interleave straight into the buffer
   stride = sizeof(VNCData);
   vertexIndexCount = part.vertex_count;
-  VNCData* v = (VNCData*) calloc (vertexIndexCount, stride);
+  RhBufferWrite w;
+  VNCData* v = (VNCData*) BeginBufferWrite (w, GL_ARRAY_BUFFER, &vertexBuffer, stride*vertexIndexCount, captureVBOData);
   if (v == NULL)
     return false;
-  for (int idx=0; idx<vertexIndexCount; idx++) {
-    v[idx].vertex = mesh->m_V[part.vi[0]+idx];
-    v[idx].normal = mesh->m_N[part.vi[0]+idx];
-    
-    ON_Color  c = mesh->m_C[part.vi[0]+idx];
-    
-    v[idx].color.x = c.FractionRed();
-    v[idx].color.y = c.FractionGreen();
-    v[idx].color.z = c.FractionBlue();
-    v[idx].color.w = c.FractionAlpha();
-  }
-  
-  // create VBO
-  while (glGetError())
-    ;   // clear existing errors
-  
-  glGenBuffers (1, &vertexBuffer);
-  glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
-  glBufferData (GL_ARRAY_BUFFER, stride*vertexIndexCount, v, GL_STATIC_DRAW);
-  
-  // check for errors
-  if (glGetError()) {
-    if (vertexBuffer)
-      glDeleteBuffers (1, &vertexBuffer);
-    vertexBuffer = 0;
-    free (v);
-    return false;
-  }
+  RhGetVNCData (*mesh, part, instanceOffset, v);
   
-  if (captureVBOData)
-    vertexAndNormalBufferData = [[NSData alloc] initWithBytes: v length: stride*vertexIndexCount];
-  free (v);
-  return true;
+  return EndBufferWrite (w, &vertexBuffer, v, &vertexAndNormalBufferData);
 }
 
 // Create a OpenGL VBO containing vertices and colors from the ON_Mesh mesh object
@@ -296,127 +380,40 @@
   const ON_MeshPartition* partition = mesh->Partition();
   const struct ON_MeshPart& part = partition->m_part[idx];
   
-  // Create a temporary buffer to hold the VertexData array
+  // interleave straight into the buffer
   stride = sizeof(VCData);
   vertexIndexCount = part.vertex_count;
-  VCData* v = (VCData*) calloc (vertexIndexCount, stride);
+  RhBufferWrite w;
+  VCData* v = (VCData*) BeginBufferWrite (w, GL_ARRAY_BUFFER, &vertexBuffer, stride*vertexIndexCount, captureVBOData);
   if (v == NULL)
     return false;
-  for (int idx=0; idx<vertexIndexCount; idx++) {
-    v[idx].vertex = mesh->m_V[part.vi[0]+idx];
-    
-    ON_Color  c = mesh->m_C[part.vi[0]+idx];
-    
-    v[idx].color.x = c.FractionRed();
-    v[idx].color.y = c.FractionGreen();
-    v[idx].color.z = c.FractionBlue();
-    v[idx].color.w = c.FractionAlpha();
-  }
-  
-  // create VBO
-  while (glGetError())
-    ;   // clear existing errors
+  RhGetVCData (*mesh, part, instanceOffset, v);
   
-  glGenBuffers (1, &vertexBuffer);
-  glBindBuffer (GL_ARRAY_BUFFER, vertexBuffer);
-  glBufferData (GL_ARRAY_BUFFER, stride*vertexIndexCount, v, GL_STATIC_DRAW);
-  
-  // check for errors
-  if (glGetError()) {
-    if (vertexBuffer)
-      glDeleteBuffers (1, &vertexBuffer);
-    vertexBuffer = 0;
-    free (v);
-    return false;
-  }
-  
-  if (captureVBOData)
-    vertexAndNormalBufferData = [[NSData alloc] initWithBytes: v length: stride*vertexIndexCount];
-  free (v);
-  return true;
+  return EndBufferWrite (w, &vertexBuffer, v, &vertexAndNormalBufferData);
 }
 
 
 // Create a OpenGL VBO for the array indices of the ON_Mesh mesh object described by part idx.
 - (bool) createIndexVBO: (const ON_Mesh*) mesh index: (int) idx
 {
-  int i0, i1, i2, j0, j1, j2;
-  
   const ON_MeshPartition* partition = mesh->Partition();
   const struct ON_MeshPart& part = partition->m_part[idx];
   
   triangleCount = part.triangle_count;
   vertexIndexCount = part.vertex_count;
   
-  int actualTriangleCount = 0;
-  // allocate array of unsigned shorts for vertex indexes
-  unsigned short* vertexIndexes = (unsigned short*) malloc (triangleCount * 3 * sizeof (unsigned short));
+  const size_t indexCount = 3*triangleCount;
+  RhBufferWrite w;
+  unsigned short* vertexIndexes = (unsigned short*) BeginBufferWrite (w, GL_ELEMENT_ARRAY_BUFFER, &indexBuffer, indexCount*sizeof (unsigned short), captureVBOData);
   if (vertexIndexes == NULL)
     return false;
-
-  unsigned short* indexes = vertexIndexes;
-  for (unsigned int fi = part.fi[0]; fi < part.fi[1]; fi++) {
-    const ON_MeshFace& f = mesh->m_F[fi];
-    if (f.IsValid (part.vi[1])) {
-      if (f.IsQuad()) {
-        // quadrangle - render as two triangles
-        ON_3fPoint v[4];
-        v[0] = mesh->m_V[f.vi[0]];
-        v[1] = mesh->m_V[f.vi[1]];
-        v[2] = mesh->m_V[f.vi[2]];
-        v[3] = mesh->m_V[f.vi[3]];
-        if (v[0].DistanceTo(v[2]) <= v[1].DistanceTo(v[3])) {
-          i0 = 0; i1 = 1; i2 = 2;
-          j0 = 0; j1 = 2; j2 = 3;
-        }
-        else {
-          i0 = 1; i1 = 2; i2 = 3;
-          j0 = 1; j1 = 3; j2 = 0;
-        }
-      }
-      else {
-        // single triangle
-        i0 = 0; i1 = 1; i2 = 2;
-        j0 = j1 = j2 = 0;
-      }
-      
-      // first triangle
-      *indexes++ = f.vi[i0]-part.vi[0];
-      *indexes++ = f.vi[i1]-part.vi[0];
-      *indexes++ = f.vi[i2]-part.vi[0];
-      actualTriangleCount++;
-      
-      if ( j0 != j1 ) {
-        // if we have a quad, second triangle
-        *indexes++ = f.vi[j0]-part.vi[0];
-        *indexes++ = f.vi[j1]-part.vi[0];
-        *indexes++ = f.vi[j2]-part.vi[0];
-        actualTriangleCount++;
-      }
-    }
-  }
-
-//  DLog (@"after short initialization, indexes:%p, &vertexIndexes[0]:%p &vertexIndexes[%d]:%p fits:%d actualTriangleCount:%d", indexes, vertexIndexes, 3*triangleCount, &vertexIndexes[3*(triangleCount)], indexes==&vertexIndexes[3*(triangleCount)], actualTriangleCount);
-
-  while (glGetError())
-    ;   // clear existing errors
   
-  glGenBuffers (1, &indexBuffer);
-  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-  glBufferData (GL_ELEMENT_ARRAY_BUFFER, 3 * triangleCount * sizeof (unsigned short), vertexIndexes, GL_STATIC_DRAW);
-
-  if (glGetError()) {
-    if (indexBuffer)
-      glDeleteBuffers (1, &indexBuffer);
-    indexBuffer = 0;
-    free (vertexIndexes);
-    return false;
-  }
+  // invalid faces are skipped; the unused end of the buffer draws degenerate triangles
+  const size_t writtenCount = 3*RhGetTriangleIndexes (*mesh, part, vertexIndexes);
+  if (writtenCount < indexCount)
+    memset (vertexIndexes + writtenCount, 0, (indexCount - writtenCount)*sizeof (unsigned short));
   
-  if (captureVBOData)
-    indexBufferData = [[NSData alloc] initWithBytes: vertexIndexes length: 3 * triangleCount * sizeof (unsigned short)];
-  free (vertexIndexes);
-  return true;
+  return EndBufferWrite (w, &indexBuffer, vertexIndexes, &indexBufferData);
 }
 
 
@@ -459,6 +456,7 @@
     rc = rc && [self createVertexVBO: mesh index: partitionIndex];
   
   rc = rc && [self createIndexVBO: mesh index: partitionIndex];
+  UploadArena().Reset();
 
   initializationFailed = ! rc;
   if (initializationFailed)
@@ -466,10 +464,11 @@
 }
 
 
-- (id) initWithMesh: (const ON_Mesh*) onMesh index: (int) index material: (const ON_Material&) onMaterial saveVBOData: (BOOL) saveVBOData
+- (id) initWithMesh: (const ON_Mesh*) onMesh index: (int) index offset: (const ON_3fVector&) offset material: (const ON_Material&) onMaterial saveVBOData: (BOOL) saveVBOData
 {
   self = [super init];
   if (self) {
+    instanceOffset = offset;
     material = onMaterial;
     partitionIndex = index;
     boundingBox = onMesh->BoundingBox();
@@ -483,8 +482,13 @@
     if ( onMesh->IsClosed() )
       isClosed = YES;
     
-    // OpenGL VBOs must be created on the main thread, so do that and wait for it to finish
-    [self performSelectorOnMainThread: @selector(makeVBOs:) withObject: [NSValue valueWithPointer: onMesh] waitUntilDone: YES];
+    // OpenGL VBOs are created on the main thread unless this thread has a context of
+    // its own in the renderer's sharegroup, like the upload context RhModel reads with
+    NSValue* meshValue = [NSValue valueWithPointer: onMesh];
+    if ([EAGLContext currentContext])
+      [self makeVBOs: meshValue];
+    else
+      [self performSelectorOnMainThread: @selector(makeVBOs:) withObject: meshValue waitUntilDone: YES];
 
     if (initializationFailed) {
       [self release];
@@ -495,6 +499,153 @@
   return self;
 }
 
+- (id) initWithMesh: (const ON_Mesh*) onMesh index: (int) index material: (const ON_Material&) onMaterial saveVBOData: (BOOL) saveVBOData
+{
+  return [self initWithMesh: onMesh index: index offset: ON_3fVector(0,0,0) material: onMaterial saveVBOData: saveVBOData];
+}
+
+// Create VBOs that can be shared by other meshes with the same geometry key.
+// The mesh must fit in a single partition.
+- (id) initWithMesh: (const ON_Mesh*) onMesh offset: (const ON_3fVector&) offset material: (const ON_Material&) onMaterial saveVBOData: (BOOL) saveVBOData
+{
+  return [self initWithMesh: onMesh index: 0 offset: offset material: onMaterial saveVBOData: saveVBOData];
+}
+
+// Draw the VBOs of shared, which was created from a mesh with the same geometry key, at offset
+- (id) initWithMesh: (const ON_Mesh*) onMesh sharingBuffersOf: (DisplayMesh*) shared offset: (const ON_3fVector&) offset material: (const ON_Material&) onMaterial
+{
+  self = [super init];
+  if (self) {
+    sharedMesh = [shared retain];
+    instanceOffset = offset;
+    material = onMaterial;
+    partitionIndex = 0;
+    boundingBox = onMesh->BoundingBox();
+    hasVertexNormals = shared->hasVertexNormals;
+    hasVertexColors = shared->hasVertexColors;
+    isClosed = shared->isClosed;
+    stride = shared->stride;
+    vertexIndexCount = shared->vertexIndexCount;
+    triangleCount = shared->triangleCount;
+    vertexBuffer = shared->vertexBuffer;
+    normalBuffer = shared->normalBuffer;
+    indexBuffer = shared->indexBuffer;
+    pickColor.SetFractionalRGBA((float)rand()/RAND_MAX,(float)rand()/RAND_MAX,(float)rand()/RAND_MAX,1.0);
+  }
+  return self;
+}
+
+#pragma mark Shared Geometry
+
+// A geometry key is this header followed by the quantized geometry itself, so
+// NSDictionary, which compares keys with -isEqual: once their hashes match, only
+// shares buffers between meshes whose quantized vertices, normals, colors and faces
+// are all equal.  The hash comes first because -[NSData hash] only looks at the
+// first bytes.
+typedef struct {
+  ON__UINT64 hash[2];
+  int vertexCount;
+  int faceCount;
+  int hasNormals;
+  int hasColors;
+  int gridExponent;
+  int reserved;
+} MeshGeometryKey;
+
+// Two independent 64 bit hashes so a collision needs both to match
+static inline void HashGeometryValue (ON__UINT64* hash, ON__INT64 value)
+{
+  hash[0] = (hash[0] ^ (ON__UINT64)value) * 0x100000001B3ULL;
+  hash[1] = (hash[1] + (ON__UINT64)value) * 0x9E3779B97F4A7C15ULL;
+  hash[1] ^= hash[1] >> 29;
+}
+
+static inline ON__INT32* AppendGeometryValue (ON__INT32* p, ON__UINT64* hash, ON__INT64 value)
+{
+  HashGeometryValue (hash, value);
+  *p = (ON__INT32) value;
+  return p+1;
+}
+
+static inline ON__INT64 QuantizeGeometryValue (double value)
+{
+  return (ON__INT64) floor (value + 0.5);
+}
+
+// Returns a key that is identical for meshes that differ only by a translation,
+// or nil if the mesh is too large to share VBOs.  offset is set to the
+// translation of this mesh, the corner of its bounding box.
+//
+// Copies of a mesh at different locations are not bit-for-bit identical relative
+// to their corners, so vertices are snapped to a grid of about 1e-5 of the
+// bounding box diagonal, a power of two so copies get the same grid.  Meshes with
+// the same key can differ by half a grid step per coordinate and by 1/2048 per
+// normal component, far below what can be seen on screen.
++ (NSData*) geometryKeyForMesh: (const ON_Mesh*) mesh offset: (ON_3fVector*) offset
+{
+  const int vertexCount = mesh->VertexCount();
+  const int faceCount = mesh->FaceCount();
+  if (vertexCount <= 0 || vertexCount > USHRT_MAX-3 || faceCount <= 0)
+    return nil;
+  
+  ON_BoundingBox bbox = mesh->BoundingBox();
+  if (!bbox.IsValid())
+    return nil;
+  ON_3fPoint origin (bbox.m_min);
+  *offset = ON_3fVector (origin.x, origin.y, origin.z);
+  
+  int gridExponent = 0;
+  frexp (bbox.Diagonal().Length() * 1.0e-5, &gridExponent);
+  if (gridExponent < -40)
+    gridExponent = -40;
+  const double scale = ldexp (1.0, -gridExponent);     // 1/grid
+  
+  const BOOL hasNormals = mesh->HasVertexNormals();
+  const BOOL hasColors = mesh->HasVertexColors();
+  const size_t valueCount = 3*(size_t)vertexCount + (hasNormals ? 3*(size_t)vertexCount : 0) + (hasColors ? (size_t)vertexCount : 0) + 4*(size_t)faceCount;
+  NSMutableData* data = [NSMutableData dataWithLength: sizeof(MeshGeometryKey) + valueCount*sizeof(ON__INT32)];
+  if (data == nil)
+    return nil;
+  
+  MeshGeometryKey key;
+  memset (&key, 0, sizeof(key));
+  key.vertexCount = vertexCount;
+  key.faceCount = faceCount;
+  key.hasNormals = hasNormals;
+  key.hasColors = hasColors;
+  key.gridExponent = gridExponent;
+  key.hash[0] = 0xCBF29CE484222325ULL;
+  key.hash[1] = 0x84222325CBF29CE4ULL;
+  
+  ON__INT32* p = (ON__INT32*)((unsigned char*)[data mutableBytes] + sizeof(MeshGeometryKey));
+  for (int vi = 0; vi < vertexCount; vi++) {
+    const ON_3fPoint& v = mesh->m_V[vi];
+    p = AppendGeometryValue (p, key.hash, QuantizeGeometryValue ((v.x - origin.x)*scale));
+    p = AppendGeometryValue (p, key.hash, QuantizeGeometryValue ((v.y - origin.y)*scale));
+    p = AppendGeometryValue (p, key.hash, QuantizeGeometryValue ((v.z - origin.z)*scale));
+  }
+  if (hasNormals) {
+    for (int vi = 0; vi < vertexCount; vi++) {
+      const ON_3fVector& n = mesh->m_N[vi];
+      p = AppendGeometryValue (p, key.hash, QuantizeGeometryValue (n.x*1024.0));
+      p = AppendGeometryValue (p, key.hash, QuantizeGeometryValue (n.y*1024.0));
+      p = AppendGeometryValue (p, key.hash, QuantizeGeometryValue (n.z*1024.0));
+    }
+  }
+  if (hasColors) {
+    for (int vi = 0; vi < vertexCount; vi++)
+      p = AppendGeometryValue (p, key.hash, (ON__INT32)(unsigned int) mesh->m_C[vi]);
+  }
+  for (int fi = 0; fi < faceCount; fi++) {
+    const ON_MeshFace& f = mesh->m_F[fi];
+    for (int i = 0; i < 4; i++)
+      p = AppendGeometryValue (p, key.hash, f.vi[i]);
+  }
+  
+  memcpy ([data mutableBytes], &key, sizeof(key));
+  return data;
+}
+
 - (void) restoreUsingMesh: (const ON_Mesh*) onMesh material: (const ON_Material&) onMaterial
 {
   // these variables are hard to archive so we restore them when reloading the model
@@ -502,6 +653,100 @@
   boundingBox = onMesh->BoundingBox();
 }
 
+#pragma mark Preview
+
+- (BOOL) addToRasterScene: (CRhRasterScene*) scene
+{
+  // the buffers makeVBOs: writes, relative to each mesh's own instanceOffset
+  DisplayMesh* owner = [self bufferOwner];
+  NSData* vertices = owner->vertexAndNormalBufferData ? owner->vertexAndNormalBufferData : owner->vertexBufferData;
+  if (vertices == nil || owner->indexBufferData == nil)
+    return NO;
+  return scene->AddDisplayBuffers ([vertices bytes], owner->vertexIndexCount, hasVertexNormals, hasVertexColors,
+                                   (const unsigned short*) [owner->indexBufferData bytes], owner->triangleCount,
+                                   instanceOffset, material);
+}
+
+#pragma mark Residency
+
+- (DisplayMesh*) bufferOwner
+{
+  return sharedMesh ? sharedMesh : self;
+}
+
+- (BOOL) isResident
+{
+  return [self vertexBuffer] != 0 && [self indexBuffer] != 0;
+}
+
+- (size_t) gpuBytes
+{
+  if (sharedMesh || ![self isResident])
+    return 0;
+  size_t bytes = stride*vertexIndexCount + 3*triangleCount*sizeof(unsigned short);
+  if (normalBuffer)
+    bytes += sizeof(ON_3fVector)*vertexIndexCount;
+  return bytes;
+}
+
+- (size_t) cpuBytes
+{
+  return [vertexBufferData length] + [normalBufferData length] + [vertexAndNormalBufferData length] + [indexBufferData length];
+}
+
+// Writes the VBO data captured when the mesh was created
+- (BOOL) writeBuffersToFile: (NSString*) path
+{
+  if (sharedMesh || indexBufferData == nil)
+    return NO;
+  NSMutableDictionary* buffers = [NSMutableDictionary dictionaryWithCapacity: 4];
+  if (vertexBufferData)
+    [buffers setObject: vertexBufferData forKey: @"IRVertexBufferData"];
+  if (normalBufferData)
+    [buffers setObject: normalBufferData forKey: @"IRNormalBufferData"];
+  if (vertexAndNormalBufferData)
+    [buffers setObject: vertexAndNormalBufferData forKey: @"IRVertexAndNormalBufferData"];
+  [buffers setObject: indexBufferData forKey: @"IRIndexBufferData"];
+  return [NSKeyedArchiver archiveRootObject: buffers toFile: path];
+}
+
+- (void) evictBuffers
+{
+  if (sharedMesh || cacheFile == nil)
+    return;
+  [self deleteBuffers];
+  vertexBuffer = normalBuffer = indexBuffer = 0;
+}
+
+- (BOOL) restoreBuffers
+{
+  if (sharedMesh || cacheFile == nil)
+    return NO;
+  if ([self isResident])
+    return YES;
+  
+  // this runs on the render thread, which has no autorelease pool of its own
+  NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+  NSDictionary* buffers = [NSKeyedUnarchiver unarchiveObjectWithFile: cacheFile];
+  vertexBufferData = [[buffers objectForKey: @"IRVertexBufferData"] retain];
+  normalBufferData = [[buffers objectForKey: @"IRNormalBufferData"] retain];
+  vertexAndNormalBufferData = [[buffers objectForKey: @"IRVertexAndNormalBufferData"] retain];
+  indexBufferData = [[buffers objectForKey: @"IRIndexBufferData"] retain];
+  const unsigned int meshStride = stride;     // reloadVBOData assumes meshes without colors
+  if (indexBufferData)
+    [self reloadVBOData];
+  stride = meshStride;
+  [self deleteVBOData];
+  [pool release];
+  
+  if (![self isResident]) {
+    [self deleteBuffers];
+    vertexBuffer = normalBuffer = indexBuffer = 0;
+    return NO;
+  }
+  return YES;
+}
+
 #pragma mark Archiving
 
 - (void) encodeWithCoder:(NSCoder *)aCoder
@@ -545,8 +790,11 @@
     triangleCount = [aDecoder decodeInt32ForKey: @"IRTriangleCount"];
     hasVertexNormals = [aDecoder decodeBoolForKey: @"IRHasVertexNormals"];
     
-    // OpenGL VBOs must be created on the main thread, so do that and wait for it to finish
-    [self performSelectorOnMainThread: @selector(reloadVBOData) withObject: nil waitUntilDone: YES];
+    // OpenGL VBOs are created on the main thread unless this thread has a context of its own
+    if ([EAGLContext currentContext])
+      [self reloadVBOData];
+    else
+      [self performSelectorOnMainThread: @selector(reloadVBOData) withObject: nil waitUntilDone: YES];
     
     [self deleteVBOData];
   }
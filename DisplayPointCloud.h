@@ -0,0 +1,70 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+//
+// This class draws a point cloud from its octree cache file.  Each frame it picks the octree
+// nodes that give the best detail for the view within a point budget, streams the points of
+// those nodes into OpenGL vertex buffer objects and frees the buffers of nodes that have not
+// been drawn for a while.  The nodes are read from the file on CRhJobSystem workers; the
+// render thread only uploads the nodes that are ready.
+//
+
+class CRhPointCloudOctree;
+struct RhNodeLoader;
+
+typedef struct {
+  ON_3fPoint    vertex;
+  ON_Color      color;
+} PointCloudVertex;
+
+
+@interface DisplayPointCloud : NSObject {
+
+  CRhPointCloudOctree* octree;
+  ON_Color color;                 // object color, used when the points have no colors
+
+  // OpenGL vertex buffers of the loaded nodes, 0 = not loaded
+  unsigned int* nodeBuffers;
+  unsigned int* nodeLastDrawn;    // frame number each node was last drawn
+  unsigned char* nodeStates;      // NodeState of each node that is not loaded
+  RhNodeLoader* loader;           // reads nodes on job system workers
+  int pendingLoadCount;           // nodes being read or waiting to be uploaded
+  unsigned int frameNumber;
+  long loadedPointCount;
+
+  ON_SimpleArray<int> drawNodes;  // loaded nodes picked for the current view
+}
+
+@property (nonatomic, readonly) ON_Color color;
+
+- (id) initWithCacheFile: (NSString*) path color: (ON_Color) color;
+
+- (BOOL) hasColors;
+- (long long) pointCount;
+- (unsigned long long) sourceKey;    // record the cache file was built from, see RhModel
+- (ON_BoundingBox) boundingBox;
+- (unsigned int) Stride;
+- (size_t) gpuBytes;              // size of the OpenGL buffers of the loaded nodes
+
+// Uploads the nodes read since the last frame, picks the nodes for a view and starts reading
+// the ones that are missing.  Returns YES if some picked nodes are still waiting to be loaded
+// and another frame should be drawn.
+- (BOOL) prepareForViewport: (const ON_Viewport&) viewport width: (int) width height: (int) height pointBudget: (int) pointBudget;
+
+- (int) drawNodeCount;
+- (unsigned int) vertexBufferForDrawNode: (int) idx;
+- (int) pointCountForDrawNode: (int) idx;
+
+@end
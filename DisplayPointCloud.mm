@@ -0,0 +1,328 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#import "DisplayPointCloud.h"
+#include "RhPointCloudOctree.h"
+#include "RhJobSystem.h"
+
+#import <OpenGLES/ES1/gl.h>
+#import <OpenGLES/ES1/glext.h>
+#include <pthread.h>
+
+
+// Nodes requested and not uploaded yet.  Reads queued for a view that has since changed
+// still run, so this keeps a fast moving view from queueing up reads it no longer needs.
+static const int MaxPendingNodeLoads = 32;
+
+// Bytes of node points uploaded to OpenGL per frame; at least one node is uploaded
+static const size_t MaxUploadBytesPerFrame = 4*1024*1024;
+
+// Buffers of nodes that were not drawn recently are freed when more points than this are loaded
+static const long MaxLoadedPointCount = 2000000;
+
+// Nodes are refined until neighboring points are about this many pixels apart
+static const double PointSpacing = 2.0;
+
+
+enum NodeState
+{
+  NodeNotRequested = 0,
+  NodeRequested,      // a job is reading it, or it waits in RhNodeLoader::finished
+  NodeFailed          // could not be read or has no points, never requested again
+};
+
+// Points of a node read by a job and waiting to be uploaded
+struct RhNodeData
+{
+  int node;
+  int pointCount;
+  void* vertices;     // onmalloc()ed PointCloudVertex or ON_3fPoint array, NULL if there is nothing to draw
+};
+
+// The jobs only touch the cache file and the finished list.  The OpenGL buffers and the node
+// states belong to the render thread.
+struct RhNodeLoader
+{
+  RhNodeLoader (CRhPointCloudOctree* tree)
+  : octree (tree)
+  {
+    pthread_mutex_init (&fileLock, NULL);
+    pthread_mutex_init (&finishedLock, NULL);
+  }
+  
+  ~RhNodeLoader()
+  {
+    group.Cancel();
+    group.Wait();
+    for (int idx=0; idx<finished.Count(); idx++)
+      onfree (finished[idx].vertices);
+    pthread_mutex_destroy (&finishedLock);
+    pthread_mutex_destroy (&fileLock);
+  }
+  
+  CRhJobGroup group;
+  CRhPointCloudOctree* octree;
+  pthread_mutex_t fileLock;             // CRhPointCloudOctree::ReadNode() is not thread safe
+  pthread_mutex_t finishedLock;
+  ON_SimpleArray<RhNodeData> finished;  // in the order the reads finished
+};
+
+// RhJobProc that reads and interleaves nodes first to last-1
+static void LoadNodesJob (void* context, int first, int last)
+{
+  RhNodeLoader* loader = (RhNodeLoader*) context;
+  for (int node=first; node<last; node++) {
+    ON_SimpleArray<ON_3fPoint> points;
+    ON_SimpleArray<ON_Color> colors;
+    pthread_mutex_lock (&loader->fileLock);
+    const bool rc = loader->octree->ReadNode (node, points, colors);
+    pthread_mutex_unlock (&loader->fileLock);
+    
+    RhNodeData data;
+    data.node = node;
+    data.pointCount = points.Count();
+    data.vertices = NULL;
+    if (rc && data.pointCount > 0) {
+      if (colors.Count() == data.pointCount) {
+        PointCloudVertex* interleaved = (PointCloudVertex*) onmalloc (data.pointCount*sizeof(PointCloudVertex));
+        if (interleaved) {
+          for (int idx=0; idx<data.pointCount; idx++) {
+            interleaved[idx].vertex = points[idx];
+            interleaved[idx].color = colors[idx];
+          }
+        }
+        data.vertices = interleaved;
+      }
+      else
+        data.vertices = points.KeepArray();
+    }
+    
+    pthread_mutex_lock (&loader->finishedLock);
+    loader->finished.Append (data);
+    pthread_mutex_unlock (&loader->finishedLock);
+  }
+}
+
+
+@implementation DisplayPointCloud
+
+@synthesize color;
+
+- (id) initWithCacheFile: (NSString*) path color: (ON_Color) aColor
+{
+  self = [super init];
+  if (self) {
+    color = aColor;
+    octree = new CRhPointCloudOctree;
+    if (!octree->Open ([path fileSystemRepresentation])) {
+      [self release];
+      return nil;
+    }
+    const int nodeCount = octree->NodeCount();
+    nodeBuffers = (unsigned int*) calloc (nodeCount, sizeof(unsigned int));
+    nodeLastDrawn = (unsigned int*) calloc (nodeCount, sizeof(unsigned int));
+    nodeStates = (unsigned char*) calloc (nodeCount, sizeof(unsigned char));
+    if (nodeBuffers == NULL || nodeLastDrawn == NULL || nodeStates == NULL) {
+      [self release];
+      return nil;
+    }
+    loader = new RhNodeLoader (octree);
+  }
+  return self;
+}
+
+- (void) dealloc
+{
+  delete loader;      // waits for the reads, before the octree goes away
+  if (nodeBuffers && octree) {
+    for (int idx=0; idx<octree->NodeCount(); idx++) {
+      if (nodeBuffers[idx])
+        glDeleteBuffers (1, &nodeBuffers[idx]);
+    }
+  }
+  free (nodeBuffers);
+  free (nodeLastDrawn);
+  free (nodeStates);
+  delete octree;
+  [super dealloc];
+}
+
+
+#pragma mark Accessors
+
+- (BOOL) hasColors
+{
+  return octree->HasColors();
+}
+
+- (long long) pointCount
+{
+  return octree->PointCount();
+}
+
+- (unsigned long long) sourceKey
+{
+  return octree->SourceKey();
+}
+
+- (ON_BoundingBox) boundingBox
+{
+  return octree->BoundingBox();
+}
+
+- (unsigned int) Stride
+{
+  return octree->HasColors() ? sizeof(PointCloudVertex) : sizeof(ON_3fPoint);
+}
+
+// The render thread loads and frees nodes, so this is a snapshot
+- (size_t) gpuBytes
+{
+  return [self Stride]*loadedPointCount;
+}
+
+- (int) drawNodeCount
+{
+  return drawNodes.Count();
+}
+
+- (unsigned int) vertexBufferForDrawNode: (int) idx
+{
+  return nodeBuffers[drawNodes[idx]];
+}
+
+- (int) pointCountForDrawNode: (int) idx
+{
+  return octree->NodePointCount(drawNodes[idx]);
+}
+
+
+#pragma mark Node VBOs
+
+- (void) uploadNode: (const RhNodeData&) data
+{
+  if (data.vertices == NULL) {
+    nodeStates[data.node] = NodeFailed;
+    return;
+  }
+
+  while (glGetError())
+    ;   // clear existing errors
+
+  unsigned int buffer = 0;
+  glGenBuffers (1, &buffer);
+  glBindBuffer (GL_ARRAY_BUFFER, buffer);
+  glBufferData (GL_ARRAY_BUFFER, [self Stride]*data.pointCount, data.vertices, GL_STATIC_DRAW);
+  if (glGetError()) {
+    if (buffer)
+      glDeleteBuffers (1, &buffer);
+    nodeStates[data.node] = NodeFailed;
+    return;
+  }
+
+  nodeBuffers[data.node] = buffer;
+  nodeStates[data.node] = NodeNotRequested;
+  loadedPointCount += data.pointCount;
+}
+
+// Uploads the nodes the jobs have read, oldest first, within MaxUploadBytesPerFrame
+- (void) uploadFinishedNodes
+{
+  ON_SimpleArray<RhNodeData> ready;
+  pthread_mutex_lock (&loader->finishedLock);
+  size_t bytes = 0;
+  int count = 0;
+  while (count < loader->finished.Count() && (count == 0 || bytes < MaxUploadBytesPerFrame)) {
+    bytes += [self Stride]*(size_t)loader->finished[count].pointCount;
+    count++;
+  }
+  ready.Append (count, loader->finished.Array());
+  const int remaining = loader->finished.Count() - count;
+  memmove (loader->finished.Array(), loader->finished.Array() + count, remaining*sizeof(RhNodeData));
+  loader->finished.SetCount (remaining);
+  pthread_mutex_unlock (&loader->finishedLock);
+
+  for (int idx=0; idx<ready.Count(); idx++) {
+    [self uploadNode: ready[idx]];
+    onfree (ready[idx].vertices);
+    pendingLoadCount--;
+  }
+}
+
+static int CompareLastDrawn (const ON_2dex* a, const ON_2dex* b)
+{
+  return a->j - b->j;
+}
+
+// Free the least recently drawn nodes until we are back under MaxLoadedPointCount
+- (void) unloadNodes
+{
+  if (loadedPointCount <= MaxLoadedPointCount)
+    return;
+
+  ON_SimpleArray<ON_2dex> candidates;   // i = node, j = frame last drawn
+  for (int node=0; node<octree->NodeCount(); node++) {
+    if (nodeBuffers[node] && nodeLastDrawn[node] != frameNumber) {
+      ON_2dex& candidate = candidates.AppendNew();
+      candidate.i = node;
+      candidate.j = (int) nodeLastDrawn[node];
+    }
+  }
+  candidates.QuickSort (CompareLastDrawn);
+
+  for (int idx=0; idx<candidates.Count() && loadedPointCount > MaxLoadedPointCount; idx++) {
+    const int node = candidates[idx].i;
+    glDeleteBuffers (1, &nodeBuffers[node]);
+    nodeBuffers[node] = 0;
+    loadedPointCount -= octree->NodePointCount(node);
+  }
+}
+
+
+#pragma mark Drawing
+
+- (BOOL) prepareForViewport: (const ON_Viewport&) viewport width: (int) width height: (int) height pointBudget: (int) pointBudget
+{
+  frameNumber++;
+  [self uploadFinishedNodes];
+
+  ON_SimpleArray<int> nodes;
+  octree->SelectNodes (viewport, width, height, pointBudget, PointSpacing, nodes);
+
+  // Nodes come parents first, so they are also read parents first, and a partly loaded
+  // selection is a coarser version of the full one rather than a hole in the cloud.
+  BOOL needsMoreFrames = NO;
+  drawNodes.SetCount(0);
+  for (int idx=0; idx<nodes.Count(); idx++) {
+    const int node = nodes[idx];
+    if (nodeBuffers[node] == 0) {
+      if (nodeStates[node] == NodeNotRequested && pendingLoadCount < MaxPendingNodeLoads) {
+        nodeStates[node] = NodeRequested;
+        pendingLoadCount++;
+        loader->group.Run (LoadNodesJob, loader, node, node+1);
+      }
+      if (nodeStates[node] != NodeFailed)
+        needsMoreFrames = YES;
+      continue;
+    }
+    nodeLastDrawn[node] = frameNumber;
+    drawNodes.Append(node);
+  }
+
+  [self unloadNodes];
+  return needsMoreFrames || pendingLoadCount > 0;
+}
+
+@end
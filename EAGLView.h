@@ -38,6 +38,10 @@
 	// isn't available.
 	id displayLink;
     NSTimer *animationTimer;
+  
+  // frame rate and render counters, shown when the IRShowFrameStats default is set
+  UILabel* frameStatsLabel;
+  NSTimer* frameStatsTimer;
 }
 
 @property (readonly, nonatomic, getter=isAnimating) BOOL animating;
@@ -18,6 +18,8 @@
 
 #import "ES1Renderer.h"
 #import "ES2Renderer.h"
+#import "RhModel.h"
+#include "RhMemoryUsage.h"
 
 @implementation EAGLView
 
@@ -164,12 +166,78 @@
   needsDisplay = false;
 }
 
+#pragma mark ---- frame statistics ----
+
+// The timer retains this view, so it only runs while the view is in a window
+- (void) willMoveToWindow: (UIWindow*) newWindow
+{
+  [super willMoveToWindow: newWindow];
+  
+  [frameStatsTimer invalidate];
+  frameStatsTimer = nil;
+  
+  if (newWindow && [RhinoApp showFrameStats]) {
+    if (frameStatsLabel == nil) {
+      frameStatsLabel = [[UILabel alloc] initWithFrame: CGRectMake (4, 4, 320, 106)];
+      frameStatsLabel.numberOfLines = 7;
+      frameStatsLabel.font = [UIFont fontWithName: @"Courier" size: 11];
+      frameStatsLabel.textColor = [UIColor whiteColor];
+      frameStatsLabel.backgroundColor = [UIColor colorWithWhite: 0.0 alpha: 0.5];
+      frameStatsLabel.userInteractionEnabled = NO;
+      [self addSubview: frameStatsLabel];
+    }
+    frameStatsTimer = [NSTimer scheduledTimerWithTimeInterval: 0.5 target: self selector: @selector(updateFrameStats:) userInfo: nil repeats: YES];
+  }
+  frameStatsLabel.hidden = (frameStatsTimer == nil);
+}
+
+- (void) updateFrameStats: (NSTimer*) timer
+{
+  CRhFrameStatsSummary stats;
+  [renderer getFrameStats: stats];
+  
+  NSMutableString* histogram = [NSMutableString stringWithString: @"ms"];
+  for (int i = 0; i < CRhFrameStatsSummary::bucket_count; i++) {
+    if (i < CRhFrameStatsSummary::bucket_count-1)
+      [histogram appendFormat: @" <%.0f:%d", CRhFrameStatsSummary::BucketLimit (i), stats.m_frame_ms_histogram[i]];
+    else
+      [histogram appendFormat: @" more:%d", stats.m_frame_ms_histogram[i]];
+  }
+  
+  // memory in MB
+  CRhMemoryUsage usage;
+  RhModel* model = RhinoApp.currentModel;
+  [model getMemoryUsage: usage];
+  const double MB = 1024.0*1024.0;
+  
+  const RhFrameCounters& avg = stats.m_average;
+  frameStatsLabel.text = [NSString stringWithFormat:
+                          @"%.1f fps  %.1f ms  95%% %.1f ms  %s\n"
+                          "submit %.1f ms (max %.1f)  present %.1f ms\n"
+                          "%d draws  %d changes  %lld tris\n"
+                          "%d drawn  %d culled  %lld coalesced\n"
+                          "%@\n"
+                          "mem %.1f MB  est %.1f  temp %.1f\n"
+                          "tbl %.1f mesh %.1f+%.1f crv %.1f pts %.1f pick %.1f",
+                          stats.m_frames_per_second, stats.m_frame_ms_median, stats.m_frame_ms_95th, stats.Bottleneck (),
+                          avg.submit_ms, stats.m_maximum.submit_ms, avg.present_ms,
+                          avg.draw_calls, avg.state_changes, (long long) avg.triangles,
+                          avg.drawn_objects, avg.culled_objects, (long long) stats.m_coalesced_count,
+                          histogram,
+                          usage.Total ()/MB, model.estimatedBytes/MB, usage.m_temporary_bytes/MB,
+                          usage.m_model_tables/MB, usage.m_mesh_buffers/MB, usage.m_mesh_buffer_data/MB,
+                          usage.m_curve_buffers/MB, usage.m_point_cloud_buffers/MB, usage.m_pick_bitmaps/MB];
+}
+
 - (void) dealloc
 {
   [displayLink invalidate];
   displayLink = nil;
   [animationTimer invalidate];
   animationTimer = nil;
+  [frameStatsTimer invalidate];
+  frameStatsTimer = nil;
+  [frameStatsLabel release];
   [renderer release];
   [super dealloc];
 }
@@ -45,9 +45,12 @@
   
   ON_Color backgroundColor;
 
-  // OpenGL names for the double-sized texture buffer
+  // OpenGL names for the view sized texture buffer the scene is drawn into...
   GLuint textureFramebuffer, texture, textureDepthbuffer;
   
+  // ...and for the texture the antialiasing samples of a still view are averaged in
+  GLuint accumFramebuffer, accumTexture;
+  
 	// The pixel dimensions of the texture
 	GLint textureWidth;
 	GLint textureHeight;
@@ -55,11 +58,18 @@
   NSThread* renderThread;
   
   // coordinate render requests
-  BOOL performingRender;
+  CRhTripleBuffer<RhFrameState>* frameState;  // main thread publishes, render thread draws the newest
+  volatile int32_t frameRequested;             // 1 while a renderFrame is scheduled
   int  stereoConfig;
-  ON_Viewport renderViewport1;
-  ON_Viewport renderViewport2;
-  RhModel* renderModel;
+  BOOL frameFastDrawing;    // fastDrawing of the frame being drawn
+  BOOL drawAnotherFrame;    // some point cloud nodes or meshes are still loading
+  
+  CRhFrameStats* frameStats;          // counters of the frames drawn on the render thread
+  ON_ClippingRegion* viewFrustum;     // meshes outside of it are not drawn
+  ON_ClippingRegion* rightEyeFrustum; // the right eye's frustum of a stereo pair, zero otherwise
+  RhDrawList* drawList;               // what beginScene: found in view for this frame
+  CRhResolutionController* resolution;  // resolution of the frames drawn while the view moves
+  CRhTemporalAA* temporalAA;          // antialiasing samples of the still view drawn so far
 }
 
 - (void) renderModel: (RhModel*) model inViewport: (ON_Viewport) viewport;
@@ -71,5 +81,6 @@
 
 - (void) setMaterial: (const ON_Material&) material;
 - (void) drawMesh: (DisplayMesh*) mesh;
+- (void) getFrameStats: (CRhFrameStatsSummary&) summary;
 
 @end
@@ -19,8 +19,12 @@
 #import "RhModel.h"
 #import "RhModelView.h"
 #import "DisplayMesh.h"
+#import "DisplayCurves.h"
+#import "DisplayPointCloud.h"
+#import "RhMeshResidency.h"
 #import "UIColor-RGBA.h"
 #import "ScreenBitmap.h"
+#include "RhTrace.h"
 
 
 #if defined (_DEBUG)
@@ -35,9 +39,15 @@
 @interface ES1Renderer ()
 - (void) setGLModelViewMatrix: (const ON_Viewport&) viewport;
 - (void) setGLProjectionMatrix: (ON_Viewport&) viewport inWidth: (int) width inHeight: (int) height;
+- (void) renderModelWithTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport inWidth: (GLint) width inHeight: (GLint) height doPresent: (BOOL) present;
 @end
 
 
+// Most point cloud points drawn in one frame, while still and while the view is moving
+static const int PointCloudBudget = 1000000;
+static const int FastPointCloudBudget = 250000;
+
+
 @implementation ES1Renderer
 
 enum 
@@ -80,6 +90,8 @@ enum
     texture            = 0;
     textureFramebuffer = 0;
     textureDepthbuffer = 0;
+    accumTexture       = 0;
+    accumFramebuffer   = 0;
     
     backingWidth  = 0;
     backingHeight = 0;
@@ -90,6 +102,15 @@ enum
     
     stereoConfig = AGM_RED_CYAN;
     
+    frameStats = new CRhFrameStats();
+    frameState = new CRhTripleBuffer<RhFrameState>();
+    resolution = new CRhResolutionController();
+    temporalAA = new CRhTemporalAA();
+    frameRequested = 0;
+    viewFrustum = new ON_ClippingRegion();
+    rightEyeFrustum = new ON_ClippingRegion();
+    drawList = new RhDrawList();
+    
     // Create our primary render buffer here to give the default layer
     // something to chew on... All other buffers will get created and/or
     // sized in "resizeFromLayer"...
@@ -163,11 +184,15 @@ enum
         rc = NO;
       }
       
-      int   maxSize = ((backingWidth > backingHeight) ? backingWidth : backingHeight) * 2;
+      int   maxSize = [self power2: ((backingWidth > backingHeight) ? backingWidth : backingHeight)];
       GLint maxTexSize;
       
       glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexSize);
       canAntialias = maxSize <= maxTexSize;
+      
+      // what the old size could afford says little about the new one
+      resolution->Reset();
+      temporalAA->Restart();
     }
     
     if ( canAntialias )
@@ -175,18 +200,20 @@ enum
       GLint  oldWidth  = textureWidth;
       GLint  oldHeight = textureHeight;
       
-      // set the texture size to twice that of our render buffer's size...
-      textureWidth  = backingWidth  * 2;
-      textureHeight = backingHeight * 2;
+      // Both textures hold an image the size of the view.  Antialiasing comes
+      // from averaging jittered frames over time, not from a bigger texture.
+      textureWidth  = backingWidth;
+      textureHeight = backingHeight;
       
       // Lazy evaluation of the texture's FBO...since we really don't know 
-      // we can anti-alias or what the oversampling sizes are until we reach 
-      // this point...
+      // we can anti-alias until we reach this point...
       if ( textureFramebuffer == 0 )
       {
         glGenFramebuffersOES( 1, &textureFramebuffer );
         glGenRenderbuffersOES( 1, &textureDepthbuffer );
         texture = [self createFboTexture: textureWidth  inHeight: textureHeight];
+        glGenFramebuffersOES( 1, &accumFramebuffer );
+        accumTexture = [self createFboTexture: textureWidth  inHeight: textureHeight];
       }
       
       // Check to see if the texture buffers need to be resized...
@@ -215,6 +242,20 @@ enum
           DLog( @"failed to make complete texture buffer object %x", glCheckFramebufferStatusOES( GL_FRAMEBUFFER_OES ) );
           rc = NO;
         }
+        
+        // The accumulation texture is only ever drawn into with glDrawTexiOES, so
+        // it needs no depth buffer...
+        glBindFramebufferOES( GL_FRAMEBUFFER_OES, accumFramebuffer );
+        glBindTexture( GL_TEXTURE_2D, accumTexture );
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,  w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+        glTexParameteriv( GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, cropRect );
+        glFramebufferTexture2DOES( GL_FRAMEBUFFER_OES, GL_COLOR_ATTACHMENT0_OES, GL_TEXTURE_2D, accumTexture, 0 );
+        
+        if ( glCheckFramebufferStatusOES( GL_FRAMEBUFFER_OES ) != GL_FRAMEBUFFER_COMPLETE_OES ) 
+        {
+          DLog( @"failed to make complete accumulation buffer object %x", glCheckFramebufferStatusOES( GL_FRAMEBUFFER_OES ) );
+          rc = NO;
+        }
       }
     }
     
@@ -275,6 +316,18 @@ enum
 		glDeleteRenderbuffersOES(1, &textureDepthbuffer);
 		textureDepthbuffer = 0;
 	}
+	
+	if (accumFramebuffer)
+	{
+		glDeleteFramebuffersOES(1, &accumFramebuffer);
+		accumFramebuffer = 0;
+	}
+	
+	if (accumTexture)
+	{
+		glDeleteTextures(1, &accumTexture);
+		accumTexture = 0;
+	}
   
   if (gradientquad)
   {
@@ -286,6 +339,18 @@ enum
     gradientquad = NULL;
   }
   
+  delete frameStats;
+  delete frameState;
+  delete resolution;
+  delete temporalAA;
+  frameStats = NULL;
+  delete viewFrustum;
+  viewFrustum = NULL;
+  delete rightEyeFrustum;
+  rightEyeFrustum = NULL;
+  delete drawList;
+  drawList = NULL;
+  
 	// Tear down context
 	if ([EAGLContext currentContext] == mainContext)
     [EAGLContext setCurrentContext: nil];
@@ -315,6 +380,12 @@ void glLoadMatrixd (double* d)
 #pragma mark ---- Accessors ----
 
 
+- (void) getFrameStats: (CRhFrameStatsSummary&) summary
+{
+  frameStats->GetSummary( summary );
+}
+
+
 - (ON_Color) backgroundColor
 {
   return backgroundColor;
@@ -668,7 +739,68 @@ void glLoadMatrixd (double* d)
 
 
 /////////////////////////////////////////////////////////////////////
-- (void) drawTransparentMeshes: (RhModel*) scene
+// The projection and model view matrices combine to this world to clip
+// transformation, so a mesh whose bounding box is outside this frustum
+// draws nothing.  A stereo pair is culled against both eyes at once.
+- (void) setViewFrustum: (const ON_Viewport&) leftEye rightEye: (const ON_Viewport*) rightEye
+{
+  if ( !leftEye.GetXform( ON::world_cs, ON::clip_cs, viewFrustum->m_xform ) )
+    viewFrustum->m_xform.Zero();
+  if ( rightEye == NULL || !rightEye->GetXform( ON::world_cs, ON::clip_cs, rightEyeFrustum->m_xform ) )
+    rightEyeFrustum->m_xform.Zero();
+}
+
+/////////////////////////////////////////////////////////////////////
+// Visible if either eye sees the mesh
+- (BOOL) isMeshVisible: (DisplayMesh*) mesh
+{
+  ON_BoundingBox bbox = mesh.boundingBox;
+  if ( !bbox.IsValid() || viewFrustum->m_xform.IsZero() )
+    return YES;
+  if ( viewFrustum->InViewFrustum( bbox ) )
+    return YES;
+  return !rightEyeFrustum->m_xform.IsZero() && rightEyeFrustum->InViewFrustum( bbox );
+}
+
+/////////////////////////////////////////////////////////////////////
+// Culls the mesh and, if it was evicted, asks the residency to restore it.
+// Meshes that are not restored this frame are drawn in a later one.
+- (BOOL) shouldDrawMesh: (DisplayMesh*) mesh residency: (RhMeshResidency*) residency
+{
+  if ( ![self isMeshVisible: mesh] )
+  {
+    frameStats->Frame().culled_objects++;
+    return NO;
+  }
+  return [self useMesh: mesh residency: residency];
+}
+
+/////////////////////////////////////////////////////////////////////
+// Restores a mesh in view if it was evicted
+- (BOOL) useMesh: (DisplayMesh*) mesh residency: (RhMeshResidency*) residency
+{
+  if ( residency != nil && ![residency useMesh: mesh] )
+    return NO;
+  frameStats->Frame().drawn_objects++;
+  return YES;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Finds the meshes in view of either eye with the model's mesh tree.  The
+// indexes of the meshes found are left in drawList->inView.  Returns nil
+// when there is no tree or frustum, and every mesh has to be tested.
+- (NSArray*) meshesInView: (RhModel*) scene opaqueCount: (int*) opaqueCount
+{
+  drawList->inView.SetCount( 0 );
+  if ( viewFrustum->m_xform.IsZero() )
+    return nil;
+  const ON_ClippingRegion* frustums[2] = { viewFrustum, rightEyeFrustum };
+  const int frustumCount = rightEyeFrustum->m_xform.IsZero() ? 1 : 2;
+  return [scene meshesInFrustums: frustums count: frustumCount indexes: drawList->inView opaqueCount: opaqueCount];
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) drawTransparentMeshes
 {
   // Drawing transparent meshes is a 3 pass process...
   //
@@ -683,58 +815,210 @@ void glLoadMatrixd (double* d)
   //            i. Draw all "open" objects' back faces
   //
   
-  if ( scene ) 
+  const ON_SimpleArray<DisplayMesh*>& meshes = drawList->transmeshes;
+  if ( meshes.Count() == 0 )
+    return;
+  
+  glDepthMask( GL_FALSE );
+  glEnable( GL_CULL_FACE );
+  
+  for (int i = 0; i < meshes.Count(); i++)
   {
-    // Now render all transparent meshes...
-    NSArray* meshes = [scene transmeshes];
+    DisplayMesh* mesh = meshes[i];
+    glCullFace( GL_FRONT );
+    [self drawMesh: mesh];
     
-    if ( meshes.count > 0 )
+    if ( !mesh.isClosed )
     {
-      glDepthMask( GL_FALSE );
-      glEnable( GL_CULL_FACE );
-      
-      for (DisplayMesh* mesh in meshes) 
-      {
-        glCullFace( GL_FRONT );
-        [self drawMesh: mesh];
-        
-        if ( !mesh.isClosed )
-        {
-          glCullFace( GL_BACK );
-          [self drawMesh: mesh];
-        }
-      }
-      
-      glDepthMask( GL_TRUE );
       glCullFace( GL_BACK );
-      for (DisplayMesh* mesh in meshes) 
-        [self drawMesh: mesh];
-      
-      glCullFace( GL_FRONT );
-      for (DisplayMesh* mesh in meshes) 
+      [self drawMesh: mesh];
+    }
+  }
+  
+  glDepthMask( GL_TRUE );
+  glCullFace( GL_BACK );
+  for (int i = 0; i < meshes.Count(); i++)
+    [self drawMesh: meshes[i]];
+  
+  glCullFace( GL_FRONT );
+  for (int i = 0; i < meshes.Count(); i++)
+  {
+    DisplayMesh* mesh = meshes[i];
+    if ( !mesh.isClosed )
+      [self drawMesh: mesh];
+  }
+  glDisable( GL_CULL_FACE );
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) drawCurves: (RhModel*) scene
+{
+  NSArray* curves = [scene curves];
+  
+  if ( curves.count == 0 )
+    return;
+  
+  // Curves are unlit; one draw call per wireframe color
+  glDisable( GL_LIGHTING );
+  glDisable( GL_BLEND );
+  glDisableClientState( GL_NORMAL_ARRAY );
+  glEnableClientState( GL_VERTEX_ARRAY );
+  frameStats->CountStateChanges();
+  
+  for (DisplayCurves* dc in curves)
+  {
+    ON_Color color = [dc color];
+    glColor4f( (GLfloat)color.FractionRed(), (GLfloat)color.FractionGreen(), (GLfloat)color.FractionBlue(), 1.0f );
+    glBindBuffer( GL_ARRAY_BUFFER, [dc vertexBuffer] );
+    glVertexPointer( 3, GL_FLOAT, sizeof(ON_3fPoint), 0 );
+    glDrawArrays( GL_LINES, 0, [dc vertexCount] );
+    frameStats->CountStateChanges( 2 );
+    frameStats->CountDrawCall( 0, [dc vertexCount]/2 );
+  }
+  
+  glEnable( GL_LIGHTING );
+  frameStats->CountStateChanges();
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) preparePointClouds: (RhModel*) scene inViewport: (const ON_Viewport&) viewport inWidth: (int) width inHeight: (int) height
+{
+  NSArray* pointClouds = [scene pointClouds];
+  
+  if ( pointClouds.count == 0 )
+    return;
+  
+  // Fewer points while the view is moving...
+  int pointBudget = (frameFastDrawing ? FastPointCloudBudget : PointCloudBudget) / pointClouds.count;
+  
+  for (DisplayPointCloud* dpc in pointClouds)
+  {
+    if ( [dpc prepareForViewport: viewport width: width height: height pointBudget: pointBudget] )
+      drawAnotherFrame = YES;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) drawPointClouds: (RhModel*) scene
+{
+  NSArray* pointClouds = [scene pointClouds];
+  
+  if ( pointClouds.count == 0 )
+    return;
+  
+  // Points are unlit
+  glDisable( GL_LIGHTING );
+  glDisable( GL_BLEND );
+  glDisableClientState( GL_NORMAL_ARRAY );
+  glEnableClientState( GL_VERTEX_ARRAY );
+  glPointSize( 2.0f );
+  frameStats->CountStateChanges();
+  
+  for (DisplayPointCloud* dpc in pointClouds)
+  {
+    ON_Color color = [dpc color];
+    glColor4f( (GLfloat)color.FractionRed(), (GLfloat)color.FractionGreen(), (GLfloat)color.FractionBlue(), 1.0f );
+    frameStats->CountStateChanges();
+    if ( [dpc hasColors] )
+      glEnableClientState( GL_COLOR_ARRAY );
+    
+    unsigned int stride = [dpc Stride];
+    
+    for (int idx = 0; idx < [dpc drawNodeCount]; idx++)
+    {
+      glBindBuffer( GL_ARRAY_BUFFER, [dpc vertexBufferForDrawNode: idx] );
+      glVertexPointer( 3, GL_FLOAT, stride, 0 );
+      if ( [dpc hasColors] )
+        glColorPointer( 4, GL_UNSIGNED_BYTE, stride, (GLvoid*)sizeof(ON_3fPoint) );
+      glDrawArrays( GL_POINTS, 0, [dpc pointCountForDrawNode: idx] );
+      frameStats->CountStateChanges();
+      frameStats->CountDrawCall( 0, 0, [dpc pointCountForDrawNode: idx] );
+    }
+    
+    glDisableClientState( GL_COLOR_ARRAY );
+  }
+  
+  glEnable( GL_LIGHTING );
+  frameStats->CountStateChanges();
+}
+
+/////////////////////////////////////////////////////////////////////
+// Culls the scene once for the frame, against both eyes when rightEye is
+// not NULL, and fills the draw list.  Evicted meshes in view are restored
+// and stay resident until endScene:, so every eye drawn in between with
+// drawScene: only changes the view.
+- (void) beginScene: (RhModel*) scene leftEye: (const ON_Viewport&) leftEye rightEye: (const ON_Viewport*) rightEye inWidth: (int) width inHeight: (int) height
+{
+  drawList->meshes.SetCount( 0 );
+  drawList->transmeshes.SetCount( 0 );
+  if ( scene == nil )
+    return;
+  
+  [self setViewFrustum: leftEye rightEye: rightEye];
+  
+  // The eyes are a few centimeters apart; one set of point cloud nodes does for both
+  [self preparePointClouds: scene inViewport: leftEye inWidth: width inHeight: height];
+  
+  // Evicted meshes are restored while the frame holds the residency lock
+  RhMeshResidency* residency = [scene meshResidency];
+  [residency beginFrame];
+  
+  int opaqueCount = 0;
+  NSArray* meshes = [self meshesInView: scene opaqueCount: &opaqueCount];
+  if ( meshes != nil )
+  {
+    // the tree skipped the rest
+    frameStats->Frame().culled_objects += (int)meshes.count - drawList->inView.Count();
+    for (int i = 0; i < drawList->inView.Count(); i++)
+    {
+      const int idx = drawList->inView[i];
+      DisplayMesh* mesh = [meshes objectAtIndex: idx];
+      if ( [self useMesh: mesh residency: residency] )
       {
-        if ( !mesh.isClosed )
-          [self drawMesh: mesh];
+        if ( idx < opaqueCount )
+          drawList->meshes.Append( mesh );
+        else
+          drawList->transmeshes.Append( mesh );
       }
-      glDisable( GL_CULL_FACE );
     }
+    return;
+  }
+  
+  for (DisplayMesh* mesh in [scene meshes])
+  {
+    if ( [self shouldDrawMesh: mesh residency: residency] )
+      drawList->meshes.Append( mesh );
+  }
+  for (DisplayMesh* mesh in [scene transmeshes])
+  {
+    if ( [self shouldDrawMesh: mesh residency: residency] )
+      drawList->transmeshes.Append( mesh );
   }
 }
 
 /////////////////////////////////////////////////////////////////////
+- (void) endScene: (RhModel*) scene
+{
+  if ( [[scene meshResidency] endFrame] )
+    drawAnotherFrame = YES;
+  drawList->meshes.SetCount( 0 );
+  drawList->transmeshes.SetCount( 0 );
+}
+
+/////////////////////////////////////////////////////////////////////
+// Draws the draw list built by beginScene: from the current view
 - (void) drawScene: (RhModel*) scene
 {
   // Draw scene...
   if ( scene ) 
   {
-    // draw each mesh
-    NSArray* meshes = [scene meshes];
-    
     // First render all opaque objects...
-    for (DisplayMesh* mesh in meshes)
-      [self drawMesh: mesh];
+    for (int i = 0; i < drawList->meshes.Count(); i++)
+      [self drawMesh: drawList->meshes[i]];
     
-    [self drawTransparentMeshes: scene];
+    [self drawCurves: scene];
+    [self drawPointClouds: scene];
+    [self drawTransparentMeshes];
   }
   CheckGLError();
 }
@@ -761,45 +1045,70 @@ void glLoadMatrixd (double* d)
   glPopMatrix();
 }
 
-- (void) renderTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport
+- (void) renderTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport inWidth: (GLint) width inHeight: (GLint) height
 {
   glBindFramebufferOES (GL_FRAMEBUFFER_OES, textureFramebuffer);
 
   [self setupLighting];
   [self setGLModelViewMatrix: viewport];
-  [self setGLProjectionMatrix: viewport inWidth: textureWidth inHeight: textureHeight];
+  [self setGLProjectionMatrix: viewport inWidth: width inHeight: height];
 
+  // Reduced resolution frames only use part of the texture; leave the rest alone
+  const BOOL scissor = (width < textureWidth || height < textureHeight);
+  if ( scissor )
+  {
+    glScissor( 0, 0, width, height );
+    glEnable( GL_SCISSOR_TEST );
+  }
+  
   [self drawBackground];
   [self drawScene: model];
+  
+  if ( scissor )
+    glDisable( GL_SCISSOR_TEST );
 }
 
 
-- (void) renderModelWithTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport doPresent: (BOOL) present
+// Size to draw a frame at while the view is moving.  Returns NO when the frame
+// should be drawn straight into the view at full resolution.
+- (BOOL) getScaledFrameWidth: (GLint&) width height: (GLint&) height
 {
-  if ([model onMacModel] == nil)
+  width  = backingWidth;
+  height = backingHeight;
+  if ( !canAntialias || !frameFastDrawing || resolution->Scale() >= 1.0 )
+    return NO;
+  width  = resolution->ScaledSize( backingWidth );
+  height = resolution->ScaledSize( backingHeight );
+  return YES;
+}
+
+
+// Tells the resolution controller what the frame that just ended cost
+- (void) updateResolution
+{
+  if ( !canAntialias || !frameFastDrawing )
     return;
-  
-  // First render our scene to a texture/target...
-  [self renderTexture: model inViewport: viewport];
-  CheckGLError();
-  
-  //  [self saveTextureToFileNamed: @"/Users/macrhino/Desktop/Texture.png"];
-  
-  // Next, bind our primary framebuffer...
-  glBindFramebufferOES (GL_FRAMEBUFFER_OES, defaultFramebuffer);
-  
-  // Move the render texture/target into the framebuffer...
+  const RhFrameCounters& frame = frameStats->Frame();
+  resolution->FrameDrawn( frame.submit_ms + frame.present_ms, frame.present_ms );
+}
+
+
+// Stretches the lower left width x height pixels of a texture over the bound
+// framebuffer.
+- (void) drawTexture: (GLuint) source inWidth: (GLint) width inHeight: (GLint) height
+{
   // Turn off some expensive tests to make this as fast as possible.
-  glDisable( GL_BLEND );
   glDisable( GL_CULL_FACE );
   glDisable( GL_LIGHTING );
   glDepthMask( GL_FALSE );
   glDepthFunc( GL_ALWAYS );
   
   // Note: texture units are FBO dependent, so this must happen here,
-  //       after the primary framebuffer has been enabled/bound.
+  //       after the framebuffer has been enabled/bound.
+  GLint cropRect[4] = { 0, 0, width, height };
   glEnable( GL_TEXTURE_2D );
-  glBindTexture(GL_TEXTURE_2D, texture);
+  glBindTexture(GL_TEXTURE_2D, source);
+  glTexParameteriv( GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, cropRect );
   glDrawTexiOES( 0,0,0, backingWidth, backingHeight );
   glDisable( GL_TEXTURE_2D );
   
@@ -809,22 +1118,118 @@ void glLoadMatrixd (double* d)
   glDepthFunc( GL_GEQUAL );
   
   CheckGLError();
+}
+
+
+// Stretches the lower left width x height pixels of a texture over the view
+// and presents the view.
+- (void) presentTexture: (GLuint) source inWidth: (GLint) width inHeight: (GLint) height doCapture: (BOOL) capture
+{
+  glBindFramebufferOES (GL_FRAMEBUFFER_OES, defaultFramebuffer);
+  glDisable( GL_BLEND );
+  [self DisableAnaglyphMode];
+  [self drawTexture: source inWidth: width inHeight: height];
   
-  if (needsImageCapturedDelegate) {
+  if (capture && needsImageCapturedDelegate) {
     [capturedImage release];
     capturedImage = [[self captureImage] retain];
     if ([needsImageCapturedDelegate respondsToSelector: @selector(didCaptureImage:)])
       [needsImageCapturedDelegate performSelectorOnMainThread: @selector(didCaptureImage:) withObject: capturedImage waitUntilDone: NO];
     needsImageCapturedDelegate = nil;
   }
-    
+  
+  frameStats->BeginPresent();
+  glBindRenderbufferOES (GL_RENDERBUFFER_OES, colorRenderbuffer);
+  [renderContext presentRenderbuffer: GL_RENDERBUFFER_OES];
+  CheckGLError();
+}
+
+
+// Draws into the lower left width x height pixels of the texture and, if
+// present is YES, stretches them over the view.
+- (void) renderModelWithTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport inWidth: (GLint) width inHeight: (GLint) height doPresent: (BOOL) present
+{
+  if ([model onMacModel] == nil)
+    return;
+  
+  // First render our scene to a texture/target...
+  [self renderTexture: model inViewport: viewport inWidth: width inHeight: height];
+  CheckGLError();
+  
+  //  [self saveTextureToFileNamed: @"/Users/macrhino/Desktop/Texture.png"];
+  
   if ( present )
+    [self presentTexture: texture inWidth: width inHeight: height doCapture: YES];
+}  
+
+
+// Blends the texture into the accumulation texture with the weight of the
+// next sample, so the accumulation texture holds the average of the samples.
+- (void) accumulateTexture: (CRhTemporalAA&) samples
+{
+  glBindFramebufferOES( GL_FRAMEBUFFER_OES, accumFramebuffer );
+  glViewport( 0, 0, textureWidth, textureHeight );
+  
+  // The first sample replaces whatever was there.  ES 1.1 has no constant
+  // blend color, so the weight is the alpha of the fragment color and the
+  // later samples only average the color channels; alpha, which is only
+  // used for the transparent background of previews, is the first sample's.
+  if ( samples.SampleIndex() > 0 )
   {
-    glBindRenderbufferOES (GL_RENDERBUFFER_OES, colorRenderbuffer);
-    [renderContext presentRenderbuffer: GL_RENDERBUFFER_OES];
-    CheckGLError();
+    glEnable( GL_BLEND );
+    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+    glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE );
+    glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE );
+    glTexEnvi( GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE );
+    glTexEnvi( GL_TEXTURE_ENV, GL_SRC0_RGB, GL_TEXTURE );
+    glTexEnvi( GL_TEXTURE_ENV, GL_COMBINE_ALPHA, GL_REPLACE );
+    glTexEnvi( GL_TEXTURE_ENV, GL_SRC0_ALPHA, GL_PRIMARY_COLOR );
+    glColor4f( 1.0f, 1.0f, 1.0f, samples.SampleWeight() );
   }
-}  
+  else
+    glDisable( GL_BLEND );
+  
+  [self drawTexture: texture inWidth: textureWidth inHeight: textureHeight];
+  
+  glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+  glColor4f( 1.0f, 1.0f, 1.0f, 1.0f );
+  glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+  glDisable( GL_BLEND );
+  CheckGLError();
+  
+  samples.SampleDone();
+}
+
+
+// Draws the next antialiasing sample of a still view, a stereo pair when
+// rightEye is not NULL, and adds it to the accumulation texture.  When
+// present is YES the view shows the average of the samples so far.
+- (void) renderSample: (CRhTemporalAA&) samples model: (RhModel*) model leftEye: (const ON_Viewport&) leftEye rightEye: (const ON_Viewport*) rightEye doPresent: (BOOL) present
+{
+  if ([model onMacModel] == nil)
+  {
+    samples.Stop();
+    return;
+  }
+  
+  ON_Viewport sampleViewport;
+  samples.GetSampleViewport( leftEye, textureWidth, textureHeight, sampleViewport );
+  [self renderModelWithTexture: model inViewport: sampleViewport inWidth: textureWidth inHeight: textureHeight doPresent: NO];
+  
+  if ( rightEye != NULL )
+  {
+    samples.GetSampleViewport( *rightEye, textureWidth, textureHeight, sampleViewport );
+    [self EnableAnaglypMode: stereoConfig];
+    [self renderModelWithTexture: model inViewport: sampleViewport inWidth: textureWidth inHeight: textureHeight doPresent: NO];
+    [self DisableAnaglyphMode];
+  }
+  
+  [self accumulateTexture: samples];
+  
+  // images are only captured once they are fully antialiased
+  if ( present )
+    [self presentTexture: accumTexture inWidth: textureWidth inHeight: textureHeight doCapture: samples.IsConverged()];
+}
 
 
 - (void) renderModelWithoutTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport doPresent: (BOOL) present
@@ -851,6 +1256,7 @@ void glLoadMatrixd (double* d)
   
   if ( present )
   {
+    frameStats->BeginPresent();
     glBindRenderbufferOES (GL_RENDERBUFFER_OES, colorRenderbuffer);
     [renderContext presentRenderbuffer: GL_RENDERBUFFER_OES];
     CheckGLError();
@@ -859,25 +1265,39 @@ void glLoadMatrixd (double* d)
 
 
 // This method is run on NSThread renderThread
-- (void) renderOneFrame
+- (void) renderOneFrame: (const RhFrameState&) state
 {
   RhModel* model;
   static ON_Viewport viewport;
   
+  // the lock keeps resizeFromLayer: from changing the framebuffers mid frame
   @synchronized(self)
   {
-    model = renderModel;
-    viewport = renderViewport1;
-    performingRender = NO;
+    RH_TRACE_SCOPE( "renderOneFrame" );
+    model = state.model;
+    viewport = state.leftEye;
+    frameFastDrawing = state.fastDrawing;
+    drawAnotherFrame = NO;
+    frameStats->BeginFrame();
     
     CheckGLError();
     [EAGLContext setCurrentContext: renderContext];
     CheckGLError();
     
-    if (canAntialias && !RhinoApp.fastDrawing)
-      [self renderModelWithTexture: model inViewport: viewport doPresent: YES];
+    GLint width, height;
+    const BOOL scaled = [self getScaledFrameWidth: width height: height];
+    [self beginScene: model leftEye: viewport rightEye: NULL inWidth: width inHeight: height];
+    
+    if (canAntialias && !frameFastDrawing)
+      [self renderSample: *temporalAA model: model leftEye: viewport rightEye: NULL doPresent: YES];
+    else if (scaled)
+      [self renderModelWithTexture: model inViewport: viewport inWidth: width inHeight: height doPresent: YES];
     else
       [self renderModelWithoutTexture: model inViewport: viewport doPresent: YES];
+    
+    [self endScene: model];
+    frameStats->EndFrame();
+    [self updateResolution];
   }
 }
 
@@ -908,7 +1328,7 @@ void glLoadMatrixd (double* d)
 
 /////////////////////////////////////////////////////////////////////
 // This method is run on NSThread renderThread
-- (void) renderStereoFrame
+- (void) renderStereoFrame: (const RhFrameState&) state
 {
   RhModel* model;
   static ON_Viewport leftEye;
@@ -916,20 +1336,30 @@ void glLoadMatrixd (double* d)
   
   @synchronized(self)
   {
-    model = renderModel;
-    leftEye  = renderViewport1;
-    rightEye = renderViewport2;
-    performingRender = NO;
+    RH_TRACE_SCOPE( "renderStereoFrame" );
+    model = state.model;
+    leftEye  = state.leftEye;
+    rightEye = state.rightEye;
+    frameFastDrawing = state.fastDrawing;
+    drawAnotherFrame = NO;
+    frameStats->BeginFrame();
     
     CheckGLError();
     [EAGLContext setCurrentContext: renderContext];
     CheckGLError();
     
-    if (canAntialias && !RhinoApp.fastDrawing)
+    // Both eyes are drawn from one draw list; only the view changes between them
+    GLint width, height;
+    const BOOL scaled = [self getScaledFrameWidth: width height: height];
+    [self beginScene: model leftEye: leftEye rightEye: &rightEye inWidth: width inHeight: height];
+    
+    if (canAntialias && !frameFastDrawing)
+      [self renderSample: *temporalAA model: model leftEye: leftEye rightEye: &rightEye doPresent: YES];
+    else if (scaled)
     {
-      [self renderModelWithTexture: model inViewport: leftEye doPresent: NO];
+      [self renderModelWithTexture: model inViewport: leftEye inWidth: width inHeight: height doPresent: NO];
       [self EnableAnaglypMode: stereoConfig];
-      [self renderModelWithTexture: model inViewport: rightEye doPresent: YES];
+      [self renderModelWithTexture: model inViewport: rightEye inWidth: width inHeight: height doPresent: YES];
     }
     else
     {
@@ -938,7 +1368,10 @@ void glLoadMatrixd (double* d)
       [self renderModelWithoutTexture: model inViewport: rightEye doPresent: YES];
     }
     
+    [self endScene: model];
     [self DisableAnaglyphMode];
+    frameStats->EndFrame();
+    [self updateResolution];
   }
 }
 
@@ -947,6 +1380,7 @@ void glLoadMatrixd (double* d)
 - (void) renderFrames
 {
   NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+  RhTraceSetThreadName( "render" );
   
   // initialize OpenGL context in this render thread
   if (renderContext == nil) {
@@ -974,56 +1408,105 @@ void glLoadMatrixd (double* d)
 }
 
 
+// This method is run on NSThread renderThread
+- (void) renderFrame
+{
+  // requests published after this get a frame of their own
+  __sync_bool_compare_and_swap( &frameRequested, 1, 0 );
+  const bool newState = frameState->Acquire();
+  const RhFrameState& state = frameState->ReadBuffer();
+  
+  // a new view, or one whose last frame was still missing some of the scene,
+  // starts the antialiasing over
+  if ( newState || drawAnotherFrame )
+    temporalAA->Restart();
+  
+  if (state.stereo)
+    [self renderStereoFrame: state];
+  else
+    [self renderOneFrame: state];
+  
+  // keep drawing until the point cloud nodes and meshes for this view are loaded
+  // and, once the view is still, until all the antialiasing samples are in
+  const BOOL sampling = canAntialias && !state.fastDrawing && !temporalAA->IsConverged();
+  if ( (drawAnotherFrame || sampling) && __sync_bool_compare_and_swap( &frameRequested, 0, 1 ) )
+    [self performSelector: _cmd onThread: [self renderThread] withObject: nil waitUntilDone: NO];
+}
+
+
+// This method runs on the main thread and schedules the frame in frameState->WriteBuffer()
+// to be drawn on the render thread.  It never waits for the render thread; if a frame is
+// already scheduled that frame draws the newest state.
+- (void) publishFrameState
+{
+  frameState->Publish();
+  if ( __sync_bool_compare_and_swap( &frameRequested, 0, 1 ) )
+    [self performSelector: @selector(renderFrame) onThread: [self renderThread] withObject: nil waitUntilDone: NO];
+  else
+    frameStats->CountCoalescedRequest();
+}
+
+
 // This method runs on the main thread and schedules one frame to be drawn on the render thread
 - (void) renderModel: (RhModel*) model inViewport: (ON_Viewport) viewport
 {
-  @synchronized(self)
-  {    
-    renderModel = model;
-    renderViewport1 = viewport;
-    
-    if (!performingRender)
-      [self performSelector: @selector(renderOneFrame) onThread: [self renderThread] withObject: nil waitUntilDone: NO];
-    performingRender = YES;
-  }
+  RhFrameState& state = frameState->WriteBuffer();
+  state.model = model;
+  state.leftEye = viewport;
+  state.stereo = NO;
+  state.fastDrawing = RhinoApp.fastDrawing;
+  [self publishFrameState];
 }
 
 - (void) renderModel: (RhModel*) model inLeftEye: (const ON_Viewport&) leftEye inRightEye: (const ON_Viewport&) rightEye;
 {
-  @synchronized(self)
-  {    
-    renderModel = model;
-    renderViewport1 = leftEye;
-    renderViewport2 = rightEye;
-    
-    if (!performingRender)
-      [self performSelector: @selector(renderStereoFrame) onThread: [self renderThread] withObject: nil waitUntilDone: NO];
-    performingRender = YES;
-  }
+  RhFrameState& state = frameState->WriteBuffer();
+  state.model = model;
+  state.leftEye = leftEye;
+  state.rightEye = rightEye;
+  state.stereo = YES;
+  state.fastDrawing = RhinoApp.fastDrawing;
+  [self publishFrameState];
 }
 
 // This method runs on the main thread
 - (UIImage*) renderPreview: (RhModel*) model inViewport: (ON_Viewport) viewport
 {
-  [EAGLContext setCurrentContext: mainContext];
-  CheckGLError();
+  UIImage* previewImage;
   
-  // set transparent background color
-  ON_Color savedBackgroundColor = backgroundColor;
-  backgroundColor = ON_Color (0, 0, 0, 0);
-  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-
-  // draw the model at texture size with a transparent background
-  [self renderModelWithTexture: model inViewport: viewport doPresent: YES];
-  UIImage* previewImage = [self captureImage];
-  
-  // restore background color
-  backgroundColor = savedBackgroundColor;
-  glClearColor( (float)backgroundColor.FractionRed(), 
-               (float)backgroundColor.FractionGreen(), 
-               (float)backgroundColor.FractionBlue(), 
-               (float)backgroundColor.FractionAlpha()
-               );
+  // the lock keeps the render thread out of the textures
+  @synchronized(self)
+  {
+    [EAGLContext setCurrentContext: mainContext];
+    CheckGLError();
+    
+    // set transparent background color
+    ON_Color savedBackgroundColor = backgroundColor;
+    backgroundColor = ON_Color (0, 0, 0, 0);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    
+    // draw all the antialiasing samples at once with a transparent background
+    CRhTemporalAA samples;
+    [self beginScene: model leftEye: viewport rightEye: NULL inWidth: textureWidth inHeight: textureHeight];
+    while ( !samples.IsConverged() )
+    {
+      const BOOL lastSample = ( samples.SampleIndex() == CRhTemporalAA::sample_count-1 );
+      [self renderSample: samples model: model leftEye: viewport rightEye: NULL doPresent: lastSample];
+    }
+    [self endScene: model];
+    previewImage = [self captureImage];
+    
+    // the view's own samples were overwritten
+    temporalAA->Restart();
+    
+    // restore background color
+    backgroundColor = savedBackgroundColor;
+    glClearColor( (float)backgroundColor.FractionRed(), 
+                 (float)backgroundColor.FractionGreen(), 
+                 (float)backgroundColor.FractionBlue(), 
+                 (float)backgroundColor.FractionAlpha()
+                 );
+  }
   return previewImage;
 }
 
@@ -1070,6 +1553,9 @@ void glLoadMatrixd (double* d)
 
 - (void) drawMesh: (DisplayMesh*) mesh
 {
+  if ( ![mesh isResident] )
+    return;
+  
   if (mesh.selected)
     [self setMaterial: [self selectedMaterialWithMaterial:[mesh material]]];
   else
@@ -1090,7 +1576,17 @@ void glLoadMatrixd (double* d)
     glVertexPointer (3, GL_FLOAT, sizeof(ON_3fPoint), (void*)0);
   }
   
+  // meshes that share VBOs are drawn at their own offset
+  const ON_3fVector& offset = [mesh instanceOffset];
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glTranslatef(offset.x, offset.y, offset.z);
   glDrawElements(GL_TRIANGLES, 3 * [mesh triangleCount], GL_UNSIGNED_SHORT, 0);
+  glPopMatrix();
+  
+  // material, vertex buffer, index buffer and instance offset
+  frameStats->CountStateChanges( 4 );
+  frameStats->CountDrawCall( [mesh triangleCount] );
 }
 
 #pragma mark ---- picking image ----
@@ -1120,6 +1616,9 @@ void glLoadMatrixd (double* d)
 
 - (void) drawPickImageMesh: (DisplayMesh*) mesh
 {
+  if ( ![mesh isResident] )
+    return;
+  
   [self setPickColor: [mesh pickColor]];
     
   glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, [mesh indexBuffer]);
@@ -1137,7 +1636,13 @@ void glLoadMatrixd (double* d)
     glVertexPointer (3, GL_FLOAT, sizeof(ON_3fPoint), (void*)0);
   }
   
+  // meshes that share VBOs are drawn at their own offset
+  const ON_3fVector& offset = [mesh instanceOffset];
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glTranslatef(offset.x, offset.y, offset.z);
   glDrawElements(GL_TRIANGLES, 3 * [mesh triangleCount], GL_UNSIGNED_SHORT, 0);
+  glPopMatrix();
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -1150,6 +1655,27 @@ void glLoadMatrixd (double* d)
     // draw each mesh
     NSArray* meshes = [scene meshes];
     
+    // evicted meshes are left out of the pick image until they are drawn again
+    RhMeshResidency* residency = [scene meshResidency];
+    [residency beginFrame];
+    
+    // only the meshes in view when the model has a mesh tree
+    int opaqueCount = 0;
+    NSArray* meshesInView = [self meshesInView: scene opaqueCount: &opaqueCount];
+    if ( meshesInView != nil )
+    {
+      for (int i = 0; i < drawList->inView.Count(); i++)
+      {
+        const int idx = drawList->inView[i];
+        DisplayMesh* mesh = [meshesInView objectAtIndex: idx];
+        if ( idx < opaqueCount || [mesh material].Transparency() < 0.8 )
+          [self drawPickImageMesh: mesh];
+      }
+      [residency endFrame];
+      CheckGLError();
+      return;
+    }
+    
     // render all opaque objects...
     for (DisplayMesh* mesh in meshes)
       [self drawPickImageMesh: mesh];
@@ -1167,6 +1693,7 @@ void glLoadMatrixd (double* d)
           [self drawPickImageMesh: mesh];
       }
     }
+    [residency endFrame];
   }
   CheckGLError();
 }
@@ -1181,8 +1708,12 @@ void glLoadMatrixd (double* d)
   
   @synchronized(self)
   {
-    model = renderModel;
-    viewport = renderViewport1;
+    RH_TRACE_SCOPE( "renderPickBitmap" );
+    // the frame drawn after this one no longer sees the new view as new
+    if ( frameState->Acquire() )
+      temporalAA->Restart();
+    model = frameState->ReadBuffer().model;
+    viewport = frameState->ReadBuffer().leftEye;
     
     if ([model onMacModel] == nil)
       return;
@@ -1199,6 +1730,9 @@ void glLoadMatrixd (double* d)
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
+    // the meshes out of view are not drawn
+    [self setViewFrustum: viewport rightEye: NULL];
+    
     // draw the scene using flat lighting and the the mesh pick colors
     [self drawPickImageScene: model];
     
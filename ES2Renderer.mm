@@ -16,9 +16,13 @@
 
 #import "ES2Renderer.h"
 #import "RhModel.h"
+#import "DisplayCurves.h"
+#import "DisplayPointCloud.h"
+#import "RhMeshResidency.h"
 #import "RhModelView.h"
 #import "UIColor-RGBA.h"
 #import "ScreenBitmap.h"
+#include "RhTrace.h"
 
 
 #if defined (_DEBUG)
@@ -31,12 +35,19 @@
 - (BOOL) loadShaders;
 - (const char *) getResourceAsString: (NSString *)name ofType:(NSString *)ext;
 - (CRhGLShaderProgram*) loadShaderResource: (NSString *)baseName;
+- (CRhGLShaderVariants*) loadShaderVariants: (NSString *)baseName features: (unsigned int) features;
 - (void) clearBackground;
 - (void) renderDrawable: (const RhGLDrawable*) drawable;
 - (void) drawScreenAlignedQuad;
+- (void) renderModelWithTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport inWidth: (GLint) width inHeight: (GLint) height doPresent:(BOOL) present;
 @end
 
 
+// Most point cloud points drawn in one frame, while still and while the view is moving
+static const int PointCloudBudget = 1000000;
+static const int FastPointCloudBudget = 250000;
+
+
 @implementation ES2Renderer
 
 enum 
@@ -46,19 +57,6 @@ enum
   AGM_MAGENTA_GREEN,
 };
 
-// round to the next power of two
-- (unsigned int) power2: (unsigned int) v
-{
-  v--;
-  v |= v >> 1;
-  v |= v >> 2;
-  v |= v >> 4;
-  v |= v >> 8;
-  v |= v >> 16;
-  v++;
-  return v;
-}
-
 ////////////////////////////////////////////////////////////////////
 // Create an ES 2.0 context
 - (id <ESRenderer>) init
@@ -82,6 +80,8 @@ enum
     texture            = 0;
     textureFramebuffer = 0;
     textureDepthbuffer = 0;
+    accumTexture       = 0;
+    accumFramebuffer   = 0;
     
     backingWidth  = 0;
     backingHeight = 0;
@@ -92,6 +92,15 @@ enum
     
     stereoConfig = AGM_RED_CYAN;
     
+    frameStats = new CRhFrameStats();
+    frameState = new CRhTripleBuffer<RhFrameState>();
+    resolution = new CRhResolutionController();
+    temporalAA = new CRhTemporalAA();
+    frameRequested = 0;
+    viewFrustum = new ON_ClippingRegion();
+    rightEyeFrustum = new ON_ClippingRegion();
+    drawList = new RhDrawList();
+    
     // Create our primary render buffer here to give the default layer
     // something to chew on... All other buffers will get created and/or
     // sized in "resizeFromLayer"...
@@ -162,11 +171,15 @@ enum
         rc = NO;
       }
       
-      int   maxSize = ((backingWidth > backingHeight) ? backingWidth : backingHeight) * 2;
+      int   maxSize = (backingWidth > backingHeight) ? backingWidth : backingHeight;
       GLint maxTexSize;
       
       glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexSize);
       canAntialias = maxSize <= maxTexSize;
+      
+      // what the old size could afford says little about the new one
+      resolution->Reset();
+      temporalAA->Restart();
     }
     
     if ( canAntialias )
@@ -174,18 +187,20 @@ enum
       GLint  oldWidth  = textureWidth;
       GLint  oldHeight = textureHeight;
       
-      // set the texture size to twice that of our render buffer's size...
-      textureWidth  = backingWidth  * 2;
-      textureHeight = backingHeight * 2;
+      // Both textures are the size of the view.  Antialiasing comes from
+      // averaging jittered frames over time, not from a bigger texture.
+      textureWidth  = backingWidth;
+      textureHeight = backingHeight;
       
       // Lazy evaluation of texture's FBO...since we really don't know we
-      // can anti-alias or what the oversampling sizes are until we reach 
-      // this point...
+      // can anti-alias until we reach this point...
       if ( textureFramebuffer == 0 )
       {
         glGenFramebuffers(1, &textureFramebuffer);
         glGenRenderbuffers(1, &textureDepthbuffer);
         texture = [self createFboTexture: textureWidth  inHeight: textureHeight];
+        glGenFramebuffers(1, &accumFramebuffer);
+        accumTexture = [self createFboTexture: textureWidth  inHeight: textureHeight];
       }
       
       // Check to see if the texture buffers need to be resized...
@@ -209,6 +224,19 @@ enum
           DLog(@"failed to make complete texture buffer object %x", glCheckFramebufferStatus(GL_FRAMEBUFFER));
           rc = NO;
         }
+        
+        // The accumulation texture is only ever drawn into with a full screen quad, so
+        // it needs no depth buffer...
+        glBindFramebuffer( GL_FRAMEBUFFER, accumFramebuffer );
+        glBindTexture( GL_TEXTURE_2D, accumTexture );
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA,  textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture, 0);
+        
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) 
+        {
+          DLog(@"failed to make complete accumulation buffer object %x", glCheckFramebufferStatus(GL_FRAMEBUFFER));
+          rc = NO;
+        }
       }
     }
     
@@ -243,23 +271,47 @@ enum
   return pShader;
 }
 
+/////////////////////////////////////////////////////////////////////
+// The other variants are compiled the first time a mesh needs them;
+// the one given by features is compiled now, so a template that does
+// not compile fails here.
+- (CRhGLShaderVariants*) loadShaderVariants: (NSString *)baseName features: (unsigned int) features
+{
+  const char  *vertexShader   = [self getResourceAsString:baseName ofType:@"vsh"];
+  const char  *fragmentShader = [self getResourceAsString:baseName ofType:@"fsh"];
+  
+  CRhGLShaderVariants *pShaders = new CRhGLShaderVariants;
+  if ( !pShaders->SetSource( vertexShader, fragmentShader ) || (pShaders->Program( features ) == NULL) )
+  {
+    delete pShaders;
+    pShaders = NULL;
+  }
+  
+  return pShaders;
+}
+
 /////////////////////////////////////////////////////////////////////
 - (BOOL) loadShaders 
 {
+  activeShaders   = NULL;
   activeShader    = NULL;
   
-  perpixelShader  = [self loadShaderResource:@"PerPixelLighting"];
-  pervertexShader = [self loadShaderResource:@"PerVertexLighting"];
+  perpixelShaders  = [self loadShaderVariants:@"PerPixelLighting" features: CRhGLShaderVariants::vertex_normals];
+  pervertexShaders = [self loadShaderVariants:@"PerVertexLighting" features: CRhGLShaderVariants::vertex_normals];
   quadShader      = [self loadShaderResource:@"FullscreenQuad"];
   gradientShader  = [self loadShaderResource:@"GradientQuad"];
+  wireframeShader = [self loadShaderResource:@"Wireframe"];
+  pointCloudShaders = [self loadShaderVariants:@"PointCloud" features: 0];
   anaglyphShader  = NULL;
   
-  if ( (perpixelShader == NULL) || (pervertexShader == NULL) || (quadShader == NULL) || (gradientShader == NULL) )
+  if ( (perpixelShaders == NULL) || (pervertexShaders == NULL) || (quadShader == NULL) || (gradientShader == NULL) || (wireframeShader == NULL) || (pointCloudShaders == NULL) )
     return NO;
   
   quadShader->Enable();
   int  loc = glGetUniformLocation( quadShader->Handle(), "Image" );
   glUniform1f( loc, 0 );
+  quadTexScale = glGetUniformLocation( quadShader->Handle(), "TexScale" );
+  glUniform2f( quadTexScale, 1.0f, 1.0f );
   quadShader->Disable();
   
 	return YES;
@@ -318,6 +370,18 @@ enum
 		glDeleteRenderbuffers(1, &textureDepthbuffer);
 		textureDepthbuffer = 0;
 	}
+	
+	if (accumFramebuffer)
+	{
+		glDeleteFramebuffers(1, &accumFramebuffer);
+		accumFramebuffer = 0;
+	}
+	
+	if (accumTexture)
+	{
+		glDeleteTextures(1, &accumTexture);
+		accumTexture = 0;
+	}
   
 	// Tear down context
 	if ([EAGLContext currentContext] == mainContext)
@@ -336,16 +400,16 @@ enum
     quad = NULL;
   }
   
-  if ( pervertexShader != NULL )
+  if ( pervertexShaders != NULL )
   {
-    delete pervertexShader;
-    pervertexShader = NULL;
+    delete pervertexShaders;
+    pervertexShaders = NULL;
   }
   
-  if ( perpixelShader != NULL )
+  if ( perpixelShaders != NULL )
   {
-    delete perpixelShader;
-    perpixelShader = NULL;
+    delete perpixelShaders;
+    perpixelShaders = NULL;
   }
   
   if ( quadShader != NULL )
@@ -360,14 +424,39 @@ enum
     gradientShader = NULL;
   }
   
+  if ( wireframeShader != NULL )
+  {
+    delete wireframeShader;
+    wireframeShader = NULL;
+  }
+  
+  if ( pointCloudShaders != NULL )
+  {
+    delete pointCloudShaders;
+    pointCloudShaders = NULL;
+  }
+  
   if ( anaglyphShader != NULL )
   {
     delete anaglyphShader;
     anaglyphShader = NULL;
   }
   
+  activeShaders = NULL;
   activeShader = NULL;
   
+  delete frameStats;
+  delete frameState;
+  delete resolution;
+  delete temporalAA;
+  frameStats = NULL;
+  delete viewFrustum;
+  viewFrustum = NULL;
+  delete rightEyeFrustum;
+  rightEyeFrustum = NULL;
+  delete drawList;
+  drawList = NULL;
+  
 	[super dealloc];
 }
 
@@ -378,6 +467,13 @@ enum
 #pragma mark ---- Accessors ----
 
 
+/////////////////////////////////////////////////////////////////////
+- (void) getFrameStats: (CRhFrameStatsSummary&) summary
+{
+  frameStats->GetSummary( summary );
+}
+
+
 /////////////////////////////////////////////////////////////////////
 - (ON_Color) backgroundColor
 {
@@ -754,7 +850,7 @@ enum
 - (void) setupActiveShader: (RhModel*) model inViewport: (const ON_Viewport&) viewport
 {
   // Do we even have an active shader...
-  if ( activeShader != NULL )
+  if ( activeShaders != NULL )
   {
     // Just use ON's default light for now...
     ON_Light   light;
@@ -763,17 +859,115 @@ enum
     // unfortunately ON assumes right-handedness...
     light.m_direction.z = -light.m_direction.z;
     
-    // First enable the shader...
-    activeShader->Enable();
+    // Curves and point clouds are drawn with their own shaders, which need the same frustum...
+    if ( wireframeShader != NULL )
+    {
+      wireframeShader->Enable();
+      wireframeShader->SetupViewport( viewport );
+    }
+    if ( pointCloudShaders != NULL )
+      pointCloudShaders->SetupViewport( viewport );
     
-    // Now setup and initialize frustum and lighting.
-    activeShader->SetupViewport( viewport );
-    activeShader->SetupLight( light );
+    // Setup frustum and lighting; each variant gets them when it is first enabled.
+    activeShaders->SetupViewport( viewport );
+    activeShaders->SetupLight( light );
+    
+    // Now enable the variant most meshes use...
+    activeShader = activeShaders->Enable( CRhGLShaderVariants::vertex_normals );
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+- (unsigned int) shaderFeaturesOfMesh: (DisplayMesh*) mesh
+{
+  unsigned int features = 0;
+  if ( [mesh hasVertexNormals] )
+    features |= CRhGLShaderVariants::vertex_normals;
+  if ( [mesh hasVertexColors] )
+    features |= CRhGLShaderVariants::vertex_colors;
+  if ( ![mesh instanceOffset].IsZero() )
+    features |= CRhGLShaderVariants::instance_offset;
+  return features;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Switches to the variant of the active shaders with the given features,
+// if it is not the one in use.  A variant that does not compile leaves
+// the current one in use.
+- (void) enableShaderVariant: (unsigned int) features
+{
+  if ( activeShaders == NULL )
+    return;
+  CRhGLShaderProgram* program = activeShaders->Program( features );
+  if ( (program == NULL) || (program == activeShader) )
+    return;
+  activeShader = activeShaders->Enable( features );
+  frameStats->CountStateChanges();
+}
+
+/////////////////////////////////////////////////////////////////////
+// The shaders transform by the same world to clip transformation, so
+// a mesh whose bounding box is outside this frustum draws nothing.
+// A stereo pair is culled against both eyes at once.
+- (void) setViewFrustum: (const ON_Viewport&) leftEye rightEye: (const ON_Viewport*) rightEye
+{
+  if ( !leftEye.GetXform( ON::world_cs, ON::clip_cs, viewFrustum->m_xform ) )
+    viewFrustum->m_xform.Zero();
+  if ( rightEye == NULL || !rightEye->GetXform( ON::world_cs, ON::clip_cs, rightEyeFrustum->m_xform ) )
+    rightEyeFrustum->m_xform.Zero();
+}
+
+/////////////////////////////////////////////////////////////////////
+// Visible if either eye sees the mesh
+- (BOOL) isMeshVisible: (DisplayMesh*) mesh
+{
+  ON_BoundingBox bbox = mesh.boundingBox;
+  if ( !bbox.IsValid() || viewFrustum->m_xform.IsZero() )
+    return YES;
+  if ( viewFrustum->InViewFrustum( bbox ) )
+    return YES;
+  return !rightEyeFrustum->m_xform.IsZero() && rightEyeFrustum->InViewFrustum( bbox );
+}
+
+/////////////////////////////////////////////////////////////////////
+// Culls the mesh and, if it was evicted, asks the residency to restore it.
+// Meshes that are not restored this frame are drawn in a later one.
+- (BOOL) shouldDrawMesh: (DisplayMesh*) mesh residency: (RhMeshResidency*) residency
+{
+  if ( ![self isMeshVisible: mesh] )
+  {
+    frameStats->Frame().culled_objects++;
+    return NO;
   }
+  return [self useMesh: mesh residency: residency];
+}
+
+/////////////////////////////////////////////////////////////////////
+// Restores a mesh in view if it was evicted
+- (BOOL) useMesh: (DisplayMesh*) mesh residency: (RhMeshResidency*) residency
+{
+  if ( residency != nil && ![residency useMesh: mesh] )
+    return NO;
+  frameStats->Frame().drawn_objects++;
+  return YES;
 }
 
 /////////////////////////////////////////////////////////////////////
-- (void) drawTransparentMeshes: (RhModel*) scene
+// Finds the meshes in view of either eye with the model's mesh tree.  The
+// indexes of the meshes found are left in drawList->inView.  Returns nil
+// when there is no tree or frustum, and every mesh has to be tested.
+- (NSArray*) meshesInView: (RhModel*) scene opaqueCount: (int*) opaqueCount
+{
+  drawList->inView.SetCount( 0 );
+  if ( viewFrustum->m_xform.IsZero() )
+    return nil;
+  const ON_ClippingRegion* frustums[2] = { viewFrustum, rightEyeFrustum };
+  const int frustumCount = rightEyeFrustum->m_xform.IsZero() ? 1 : 2;
+  return [scene meshesInFrustums: frustums count: frustumCount indexes: drawList->inView opaqueCount: opaqueCount];
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) drawTransparentMeshes
 {
   // Drawing transparent meshes is a 3 pass process...
   //
@@ -788,58 +982,221 @@ enum
   //            i. Draw all "open" objects' back faces
   //
   
-  if ( scene ) 
+  const ON_SimpleArray<DisplayMesh*>& meshes = drawList->transmeshes;
+  if ( meshes.Count() == 0 )
+    return;
+  
+  glDepthMask( GL_FALSE );
+  glEnable( GL_CULL_FACE );
+  
+  for (int i = 0; i < meshes.Count(); i++)
   {
-    // Now render all transparent meshes...
-    NSArray* meshes = [scene transmeshes];
-
-    if ( meshes.count > 0 )
+    DisplayMesh* mesh = meshes[i];
+    glCullFace( GL_FRONT );
+    [self drawMesh: mesh];
+    
+    if ( !mesh.isClosed )
     {
-      glDepthMask( GL_FALSE );
-      glEnable( GL_CULL_FACE );
-      
-      for (DisplayMesh* mesh in meshes) 
-      {
-        glCullFace( GL_FRONT );
-        [self drawMesh: mesh];
-        
-        if ( !mesh.isClosed )
-        {
-          glCullFace( GL_BACK );
-          [self drawMesh: mesh];
-        }
-      }
-      
-      glDepthMask( GL_TRUE );
       glCullFace( GL_BACK );
-      for (DisplayMesh* mesh in meshes) 
-        [self drawMesh: mesh];
-      
-      glCullFace( GL_FRONT );
-      for (DisplayMesh* mesh in meshes) 
+      [self drawMesh: mesh];
+    }
+  }
+  
+  glDepthMask( GL_TRUE );
+  glCullFace( GL_BACK );
+  for (int i = 0; i < meshes.Count(); i++)
+    [self drawMesh: meshes[i]];
+  
+  glCullFace( GL_FRONT );
+  for (int i = 0; i < meshes.Count(); i++)
+  {
+    DisplayMesh* mesh = meshes[i];
+    if ( !mesh.isClosed )
+      [self drawMesh: mesh];
+  }
+  glDisable( GL_CULL_FACE );
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) drawCurves: (RhModel*) scene
+{
+  NSArray* curves = [scene curves];
+  
+  if ( (curves.count == 0) || (wireframeShader == NULL) )
+    return;
+  
+  // One draw call per wireframe color...
+  wireframeShader->Enable();
+  glEnableVertexAttribArray( ATTRIB_VERTEX );
+  frameStats->CountStateChanges();
+  
+  for (DisplayCurves* dc in curves)
+  {
+    ON_Material material;
+    material.SetEmission( [dc color] );
+    wireframeShader->SetupMaterial( material );
+    
+    glBindBuffer( GL_ARRAY_BUFFER, [dc vertexBuffer] );
+    glVertexAttribPointer( ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, sizeof(ON_3fPoint), 0 );
+    glDrawArrays( GL_LINES, 0, [dc vertexCount] );
+    frameStats->CountStateChanges( 2 );
+    frameStats->CountDrawCall( 0, [dc vertexCount]/2 );
+  }
+  
+  glDisableVertexAttribArray( ATTRIB_VERTEX );
+  
+  if ( activeShader != NULL )
+  {
+    activeShader->Enable();
+    frameStats->CountStateChanges();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) preparePointClouds: (RhModel*) scene inViewport: (const ON_Viewport&) viewport inWidth: (int) width inHeight: (int) height
+{
+  NSArray* pointClouds = [scene pointClouds];
+  
+  if ( pointClouds.count == 0 )
+    return;
+  
+  // Fewer points while the view is moving...
+  int pointBudget = (frameFastDrawing ? FastPointCloudBudget : PointCloudBudget) / pointClouds.count;
+  
+  for (DisplayPointCloud* dpc in pointClouds)
+  {
+    if ( [dpc prepareForViewport: viewport width: width height: height pointBudget: pointBudget] )
+      drawAnotherFrame = YES;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) drawPointClouds: (RhModel*) scene
+{
+  NSArray* pointClouds = [scene pointClouds];
+  
+  if ( (pointClouds.count == 0) || (pointCloudShaders == NULL) )
+    return;
+  
+  glEnableVertexAttribArray( ATTRIB_VERTEX );
+  
+  for (DisplayPointCloud* dpc in pointClouds)
+  {
+    CRhGLShaderProgram* pointCloudShader = pointCloudShaders->Enable( [dpc hasColors] ? CRhGLShaderVariants::vertex_colors : 0 );
+    if ( pointCloudShader == NULL )
+      continue;
+    
+    ON_Material material;
+    material.SetEmission( [dpc color] );
+    pointCloudShader->SetupMaterial( material );
+    frameStats->CountStateChanges( 2 );
+    
+    if ( [dpc hasColors] )
+      glEnableVertexAttribArray( ATTRIB_COLOR );
+    else
+      glDisableVertexAttribArray( ATTRIB_COLOR );
+    
+    unsigned int stride = [dpc Stride];
+    
+    for (int idx = 0; idx < [dpc drawNodeCount]; idx++)
+    {
+      glBindBuffer( GL_ARRAY_BUFFER, [dpc vertexBufferForDrawNode: idx] );
+      glVertexAttribPointer( ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, stride, 0 );
+      if ( [dpc hasColors] )
+        glVertexAttribPointer( ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (GLvoid*)sizeof(ON_3fPoint) );
+      glDrawArrays( GL_POINTS, 0, [dpc pointCountForDrawNode: idx] );
+      frameStats->CountStateChanges();
+      frameStats->CountDrawCall( 0, 0, [dpc pointCountForDrawNode: idx] );
+    }
+  }
+  
+  glDisableVertexAttribArray( ATTRIB_VERTEX );
+  glDisableVertexAttribArray( ATTRIB_COLOR );
+  
+  if ( activeShader != NULL )
+  {
+    activeShader->Enable();
+    frameStats->CountStateChanges();
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+// Culls the scene once for the frame, against both eyes when rightEye is
+// not NULL, and fills the draw list.  Evicted meshes in view are restored
+// and stay resident until endScene:, so every eye drawn in between with
+// drawScene: only changes the view.
+- (void) beginScene: (RhModel*) scene leftEye: (const ON_Viewport&) leftEye rightEye: (const ON_Viewport*) rightEye inWidth: (int) width inHeight: (int) height
+{
+  drawList->meshes.SetCount( 0 );
+  drawList->transmeshes.SetCount( 0 );
+  if ( scene == nil )
+    return;
+  
+  [self setViewFrustum: leftEye rightEye: rightEye];
+  
+  // The eyes are a few centimeters apart; one set of point cloud nodes does for both
+  [self preparePointClouds: scene inViewport: leftEye inWidth: width inHeight: height];
+  
+  // Evicted meshes are restored while the frame holds the residency lock
+  RhMeshResidency* residency = [scene meshResidency];
+  [residency beginFrame];
+  
+  int opaqueCount = 0;
+  NSArray* meshes = [self meshesInView: scene opaqueCount: &opaqueCount];
+  if ( meshes != nil )
+  {
+    // the tree skipped the rest
+    frameStats->Frame().culled_objects += (int)meshes.count - drawList->inView.Count();
+    for (int i = 0; i < drawList->inView.Count(); i++)
+    {
+      const int idx = drawList->inView[i];
+      DisplayMesh* mesh = [meshes objectAtIndex: idx];
+      if ( [self useMesh: mesh residency: residency] )
       {
-        if ( !mesh.isClosed )
-          [self drawMesh: mesh];
+        if ( idx < opaqueCount )
+          drawList->meshes.Append( mesh );
+        else
+          drawList->transmeshes.Append( mesh );
       }
-      glDisable( GL_CULL_FACE );
     }
+    return;
+  }
+  
+  for (DisplayMesh* mesh in [scene meshes])
+  {
+    if ( [self shouldDrawMesh: mesh residency: residency] )
+      drawList->meshes.Append( mesh );
   }
+  for (DisplayMesh* mesh in [scene transmeshes])
+  {
+    if ( [self shouldDrawMesh: mesh residency: residency] )
+      drawList->transmeshes.Append( mesh );
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+- (void) endScene: (RhModel*) scene
+{
+  if ( [[scene meshResidency] endFrame] )
+    drawAnotherFrame = YES;
+  drawList->meshes.SetCount( 0 );
+  drawList->transmeshes.SetCount( 0 );
 }
 
 /////////////////////////////////////////////////////////////////////
+// Draws the draw list built by beginScene: from the current view
 - (void) drawScene: (RhModel*) scene
 {
   // Draw scene...
   if ( scene ) 
   {
-    // draw each mesh
-    NSArray* meshes = [scene meshes];
-    
     // First render all opaque objects...
-    for (DisplayMesh* mesh in meshes)
-      [self drawMesh: mesh];
+    for (int i = 0; i < drawList->meshes.Count(); i++)
+      [self drawMesh: drawList->meshes[i]];
   
-    [self drawTransparentMeshes: scene];
+    [self drawCurves: scene];
+    [self drawPointClouds: scene];
+    [self drawTransparentMeshes];
   }
   CheckGLError();
 }
@@ -875,62 +1232,172 @@ enum
 ////////////////////////////////////////////////////////////////////
 - (void) renderToTarget: (RhModel*) scene inFBO: (GLuint) target inWidth: (int) width inHeight: (int) height
 {
-  // Enable oversample FBO...
+  // Enable offscreen FBO...
   glBindFramebuffer( GL_FRAMEBUFFER, target );
   glViewport( 0, 0, width, height );
   glDepthFunc( GL_GEQUAL );
   
+  // Reduced resolution frames only use part of the target; leave the rest alone
+  const BOOL scissor = (width < textureWidth || height < textureHeight);
+  if ( scissor )
+  {
+    glScissor( 0, 0, width, height );
+    glEnable( GL_SCISSOR_TEST );
+  }
+  
   [self clearBackground];
   [self drawScene: scene];
+  
+  if ( scissor )
+    glDisable( GL_SCISSOR_TEST );
   CheckGLError();
 }
 
 
 /////////////////////////////////////////////////////////////////////
-- (void) renderModelWithTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport doPresent:(BOOL) present
+// Size to draw a frame at while the view is moving.  Returns NO when the frame
+// should be drawn straight into the view at full resolution.
+- (BOOL) getScaledFrameWidth: (GLint&) width height: (GLint&) height
 {
-  if ([model onMacModel] == nil)
+  width  = backingWidth;
+  height = backingHeight;
+  if ( !canAntialias || !frameFastDrawing || resolution->Scale() >= 1.0 )
+    return NO;
+  width  = resolution->ScaledSize( backingWidth );
+  height = resolution->ScaledSize( backingHeight );
+  return YES;
+}
+
+
+/////////////////////////////////////////////////////////////////////
+// Tells the resolution controller what the frame that just ended cost
+- (void) updateResolution
+{
+  if ( !canAntialias || !frameFastDrawing )
     return;
-  
-  glDisable(GL_BLEND);
-  [self renderToTarget: model inFBO: textureFramebuffer inWidth:textureWidth inHeight:textureHeight];
-  
-  //if ( present )
-  //  [self saveTextureToFileNamed: @"/Users/jefflasor/Desktop/Texture.png"];
-  
+  const RhFrameCounters& frame = frameStats->Frame();
+  resolution->FrameDrawn( frame.submit_ms + frame.present_ms, frame.present_ms );
+}
+
+
+/////////////////////////////////////////////////////////////////////
+// Stretches the lower left width x height pixels of a texture over the view
+// and presents the view.
+- (void) presentTexture: (GLuint) source inWidth: (GLint) width inHeight: (GLint) height doCapture: (BOOL) capture
+{
   glBindFramebuffer (GL_FRAMEBUFFER, defaultFramebuffer);
   glViewport (0, 0, backingWidth, backingHeight);
   CheckGLError();
   
-  if ( present )
-  {
-    glActiveTexture( GL_TEXTURE0 );
-    glBindTexture( GL_TEXTURE_2D, texture );
-   
-    glDisable( GL_BLEND );
-    [self DisableAnaglyphMode];
-    quadShader->Enable();
-    [self drawScreenAlignedQuad];
-    quadShader->Disable();
-   
-    CheckGLError();
-  }
+  glActiveTexture( GL_TEXTURE0 );
+  glBindTexture( GL_TEXTURE_2D, source );
   
-  if (present && needsImageCapturedDelegate) {
+  glDisable( GL_BLEND );
+  [self DisableAnaglyphMode];
+  quadShader->Enable();
+  glUniform2f( quadTexScale, (float)width/(float)textureWidth, (float)height/(float)textureHeight );
+  [self drawScreenAlignedQuad];
+  quadShader->Disable();
+  CheckGLError();
+  
+  if (capture && needsImageCapturedDelegate) {
     [capturedImage release];
     capturedImage = [[self captureImage] retain];
     if ([needsImageCapturedDelegate respondsToSelector: @selector(didCaptureImage:)])
       [needsImageCapturedDelegate performSelectorOnMainThread: @selector(didCaptureImage:) withObject: capturedImage waitUntilDone: NO];
     needsImageCapturedDelegate = nil;
   }
-    
+  
+  frameStats->BeginPresent();
+  glBindRenderbuffer (GL_RENDERBUFFER, colorRenderbuffer);
+  [renderContext presentRenderbuffer: GL_RENDERBUFFER];
+  CheckGLError();
+}
+
+
+/////////////////////////////////////////////////////////////////////
+// Draws into the lower left width x height pixels of the texture and, if
+// present is YES, stretches them over the view.
+- (void) renderModelWithTexture: (RhModel*) model inViewport: (ON_Viewport&) viewport inWidth: (GLint) width inHeight: (GLint) height doPresent:(BOOL) present
+{
+  if ([model onMacModel] == nil)
+    return;
+  
+  glDisable(GL_BLEND);
+  [self renderToTarget: model inFBO: textureFramebuffer inWidth: width inHeight: height];
+  
+  //if ( present )
+  //  [self saveTextureToFileNamed: @"/Users/jefflasor/Desktop/Texture.png"];
+  
   if ( present )
+    [self presentTexture: texture inWidth: width inHeight: height doCapture: YES];
+}  
+
+
+/////////////////////////////////////////////////////////////////////
+// Blends the texture into the accumulation texture with the weight of the
+// next sample, so the accumulation texture holds the average of the samples.
+- (void) accumulateTexture: (CRhTemporalAA&) samples
+{
+  glBindFramebuffer( GL_FRAMEBUFFER, accumFramebuffer );
+  glViewport( 0, 0, textureWidth, textureHeight );
+  
+  glActiveTexture( GL_TEXTURE0 );
+  glBindTexture( GL_TEXTURE_2D, texture );
+  
+  // the first sample replaces whatever was there
+  if ( samples.SampleIndex() > 0 )
   {
-    glBindRenderbuffer (GL_RENDERBUFFER, colorRenderbuffer);
-    [renderContext presentRenderbuffer: GL_RENDERBUFFER];
-    CheckGLError();
+    glEnable( GL_BLEND );
+    glBlendColor( 0.0f, 0.0f, 0.0f, samples.SampleWeight() );
+    glBlendFunc( GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA );
   }
-}  
+  
+  quadShader->Enable();
+  glUniform2f( quadTexScale, 1.0f, 1.0f );
+  [self drawScreenAlignedQuad];
+  quadShader->Disable();
+  
+  glDisable( GL_BLEND );
+  glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+  CheckGLError();
+  
+  samples.SampleDone();
+}
+
+
+/////////////////////////////////////////////////////////////////////
+// Draws the next antialiasing sample of a still view, a stereo pair when
+// rightEye is not NULL, and adds it to the accumulation texture.  When
+// present is YES the view shows the average of the samples so far.
+- (void) renderSample: (CRhTemporalAA&) samples model: (RhModel*) model leftEye: (const ON_Viewport&) leftEye rightEye: (const ON_Viewport*) rightEye doPresent: (BOOL) present
+{
+  if ([model onMacModel] == nil)
+  {
+    samples.Stop();
+    return;
+  }
+  
+  ON_Viewport sampleViewport;
+  samples.GetSampleViewport( leftEye, textureWidth, textureHeight, sampleViewport );
+  [self setupActiveShader: model inViewport: sampleViewport];
+  [self renderModelWithTexture: model inViewport: sampleViewport inWidth: textureWidth inHeight: textureHeight doPresent: NO];
+  
+  if ( rightEye != NULL )
+  {
+    samples.GetSampleViewport( *rightEye, textureWidth, textureHeight, sampleViewport );
+    [self setupActiveShader: model inViewport: sampleViewport];
+    [self EnableAnaglypMode: stereoConfig];
+    [self renderModelWithTexture: model inViewport: sampleViewport inWidth: textureWidth inHeight: textureHeight doPresent: NO];
+    [self DisableAnaglyphMode];
+  }
+  
+  [self accumulateTexture: samples];
+  
+  // images are only captured once they are fully antialiased
+  if ( present )
+    [self presentTexture: accumTexture inWidth: textureWidth inHeight: textureHeight doCapture: samples.IsConverged()];
+}
 
 
 /////////////////////////////////////////////////////////////////////
@@ -960,6 +1427,7 @@ enum
   
   if ( present )
   {
+    frameStats->BeginPresent();
     glBindRenderbuffer (GL_RENDERBUFFER, colorRenderbuffer);
     [renderContext presentRenderbuffer: GL_RENDERBUFFER];
     CheckGLError();
@@ -969,40 +1437,58 @@ enum
 
 /////////////////////////////////////////////////////////////////////
 // This method is run on NSThread renderThread
-- (void) renderOneFrame
+- (void) renderOneFrame: (const RhFrameState&) state
 {
   RhModel* model;
   static ON_Viewport viewport;
   
+  // the lock keeps resizeFromLayer: from changing the framebuffers mid frame
   @synchronized(self)
   {
-    model = renderModel;
-    viewport = renderViewport1;
-    performingRender = NO;
+    RH_TRACE_SCOPE( "renderOneFrame" );
+    model = state.model;
+    viewport = state.leftEye;
+    frameFastDrawing = state.fastDrawing;
+    drawAnotherFrame = NO;
+    frameStats->BeginFrame();
     
     [EAGLContext setCurrentContext: renderContext];
     CheckGLError();
     
-    if ( !RhinoApp.fastDrawing )
-      activeShader = perpixelShader;
+    if ( !frameFastDrawing )
+      activeShaders = perpixelShaders;
     else
-      activeShader = pervertexShader;
+      activeShaders = pervertexShaders;
     
-    [self setupActiveShader: model inViewport: viewport];  
+    GLint width, height;
+    const BOOL scaled = [self getScaledFrameWidth: width height: height];
+    [self beginScene: model leftEye: viewport rightEye: NULL inWidth: width inHeight: height];
     
     glDepthFunc( GL_GEQUAL );
-    if (canAntialias && !RhinoApp.fastDrawing)
-      [self renderModelWithTexture: model inViewport: viewport doPresent: YES];
+    if (canAntialias && !frameFastDrawing)
+      [self renderSample: *temporalAA model: model leftEye: viewport rightEye: NULL doPresent: YES];
+    else if (scaled)
+    {
+      [self setupActiveShader: model inViewport: viewport];  
+      [self renderModelWithTexture: model inViewport: viewport inWidth: width inHeight: height doPresent: YES];
+    }
     else
+    {
+      [self setupActiveShader: model inViewport: viewport];  
       [self renderModelWithoutTexture: model inViewport: viewport doPresent: YES];
+    }
 
-    activeShader->Disable();
+    [self endScene: model];
+    if ( activeShader != NULL )
+      activeShader->Disable();
+    frameStats->EndFrame();
+    [self updateResolution];
   }
 }
 
 /////////////////////////////////////////////////////////////////////
 // This method is run on NSThread renderThread
-- (void) renderStereoFrame
+- (void) renderStereoFrame: (const RhFrameState&) state
 {
   RhModel* model;
   static ON_Viewport leftEye;
@@ -1010,28 +1496,38 @@ enum
   
   @synchronized(self)
   {
-    model = renderModel;
-    leftEye  = renderViewport1;
-    rightEye = renderViewport2;
-    performingRender = NO;
+    RH_TRACE_SCOPE( "renderStereoFrame" );
+    model = state.model;
+    leftEye  = state.leftEye;
+    rightEye = state.rightEye;
+    frameFastDrawing = state.fastDrawing;
+    drawAnotherFrame = NO;
+    frameStats->BeginFrame();
     
     [EAGLContext setCurrentContext: renderContext];
     CheckGLError();
     
-    if ( !RhinoApp.fastDrawing )
-      activeShader = perpixelShader;
+    if ( !frameFastDrawing )
+      activeShaders = perpixelShaders;
     else
-      activeShader = pervertexShader;
+      activeShaders = pervertexShaders;
+    
     
+    // Both eyes are drawn from one draw list; only the view changes between them
+    GLint width, height;
+    const BOOL scaled = [self getScaledFrameWidth: width height: height];
+    [self beginScene: model leftEye: leftEye rightEye: &rightEye inWidth: width inHeight: height];
     
-    if (canAntialias && !RhinoApp.fastDrawing)
+    if (canAntialias && !frameFastDrawing)
+      [self renderSample: *temporalAA model: model leftEye: leftEye rightEye: &rightEye doPresent: YES];
+    else if (scaled)
     {
       [self setupActiveShader: model inViewport: leftEye];  
-      [self renderModelWithTexture: model inViewport: leftEye doPresent: NO];
+      [self renderModelWithTexture: model inViewport: leftEye inWidth: width inHeight: height doPresent: NO];
       
       [self setupActiveShader: model inViewport: rightEye];  
       [self EnableAnaglypMode: stereoConfig];
-      [self renderModelWithTexture: model inViewport: rightEye doPresent: YES];
+      [self renderModelWithTexture: model inViewport: rightEye inWidth: width inHeight: height doPresent: YES];
     }
     else
     {
@@ -1043,8 +1539,12 @@ enum
       [self renderModelWithoutTexture: model inViewport: rightEye doPresent: YES];
     }
     
+    [self endScene: model];
     [self DisableAnaglyphMode];
-    activeShader->Disable();
+    if ( activeShader != NULL )
+      activeShader->Disable();
+    frameStats->EndFrame();
+    [self updateResolution];
   }
 }
 
@@ -1054,6 +1554,7 @@ enum
 - (void) renderFrames
 {
   NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+  RhTraceSetThreadName( "render" );
   
   // initialize OpenGL context in this render thread
   if (renderContext == nil) {
@@ -1081,35 +1582,70 @@ enum
 }
 
 
+/////////////////////////////////////////////////////////////////////
+// This method is run on NSThread renderThread
+- (void) renderFrame
+{
+  // requests published after this get a frame of their own
+  __sync_bool_compare_and_swap( &frameRequested, 1, 0 );
+  const bool newState = frameState->Acquire();
+  const RhFrameState& state = frameState->ReadBuffer();
+  
+  // a new view, or one whose last frame was still missing some of the scene,
+  // starts the antialiasing over
+  if ( newState || drawAnotherFrame )
+    temporalAA->Restart();
+  
+  if (state.stereo)
+    [self renderStereoFrame: state];
+  else
+    [self renderOneFrame: state];
+  
+  // keep drawing until the point cloud nodes and meshes for this view are loaded
+  // and, once the view is still, until all the antialiasing samples are in
+  const BOOL sampling = canAntialias && !state.fastDrawing && !temporalAA->IsConverged();
+  if ( (drawAnotherFrame || sampling) && __sync_bool_compare_and_swap( &frameRequested, 0, 1 ) )
+    [self performSelector: _cmd onThread: [self renderThread] withObject: nil waitUntilDone: NO];
+}
+
+
+/////////////////////////////////////////////////////////////////////
+// This method runs on the main thread and schedules the frame in frameState->WriteBuffer()
+// to be drawn on the render thread.  It never waits for the render thread; if a frame is
+// already scheduled that frame draws the newest state.
+- (void) publishFrameState
+{
+  frameState->Publish();
+  if ( __sync_bool_compare_and_swap( &frameRequested, 0, 1 ) )
+    [self performSelector: @selector(renderFrame) onThread: [self renderThread] withObject: nil waitUntilDone: NO];
+  else
+    frameStats->CountCoalescedRequest();
+}
+
+
 /////////////////////////////////////////////////////////////////////
 // This method runs on the main thread and schedules one frame to be drawn on the render thread
 - (void) renderModel: (RhModel*) model inViewport: (ON_Viewport) viewport
 {
-  @synchronized(self)
-  {    
-    renderModel = model;
-    renderViewport1 = viewport;
-    
-    if (!performingRender)
-      [self performSelector: @selector(renderOneFrame) onThread: [self renderThread] withObject: nil waitUntilDone: NO];
-    performingRender = YES;
-  }
+  RhFrameState& state = frameState->WriteBuffer();
+  state.model = model;
+  state.leftEye = viewport;
+  state.stereo = NO;
+  state.fastDrawing = RhinoApp.fastDrawing;
+  [self publishFrameState];
 }
 
 
 /////////////////////////////////////////////////////////////////////
 - (void) renderModel: (RhModel*) model inLeftEye: (const ON_Viewport&) leftEye inRightEye: (const ON_Viewport&) rightEye;
 {
-  @synchronized(self)
-  {    
-    renderModel = model;
-    renderViewport1 = leftEye;
-    renderViewport2 = rightEye;
-    
-    if (!performingRender)
-      [self performSelector: @selector(renderStereoFrame) onThread: [self renderThread] withObject: nil waitUntilDone: NO];
-    performingRender = YES;
-  }
+  RhFrameState& state = frameState->WriteBuffer();
+  state.model = model;
+  state.leftEye = leftEye;
+  state.rightEye = rightEye;
+  state.stereo = YES;
+  state.fastDrawing = RhinoApp.fastDrawing;
+  [self publishFrameState];
 }
 
 
@@ -1117,36 +1653,60 @@ enum
 // This method runs on the main thread
 - (UIImage*) renderPreview: (RhModel*) model inViewport: (ON_Viewport) viewport
 {
-  [EAGLContext setCurrentContext: mainContext];
-  CheckGLError();
-  
-  // set transparent background color
-  ON_Color savedBackgroundColor = backgroundColor;
-  backgroundColor = ON_Color (0, 0, 0, 0);
-  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-  
-  // draw the model at texture size with a transparent background
-  [self renderModelWithTexture: model inViewport: viewport doPresent: YES];
-  UIImage* previewImage = [self captureImage];
+  UIImage* previewImage;
   
-  // restore background color
-  backgroundColor = savedBackgroundColor;
-  glClearColor( (float)backgroundColor.FractionRed(), 
-                (float)backgroundColor.FractionGreen(), 
-                (float)backgroundColor.FractionBlue(), 
-                (float)backgroundColor.FractionAlpha()
-               );
+  // the lock keeps the render thread out of the textures
+  @synchronized(self)
+  {
+    [EAGLContext setCurrentContext: mainContext];
+    CheckGLError();
+    
+    // set transparent background color
+    ON_Color savedBackgroundColor = backgroundColor;
+    backgroundColor = ON_Color (0, 0, 0, 0);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    
+    // draw all the antialiasing samples at once with a transparent background
+    CRhTemporalAA samples;
+    [self beginScene: model leftEye: viewport rightEye: NULL inWidth: textureWidth inHeight: textureHeight];
+    while ( !samples.IsConverged() )
+    {
+      const BOOL lastSample = ( samples.SampleIndex() == CRhTemporalAA::sample_count-1 );
+      [self renderSample: samples model: model leftEye: viewport rightEye: NULL doPresent: lastSample];
+    }
+    [self endScene: model];
+    previewImage = [self captureImage];
+    
+    // the view's own samples were overwritten
+    temporalAA->Restart();
+    
+    // restore background color
+    backgroundColor = savedBackgroundColor;
+    glClearColor( (float)backgroundColor.FractionRed(), 
+                  (float)backgroundColor.FractionGreen(), 
+                  (float)backgroundColor.FractionBlue(), 
+                  (float)backgroundColor.FractionAlpha()
+                 );
+  }
   return previewImage;
 }
 
 /////////////////////////////////////////////////////////////////////
 - (void) drawMesh: (DisplayMesh*) mesh
 {
+  if ( ![mesh isResident] )
+    return;
+  
+  [self enableShaderVariant: [self shaderFeaturesOfMesh: mesh]];
+  
   if (mesh.selected)
     [self setMaterial: [self selectedMaterialWithMaterial:[mesh material]]];
   else
     [self setMaterial: [mesh material]];
     
+  if ( activeShader != NULL )
+    activeShader->SetupInstanceOffset( [mesh instanceOffset] );
+  
   glBindBuffer( GL_ARRAY_BUFFER, [mesh vertexBuffer] );
   
   unsigned int stride = [mesh Stride];
@@ -1169,8 +1729,6 @@ enum
     
     glEnableVertexAttribArray( ATTRIB_COLOR );
     glVertexAttribPointer( ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset );
-    if ( activeShader != NULL )
-      activeShader->EnableColorUsage( true );
   }
   
   glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, [mesh indexBuffer] );
@@ -1178,6 +1736,11 @@ enum
 
   glDisableVertexAttribArray( ATTRIB_VERTEX );
   glDisableVertexAttribArray( ATTRIB_NORMAL );
+  glDisableVertexAttribArray( ATTRIB_COLOR );
+  
+  // material, vertex buffer and index buffer
+  frameStats->CountStateChanges( 3 );
+  frameStats->CountDrawCall( [mesh triangleCount] );
 }
 
 #pragma mark ---- picking image ----
@@ -1203,7 +1766,14 @@ enum
 
 - (void) drawPickImageMesh: (DisplayMesh*) mesh
 {
+  if ( ![mesh isResident] )
+    return;
+  
+  // Pick colors are flat, so the variant without normals or vertex colors does
+  [self enableShaderVariant: [mesh instanceOffset].IsZero() ? 0 : CRhGLShaderVariants::instance_offset];
   [self setPickColor: [mesh pickColor]];
+  if ( activeShader != NULL )
+    activeShader->SetupInstanceOffset( [mesh instanceOffset] );
 
   glBindBuffer( GL_ARRAY_BUFFER, [mesh vertexBuffer] );
 
@@ -1211,31 +1781,11 @@ enum
   
   glEnableVertexAttribArray( ATTRIB_VERTEX );
   glVertexAttribPointer( ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, stride, 0 );
-  
-  if ( [mesh hasVertexNormals] )
-  {
-    glEnableVertexAttribArray( ATTRIB_NORMAL );
-    glVertexAttribPointer( ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)sizeof(ON_3fPoint) );
-  }
-
-  if ( [mesh hasVertexColors] )
-  {
-    int  offset = sizeof(ON_3fPoint);
-    
-    if ( [mesh hasVertexNormals] )
-      offset += sizeof(ON_3fVector);
-    
-    glEnableVertexAttribArray( ATTRIB_COLOR );
-    glVertexAttribPointer( ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset );
-    if ( activeShader != NULL )
-      activeShader->EnableColorUsage( true );
-  }
 
   glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, [mesh indexBuffer] );
   glDrawElements( GL_TRIANGLES, 3 * [mesh triangleCount], GL_UNSIGNED_SHORT, 0 );  
 
   glDisableVertexAttribArray( ATTRIB_VERTEX );
-  glDisableVertexAttribArray( ATTRIB_NORMAL );
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -1248,6 +1798,27 @@ enum
     // draw each mesh
     NSArray* meshes = [scene meshes];
     
+    // evicted meshes are left out of the pick image until they are drawn again
+    RhMeshResidency* residency = [scene meshResidency];
+    [residency beginFrame];
+    
+    // only the meshes in view when the model has a mesh tree
+    int opaqueCount = 0;
+    NSArray* meshesInView = [self meshesInView: scene opaqueCount: &opaqueCount];
+    if ( meshesInView != nil )
+    {
+      for (int i = 0; i < drawList->inView.Count(); i++)
+      {
+        const int idx = drawList->inView[i];
+        DisplayMesh* mesh = [meshesInView objectAtIndex: idx];
+        if ( idx < opaqueCount || [mesh material].Transparency() < 0.8 )
+          [self drawPickImageMesh: mesh];
+      }
+      [residency endFrame];
+      CheckGLError();
+      return;
+    }
+    
     // render all opaque objects...
     for (DisplayMesh* mesh in meshes)
       [self drawPickImageMesh: mesh];
@@ -1265,6 +1836,7 @@ enum
           [self drawPickImageMesh: mesh];
       }
     }
+    [residency endFrame];
   }
   CheckGLError();
 }
@@ -1279,13 +1851,17 @@ enum
   
   @synchronized(self)
   {
-    model = renderModel;
-    viewport = renderViewport1;
+    RH_TRACE_SCOPE( "renderPickBitmap" );
+    // the frame drawn after this one no longer sees the new view as new
+    if ( frameState->Acquire() )
+      temporalAA->Restart();
+    model = frameState->ReadBuffer().model;
+    viewport = frameState->ReadBuffer().leftEye;
     
     if ([model onMacModel] == nil)
       return;
     
-    activeShader = pervertexShader;
+    activeShaders = pervertexShaders;
     [self setupActiveShader: model inViewport: viewport];  
     
     glBindFramebuffer (GL_FRAMEBUFFER, defaultFramebuffer);
@@ -1300,6 +1876,9 @@ enum
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
+    // the meshes out of view are not drawn
+    [self setViewFrustum: viewport rightEye: NULL];
+    
     // draw the scene using flat shading and the the mesh pick colors
     [self drawPickImageScene: model];
     
@@ -1314,7 +1893,8 @@ enum
                  (float)backgroundColor.FractionAlpha()
                  );
     
-    activeShader->Disable();
+    if ( activeShader != NULL )
+      activeShader->Disable();
   }
 }
 
@@ -16,6 +16,10 @@
 
 #import <QuartzCore/QuartzCore.h>
 #import "DisplayMesh.h"
+#include "RhFrameStats.h"
+#include "RhResolutionController.h"
+#include "RhTemporalAA.h"
+#include "RhTripleBuffer.h"
 
 #import <OpenGLES/EAGL.h>
 #import <OpenGLES/EAGLDrawable.h>
@@ -34,6 +38,30 @@ struct RhGLDrawable
 @class RhModelView;
 
 
+// What the main thread asks the render thread to draw next
+struct RhFrameState
+{
+  RhFrameState() : model(nil), stereo(NO), fastDrawing(NO) {}
+
+  RhModel* model;           // not retained
+  ON_Viewport leftEye;      // the viewport when stereo is NO
+  ON_Viewport rightEye;
+  BOOL stereo;
+  BOOL fastDrawing;         // RhinoApp.fastDrawing when the frame was requested
+};
+
+
+// The meshes of the frame being drawn that passed culling, in the order they
+// are drawn.  It is built once per frame and drawn once per eye, so a stereo
+// pair culls and restores evicted meshes only once.
+struct RhDrawList
+{
+  ON_SimpleArray<DisplayMesh*> meshes;        // opaque, not retained
+  ON_SimpleArray<DisplayMesh*> transmeshes;   // transparent, not retained
+  ON_SimpleArray<int> inView;                 // indexes of the meshes found by the model's mesh tree
+};
+
+
 @protocol ESRenderer <NSObject>
 
 - (void) renderModel: (RhModel*) model inViewport: (ON_Viewport) viewport;
@@ -56,6 +84,9 @@ struct RhGLDrawable
 - (void) setNeedsImageCapturedForDelegate: (id) aDelegate;
 - (void) drawMesh: (DisplayMesh*) mesh;
 
+// Counters of the most recently drawn frames; may be called from any thread
+- (void) getFrameStats: (CRhFrameStatsSummary&) summary;
+
 @end
 
 
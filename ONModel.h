@@ -17,6 +17,13 @@
 #if !defined(ONX_MODEL_EXTENSIONS_INC_)
 #define ONX_MODEL_EXTENSIONS_INC_
 
+#include "RhModelIndex.h"
+#include "RhJobSystem.h"
+
+class CRhLoadEstimate;
+class CRhLoadTask;
+class CRhObjectReceiver;
+
 /*
 Description:
   Used to store user data information in an EX_ONX_Model.
@@ -203,6 +210,33 @@ public:
   
   int ShouldKeepObject (ON_Object*, ON_3dmObjectAttributes& attr);
   // return +1 to keep object, 0 to discard object, -1 to stop reading file
+
+  bool ShouldSkipObject (ON::object_type type, const ON_3dmObjectAttributes& attr, ON__UINT64 record_key, ON__UINT64 record_bytes);
+  // called before a point cloud is read, return true if it is not needed and the record can be skipped;
+  // record_key tells records apart, see CRhObjectReadPipeline::SetSkipFilter()
+
+  int KeepObject (ON_Object*, ON_3dmObjectAttributes& attr, CRhObjectReceiver& receiver);
+  bool SkipObject (ON::object_type type, const ON_3dmObjectAttributes& attr, ON__UINT64 record_key, ON__UINT64 record_bytes,
+                   CRhObjectReceiver& receiver);
+  // the viewer's ShouldKeepObject() and ShouldSkipObject() policy, see RhDisplayData.cpp
+
+  int ShouldReadObjectTable (const CRhLoadEstimate& estimate);
+  // called before the first object is read, return +1 to read the objects, -1 to stop reading file
+
+  size_t SizeOfTables() const;
+  // bytes held by the tables and the objects kept in them
+
+  // When true, Read() turns off chunk CRC verification.  Only set this
+  // for files whose contents were verified by an earlier read.
+  bool m_bSkipCRCCheck;
+  
+  // When set, Read() reports object table progress to this task and stops
+  // when it is cancelled.  Not owned.
+  CRhLoadTask* m_load_task;
+  
+  // RhModel the objects are read for, see ShouldKeepObject().  NULL means
+  // the application's current model.
+  void* m_owner;
   
   /*
    * End of RhinoView Additions
@@ -428,6 +462,29 @@ public:
         ON_SimpleArray<int>* warnings
         );
 
+  /*
+  Description:
+    Does the checks and repairs of EX_ONX_Model::Audit() as
+    CRhJobSystem jobs and reports the same results.  The tables are checked
+    concurrently and the object table is split into ranges.  Use it
+    for models with many objects.
+  Parameters:
+    bAttemptRepair, repair_count, text_log, warnings - [in/out]
+        as in Audit().
+    job_priority - [in] priority of the audit jobs
+  Returns:
+    Same as Audit().
+  Remarks:
+    Checks added by classes that override Audit() are not done.
+  */
+  int AuditInParallel( 
+        bool bAttemptRepair,
+        int* repair_count,
+        ON_TextLog* text_log,
+        ON_SimpleArray<int>* warnings,
+        CRhJobSystem::priority job_priority = CRhJobSystem::normal_priority
+        );
+
   /////////////////////////////////////////////////////////////////////
   //
   // BEGIN model definitions
@@ -667,6 +724,16 @@ public:
   virtual
   void GetUnusedLayerName( ON_wString& layer_name ) const;
 
+  /*
+  Description:
+    The name and id lookups are hash tables that pick up rows appended
+    to the tables on the next lookup.  Call these after renaming an
+    existing layer or instance definition.  Call DestroyCache() after
+    removing or reordering table rows or changing ids.
+  */
+  void LayerRenamed( int layer_index );
+  void IDefRenamed( int idef_index );
+
 
   /////////////////////////////////////////////////////////////////////
   //
@@ -739,6 +806,20 @@ private:
   EX_ONX_Model& operator=(const EX_ONX_Model&);
 
 private:
+  // Lookups by case folded name and by id, see RhModelIndex.h.  The
+  // const lookups add new rows to them, so they are only used while
+  // holding m_index_lock; the app looks up objects from more than one
+  // thread.
+  mutable CRhTableIndex m_layer_name_index;
+  mutable CRhTableIndex m_idef_name_index;
+  mutable CRhTableIndex m_idef_uuid_index;
+  mutable CRhTableIndex m_object_uuid_index;
+  mutable pthread_mutex_t m_index_lock;
+
+  // GetUnusedLayerName() and GetUnusedIDefName() continue from the last name they returned
+  mutable int m_unused_layer_number;
+  mutable int m_unused_idef_number;
+
 
   // This bounding box contains all objects in the object table.
   ON_BoundingBox m__object_table_bbox;
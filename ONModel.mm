@@ -14,6 +14,10 @@
  */
 
 #include "ONModel.h"
+#include "RhObjectReadPipeline.h"
+#include "RhMemoryUsage.h"
+#include "RhLoadTask.h"
+#include "RhTrace.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -21,6 +25,15 @@
 //
 
 
+// Preloads run their jobs at background priority so they do not hold up the
+// model the user is looking at.
+static CRhJobSystem::priority LoadJobPriority( const CRhLoadTask* task )
+{
+  return ( task && CRhLoadTask::background_priority == task->Priority() )
+         ? CRhJobSystem::background_priority
+         : CRhJobSystem::normal_priority;
+}
+
 void EX_ONX_Model::GetObjectMaterial( 
                                    int object_index,
                                    ON_Material& material 
@@ -61,6 +74,7 @@ void EX_ONX_Model::GetObjectMaterial(
 
 ON_BOOL32 EX_ONX_Model::initWithFilename(const char* sFileName)
 {
+  RH_TRACE_SCOPE( "EX_ONX_Model::initWithFilename" );
   DLog (@"EX_ONX_Model %p initWithFilename: %s", this, sFileName);
 
 	// read the file
@@ -72,11 +86,66 @@ ON_BOOL32 EX_ONX_Model::initWithFilename(const char* sFileName)
 		return FALSE;
 	}
   
+  // Repair nil and duplicate ids and bad table indexes like ONX_Model
+  // readers do with Audit(true).  The object table is checked in ranges
+  // by CRhJobSystem jobs.
+  AuditInParallel( true, NULL, NULL, NULL, LoadJobPriority( m_load_task ) );
   
 	return TRUE;
 }
 
 
+template <class T> static size_t SizeOfObjectArray (const ON_ClassArray<T>& a)
+{
+  size_t sz = a.SizeOfArray();
+  for (int i = 0; i < a.Count(); i++) {
+    // SizeOf() includes sizeof(T), which SizeOfArray() already counted
+    const size_t sizeof_object = a[i].SizeOf();
+    if (sizeof_object > sizeof(T))
+      sz += sizeof_object - sizeof(T);
+  }
+  return sz;
+}
+
+size_t EX_ONX_Model::SizeOfTables() const
+{
+  size_t sz = SizeOfObjectArray (m_mapping_table)
+            + SizeOfObjectArray (m_material_table)
+            + SizeOfObjectArray (m_linetype_table)
+            + SizeOfObjectArray (m_layer_table)
+            + SizeOfObjectArray (m_group_table)
+            + SizeOfObjectArray (m_font_table)
+            + SizeOfObjectArray (m_dimstyle_table)
+            + SizeOfObjectArray (m_hatch_pattern_table)
+            + SizeOfObjectArray (m_idef_table)
+            + m_light_table.SizeOfArray()
+            + m_object_table.SizeOfArray()
+            + m_bitmap_table.SizeOfArray()
+            + m_history_record_table.SizeOfArray()
+            + m_userdata_table.SizeOfArray();
+  
+  for (int i = 0; i < m_object_table.Count(); i++) {
+    const EX_ONX_Model_Object& mo = m_object_table[i];
+    if (mo.m_object && mo.m_bDeleteObject)
+      sz += mo.m_object->SizeOf();
+  }
+  for (int i = 0; i < m_bitmap_table.Count(); i++) {
+    if (m_bitmap_table[i])
+      sz += m_bitmap_table[i]->SizeOf();
+  }
+  for (int i = 0; i < m_history_record_table.Count(); i++) {
+    if (m_history_record_table[i])
+      sz += m_history_record_table[i]->SizeOf();
+  }
+  for (int i = 0; i < m_userdata_table.Count(); i++) {
+    if (m_userdata_table[i].m_goo.m_value > 0)
+      sz += m_userdata_table[i].m_goo.m_value;
+  }
+  
+  return sz;
+}
+
+
 
 void EX_ONX_Model::GetDefaultView( const ON_BoundingBox& bbox, ON_3dmView& view )
 {
@@ -488,11 +557,17 @@ EX_ONX_Model_UserData& EX_ONX_Model_UserData::operator=(const EX_ONX_Model_UserD
 ////////////////////////////////////////////////////////////////////////
 
 EX_ONX_Model::EX_ONX_Model() 
-          : m_3dm_file_version(0), 
+          : m_bSkipCRCCheck(false),
+            m_load_task(0),
+            m_owner(0),
+            m_3dm_file_version(0), 
             m_3dm_opennurbs_version(0),
             m_file_length(0),
-            m_crc_error_count(0)
+            m_crc_error_count(0),
+            m_unused_layer_number(1),
+            m_unused_idef_number(1)
 {
+  pthread_mutex_init( &m_index_lock, NULL );
   m_sStartSectionComments.Empty();
   m_properties.Default();
   m_settings.Default();
@@ -501,6 +576,7 @@ EX_ONX_Model::EX_ONX_Model()
 EX_ONX_Model::~EX_ONX_Model()
 {
   Destroy();
+  pthread_mutex_destroy( &m_index_lock );
 }
 
 void EX_ONX_Model::Destroy()
@@ -549,6 +625,15 @@ void EX_ONX_Model::DestroyCache()
   m_idef_id_index.Empty();
   m_object_id_index.Empty();
 
+  pthread_mutex_lock( &m_index_lock );
+  m_layer_name_index.Empty();
+  m_idef_name_index.Empty();
+  m_idef_uuid_index.Empty();
+  m_object_uuid_index.Empty();
+  pthread_mutex_unlock( &m_index_lock );
+  m_unused_layer_number = 1;
+  m_unused_idef_number = 1;
+
 //  m__object_table_bbox.Destroy();
 }
 
@@ -2195,6 +2280,13 @@ void EX_ONX_Model::Polish()
 }
 
 
+// CRhObjectReadPipeline::SKIP_FILTER for ShouldSkipObject()
+static bool SkipObjectHelper( void* model, ON::object_type object_type, const ON_3dmObjectAttributes& attributes,
+                              ON__UINT64 record_key, ON__UINT64 record_bytes )
+{
+  return ((EX_ONX_Model*)model)->ShouldSkipObject( object_type, attributes, record_key, record_bytes );
+}
+
 bool EX_ONX_Model::Read( 
        const char* filename,
        ON_TextLog* error_log
@@ -2242,12 +2334,17 @@ bool EX_ONX_Model::Read(
 {
   const int max_error_count = 2000;
   int error_count = 0;
+  int pipeline_crc_error_count = 0;
   bool return_code = true;
   int count, rc;
 
   Destroy(); // get rid of any residual stuff
 
+  if ( m_bSkipCRCCheck )
+    archive.EnableCRCCalculation( false );
+
   // STEP 1: REQUIRED - Read start section
+  RH_TRACE_SCOPE( "start section" );
   if ( !archive.Read3dmStartSection( &m_3dm_file_version, m_sStartSectionComments ) )
   {
     if ( error_log) error_log->Print("ERROR: Unable to read start section. (ON_BinaryArchive::Read3dmStartSection() returned false.)\n");
@@ -2257,6 +2354,7 @@ bool EX_ONX_Model::Read(
     return_code = false;
 
   // STEP 2: REQUIRED - Read properties section
+  RH_TRACE_NEXT( "properties section" );
   if ( !archive.Read3dmProperties( m_properties ) )
   {
     if ( error_log) error_log->Print("ERROR: Unable to read properties section. (ON_BinaryArchive::Read3dmProperties() returned false.)\n");
@@ -2271,6 +2369,7 @@ bool EX_ONX_Model::Read(
   InspectProperties (m_properties);
     
   // STEP 3: REQUIRED - Read properties section
+  RH_TRACE_NEXT( "settings section" );
   if ( !archive.Read3dmSettings( m_settings ) )
   {
     if ( error_log) error_log->Print("ERROR: Unable to read settings section. (ON_BinaryArchive::Read3dmSettings() returned false.)\n");
@@ -2280,6 +2379,7 @@ bool EX_ONX_Model::Read(
     return_code = false;
 
   // STEP 4: REQUIRED - Read embedded bitmap table
+  RH_TRACE_NEXT( "bitmap table" );
   if ( archive.BeginRead3dmBitmapTable() )
   {
     // At the moment no bitmaps are embedded so this table is empty
@@ -2328,6 +2428,7 @@ bool EX_ONX_Model::Read(
 
 
   // STEP 5: REQUIRED - Read texture mapping table
+  RH_TRACE_NEXT( "texture mapping table" );
   if ( archive.BeginRead3dmTextureMappingTable() )
   {
     ON_TextureMapping* pTextureMapping = NULL;
@@ -2379,6 +2480,7 @@ bool EX_ONX_Model::Read(
 
 
   // STEP 6: REQUIRED - Read render material table
+  RH_TRACE_NEXT( "material table" );
   if ( archive.BeginRead3dmMaterialTable() )
   {
     ON_Material* pMaterial = NULL;
@@ -2430,6 +2532,7 @@ bool EX_ONX_Model::Read(
 
 
   // STEP 7: REQUIRED - Read line type table
+  RH_TRACE_NEXT( "linetype table" );
   if ( archive.BeginRead3dmLinetypeTable() )
   {
     ON_Linetype* pLinetype = NULL;
@@ -2480,6 +2583,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 8: REQUIRED - Read layer table
+  RH_TRACE_NEXT( "layer table" );
   if ( archive.BeginRead3dmLayerTable() )
   {
     ON_Layer* pLayer = NULL;
@@ -2531,6 +2635,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 9: REQUIRED - Read group table
+  RH_TRACE_NEXT( "group table" );
   if ( archive.BeginRead3dmGroupTable() )
   {
     ON_Group* pGroup = NULL;
@@ -2581,6 +2686,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 10: REQUIRED - Read font table
+  RH_TRACE_NEXT( "font table" );
   if ( archive.BeginRead3dmFontTable() )
   {
     ON_Font* pFont = NULL;
@@ -2631,6 +2737,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 11: REQUIRED - Read dimstyle table
+  RH_TRACE_NEXT( "dimstyle table" );
   if ( archive.BeginRead3dmDimStyleTable() )
   {
     ON_DimStyle* pDimStyle = NULL;
@@ -2681,6 +2788,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 12: REQUIRED - Read render lights table
+  RH_TRACE_NEXT( "light table" );
   if ( archive.BeginRead3dmLightTable() )
   {
     ON_Light* pLight = NULL;
@@ -2734,6 +2842,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 13 - read hatch pattern table
+  RH_TRACE_NEXT( "hatch pattern table" );
   if ( archive.BeginRead3dmHatchPatternTable() )
   {
     ON_HatchPattern* pHatchPattern = NULL;
@@ -2784,6 +2893,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 14: REQUIRED - Read instance definition table
+  RH_TRACE_NEXT( "instance definition table" );
   if ( archive.BeginRead3dmInstanceDefinitionTable() )
   {
     ON_InstanceDefinition* pIDef = NULL;
@@ -2834,6 +2944,7 @@ bool EX_ONX_Model::Read(
 
 
   // STEP 15: REQUIRED - Read object (geometry and annotation) table
+  RH_TRACE_NEXT( "object table" );
   if ( archive.BeginRead3dmObjectTable() )
   {
     // optional filter made by setting ON::object_type bits 
@@ -2841,14 +2952,36 @@ bool EX_ONX_Model::Read(
     // object_filter = ON::point_object | ON::mesh_object;
 //    int object_filter = 0; 
 
+    // Estimate the memory the objects need before reading any of them
+    CRhLoadEstimate estimate;
+    if ( estimate.ScanObjectTable( archive ) && ShouldReadObjectTable( estimate ) < 0 )
+      return false;       // stop reading RIGHT NOW!
+    if ( m_load_task )
+      m_load_task->SetTotalObjects( estimate.m_record_count );
+
+    // Records are decoded on worker threads and handed back in file order.
+    CRhObjectReadPipeline pipeline( archive, m_3dm_file_version, m_3dm_opennurbs_version, !m_bSkipCRCCheck, LoadJobPriority( m_load_task ) );
+    pipeline.SetSkipFilter( ON::pointset_object, SkipObjectHelper, this );
+
     for( count = 0; true; count++ ) 
     {
       ON_Object* pObject = NULL;
       ON_3dmObjectAttributes attributes;
-      rc = archive.Read3dmObject(&pObject,&attributes,0);
+      int record_crc_error_count = 0;
+      rc = pipeline.Read3dmObject(&pObject,&attributes,&record_crc_error_count);
       if ( rc == 0 )
         break; // end of object table
       
+      if ( m_load_task )
+      {
+        m_load_task->ObjectRead( archive.CurrentPosition() );
+        if ( !m_load_task->ShouldContinue() )
+        {
+          delete pObject;
+          return false;   // cancelled
+        }
+      }
+      
       if ( rc < 0 ) 
       {
         if ( error_log)
@@ -2870,6 +3003,16 @@ bool EX_ONX_Model::Read(
         }
         m_crc_error_count = archive.BadCRCCount();
       }
+      if ( record_crc_error_count > 0 )
+      {
+        // CRC errors found by a pipeline worker are not counted by archive.BadCRCCount()
+        if ( error_log)
+        {
+          error_log->Print("ERROR: Object table entry %d is corrupt. (CRC errors).\n",count);
+          error_log->Print("-- Attempting to continue.\n");
+        }
+        pipeline_crc_error_count += record_crc_error_count;
+      }
       if ( pObject ) 
       {
         int rx = ShouldKeepObject (pObject, attributes);
@@ -2922,6 +3065,7 @@ bool EX_ONX_Model::Read(
   //#if SKIP_UNNEEDED_INFO
   
   // STEP 16: Read history table
+  RH_TRACE_NEXT( "history record table" );
   if ( archive.BeginRead3dmHistoryRecordTable() )
   {
     for( count = 0; true; count++ ) 
@@ -2985,6 +3129,7 @@ bool EX_ONX_Model::Read(
   }
 
   // STEP 17: OPTIONAL - Read user tables as anonymous goo
+  RH_TRACE_NEXT( "user tables" );
   // If you develop a plug-ins or application that uses OpenNURBS files,
   // you can store anything you want in a user table.
   for(count=0;true;count++)
@@ -3012,6 +3157,7 @@ bool EX_ONX_Model::Read(
   //#endif // SKIP_UNNEEDED_INFO
 
   // STEP 18: OPTIONAL - check for end mark
+  RH_TRACE_NEXT( "end mark" );
   if ( !archive.Read3dmEndMark(&m_file_length) )
   {
     if ( archive.Archive3dmVersion() != 1 ) 
@@ -3022,6 +3168,11 @@ bool EX_ONX_Model::Read(
   }
   
   
+  // Every section has been checked against archive.BadCRCCount().
+  // Now include the errors found in records decoded by the pipeline.
+  m_crc_error_count += pipeline_crc_error_count;
+
+  RH_TRACE_NEXT( "Polish" );
   // Remap layer, material, linetype, font, dimstyle, hatch pattern, etc., 
   // indices so the correspond to the model's table array index.
   Polish();
@@ -3524,133 +3675,173 @@ bool EX_ONX_Model::IsValid( ON_TextLog* text_log ) const
 {
   // Audit with no repairs will simply complain if it
   // finds something wrong;
-  int i = const_cast<EX_ONX_Model*>(this)->Audit(false,NULL,text_log,NULL);
+  int i = const_cast<EX_ONX_Model*>(this)->AuditInParallel(false,NULL,text_log,NULL);
   return (i>=0);
 }
 
-int EX_ONX_Model::ObjectIndex( ON_UUID object_uuid ) const
+//
+// Table lookups.  Each CRhTableIndex holds hashes of one key of one table; the
+// helpers below add the rows appended since the last lookup and check the
+// candidates against the table.  Callers hold m_index_lock.
+//
+
+class CRhLayerKeys
+{
+public:
+  static const wchar_t* Name( const ON_Layer& layer ) { return layer.LayerName(); }
+};
+
+class CRhIDefKeys
 {
-  // In a high quality app, you may want to override this
-  // and do something a little smarter.
+public:
+  static const wchar_t* Name( const ON_InstanceDefinition& idef ) { return idef.Name(); }
+  static ON_UUID Id( const ON_InstanceDefinition& idef ) { return idef.m_uuid; }
+  static void SetId( ON_InstanceDefinition& idef, ON_UUID id ) { idef.m_uuid = id; }
+};
+
+class CRhObjectKeys
+{
+public:
+  static ON_UUID Id( const EX_ONX_Model_Object& mo ) { return mo.m_attributes.m_uuid; }
+  static void SetId( EX_ONX_Model_Object& mo, ON_UUID id ) { mo.m_attributes.m_uuid = id; }
+};
 
-  int object_index = -1;
-  if ( ON_UuidIsNotNil(object_uuid) )
+template <class T, class KEYS>
+class CRhNameMatch
+{
+public:
+  CRhNameMatch( const ON_ClassArray<T>& table, const wchar_t* name ) : m_table(table), m_name(name) {}
+  bool operator()( int i ) const
   {
-    int i, object_count = m_object_table.Count();
-    if ( object_count > 0 )
-    {
-      if ( object_count != m_object_id_index.Count() )
-      {
-        // rebuild m__object_uuid_index[]
-        ON_UuidIndexList* p = const_cast< ON_UuidIndexList* >(&m_object_id_index);
-        p->Empty();
-        p->Reserve(object_count);
-        for ( i = 0; i < object_count; i++ )
-        {
-          ON_UUID id = m_object_table[i].m_attributes.m_uuid;
-          if ( ON_UuidIsNil(id) )
-          {
-            ON_ERROR("Nil object ids in model");
-            ON_CreateUuid(id);
-            *(const_cast<ON_UUID*>(&m_object_table[i].m_attributes.m_uuid)) = id;
-          }
-          if ( !p->AddUuidIndex(id,i,true) )
-          {
-            ON_ERROR("Duplicate object ids in model");
-            ON_CreateUuid(id);
-            *(const_cast<ON_UUID*>(&m_object_table[i].m_attributes.m_uuid)) = id;
-            p->AddUuidIndex(id,i,false);
-          }
-        }
-      }
+    return i < m_table.Count() && 0 == on_wcsicmp( m_name, KEYS::Name( m_table[i] ) );
+  }
+private:
+  const ON_ClassArray<T>& m_table;
+  const wchar_t* m_name;
+};
 
-      if ( !m_object_id_index.FindUuid(object_uuid,&object_index) )
-        object_index = -1;
-    }
+template <class T, class KEYS>
+class CRhIdMatch
+{
+public:
+  CRhIdMatch( const ON_ClassArray<T>& table, ON_UUID id ) : m_table(table), m_id(id) {}
+  bool operator()( int i ) const
+  {
+    return i < m_table.Count() && 0 == ON_UuidCompare( m_id, KEYS::Id( m_table[i] ) );
   }
+private:
+  const ON_ClassArray<T>& m_table;
+  ON_UUID m_id;
+};
 
-  return object_index;
+template <class T, class KEYS>
+static void UpdateNameIndex( CRhTableIndex& index, const ON_ClassArray<T>& table )
+{
+  const int count = table.Count();
+  if ( count < index.IndexedCount() )
+    index.Empty();      // rows were removed
+  for ( int i = index.IndexedCount(); i < count; i++ )
+    index.Add( RhHashName( KEYS::Name( table[i] ) ), i );
+  index.SetIndexedCount( count );
 }
 
-int EX_ONX_Model::IDefIndex( ON_UUID idef_uuid ) const
+// When bRepair is true, nil and duplicate ids get new ids the way the
+// openNURBS lookups always did for objects and instance definitions.
+template <class T, class KEYS>
+static void UpdateIdIndex( CRhTableIndex& index, const ON_ClassArray<T>& table, bool bRepair )
 {
-  // In a high quality app, you may want to override this
-  // and do something a little smarter.
-
-  int idef_index = -1;
-  if ( ON_UuidIsNotNil(idef_uuid) )
+  const int count = table.Count();
+  if ( count < index.IndexedCount() )
+    index.Empty();      // rows were removed
+  for ( int i = index.IndexedCount(); i < count; i++ )
   {
-    int i, idef_count = m_idef_table.Count();
-    if ( idef_count > 0 )
+    ON_UUID id = KEYS::Id( table[i] );
+    if ( ON_UuidIsNil(id) )
     {
-      if ( idef_count != m_idef_id_index.Count() )      
-      {
-        // rebuild m__idef_uuid_index[]
-        ON_UuidIndexList* p = const_cast<ON_UuidIndexList*>(&m_idef_id_index);
-        p->Empty();
-        p->Reserve(idef_count);
-        for ( i = 0; i < idef_count; i++ )
-        {
-          ON_UUID id = m_idef_table[i].m_uuid;
-          if ( ON_UuidIsNil(id) )
-          {
-            ON_ERROR("Nil idef ids in model");
-            ON_CreateUuid(id);
-            (const_cast<ON_InstanceDefinition*>(&m_idef_table[i]))->m_uuid = id;
-          }
-          if ( !p->AddUuidIndex(id,i,true) )
-          {
-            ON_ERROR("Duplicate idef ids in model");
-            ON_CreateUuid(id);
-            (const_cast<ON_InstanceDefinition*>(&m_idef_table[i]))->m_uuid = id;
-            p->AddUuidIndex(id,i,false);
-          }
-        }
-      }
-
-      if ( !m_idef_id_index.FindUuid(idef_uuid,&idef_index) )
-        idef_index = -1;
+      if ( !bRepair )
+        continue;
+      ON_ERROR("Nil ids in model table");
+      ON_CreateUuid(id);
+      KEYS::SetId( const_cast<T&>(table[i]), id );
+    }
+    else if ( bRepair && index.Find( RhHashUuid(id), CRhIdMatch<T,KEYS>( table, id ) ) >= 0 )
+    {
+      ON_ERROR("Duplicate ids in model table");
+      ON_CreateUuid(id);
+      KEYS::SetId( const_cast<T&>(table[i]), id );
     }
+    index.Add( RhHashUuid(id), i );
   }
+  index.SetIndexedCount( count );
+}
+
+template <class T, class KEYS>
+static int FindId( CRhTableIndex& index, const ON_ClassArray<T>& table, ON_UUID id, bool bRepair )
+{
+  if ( ON_UuidIsNil(id) || table.Count() <= 0 )
+    return -1;
+  UpdateIdIndex<T,KEYS>( index, table, bRepair );
+  return index.Find( RhHashUuid(id), CRhIdMatch<T,KEYS>( table, id ) );
+}
+
+template <class T, class KEYS>
+static int FindName( CRhTableIndex& index, const ON_ClassArray<T>& table, const wchar_t* name )
+{
+  if ( 0 == name || 0 == name[0] )
+    return -1;
+  UpdateNameIndex<T,KEYS>( index, table );
+  return index.Find( RhHashName(name), CRhNameMatch<T,KEYS>( table, name ) );
+}
 
-  return idef_index;
+
+int EX_ONX_Model::ObjectIndex( ON_UUID object_uuid ) const
+{
+  pthread_mutex_lock( &m_index_lock );
+  const int i = FindId<EX_ONX_Model_Object,CRhObjectKeys>( m_object_uuid_index, m_object_table, object_uuid, true );
+  pthread_mutex_unlock( &m_index_lock );
+  return i;
+}
+
+int EX_ONX_Model::IDefIndex( ON_UUID idef_uuid ) const
+{
+  pthread_mutex_lock( &m_index_lock );
+  const int i = FindId<ON_InstanceDefinition,CRhIDefKeys>( m_idef_uuid_index, m_idef_table, idef_uuid, true );
+  pthread_mutex_unlock( &m_index_lock );
+  return i;
 }
 
 int EX_ONX_Model::IDefIndex( const wchar_t* idef_name ) const
 {
-  // slow and stupid search - what do you expect for free?
-  // In a high quality app, you will want to override this
-  // and do something a little smarter.
-  //
-  int idef_index = -1;
-  if ( 0 != idef_name && 0 != idef_name[0]  )
-  {
-    int i, idef_count = m_idef_table.Count();
-    for ( i = 0; i < idef_count; i++ )
-    {
-      if ( 0 == on_wcsicmp(idef_name, m_idef_table[i].Name() ) )
-      {
-        idef_index = i;
-        break;
-      }
-    }
-  }
-  return idef_index;
+  pthread_mutex_lock( &m_index_lock );
+  const int i = FindName<ON_InstanceDefinition,CRhIDefKeys>( m_idef_name_index, m_idef_table, idef_name );
+  pthread_mutex_unlock( &m_index_lock );
+  return i;
 }
 
 void EX_ONX_Model::GetUnusedIDefName( ON_wString& idef_name ) const
 {
-  int i = 1;
-  for(i = 1; i < 100000; i++ )
+  int i;
+  for(i = m_unused_idef_number; i < 100000; i++ )
   {
     idef_name.Format("IDef_%02d",i);
     if ( IDefIndex(idef_name) < 0 )
+    {
+      m_unused_idef_number = i+1;
       return;
+    }
   }
   idef_name = "IDef";
   return;
 }
 
+void EX_ONX_Model::IDefRenamed( int idef_index )
+{
+  pthread_mutex_lock( &m_index_lock );
+  if ( idef_index >= 0 && idef_index < m_idef_name_index.IndexedCount() )
+    m_idef_name_index.Add( RhHashName( m_idef_table[idef_index].Name() ), idef_index );
+  pthread_mutex_unlock( &m_index_lock );
+}
+
 int EX_ONX_Model::UsesIDef(
         const ON_InstanceRef& iref,
         ON_UUID idef_uuid
@@ -3740,40 +3931,37 @@ int EX_ONX_Model::UsesIDef(
 
 int EX_ONX_Model::LayerIndex( const wchar_t* layer_name ) const
 {
-  // slow and stupid search - what do you expect for free?
-  // In a high quality app, you will want to override this
-  // and do something a little smarter.
-
-  int layer_index = -1;
-  if ( 0 != layer_name && 0 != layer_name[0] )
-  {
-    int i, layer_count = m_layer_table.Count();
-    for ( i = 0; i < layer_count; i++ )
-    {
-      if ( 0 == on_wcsicmp(layer_name, m_layer_table[i].LayerName() ) )
-      {
-        layer_index = i;
-        break;
-      }
-    }
-  }
-  return layer_index;
+  pthread_mutex_lock( &m_index_lock );
+  const int i = FindName<ON_Layer,CRhLayerKeys>( m_layer_name_index, m_layer_table, layer_name );
+  pthread_mutex_unlock( &m_index_lock );
+  return i;
 }
 
 
 void EX_ONX_Model::GetUnusedLayerName( ON_wString& layer_name ) const
 {
-  int i = 1;
-  for(i = 1; i < 100000; i++ )
+  int i;
+  for(i = m_unused_layer_number; i < 100000; i++ )
   {
     layer_name.Format("Layer_%02d",i);
     if ( LayerIndex(layer_name) < 0 )
+    {
+      m_unused_layer_number = i+1;
       return;
+    }
   }
   layer_name = "Layer";
   return;
 }
 
+void EX_ONX_Model::LayerRenamed( int layer_index )
+{
+  pthread_mutex_lock( &m_index_lock );
+  if ( layer_index >= 0 && layer_index < m_layer_name_index.IndexedCount() )
+    m_layer_name_index.Add( RhHashName( m_layer_table[layer_index].LayerName() ), layer_index );
+  pthread_mutex_unlock( &m_index_lock );
+}
+
 static int AuditTextureMappingTableHelper( 
       EX_ONX_Model& model,
       bool bAttemptRepair,
@@ -4298,6 +4486,7 @@ static int AuditLayerTableHelper(
         ON_wString name;
         model.GetUnusedLayerName( name );
         layer.SetLayerName( name );
+        model.LayerRenamed( i );
         if ( text_log )
         {
           text_log->PushIndent();
@@ -4325,6 +4514,7 @@ static int AuditLayerTableHelper(
         ON_wString name;
         model.GetUnusedLayerName( name );
         layer.SetLayerName( name );
+        model.LayerRenamed( i );
         if ( text_log )
         {
           text_log->PushIndent();
@@ -4353,6 +4543,7 @@ static int AuditLayerTableHelper(
         ON_wString name;
         model.GetUnusedLayerName( name );
         layer.SetLayerName( name );
+        model.LayerRenamed( i );
         if ( text_log )
         {
           text_log->PushIndent();
@@ -4374,6 +4565,27 @@ static int AuditLayerTableHelper(
   return rc;
 }
 
+// Matches rows of an ON_UuidIndex list whose m_i is the row
+class CRhUuidIndexMatch
+{
+public:
+  CRhUuidIndexMatch( const ON_SimpleArray<ON_UuidIndex>& id_list, ON_UUID id ) : m_id_list(id_list), m_id(id) {}
+  bool operator()( int i ) const { return 0 == ON_UuidCompare( m_id, m_id_list[i].m_id ); }
+private:
+  const ON_SimpleArray<ON_UuidIndex>& m_id_list;
+  ON_UUID m_id;
+};
+
+/*
+Description:
+  Makes sure the ids in id_list are not nil and unique.
+Parameters:
+  id_list - [in/out] one entry per table row, in row order.  On
+            return m_i is the row and m_id the repaired id.
+  repair_count - [in/out] number of repairs is added to this.
+Returns:
+  Number of nil and duplicate ids found.
+*/
 static int AuditIdsHelper(
       ON_SimpleArray<ON_UuidIndex>& id_list,
       ON_UuidIndexList* index_list,
@@ -4424,10 +4636,12 @@ static int AuditIdsHelper(
 
     if ( count > 1 )
     {
-      // Make sure objects have unique ids
-      id_list.HeapSort( ON_UuidIndex::CompareIdAndIndex );
-      ON_UuidIndex id0 = id_list[0];
-      for ( i = 1; i < count; i++ )
+      // Make sure objects have unique ids.  A hash of the ids finds the
+      // duplicates; they are then reported in id order, the order the
+      // report has always been in.
+      CRhTableIndex id_index;
+      ON_SimpleArray<ON_UuidIndex> dup_list;
+      for ( i = 0; i < count; i++ )
       {
         if ( ON_nil_uuid == id_list[i].m_id )
         {
@@ -4437,32 +4651,37 @@ static int AuditIdsHelper(
           // is returning nil ids.
           continue;
         }
+        const ON__UINT32 hash = RhHashUuid( id_list[i].m_id );
+        if ( id_index.Find( hash, CRhUuidIndexMatch( id_list, id_list[i].m_id ) ) >= 0 )
+          dup_list.Append( id_list[i] );
+        else
+          id_index.Add( hash, i );
+      }
 
-        if ( id_list[i].m_id == id0.m_id )
-        {
-          dup_count++;
-          if ( text_log )
-            text_log->Print(dup_id_msg,id0.m_i,id_list[i].m_i);
+      dup_list.HeapSort( ON_UuidIndex::CompareIdAndIndex );
+      for ( i = 0; i < dup_list.Count(); i++ )
+      {
+        // first row with this id
+        const int i0 = id_index.Find( RhHashUuid( dup_list[i].m_id ), CRhUuidIndexMatch( id_list, dup_list[i].m_id ) );
+        const int i1 = dup_list[i].m_i;
+        dup_count++;
+        if ( text_log )
+          text_log->Print(dup_id_msg,i0,i1);
 
-          if ( bAttemptRepair )
+        if ( bAttemptRepair )
+        {
+          // fix duplicate object id
+          uuid = ON_nil_uuid;
+          if ( ON_CreateUuid(uuid) && !ON_UuidIsNil(uuid) )
           {
-            // fix duplicate object id
-            uuid = ON_nil_uuid;
-            if ( ON_CreateUuid(uuid) && !ON_UuidIsNil(uuid) )
-            {
-              rep_count++;
-              id_list[i].m_id = uuid;
-              if ( text_log )
-                text_log->Print(L" Repaired.");
-            }
+            rep_count++;
+            id_list[i1].m_id = uuid;
+            if ( text_log )
+              text_log->Print(L" Repaired.");
           }
-          if ( text_log )
-            text_log->Print(L"\n");
-        }
-        else
-        {
-          id0 = id_list[i];
         }
+        if ( text_log )
+          text_log->Print(L"\n");
       }
     }
 
@@ -4478,7 +4697,7 @@ static int AuditIdsHelper(
   }
 
   if ( repair_count )
-    *repair_count = rep_count;
+    *repair_count += rep_count;
 
   return dup_count + nil_count;
 }
@@ -4593,6 +4812,10 @@ static int AuditLightIdsHelper(
       }
     }
 
+    // AuditIdsHelper() leaves id_list in table order; sort it for the
+    // BinarySearch() below
+    id_list.HeapSort( ON_UuidIndex::CompareId );
+
     // make sure light ids are not duplicated in object id list
     for ( i = 0; i < count; i++ )
     {
@@ -4866,6 +5089,7 @@ static int AuditIDefTableHelper(
       if ( EX_ONX_IsValidName(new_name) && -1 == model.IDefIndex(new_name) )
       {
         idef.SetName(new_name);
+        model.IDefRenamed( i );
         if ( repair_count )
           *repair_count = *repair_count + 1;
         if ( text_log )
@@ -4997,8 +5221,11 @@ static int AuditIDefTableHelper(
 }
 
 
-static int AuditObjectTableHelper( 
+// Audits m_object_table[first_index] to m_object_table[last_index-1]
+static int AuditObjectRangeHelper( 
       EX_ONX_Model& model,
+      int first_index,
+      int last_index,
       bool bAttemptRepair,
       int* repair_count,
       ON_TextLog* text_log 
@@ -5007,9 +5234,9 @@ static int AuditObjectTableHelper(
   // AuditObjectIds() are already validated/repaired object ids.
 
   int rc = 0;
-  int i, count = model.m_object_table.Count();
+  int i;
 
-  for ( i = 0; i < count; i++ )
+  for ( i = first_index; i < last_index; i++ )
   {
     EX_ONX_Model_Object& obj = model.m_object_table[i];
     if ( 0 == obj.m_object )
@@ -5047,6 +5274,16 @@ static int AuditObjectTableHelper(
   return rc;
 }
 
+static int AuditObjectTableHelper( 
+      EX_ONX_Model& model,
+      bool bAttemptRepair,
+      int* repair_count,
+      ON_TextLog* text_log 
+      )
+{
+  return AuditObjectRangeHelper( model, 0, model.m_object_table.Count(), bAttemptRepair, repair_count, text_log );
+}
+
 static int AuditHistoryRecordTableHelper( 
       EX_ONX_Model& model,
       bool bAttemptRepair,
@@ -5058,6 +5295,126 @@ static int AuditHistoryRecordTableHelper(
   return 0;
 }
 
+//////////////////////////////////////////////////////////////
+//
+// Parallel audit
+//
+// EX_ONX_Model::AuditInParallel() runs the same helpers as Audit().  Each
+// helper, or range of the object table, is one CRhJobSystem job.  A job logs
+// to its own string and counts its own repairs, and the results are gathered
+// in the order Audit() runs the helpers, so the report does not depend on
+// which thread ran what.
+//
+
+typedef int (*AuditTableHelper)( EX_ONX_Model&, bool, int*, ON_TextLog* );
+
+// Objects per object table job.  Small enough to balance the workers,
+// big enough that the per job log string and bookkeeping do not matter.
+static const int AuditObjectsPerJob = 2048;
+
+struct CRhAuditJob
+{
+  AuditTableHelper m_helper;    // NULL for a range of the object table
+  int m_first_object;
+  int m_last_object;
+  int m_rc;
+  int m_repair_count;
+  ON_wString m_log;
+};
+
+class CRhAuditJobs
+{
+public:
+  CRhAuditJobs( EX_ONX_Model& model, bool bAttemptRepair, bool bLog );
+  ~CRhAuditJobs();
+
+  void AddJob( AuditTableHelper helper );
+  void AddObjectTableJobs();
+
+  // Runs every job and waits for them
+  void Run( CRhJobSystem::priority job_priority );
+
+  int Count() const { return m_jobs.Count(); }
+  const CRhAuditJob& operator[]( int i ) const { return m_jobs[i]; }
+
+private:
+  static void RunJobs( void* jobs, int first, int last );
+  void RunJob( CRhAuditJob& job );
+
+  EX_ONX_Model& m_model;
+  const bool m_bAttemptRepair;
+  const bool m_bLog;
+  ON_ClassArray<CRhAuditJob> m_jobs;
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhAuditJobs(const CRhAuditJobs&);
+  CRhAuditJobs& operator=(const CRhAuditJobs&);
+};
+
+CRhAuditJobs::CRhAuditJobs( EX_ONX_Model& model, bool bAttemptRepair, bool bLog )
+: m_model(model)
+, m_bAttemptRepair(bAttemptRepair)
+, m_bLog(bLog)
+{
+}
+
+CRhAuditJobs::~CRhAuditJobs()
+{
+}
+
+void CRhAuditJobs::AddJob( AuditTableHelper helper )
+{
+  CRhAuditJob& job = m_jobs.AppendNew();
+  job.m_helper = helper;
+  job.m_first_object = 0;
+  job.m_last_object = 0;
+  job.m_rc = 0;
+  job.m_repair_count = 0;
+}
+
+void CRhAuditJobs::AddObjectTableJobs()
+{
+  const int count = m_model.m_object_table.Count();
+  for ( int first = 0; first < count; first += AuditObjectsPerJob ) {
+    CRhAuditJob& job = m_jobs.AppendNew();
+    job.m_helper = NULL;
+    job.m_first_object = first;
+    job.m_last_object = ( count - first > AuditObjectsPerJob ) ? first + AuditObjectsPerJob : count;
+    job.m_rc = 0;
+    job.m_repair_count = 0;
+  }
+}
+
+void CRhAuditJobs::RunJob( CRhAuditJob& job )
+{
+  ON_TextLog log( job.m_log );
+  ON_TextLog* text_log = m_bLog ? &log : NULL;
+  if ( job.m_helper ) {
+    job.m_rc = job.m_helper( m_model, m_bAttemptRepair, &job.m_repair_count, text_log );
+  }
+  else {
+    RH_TRACE_SCOPE_ARG( "audit objects", job.m_first_object );
+    job.m_rc = AuditObjectRangeHelper( m_model, job.m_first_object, job.m_last_object,
+                                       m_bAttemptRepair, &job.m_repair_count, text_log );
+  }
+}
+
+void CRhAuditJobs::RunJobs( void* jobs, int first, int last )
+{
+  for ( int i = first; i < last; i++ )
+    ((CRhAuditJobs*)jobs)->RunJob( ((CRhAuditJobs*)jobs)->m_jobs[i] );
+}
+
+void CRhAuditJobs::Run( CRhJobSystem::priority job_priority )
+{
+  RH_TRACE_SCOPE_ARG( "CRhAuditJobs::Run", m_jobs.Count() );
+  CRhJobGroup group( job_priority );
+  group.ParallelFor( m_jobs.Count(), 1, RunJobs, this );
+  group.Wait();
+}
+
+
 int EX_ONX_Model::Audit( 
       bool bAttemptRepair,
       int* repair_count,
@@ -5079,6 +5436,12 @@ int EX_ONX_Model::Audit(
     return i;
   warning_count += i;
 
+  // ids may have been repaired
+  pthread_mutex_lock( &m_index_lock );
+  m_object_uuid_index.Empty();
+  m_idef_uuid_index.Empty();
+  pthread_mutex_unlock( &m_index_lock );
+
   repcnt = 0;
   i = AuditTextureMappingTableHelper( *this, bAttemptRepair, &repcnt, text_log );
   if ( repair_count ) 
@@ -5190,3 +5553,89 @@ int EX_ONX_Model::Audit(
   return warning_count;
 }
 
+int EX_ONX_Model::AuditInParallel( 
+      bool bAttemptRepair,
+      int* repair_count,
+      ON_TextLog* text_log,
+      ON_SimpleArray<int>* warnings,
+      CRhJobSystem::priority job_priority
+      )
+{
+  RH_TRACE_SCOPE_ARG( "EX_ONX_Model::AuditInParallel", m_object_table.Count() );
+  int warning_count = 0;
+  int i;
+  if ( repair_count ) 
+    *repair_count = 0;
+
+  // Ids.  Lights are checked against the object ids, so they go after the
+  // other tables.  The id helpers never fail, they count problems.
+  CRhAuditJobs id_jobs( *this, bAttemptRepair, 0 != text_log );
+  id_jobs.AddJob( AuditObjectIdsHelper );
+  id_jobs.AddJob( AuditIDefIdsHelper );
+  id_jobs.AddJob( AuditMappingIdsHelper );
+  id_jobs.AddJob( AuditMaterialIdsHelper );
+  id_jobs.Run( job_priority );
+
+  CRhAuditJobs light_id_jobs( *this, bAttemptRepair, 0 != text_log );
+  light_id_jobs.AddJob( AuditLightIdsHelper );
+  light_id_jobs.Run( job_priority );
+
+  // same order and warnings as AuditModelIdsHelper()
+  const CRhAuditJob* id_results[5] = { &id_jobs[0], &light_id_jobs[0], &id_jobs[1], &id_jobs[2], &id_jobs[3] };
+  const int id_warnings[5] = { 3, 15, 12, 13, 13 };
+  for ( i = 0; i < 5; i++ )
+  {
+    const CRhAuditJob& job = *id_results[i];
+    if ( text_log )
+      text_log->Print( job.m_log );
+    if ( repair_count ) 
+      *repair_count += job.m_repair_count;
+    if ( job.m_rc > 0 )
+    {
+      warning_count += job.m_rc;
+      if ( warnings )
+        warnings->Append( id_warnings[i] );
+    }
+  }
+
+  // ids may have been repaired
+  pthread_mutex_lock( &m_index_lock );
+  m_object_uuid_index.Empty();
+  m_idef_uuid_index.Empty();
+  pthread_mutex_unlock( &m_index_lock );
+
+  // Tables.  The helpers write only to their own table; the object and light
+  // attribute checks read the sizes of the layer, linetype and material
+  // tables, which the helpers do not change.  Helpers only fail when
+  // bAttemptRepair is false, in which case none of them change the model,
+  // so running the ones after a failure is harmless; their results are
+  // dropped like Audit() never got to them.
+  CRhAuditJobs table_jobs( *this, bAttemptRepair, 0 != text_log );
+  table_jobs.AddJob( AuditTextureMappingTableHelper );
+  table_jobs.AddJob( AuditMaterialTableHelper );
+  table_jobs.AddJob( AuditLinetypeTableHelper );
+  table_jobs.AddJob( AuditLayerTableHelper );
+  table_jobs.AddJob( AuditGroupTableHelper );
+  table_jobs.AddJob( AuditFontTableHelper );
+  table_jobs.AddJob( AuditDimStyleTableHelper );
+  table_jobs.AddJob( AuditLightTableHelper );
+  table_jobs.AddJob( AuditHatchPatternTableHelper );
+  table_jobs.AddJob( AuditIDefTableHelper );
+  table_jobs.AddObjectTableJobs();
+  table_jobs.AddJob( AuditHistoryRecordTableHelper );
+  table_jobs.Run( job_priority );
+
+  for ( i = 0; i < table_jobs.Count(); i++ )
+  {
+    const CRhAuditJob& job = table_jobs[i];
+    if ( text_log )
+      text_log->Print( job.m_log );
+    if ( repair_count ) 
+      *repair_count += job.m_repair_count;
+    if ( job.m_rc < 0 )
+      return job.m_rc;
+  }
+
+  return warning_count;
+}
+
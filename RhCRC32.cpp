@@ -0,0 +1,170 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "RhCRC32.h"
+#include "RhTrace.h"
+
+
+#if !defined(__ARM_FEATURE_CRC32)
+
+// s_crc_table[0] is the classic byte-at-a-time table for the reflected
+// polynomial 0xEDB88320.  s_crc_table[k][n] is the CRC of byte n followed
+// by k zero bytes, which lets us fold 8 input bytes per step.
+static ON__UINT32 s_crc_table[8][256];
+static pthread_once_t s_crc_table_once = PTHREAD_ONCE_INIT;
+
+static void MakeCRCTable(void)
+{
+  for ( ON__UINT32 n = 0; n < 256; n++ ) {
+    ON__UINT32 c = n;
+    for ( int k = 0; k < 8; k++ )
+      c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+    s_crc_table[0][n] = c;
+  }
+  for ( ON__UINT32 n = 0; n < 256; n++ ) {
+    ON__UINT32 c = s_crc_table[0][n];
+    for ( int k = 1; k < 8; k++ ) {
+      c = s_crc_table[0][c & 0xFF] ^ (c >> 8);
+      s_crc_table[k][n] = c;
+    }
+  }
+}
+
+#endif
+
+
+ON__UINT32 RhCRC32( ON__UINT32 current_remainder, size_t count, const void* buffer )
+{
+  const unsigned char* p = (const unsigned char*)buffer;
+  if ( p == NULL || count == 0 )
+    return current_remainder;
+
+  ON__UINT32 crc = current_remainder ^ 0xFFFFFFFF;
+
+#if defined(__ARM_FEATURE_CRC32)
+
+  // ARMv8 crc32 instructions use the same polynomial as zlib
+  while ( count > 0 && ((size_t)p & 7) != 0 ) {
+    crc = __crc32b( crc, *p++ );
+    count--;
+  }
+  while ( count >= 8 ) {
+    crc = __crc32d( crc, *(const ON__UINT64*)p );
+    p += 8;
+    count -= 8;
+  }
+  while ( count-- > 0 )
+    crc = __crc32b( crc, *p++ );
+
+#else
+
+  pthread_once( &s_crc_table_once, MakeCRCTable );
+
+  // align to a 4 byte boundary
+  while ( count > 0 && ((size_t)p & 3) != 0 ) {
+    crc = s_crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    count--;
+  }
+
+  // 8 bytes per step; the byte order of the 32 bit reads below assumes
+  // a little endian CPU, as on every device and simulator we target.
+  while ( count >= 8 ) {
+    ON__UINT32 one = *(const ON__UINT32*)p ^ crc;
+    ON__UINT32 two = *(const ON__UINT32*)(p+4);
+    crc = s_crc_table[7][ one        & 0xFF] ^
+          s_crc_table[6][(one >>  8) & 0xFF] ^
+          s_crc_table[5][(one >> 16) & 0xFF] ^
+          s_crc_table[4][ one >> 24        ] ^
+          s_crc_table[3][ two        & 0xFF] ^
+          s_crc_table[2][(two >>  8) & 0xFF] ^
+          s_crc_table[1][(two >> 16) & 0xFF] ^
+          s_crc_table[0][ two >> 24        ];
+    p += 8;
+    count -= 8;
+  }
+
+  while ( count-- > 0 )
+    crc = s_crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+#endif
+
+  return crc ^ 0xFFFFFFFF;
+}
+
+
+bool RhFileCRC32( const char* filename, ON__UINT32* crc, ON__UINT64* file_length )
+{
+  RH_TRACE_SCOPE( "RhFileCRC32" );
+  *crc = 0;
+  *file_length = 0;
+
+  FILE* fp = ON::OpenFile( filename, "rb" );
+  if ( fp == NULL )
+    return false;
+
+  const size_t sizeof_buffer = 1024*1024;
+  void* buffer = onmalloc( sizeof_buffer );
+  bool rc = (buffer != NULL);
+  while ( rc ) {
+    size_t count = fread( buffer, 1, sizeof_buffer, fp );
+    *crc = RhCRC32( *crc, count, buffer );
+    *file_length += count;
+    if ( count < sizeof_buffer ) {
+      rc = (0 == ferror(fp));
+      break;
+    }
+  }
+
+  onfree( buffer );
+  ON::CloseFile( fp );
+  return rc;
+}
+
+bool RhFileQuickKey( const char* filename, size_t sizeof_header, ON__UINT32* header_crc,
+                     ON__UINT64* file_length, ON__INT64* modified_time )
+{
+  *header_crc = 0;
+  *file_length = 0;
+  *modified_time = 0;
+
+  FILE* fp = ON::OpenFile( filename, "rb" );
+  if ( fp == NULL )
+    return false;
+
+  bool rc = false;
+  struct stat st;
+  if ( 0 == fstat( fileno(fp), &st ) ) {
+    *file_length = (ON__UINT64)st.st_size;
+    *modified_time = (ON__INT64)st.st_mtime;
+    void* buffer = onmalloc( sizeof_header > 0 ? sizeof_header : 1 );
+    if ( buffer ) {
+      const size_t count = fread( buffer, 1, sizeof_header, fp );
+      *header_crc = RhCRC32( 0, count, buffer );
+      rc = (0 == ferror(fp));
+      onfree( buffer );
+    }
+  }
+
+  ON::CloseFile( fp );
+  return rc;
+}
@@ -0,0 +1,80 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_CRC32_INC_)
+#define RH_CRC32_INC_
+
+/*
+Description:
+  Continues 32 bit CRC calulation to include the buffer.
+
+  RhCRC32() computes the same values as ON_CRC32() and zlib's crc32()
+  but processes 8 bytes per step (slicing-by-8), or uses the ARMv8 CRC32
+  instructions when the compiler targets them.
+Parameters:
+  current_remainder - [in]
+  sizeof_buffer - [in]  number of bytes in buffer
+  buffer - [in]
+Returns:
+  The updated CRC.
+*/
+ON__UINT32 RhCRC32(
+         ON__UINT32 current_remainder,
+         size_t sizeof_buffer,
+         const void* buffer
+         );
+
+/*
+Description:
+  Computes the 32 bit CRC of an entire file.
+Parameters:
+  filename - [in] UTF-8 path of the file
+  crc - [out] RhCRC32() of the file contents with a seed of 0
+  file_length - [out] number of bytes in the file
+Returns:
+  True if the file was read to the end.
+*/
+bool RhFileCRC32(
+         const char* filename,
+         ON__UINT32* crc,
+         ON__UINT64* file_length
+         );
+
+/*
+Description:
+  A cheap key that tells whether a file changed without reading all of
+  it: its length, its modification time and the CRC of its first bytes.
+  A different key means the file changed.  Equal keys only suggest it
+  did not, since damage past the first bytes keeps the length and time;
+  use RhFileCRC32() before trusting the contents.
+Parameters:
+  filename - [in] UTF-8 path of the file
+  sizeof_header - [in] number of bytes at the start of the file to hash
+  header_crc - [out] RhCRC32() of the first sizeof_header bytes, or of
+                     the whole file if it is shorter, with a seed of 0
+  file_length - [out] number of bytes in the file
+  modified_time - [out] modification time in seconds since 1970
+Returns:
+  True if the file exists and its first bytes were read.
+*/
+bool RhFileQuickKey(
+         const char* filename,
+         size_t sizeof_header,
+         ON__UINT32* header_crc,
+         ON__UINT64* file_length,
+         ON__INT64* modified_time
+         );
+
+#endif
@@ -0,0 +1,203 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhCurveTessellator.h"
+#include "RhTrace.h"
+
+// Every span of degree > 1 is split at least this many times so an
+// S shaped span whose midpoint happens to lie on the chord is not
+// mistaken for a straight one.
+static const int MinSubdivisionDepth = 2;
+
+// at most 2^MaxSubdivisionDepth segments per span
+static const int MaxSubdivisionDepth = 10;
+
+// Curves per tessellation job
+static const int CurvesPerClaim = 16;
+
+// Below this many curves it is not worth queueing jobs
+static const int MinThreadedCurveCount = 4*CurvesPerClaim;
+
+
+//////////////////////////////////////////////////////////////
+//
+static void AppendSegment( ON_SimpleArray<ON_3fPoint>& lines, const ON_3dPoint& P0, const ON_3dPoint& P1 )
+{
+  lines.Append( ON_3fPoint(P0) );
+  lines.Append( ON_3fPoint(P1) );
+}
+
+static void SubdivideSpan(
+                const ON_Curve& curve,
+                double t0, const ON_3dPoint& P0,
+                double t1, const ON_3dPoint& P1,
+                double chord_tolerance,
+                int depth,
+                ON_SimpleArray<ON_3fPoint>& lines
+                )
+{
+  const double tm = 0.5*(t0 + t1);
+  const ON_3dPoint M = curve.PointAt( tm );
+
+  if ( depth >= MaxSubdivisionDepth
+       || (depth >= MinSubdivisionDepth && ON_Line(P0,P1).MinimumDistanceTo(M) <= chord_tolerance) )
+  {
+    AppendSegment( lines, P0, P1 );
+    return;
+  }
+
+  SubdivideSpan( curve, t0, P0, tm, M, chord_tolerance, depth+1, lines );
+  SubdivideSpan( curve, tm, M, t1, P1, chord_tolerance, depth+1, lines );
+}
+
+static void TessellateAnyCurve( const ON_Curve& curve, double chord_tolerance, ON_SimpleArray<ON_3fPoint>& lines )
+{
+  // polycurves can mix lines and arcs, so each segment is handled on its own
+  const ON_PolyCurve* polycurve = ON_PolyCurve::Cast( &curve );
+  if ( polycurve ) {
+    const int segment_count = polycurve->Count();
+    for ( int i = 0; i < segment_count; i++ ) {
+      const ON_Curve* segment = polycurve->SegmentCurve( i );
+      if ( segment )
+        TessellateAnyCurve( *segment, chord_tolerance, lines );
+    }
+    return;
+  }
+
+  const int span_count = curve.SpanCount();
+  if ( span_count <= 0 )
+    return;
+  ON_SimpleArray<double> span_vector( span_count+1 );
+  span_vector.SetCount( span_count+1 );
+  if ( !curve.GetSpanVector( span_vector.Array() ) )
+    return;
+
+  const bool bLinear = (curve.Degree() == 1);
+  ON_3dPoint P0 = curve.PointAt( span_vector[0] );
+  for ( int i = 0; i < span_count; i++ ) {
+    const double t0 = span_vector[i];
+    const double t1 = span_vector[i+1];
+    if ( !(t0 < t1) )
+      continue;
+    const ON_3dPoint P1 = curve.PointAt( t1 );
+    if ( bLinear )
+      AppendSegment( lines, P0, P1 );
+    else
+      SubdivideSpan( curve, t0, P0, t1, P1, chord_tolerance, 0, lines );
+    P0 = P1;
+  }
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhCurveTessellator::CRhCurveTessellator( double chord_tolerance )
+  : m_chord_tolerance(chord_tolerance > 0.0 ? chord_tolerance : ON_ZERO_TOLERANCE)
+{
+}
+
+CRhCurveTessellator::~CRhCurveTessellator()
+{
+  for ( int i = 0; i < m_curves.Count(); i++ )
+    delete m_curves[i].m_lines;
+}
+
+void CRhCurveTessellator::AddCurve( const ON_Curve* curve, ON_Color color )
+{
+  if ( curve == NULL )
+    return;
+  CurveItem& item = m_curves.AppendNew();
+  item.m_curve = curve;
+  item.m_color = color;
+  item.m_lines = NULL;
+}
+
+int CRhCurveTessellator::BatchCount() const
+{
+  return m_batch_lines.Count();
+}
+
+ON_Color CRhCurveTessellator::BatchColor( int batch_index ) const
+{
+  return m_batch_color[batch_index];
+}
+
+const ON_SimpleArray<ON_3fPoint>& CRhCurveTessellator::BatchLines( int batch_index ) const
+{
+  return m_batch_lines[batch_index];
+}
+
+//////////////////////////////////////////////////////////////
+//
+void CRhCurveTessellator::TessellateCurve( int curve_index )
+{
+  CurveItem& item = m_curves[curve_index];
+  ON_SimpleArray<ON_3fPoint>* lines = new ON_SimpleArray<ON_3fPoint>;
+  TessellateAnyCurve( *item.m_curve, m_chord_tolerance, *lines );
+  item.m_lines = lines;
+}
+
+void CRhCurveTessellator::TessellateJob( void* arg, int first, int last )
+{
+  CRhCurveTessellator* tessellator = (CRhCurveTessellator*)arg;
+  RH_TRACE_SCOPE_ARG( "tessellate curves", first );
+  for ( int i = first; i < last; i++ )
+    tessellator->TessellateCurve( i );
+}
+
+//////////////////////////////////////////////////////////////
+//
+int CRhCurveTessellator::Tessellate( CRhJobSystem::priority job_priority )
+{
+  RH_TRACE_SCOPE_ARG( "CRhCurveTessellator::Tessellate", m_curves.Count() );
+  const int curve_count = m_curves.Count();
+
+  if ( curve_count >= MinThreadedCurveCount ) {
+    CRhJobGroup jobs( job_priority );
+    jobs.ParallelFor( curve_count, CurvesPerClaim, TessellateJob, this );
+    jobs.Wait();
+  }
+  else {
+    TessellateJob( this, 0, curve_count );
+  }
+
+  // Gather the segments into one batch per color.  Curves are visited in
+  // the order they were added so the result does not depend on which
+  // thread tessellated what.
+  int segment_count = 0;
+  for ( int i = 0; i < curve_count; i++ ) {
+    CurveItem& item = m_curves[i];
+    if ( item.m_lines == NULL )
+      continue;
+
+    int batch_index = m_batch_color.Count() - 1;
+    while ( batch_index >= 0 && m_batch_color[batch_index] != item.m_color )
+      batch_index--;
+    if ( batch_index < 0 ) {
+      batch_index = m_batch_color.Count();
+      m_batch_color.Append( item.m_color );
+      m_batch_lines.AppendNew();
+    }
+
+    m_batch_lines[batch_index].Append( item.m_lines->Count(), item.m_lines->Array() );
+    segment_count += item.m_lines->Count()/2;
+
+    delete item.m_lines;
+    item.m_lines = NULL;
+  }
+
+  m_curves.Empty();
+  return segment_count;
+}
@@ -0,0 +1,92 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_CURVE_TESSELLATOR_INC_)
+#define RH_CURVE_TESSELLATOR_INC_
+
+#include "RhJobSystem.h"
+
+/*
+Description:
+  Turns curve objects into line segments for display.
+
+  Curves are added with their wireframe color, tessellated by
+  CRhJobSystem jobs and then gathered into one batch of line segments per color
+  so each color can be drawn with a single glDrawArrays(GL_LINES) call.
+
+  Spans of degree 1 (lines, polylines) are copied exactly.  Spans of
+  higher degree are subdivided until the curve is within the chord
+  tolerance of each segment.
+*/
+class CRhCurveTessellator
+{
+public:
+  /*
+  Parameters:
+    chord_tolerance - [in] maximum distance between a curve and the
+                           segments that approximate it.
+  */
+  CRhCurveTessellator( double chord_tolerance );
+  ~CRhCurveTessellator();
+
+  /*
+  Parameters:
+    curve - [in] curve to tessellate.  The curve must stay alive until
+                 Tessellate() returns.
+    color - [in] color used to draw the curve
+  */
+  void AddCurve( const ON_Curve* curve, ON_Color color );
+
+  /*
+  Description:
+    Tessellates all curves added so far and fills in the batches.
+  Parameters:
+    job_priority - [in] priority of the tessellation jobs
+  Returns:
+    Total number of line segments.
+  */
+  int Tessellate( CRhJobSystem::priority job_priority = CRhJobSystem::normal_priority );
+
+  int BatchCount() const;
+  ON_Color BatchColor( int batch_index ) const;
+
+  // Pairs of points, one pair per GL_LINES segment
+  const ON_SimpleArray<ON_3fPoint>& BatchLines( int batch_index ) const;
+
+private:
+  void TessellateCurve( int curve_index );
+  static void TessellateJob( void* tessellator, int first, int last );
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhCurveTessellator(const CRhCurveTessellator&);
+  CRhCurveTessellator& operator=(const CRhCurveTessellator&);
+
+private:
+  struct CurveItem
+  {
+    const ON_Curve* m_curve;
+    ON_Color m_color;
+    ON_SimpleArray<ON_3fPoint>* m_lines;
+  };
+
+  const double m_chord_tolerance;
+  ON_SimpleArray<CurveItem> m_curves;
+
+  ON_SimpleArray<ON_Color> m_batch_color;
+  ON_ClassArray< ON_SimpleArray<ON_3fPoint> > m_batch_lines;
+};
+
+#endif
@@ -0,0 +1,254 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "ONModel.h"
+#include "RhDisplayData.h"
+#include "RhTrace.h"
+
+
+bool RhIsObjectVisible( const EX_ONX_Model& model, const ON_3dmObjectAttributes& attr )
+{
+  // ensure the object is visible
+  if ( !attr.IsVisible() )
+    return false;
+
+  // ensure the object's layer is visible
+  int layerIndex = attr.m_layer_index;
+  if ( layerIndex >= 0 && layerIndex < model.m_layer_table.Count() ) {
+    const ON_Layer& layer = model.m_layer_table[layerIndex];
+    if ( !layer.IsVisible() )
+      return false;
+  }
+  return true;
+}
+
+
+void RhPrepareMeshObject( ON_Mesh* mesh )
+{
+  if ( 0 == mesh->HiddenVertexCount() )
+    mesh->DestroyHiddenVertexArray();
+
+  if ( !mesh->HasVertexNormals() && mesh->m_V.Count() > 0 && mesh->m_F.Count() > 0 ) {
+    // 26 September 2003 Dale Lear -
+    //   Some 3dm files have meshes with no normals and this messes up the shading code.
+    mesh->ComputeVertexNormals();
+  }
+}
+
+
+const ON_Mesh* RhBrepRenderMesh( const ON_Brep* brep, ON_Mesh& combined, int* mesh_count )
+{
+  ON_SimpleArray< const ON_Mesh* > meshes;
+  int count = brep->GetMesh( ON::render_mesh, meshes );
+  if ( mesh_count )
+    *mesh_count = count;
+
+  if ( count == 1 )
+  {
+    if ( meshes[0] && meshes[0]->VertexCount() )
+      return meshes[0];
+    return NULL;
+  }
+
+  // Sometimes it's possible to have lists of NULL ON_Meshes...Rhino
+  // can put them there as placeholders for badly formed/meshed breps.
+  // Therefore, we need to always make sure we're actually looking at
+  // a mesh that contains something and/or is not NULL.
+  for ( int i = 0; i < count; i++ )
+  {
+    // If we have a valid pointer, append the mesh to our accumulator mesh...
+    if ( meshes[i] )
+      combined.Append( *meshes[i] );
+  }
+
+  // See if the end result actually contains anything
+  if ( combined.VertexCount() > 0 )
+    return &combined;
+  return NULL;
+}
+
+
+CRhObjectReceiver::~CRhObjectReceiver()
+{
+}
+
+
+// Everything that is drawn is turned into display data as it is read
+// and discarded.  Only curves are kept, until they are tessellated.
+int EX_ONX_Model::KeepObject( ON_Object* pObject, ON_3dmObjectAttributes& attr, CRhObjectReceiver& receiver )
+{
+  RH_TRACE_SCOPE_ARG( "KeepObject", pObject->ObjectType() );
+
+  if ( !receiver.ShouldContinue() )
+    return -1;        // stop reading RIGHT NOW!
+
+  if ( !RhIsObjectVisible( *this, attr ) )
+    return 0;
+
+  // calculate bounding box as we read objects
+  const ON_Geometry* geo = ON_Geometry::Cast( pObject );
+  if ( geo ) {
+    m__object_table_bbox.Union( geo->BoundingBox() );
+    receiver.AddGeometry( *geo );
+  }
+
+  switch ( pObject->ObjectType() )
+  {
+  case ON::mesh_object:
+    {
+      ON_Mesh* mesh = (ON_Mesh*) pObject;
+      RhPrepareMeshObject( mesh );
+      receiver.AddMesh( mesh, attr );
+    }
+    return 0;         // do not keep ON::mesh_object
+
+  case ON::brep_object:
+    {
+      const ON_Brep* brep = (ON_Brep*) pObject;
+      ON_Mesh combined;
+      int count = 0;
+      const ON_Mesh* renderMesh = RhBrepRenderMesh( brep, combined, &count );
+      receiver.AddBrep( brep, renderMesh, count, attr );
+    }
+    return 0;         // do not keep ON::brep_object
+
+  case ON::curve_object:
+    {
+      const ON_Curve* curve = ON_Curve::Cast( pObject );
+      if ( curve == NULL )
+        return 0;
+      receiver.AddCurve( curve, attr );
+    }
+    return 1;         // keep ON::curve_object until it is tessellated
+
+  case ON::pointset_object:
+    {
+      ON_PointCloud* cloud = ON_PointCloud::Cast( pObject );
+      if ( cloud && cloud->PointCount() > 0 )
+        receiver.AddPointCloud( cloud, attr );
+    }
+    return 0;         // do not keep ON::pointset_object, it is drawn from the octree cache
+
+  default:
+    // extrusion objects do not have a mesh
+    return 0;         // do not keep anything else
+  }
+}
+
+bool EX_ONX_Model::SkipObject( ON::object_type type, const ON_3dmObjectAttributes& attr, ON__UINT64 record_key,
+                               ON__UINT64 record_bytes, CRhObjectReceiver& receiver )
+{
+  if ( !RhIsObjectVisible( *this, attr ) )
+    return true;      // KeepObject() would discard it anyway
+
+  ON_BoundingBox bbox;
+  if ( type == ON::pointset_object && receiver.AddCachedPointCloud( attr, record_key, record_bytes, bbox ) ) {
+    m__object_table_bbox.Union( bbox );
+    return true;      // drawn from the octree cache, the points are not needed
+  }
+  return false;
+}
+
+
+void RhGetVertexData( const ON_Mesh& mesh, const ON_MeshPart& part, const ON_3fVector& offset, VertexData* v )
+{
+  const int count = part.vertex_count;
+  const ON_3fPoint* V = &mesh.m_V[part.vi[0]];
+  const ON_3fVector* N = &mesh.m_N[part.vi[0]];
+  for ( int idx = 0; idx < count; idx++ ) {
+    v[idx].vertex = V[idx] - offset;
+    v[idx].normal = N[idx];
+  }
+}
+
+void RhGetVNCData( const ON_Mesh& mesh, const ON_MeshPart& part, const ON_3fVector& offset, VNCData* v )
+{
+  const int count = part.vertex_count;
+  const ON_3fPoint* V = &mesh.m_V[part.vi[0]];
+  const ON_3fVector* N = &mesh.m_N[part.vi[0]];
+  const ON_Color* C = &mesh.m_C[part.vi[0]];
+  for ( int idx = 0; idx < count; idx++ ) {
+    v[idx].vertex = V[idx] - offset;
+    v[idx].normal = N[idx];
+    v[idx].color.x = (float)C[idx].FractionRed();
+    v[idx].color.y = (float)C[idx].FractionGreen();
+    v[idx].color.z = (float)C[idx].FractionBlue();
+    v[idx].color.w = (float)C[idx].FractionAlpha();
+  }
+}
+
+void RhGetVCData( const ON_Mesh& mesh, const ON_MeshPart& part, const ON_3fVector& offset, VCData* v )
+{
+  const int count = part.vertex_count;
+  const ON_3fPoint* V = &mesh.m_V[part.vi[0]];
+  const ON_Color* C = &mesh.m_C[part.vi[0]];
+  for ( int idx = 0; idx < count; idx++ ) {
+    v[idx].vertex = V[idx] - offset;
+    v[idx].color.x = (float)C[idx].FractionRed();
+    v[idx].color.y = (float)C[idx].FractionGreen();
+    v[idx].color.z = (float)C[idx].FractionBlue();
+    v[idx].color.w = (float)C[idx].FractionAlpha();
+  }
+}
+
+
+int RhGetTriangleIndexes( const ON_Mesh& mesh, const ON_MeshPart& part, unsigned short* indexes )
+{
+  int i0, i1, i2, j0, j1, j2;
+  int triangle_count = 0;
+
+  for ( int fi = part.fi[0]; fi < part.fi[1]; fi++ ) {
+    const ON_MeshFace& f = mesh.m_F[fi];
+    if ( !f.IsValid( part.vi[1] ) )
+      continue;
+
+    if ( f.IsQuad() ) {
+      // quadrangle - render as two triangles
+      const ON_3fPoint& v0 = mesh.m_V[f.vi[0]];
+      const ON_3fPoint& v1 = mesh.m_V[f.vi[1]];
+      const ON_3fPoint& v2 = mesh.m_V[f.vi[2]];
+      const ON_3fPoint& v3 = mesh.m_V[f.vi[3]];
+      if ( v0.DistanceTo(v2) <= v1.DistanceTo(v3) ) {
+        i0 = 0; i1 = 1; i2 = 2;
+        j0 = 0; j1 = 2; j2 = 3;
+      }
+      else {
+        i0 = 1; i1 = 2; i2 = 3;
+        j0 = 1; j1 = 3; j2 = 0;
+      }
+    }
+    else {
+      // single triangle
+      i0 = 0; i1 = 1; i2 = 2;
+      j0 = j1 = j2 = 0;
+    }
+
+    // first triangle
+    *indexes++ = f.vi[i0]-part.vi[0];
+    *indexes++ = f.vi[i1]-part.vi[0];
+    *indexes++ = f.vi[i2]-part.vi[0];
+    triangle_count++;
+
+    if ( j0 != j1 ) {
+      // if we have a quad, second triangle
+      *indexes++ = f.vi[j0]-part.vi[0];
+      *indexes++ = f.vi[j1]-part.vi[0];
+      *indexes++ = f.vi[j2]-part.vi[0];
+      triangle_count++;
+    }
+  }
+
+  return triangle_count;
+}
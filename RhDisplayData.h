@@ -0,0 +1,138 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_DISPLAY_DATA_INC_)
+#define RH_DISPLAY_DATA_INC_
+
+//
+// Plain C++ parts of turning objects read from a 3dm file into display data.  Nothing
+// here uses Objective-C or OpenGL, so the same code runs in the app and in the
+// headless load benchmark.
+//
+
+class EX_ONX_Model;
+
+typedef struct {
+  ON_3fPoint    vertex;
+  ON_3fVector    normal;
+} VertexData;
+
+typedef struct {
+  ON_3fPoint    vertex;
+  ON_3fVector   normal;
+  ON_4fPoint    color;
+} VNCData;
+
+typedef struct {
+  ON_3fPoint    vertex;
+  ON_4fPoint    color;
+} VCData;
+
+
+/*
+Returns:
+  true if the object and its layer are visible.
+*/
+bool RhIsObjectVisible( const EX_ONX_Model& model, const ON_3dmObjectAttributes& attr );
+
+/*
+Description:
+  Fixes up a mesh object so it can be drawn: removes an unused hidden
+  vertex array and computes missing vertex normals.
+*/
+void RhPrepareMeshObject( ON_Mesh* mesh );
+
+/*
+Description:
+  Gets the render mesh of a brep.
+Parameters:
+  brep - [in]
+  combined - [out] used when the brep has more than one render mesh
+  mesh_count - [out] number of render meshes on the brep
+Returns:
+  The mesh to draw or NULL if there is nothing to draw.
+*/
+const ON_Mesh* RhBrepRenderMesh( const ON_Brep* brep, ON_Mesh& combined, int* mesh_count );
+
+/*
+Description:
+  Receives the objects EX_ONX_Model::KeepObject() turns into display
+  data.  RhModel and the load benchmark each implement it, so both keep
+  and drop exactly the same objects.
+*/
+class CRhObjectReceiver
+{
+public:
+  virtual ~CRhObjectReceiver();
+
+  // Return false to stop reading the file
+  virtual bool ShouldContinue() = 0;
+
+  // Called for every visible geometry object, before the calls below
+  virtual void AddGeometry( const ON_Geometry& geometry ) = 0;
+
+  virtual void AddMesh( ON_Mesh* mesh, ON_3dmObjectAttributes& attr ) = 0;
+
+  // render_mesh is NULL when the brep has nothing to draw
+  virtual void AddBrep( const ON_Brep* brep, const ON_Mesh* render_mesh, int render_mesh_count, ON_3dmObjectAttributes& attr ) = 0;
+
+  // The curve is kept in the object table until the receiver tessellates it
+  virtual void AddCurve( const ON_Curve* curve, ON_3dmObjectAttributes& attr ) = 0;
+
+  // The cloud is deleted afterwards, so the receiver may reorder its points
+  virtual void AddPointCloud( ON_PointCloud* cloud, ON_3dmObjectAttributes& attr ) = 0;
+
+  /*
+  Description:
+    Called before a point cloud is read.
+  Parameters:
+    record_key - [in] identifies the contents of the point cloud record,
+                      see CRhObjectReadPipeline::SetSkipFilter().  A cache
+                      is only used for the record it was built from.
+    record_bytes - [in] size of the record, to tell whether a cache can
+                        be built for it, see
+                        CRhLoadEstimate::PointCloudBuildBytes()
+    bbox - [out] bounding box of the cached point cloud
+  Returns:
+    true if the point cloud was added from a cache, or will not be
+    drawn, and its points are not needed.
+  */
+  virtual bool AddCachedPointCloud( const ON_3dmObjectAttributes& attr, ON__UINT64 record_key, ON__UINT64 record_bytes,
+                                    ON_BoundingBox& bbox ) = 0;
+};
+
+/*
+Description:
+  Fill the interleaved vertex buffers of one mesh partition.  Vertices
+  are stored relative to offset.
+Parameters:
+  v - [out] array of part.vertex_count elements
+*/
+void RhGetVertexData( const ON_Mesh& mesh, const ON_MeshPart& part, const ON_3fVector& offset, VertexData* v );
+void RhGetVNCData( const ON_Mesh& mesh, const ON_MeshPart& part, const ON_3fVector& offset, VNCData* v );
+void RhGetVCData( const ON_Mesh& mesh, const ON_MeshPart& part, const ON_3fVector& offset, VCData* v );
+
+/*
+Description:
+  Fill the triangle index buffer of one mesh partition.  Quads are
+  split along their shorter diagonal.
+Parameters:
+  indexes - [out] array of 3*part.triangle_count elements
+Returns:
+  Number of triangles written.
+*/
+int RhGetTriangleIndexes( const ON_Mesh& mesh, const ON_MeshPart& part, unsigned short* indexes );
+
+#endif
@@ -0,0 +1,210 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <sys/time.h>
+
+#include "RhFrameStats.h"
+
+// More draw calls than this and the frame is most likely limited by the
+// per call overhead of the OpenGL ES driver.
+static const int ManyDrawCalls = 300;
+
+static const double BucketLimits[CRhFrameStatsSummary::bucket_count] =
+{
+  4.0, 8.0, 16.7, 33.3, 50.0, 100.0, 1.0e30
+};
+
+//////////////////////////////////////////////////////////////
+//
+CRhFrameStatsSummary::CRhFrameStatsSummary()
+{
+  memset( this, 0, sizeof(*this) );
+}
+
+double CRhFrameStatsSummary::BucketLimit( int bucket_index )
+{
+  if ( bucket_index < 0 || bucket_index >= bucket_count )
+    return 0.0;
+  return BucketLimits[bucket_index];
+}
+
+const char* CRhFrameStatsSummary::Bottleneck() const
+{
+  if ( m_frame_count == 0 )
+    return "";
+  if ( m_average.present_ms > m_average.submit_ms )
+    return "GPU";
+  if ( m_average.draw_calls > ManyDrawCalls )
+    return "draw calls";
+  return "CPU";
+}
+
+static int BucketIndex( double ms )
+{
+  int i = 0;
+  while ( i < CRhFrameStatsSummary::bucket_count-1 && ms >= BucketLimits[i] )
+    i++;
+  return i;
+}
+
+static int CompareDouble( const double* a, const double* b )
+{
+  if ( *a < *b )
+    return -1;
+  return ( *a > *b ) ? 1 : 0;
+}
+
+//////////////////////////////////////////////////////////////
+//
+CRhFrameStats::CRhFrameStats()
+: m_frame_start(0.0)
+, m_present_start(0.0)
+, m_previous_frame_start(0.0)
+, m_history_count(0)
+, m_total_frame_count(0)
+, m_coalesced_count(0)
+{
+  memset( &m_frame, 0, sizeof(m_frame) );
+  pthread_mutex_init( &m_lock, NULL );
+}
+
+CRhFrameStats::~CRhFrameStats()
+{
+  pthread_mutex_destroy( &m_lock );
+}
+
+double CRhFrameStats::Milliseconds()
+{
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return tv.tv_sec*1000.0 + tv.tv_usec/1000.0;
+}
+
+void CRhFrameStats::BeginFrame()
+{
+  memset( &m_frame, 0, sizeof(m_frame) );
+  m_frame_start = Milliseconds();
+  m_present_start = 0.0;
+  if ( m_previous_frame_start > 0.0 )
+    m_frame.interval_ms = m_frame_start - m_previous_frame_start;
+  m_previous_frame_start = m_frame_start;
+}
+
+void CRhFrameStats::BeginPresent()
+{
+  m_present_start = Milliseconds();
+}
+
+void CRhFrameStats::EndFrame()
+{
+  const double now = Milliseconds();
+  if ( m_present_start > 0.0 ) {
+    m_frame.submit_ms = m_present_start - m_frame_start;
+    m_frame.present_ms = now - m_present_start;
+  }
+  else
+    m_frame.submit_ms = now - m_frame_start;
+
+  pthread_mutex_lock( &m_lock );
+  m_history[m_total_frame_count % history_size] = m_frame;
+  m_total_frame_count++;
+  if ( m_history_count < history_size )
+    m_history_count++;
+  pthread_mutex_unlock( &m_lock );
+}
+
+void CRhFrameStats::CountCoalescedRequest()
+{
+  pthread_mutex_lock( &m_lock );
+  m_coalesced_count++;
+  pthread_mutex_unlock( &m_lock );
+}
+
+void CRhFrameStats::GetSummary( CRhFrameStatsSummary& summary ) const
+{
+  summary = CRhFrameStatsSummary();
+
+  RhFrameCounters frames[history_size];
+  pthread_mutex_lock( &m_lock );
+  const int frame_count = m_history_count;
+  for ( int i = 0; i < frame_count; i++ )
+    frames[i] = m_history[(m_total_frame_count - frame_count + i) % history_size];
+  summary.m_total_frame_count = m_total_frame_count;
+  summary.m_coalesced_count = m_coalesced_count;
+  pthread_mutex_unlock( &m_lock );
+
+  summary.m_frame_count = frame_count;
+  if ( frame_count == 0 )
+    return;
+
+  RhFrameCounters& avg = summary.m_average;
+  RhFrameCounters& max = summary.m_maximum;
+  double frame_ms[history_size];
+  double interval_ms = 0.0;
+  int interval_count = 0;
+
+  for ( int i = 0; i < frame_count; i++ ) {
+    const RhFrameCounters& f = frames[i];
+    avg.draw_calls += f.draw_calls;
+    avg.state_changes += f.state_changes;
+    avg.drawn_objects += f.drawn_objects;
+    avg.culled_objects += f.culled_objects;
+    avg.triangles += f.triangles;
+    avg.lines += f.lines;
+    avg.points += f.points;
+    avg.submit_ms += f.submit_ms;
+    avg.present_ms += f.present_ms;
+    avg.interval_ms += f.interval_ms;
+
+    if ( f.draw_calls > max.draw_calls ) max.draw_calls = f.draw_calls;
+    if ( f.state_changes > max.state_changes ) max.state_changes = f.state_changes;
+    if ( f.drawn_objects > max.drawn_objects ) max.drawn_objects = f.drawn_objects;
+    if ( f.culled_objects > max.culled_objects ) max.culled_objects = f.culled_objects;
+    if ( f.triangles > max.triangles ) max.triangles = f.triangles;
+    if ( f.lines > max.lines ) max.lines = f.lines;
+    if ( f.points > max.points ) max.points = f.points;
+    if ( f.submit_ms > max.submit_ms ) max.submit_ms = f.submit_ms;
+    if ( f.present_ms > max.present_ms ) max.present_ms = f.present_ms;
+    if ( f.interval_ms > max.interval_ms ) max.interval_ms = f.interval_ms;
+
+    frame_ms[i] = f.submit_ms + f.present_ms;
+    summary.m_frame_ms_histogram[BucketIndex( frame_ms[i] )]++;
+    summary.m_submit_ms_histogram[BucketIndex( f.submit_ms )]++;
+
+    // the first frame after a pause has no meaningful interval
+    if ( f.interval_ms > 0.0 && f.interval_ms < 1000.0 ) {
+      interval_ms += f.interval_ms;
+      interval_count++;
+    }
+  }
+
+  avg.draw_calls /= frame_count;
+  avg.state_changes /= frame_count;
+  avg.drawn_objects /= frame_count;
+  avg.culled_objects /= frame_count;
+  avg.triangles /= frame_count;
+  avg.lines /= frame_count;
+  avg.points /= frame_count;
+  avg.submit_ms /= frame_count;
+  avg.present_ms /= frame_count;
+  avg.interval_ms /= frame_count;
+
+  if ( interval_count > 0 && interval_ms > 0.0 )
+    summary.m_frames_per_second = 1000.0*interval_count/interval_ms;
+
+  ON_qsort( frame_ms, frame_count, sizeof(frame_ms[0]), (int(*)(const void*,const void*))CompareDouble );
+  summary.m_frame_ms_median = frame_ms[frame_count/2];
+  summary.m_frame_ms_95th = frame_ms[(frame_count*95)/100];
+}
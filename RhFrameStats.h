@@ -0,0 +1,135 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_FRAME_STATS_INC_)
+#define RH_FRAME_STATS_INC_
+
+#include <pthread.h>
+
+//
+// Per frame performance counters of the renderers.  The render thread fills in the
+// counters of the frame it is drawing; any thread can ask for a summary of the most
+// recent frames.
+//
+
+// What one frame cost
+struct RhFrameCounters
+{
+  int draw_calls;
+  int state_changes;        // material, shader and buffer changes
+  int drawn_objects;
+  int culled_objects;       // display meshes outside the view frustum
+  ON__INT64 triangles;
+  ON__INT64 lines;
+  ON__INT64 points;
+  double submit_ms;         // CPU time spent issuing OpenGL commands
+  double present_ms;        // time spent in presentRenderbuffer, which waits for the GPU
+  double interval_ms;       // time since the previous frame started
+};
+
+
+class CRhFrameStatsSummary
+{
+public:
+  CRhFrameStatsSummary();
+
+  // Upper limits of the frame time histogram buckets in milliseconds.
+  // The last bucket holds everything slower.
+  enum { bucket_count = 7 };
+  static double BucketLimit( int bucket_index );
+
+  /*
+  Returns:
+    A short guess at what limits the frame rate: "GPU", "draw calls" or "CPU".
+  */
+  const char* Bottleneck() const;
+
+  int m_frame_count;                // frames in the summary
+  ON__INT64 m_total_frame_count;    // frames drawn since the stats were created
+  ON__INT64 m_coalesced_count;      // frame requests merged into a frame that was already pending
+  double m_frames_per_second;
+
+  RhFrameCounters m_average;
+  RhFrameCounters m_maximum;
+
+  // frame time = submit_ms + present_ms
+  double m_frame_ms_median;
+  double m_frame_ms_95th;
+  int m_frame_ms_histogram[bucket_count];
+  int m_submit_ms_histogram[bucket_count];
+};
+
+
+class CRhFrameStats
+{
+public:
+  // Summaries cover this many of the most recent frames
+  enum { history_size = 120 };
+
+  CRhFrameStats();
+  ~CRhFrameStats();
+
+  /*
+  Description:
+    Render thread calls.  BeginFrame() clears Frame(), BeginPresent()
+    ends the submit time and EndFrame() adds the frame to the history.
+    A stereo frame is one frame.
+  */
+  void BeginFrame();
+  void BeginPresent();
+  void EndFrame();
+
+  // Counters of the frame being drawn.  Only the render thread may use them.
+  RhFrameCounters& Frame() { return m_frame; }
+
+  void CountDrawCall( int triangles, int lines = 0, int points = 0 )
+  {
+    m_frame.draw_calls++;
+    m_frame.triangles += triangles;
+    m_frame.lines += lines;
+    m_frame.points += points;
+  }
+
+  void CountStateChanges( int count = 1 )
+  {
+    m_frame.state_changes += count;
+  }
+
+  // A frame was requested while one was still pending, so no extra frame is drawn
+  void CountCoalescedRequest();
+
+  void GetSummary( CRhFrameStatsSummary& summary ) const;
+
+private:
+  static double Milliseconds();
+
+  RhFrameCounters m_frame;
+  double m_frame_start;
+  double m_present_start;
+  double m_previous_frame_start;
+
+  mutable pthread_mutex_t m_lock;
+  RhFrameCounters m_history[history_size];
+  int m_history_count;
+  ON__INT64 m_total_frame_count;
+  ON__INT64 m_coalesced_count;
+
+private:
+  // prohibit use
+  CRhFrameStats(const CRhFrameStats&);
+  CRhFrameStats& operator=(const CRhFrameStats&);
+};
+
+#endif
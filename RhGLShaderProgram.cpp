@@ -192,6 +192,14 @@ void CRhGLShaderProgram::EnableColorUsage(bool  bEnable)
     glUniform1i( m_Uniforms.rglUsesColors,  bEnable?1:0 );
 }
 
+//////////////////////////////////////////////////////////////////////////
+//
+void CRhGLShaderProgram::SetupInstanceOffset(const ON_3fVector& offset)
+{
+  if ( m_Uniforms.rglInstanceOffset >= 0 )
+    glUniform3f( m_Uniforms.rglInstanceOffset, offset.x, offset.y, offset.z );
+}
+
 ///////////////////////////////////////////////////////////////////////////
 //
 bool CRhGLShaderProgram::BuildProgram(const GLchar* VertexShader, const GLchar* FragmentShader)
@@ -337,6 +345,7 @@ void CRhGLShaderProgram::ResolvePredefines(void)
   m_Uniforms.rglEmission  = glGetUniformLocation( m_hProgram, "rglEmission" );
   m_Uniforms.rglShininess = glGetUniformLocation( m_hProgram, "rglShininess" );
   m_Uniforms.rglUsesColors = glGetUniformLocation( m_hProgram, "rglUsesColors" );
+  m_Uniforms.rglInstanceOffset = glGetUniformLocation( m_hProgram, "rglInstanceOffset" );
   
   m_Uniforms.rglLightAmbient  = glGetUniformLocation( m_hProgram, "rglLightAmbient" );
   m_Uniforms.rglLightDiffuse  = glGetUniformLocation( m_hProgram, "rglLightDiffuse" );
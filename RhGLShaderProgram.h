@@ -29,6 +29,7 @@ struct RhGLPredefinedUniforms
   GLint   rglEmission;
   GLint   rglShininess;
   GLint   rglUsesColors;
+  GLint   rglInstanceOffset;
   
   GLint   rglLightAmbient;
   GLint   rglLightDiffuse;
@@ -71,6 +72,7 @@ public:
   void   SetupLight(const ON_Light&);
   void   SetupMaterial(const ON_Material&);
   void   EnableColorUsage(bool bEnable);
+  void   SetupInstanceOffset(const ON_3fVector&);
   
 public:
   bool  BuildProgram(const GLchar* VertexShader, const GLchar* FragmentShader);
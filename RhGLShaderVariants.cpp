@@ -0,0 +1,125 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhGLShaderVariants.h"
+#include "RhTrace.h"
+
+// The templates test these with #if defined(...)
+static void AppendFeatureDefines( unsigned int features, ON_String& source )
+{
+  if ( features & CRhGLShaderVariants::vertex_normals )
+    source += "#define RGL_VERTEX_NORMALS\n";
+  if ( features & CRhGLShaderVariants::vertex_colors )
+    source += "#define RGL_VERTEX_COLORS\n";
+  if ( features & CRhGLShaderVariants::instance_offset )
+    source += "#define RGL_INSTANCE_OFFSET\n";
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhGLShaderVariants::CRhGLShaderVariants()
+: m_bHaveViewport(false)
+, m_bHaveLight(false)
+, m_view_serial(1)
+{
+  for ( int i = 0; i < variant_count; i++ ) {
+    m_programs[i] = NULL;
+    m_failed[i] = false;
+    m_serial[i] = 0;
+  }
+}
+
+CRhGLShaderVariants::~CRhGLShaderVariants()
+{
+  Destroy();
+}
+
+bool CRhGLShaderVariants::SetSource( const char* vertex_shader, const char* fragment_shader )
+{
+  Destroy();
+  if ( vertex_shader == NULL || fragment_shader == NULL )
+    return false;
+  m_vertex_shader = vertex_shader;
+  m_fragment_shader = fragment_shader;
+  return true;
+}
+
+void CRhGLShaderVariants::Destroy()
+{
+  for ( int i = 0; i < variant_count; i++ ) {
+    delete m_programs[i];
+    m_programs[i] = NULL;
+    m_failed[i] = false;
+    m_serial[i] = 0;
+  }
+}
+
+CRhGLShaderProgram* CRhGLShaderVariants::Program( unsigned int features )
+{
+  features &= (variant_count-1);
+  if ( m_programs[features] != NULL || m_failed[features] )
+    return m_programs[features];
+  if ( m_vertex_shader.IsEmpty() || m_fragment_shader.IsEmpty() )
+    return NULL;
+
+  RH_TRACE_SCOPE( "compile shader variant" );
+  ON_String vertex_shader, fragment_shader;
+  AppendFeatureDefines( features, vertex_shader );
+  AppendFeatureDefines( features, fragment_shader );
+  vertex_shader += m_vertex_shader;
+  fragment_shader += m_fragment_shader;
+
+  CRhGLShaderProgram* program = new CRhGLShaderProgram;
+  if ( !program->BuildProgram( vertex_shader.Array(), fragment_shader.Array() ) ) {
+    delete program;
+    program = NULL;
+    m_failed[features] = true;
+  }
+  m_programs[features] = program;
+  return program;
+}
+
+CRhGLShaderProgram* CRhGLShaderVariants::Enable( unsigned int features )
+{
+  features &= (variant_count-1);
+  CRhGLShaderProgram* program = Program( features );
+  if ( program == NULL )
+    return NULL;
+
+  program->Enable();
+  if ( m_serial[features] != m_view_serial ) {
+    if ( m_bHaveViewport )
+      program->SetupViewport( m_viewport );
+    if ( m_bHaveLight )
+      program->SetupLight( m_light );
+    m_serial[features] = m_view_serial;
+  }
+  return program;
+}
+
+void CRhGLShaderVariants::SetupViewport( const ON_Viewport& viewport )
+{
+  m_viewport = viewport;
+  m_bHaveViewport = true;
+  m_view_serial++;
+}
+
+void CRhGLShaderVariants::SetupLight( const ON_Light& light )
+{
+  m_light = light;
+  m_bHaveLight = true;
+  m_view_serial++;
+}
@@ -0,0 +1,103 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_GL_SHADER_VARIANTS_INC_)
+#define RH_GL_SHADER_VARIANTS_INC_
+
+#include "RhGLShaderProgram.h"
+
+/*
+Description:
+  The programs built from one pair of shader templates, one for each set
+  of vertex features.  Each feature is a #define put in front of the
+  template sources, so a mesh without vertex colors runs a program that
+  has no color code at all instead of testing a uniform per fragment.
+
+  Programs are compiled the first time they are asked for and kept.  The
+  uniform locations are resolved once, when a program is linked.
+
+  The viewport and light are remembered and given to each program the
+  next time it is enabled, so only the variants a frame actually uses
+  are set up.
+*/
+class CRhGLShaderVariants
+{
+public:
+  enum feature
+  {
+    vertex_normals  = 1,    // RGL_VERTEX_NORMALS, rglNormal is bound
+    vertex_colors   = 2,    // RGL_VERTEX_COLORS, rglColor is bound
+    instance_offset = 4,    // RGL_INSTANCE_OFFSET, rglInstanceOffset is not zero
+    variant_count   = 8
+  };
+
+  CRhGLShaderVariants();
+  ~CRhGLShaderVariants();
+
+  /*
+  Description:
+    Copies the template sources and deletes any programs built from the
+    previous ones.
+  Returns:
+    false if either source is NULL.
+  */
+  bool SetSource( const char* vertex_shader, const char* fragment_shader );
+
+  /*
+  Parameters:
+    features - [in] feature bits.
+  Returns:
+    The variant's program, compiled now if it was not yet, or NULL if it
+    does not compile.  A variant that failed is not tried again.
+  */
+  CRhGLShaderProgram* Program( unsigned int features );
+
+  /*
+  Description:
+    Makes the variant the current program and, if the viewport or light
+    changed since it was last enabled, sets them up.
+  Returns:
+    The program or NULL, see Program().
+  */
+  CRhGLShaderProgram* Enable( unsigned int features );
+
+  void SetupViewport( const ON_Viewport& viewport );
+  void SetupLight( const ON_Light& light );
+
+  // Deletes the programs; the sources are kept
+  void Destroy();
+
+private:
+  ON_String m_vertex_shader;
+  ON_String m_fragment_shader;
+
+  CRhGLShaderProgram* m_programs[variant_count];
+  bool m_failed[variant_count];
+
+  // m_viewport and m_light were set up on the programs whose m_serial is m_view_serial
+  ON_Viewport m_viewport;
+  ON_Light m_light;
+  bool m_bHaveViewport;
+  bool m_bHaveLight;
+  unsigned int m_view_serial;
+  unsigned int m_serial[variant_count];
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhGLShaderVariants(const CRhGLShaderVariants&);
+  CRhGLShaderVariants& operator=(const CRhGLShaderVariants&);
+};
+
+#endif
@@ -0,0 +1,346 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <unistd.h>
+
+#include "RhJobSystem.h"
+#include "RhTrace.h"
+
+// Worker index + 1 of the calling thread; NULL on threads that are not workers
+static pthread_key_t g_worker_key;
+
+
+//////////////////////////////////////////////////////////////
+//
+// A deque of jobs.  The owning worker takes jobs from the back; shared
+// queues and thieves take them from the front.
+//
+class CRhJobQueue
+{
+public:
+  CRhJobQueue() : m_first(0)
+  {
+    pthread_mutex_init( &m_lock, NULL );
+  }
+
+  ~CRhJobQueue()
+  {
+    pthread_mutex_destroy( &m_lock );
+  }
+
+  void PushBack( const CRhJob& job )
+  {
+    pthread_mutex_lock( &m_lock );
+    if ( m_first > 0 && m_first >= m_jobs.Count()/2 ) {
+      // reuse the space of the jobs taken from the front
+      const int count = m_jobs.Count() - m_first;
+      memmove( m_jobs.Array(), m_jobs.Array() + m_first, count*sizeof(CRhJob) );
+      m_jobs.SetCount( count );
+      m_first = 0;
+    }
+    m_jobs.Append( job );
+    pthread_mutex_unlock( &m_lock );
+  }
+
+  bool PopBack( CRhJob& job )
+  {
+    pthread_mutex_lock( &m_lock );
+    const bool rc = m_jobs.Count() > m_first;
+    if ( rc ) {
+      job = *m_jobs.Last();
+      m_jobs.SetCount( m_jobs.Count() - 1 );
+      if ( m_jobs.Count() == m_first ) {
+        m_jobs.SetCount( 0 );
+        m_first = 0;
+      }
+    }
+    pthread_mutex_unlock( &m_lock );
+    return rc;
+  }
+
+  bool PopFront( CRhJob& job )
+  {
+    pthread_mutex_lock( &m_lock );
+    const bool rc = m_jobs.Count() > m_first;
+    if ( rc ) {
+      job = m_jobs[m_first++];
+      if ( m_jobs.Count() == m_first ) {
+        m_jobs.SetCount( 0 );
+        m_first = 0;
+      }
+    }
+    pthread_mutex_unlock( &m_lock );
+    return rc;
+  }
+
+private:
+  pthread_mutex_t m_lock;
+  ON_SimpleArray<CRhJob> m_jobs;
+  int m_first;      // m_jobs[m_first] is the oldest queued job
+};
+
+
+//////////////////////////////////////////////////////////////
+//
+static pthread_once_t g_job_system_once = PTHREAD_ONCE_INIT;
+static CRhJobSystem* g_job_system = NULL;
+
+void CRhJobSystem::CreateShared()
+{
+  pthread_key_create( &g_worker_key, NULL );
+  g_job_system = new CRhJobSystem();
+}
+
+CRhJobSystem& CRhJobSystem::Shared()
+{
+  pthread_once( &g_job_system_once, CreateShared );
+  return *g_job_system;
+}
+
+struct CRhWorkerStart
+{
+  CRhJobSystem* m_system;
+  int m_worker_index;
+};
+
+CRhJobSystem::CRhJobSystem()
+: m_worker_count(0)
+, m_worker_queue_count(0)
+, m_worker_queues(NULL)
+, m_shared_queues(NULL)
+, m_submit_count(0)
+{
+  pthread_mutex_init( &m_lock, NULL );
+  pthread_cond_init( &m_work_available, NULL );
+
+  m_shared_queues = new CRhJobQueue[priority_count];
+
+  long cpu_count = sysconf( _SC_NPROCESSORS_ONLN );
+  const int max_worker_count = (cpu_count > 1) ? (int)(cpu_count - 1) : 0;
+  if ( max_worker_count > 0 )
+    m_worker_queues = new CRhJobQueue[max_worker_count];
+  m_worker_queue_count = max_worker_count;    // set before the workers read it
+
+  // The system lives as long as the process, so the workers are never joined
+  pthread_attr_t attr;
+  pthread_attr_init( &attr );
+  pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+  for ( int i = 0; i < max_worker_count; i++ ) {
+    CRhWorkerStart* start = new CRhWorkerStart;
+    start->m_system = this;
+    start->m_worker_index = i;
+    pthread_t thread;
+    if ( 0 != pthread_create( &thread, &attr, WorkerThread, start ) ) {
+      delete start;
+      break;
+    }
+    m_worker_count++;
+  }
+  pthread_attr_destroy( &attr );
+}
+
+CRhJobSystem::~CRhJobSystem()
+{
+  // never called, see CRhJobSystem::Shared()
+}
+
+int CRhJobSystem::WorkerCount() const
+{
+  return m_worker_count;
+}
+
+void CRhJobSystem::Submit( const CRhJob& job, priority p )
+{
+  const int worker_index = (int)(size_t)pthread_getspecific( g_worker_key ) - 1;
+  if ( worker_index >= 0 && p == normal_priority )
+    m_worker_queues[worker_index].PushBack( job );
+  else
+    m_shared_queues[p].PushBack( job );
+
+  pthread_mutex_lock( &m_lock );
+  m_submit_count++;
+  pthread_cond_signal( &m_work_available );
+  pthread_mutex_unlock( &m_lock );
+}
+
+bool CRhJobSystem::FindJob( int worker_index, priority min_priority, CRhJob& job )
+{
+  bool rc = m_shared_queues[high_priority].PopFront( job );
+  if ( min_priority > normal_priority )
+    return rc;
+
+  // worker queues only hold normal priority jobs
+  if ( !rc && worker_index >= 0 )
+    rc = m_worker_queues[worker_index].PopBack( job );
+  for ( int i = 1; !rc && i <= m_worker_queue_count; i++ ) {
+    // steal, starting with the next worker so thieves spread out
+    const int victim = (worker_index + i) % m_worker_queue_count;
+    if ( victim != worker_index )
+      rc = m_worker_queues[victim].PopFront( job );
+  }
+  if ( !rc )
+    rc = m_shared_queues[normal_priority].PopFront( job );
+  if ( !rc && min_priority <= background_priority )
+    rc = m_shared_queues[background_priority].PopFront( job );
+  return rc;
+}
+
+void CRhJobSystem::Execute( const CRhJob& job )
+{
+  if ( !job.m_group->IsCancelled() )
+    job.m_proc( job.m_context, job.m_first, job.m_last );
+  job.m_group->JobDone();
+}
+
+bool CRhJobSystem::RunOneJob( priority min_priority )
+{
+  const int worker_index = (int)(size_t)pthread_getspecific( g_worker_key ) - 1;
+  CRhJob job;
+  if ( !FindJob( worker_index, min_priority, job ) )
+    return false;
+  Execute( job );
+  return true;
+}
+
+void* CRhJobSystem::WorkerThread( void* arg )
+{
+  CRhWorkerStart* start = (CRhWorkerStart*)arg;
+  CRhJobSystem* system = start->m_system;
+  const int worker_index = start->m_worker_index;
+  delete start;
+
+  RhTraceSetThreadName( "job worker" );
+  pthread_setspecific( g_worker_key, (void*)(size_t)(worker_index + 1) );
+
+  for(;;) {
+    // note the submits before looking, so a job queued during the
+    // search is not slept through
+    pthread_mutex_lock( &system->m_lock );
+    const unsigned int submit_count = system->m_submit_count;
+    pthread_mutex_unlock( &system->m_lock );
+
+    CRhJob job;
+    if ( system->FindJob( worker_index, background_priority, job ) ) {
+      system->Execute( job );
+      continue;
+    }
+
+    // every queue was empty; sleep until the next Submit()
+    pthread_mutex_lock( &system->m_lock );
+    while ( submit_count == system->m_submit_count )
+      pthread_cond_wait( &system->m_work_available, &system->m_lock );
+    pthread_mutex_unlock( &system->m_lock );
+  }
+
+  return NULL;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhJobGroup::CRhJobGroup( CRhJobSystem::priority p )
+: m_system(CRhJobSystem::Shared())
+, m_priority(p)
+, m_pending_count(0)
+, m_bCancel(false)
+{
+  pthread_mutex_init( &m_lock, NULL );
+  pthread_cond_init( &m_job_done, NULL );
+}
+
+CRhJobGroup::~CRhJobGroup()
+{
+  Wait();
+  pthread_cond_destroy( &m_job_done );
+  pthread_mutex_destroy( &m_lock );
+}
+
+void CRhJobGroup::Run( RhJobProc proc, void* context, int first, int last )
+{
+  CRhJob job;
+  job.m_proc = proc;
+  job.m_context = context;
+  job.m_first = first;
+  job.m_last = last;
+  job.m_group = this;
+
+  pthread_mutex_lock( &m_lock );
+  m_pending_count++;
+  pthread_mutex_unlock( &m_lock );
+
+  if ( m_system.WorkerCount() == 0 )
+    m_system.Execute( job );      // nobody else would run it
+  else
+    m_system.Submit( job, m_priority );
+}
+
+void CRhJobGroup::ParallelFor( int count, int grain_size, RhJobProc proc, void* context )
+{
+  if ( grain_size < 1 )
+    grain_size = 1;
+  for ( int first = 0; first < count; first += grain_size )
+    Run( proc, context, first, (count - first > grain_size) ? first + grain_size : count );
+}
+
+void CRhJobGroup::Wait()
+{
+  for(;;) {
+    pthread_mutex_lock( &m_lock );
+    const bool bDone = ( m_pending_count == 0 );
+    pthread_mutex_unlock( &m_lock );
+    if ( bDone )
+      break;
+
+    // Help with queued jobs of this priority or higher, ours or not.
+    // Lower priority jobs could keep the waiting thread long after the
+    // group is done.
+    if ( m_system.RunOneJob( m_priority ) )
+      continue;
+
+    // everything left is running on other threads
+    pthread_mutex_lock( &m_lock );
+    if ( m_pending_count > 0 )
+      pthread_cond_wait( &m_job_done, &m_lock );
+    pthread_mutex_unlock( &m_lock );
+  }
+}
+
+void CRhJobGroup::Cancel()
+{
+  pthread_mutex_lock( &m_lock );
+  m_bCancel = true;
+  pthread_mutex_unlock( &m_lock );
+}
+
+bool CRhJobGroup::IsCancelled() const
+{
+  pthread_mutex_lock( &m_lock );
+  const bool rc = m_bCancel;
+  pthread_mutex_unlock( &m_lock );
+  return rc;
+}
+
+CRhJobSystem::priority CRhJobGroup::Priority() const
+{
+  return m_priority;
+}
+
+void CRhJobGroup::JobDone()
+{
+  pthread_mutex_lock( &m_lock );
+  m_pending_count--;
+  pthread_cond_broadcast( &m_job_done );
+  pthread_mutex_unlock( &m_lock );
+}
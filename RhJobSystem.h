@@ -0,0 +1,180 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_JOB_SYSTEM_INC_)
+#define RH_JOB_SYSTEM_INC_
+
+#include <pthread.h>
+
+class CRhJobGroup;
+class CRhJobQueue;
+
+/*
+Description:
+  Job function.  Does the work for items first to last-1 of whatever
+  context points at.
+*/
+typedef void (*RhJobProc)( void* context, int first, int last );
+
+// One queued job.  Used by CRhJobSystem and CRhJobGroup only.
+struct CRhJob
+{
+  RhJobProc m_proc;
+  void* m_context;
+  int m_first;
+  int m_last;
+  CRhJobGroup* m_group;
+};
+
+
+/*
+Description:
+  One pool of worker threads for all the parallel work in the viewer:
+  object decoding, curve tessellation, model audits and whatever comes
+  next.  Sharing a pool sized to the core count keeps the parallel
+  paths from starting more threads than there are cores when they run
+  at the same time, like a background model preload during a frame.
+
+  Every worker has its own queue.  Jobs a worker submits go to the back
+  of its queue and it runs them newest first, which keeps nested work
+  in cache; an idle worker steals the oldest job from another worker's
+  queue.  Jobs submitted from other threads, and all high and
+  background priority jobs, go to a shared queue per priority.
+
+  Jobs are submitted and waited for through a CRhJobGroup.
+*/
+class CRhJobSystem
+{
+public:
+  enum priority
+  {
+    background_priority = 0,  // preloading models the user is not looking at
+    normal_priority,          // the model being loaded for the user
+    high_priority,            // work a frame is waiting for
+    priority_count
+  };
+
+  /*
+  Returns:
+    The process wide job system.  It is created on first use with one
+    worker thread less than there are cores, because a thread waiting
+    for a job group runs jobs too.
+  */
+  static CRhJobSystem& Shared();
+
+  /*
+  Returns:
+    Number of worker threads.  0 on a single core device, where jobs
+    run on the thread that submits them.
+  */
+  int WorkerCount() const;
+
+private:
+  friend class CRhJobGroup;
+
+  CRhJobSystem();
+  ~CRhJobSystem();
+  static void CreateShared();
+
+  void Submit( const CRhJob& job, priority p );
+
+  /*
+  Description:
+    Runs one queued job of min_priority or higher on the calling thread.
+  Returns:
+    false if no such job was queued.
+  */
+  bool RunOneJob( priority min_priority );
+
+  bool FindJob( int worker_index, priority min_priority, CRhJob& job );
+  void Execute( const CRhJob& job );
+  static void* WorkerThread( void* arg );
+
+  // prohibit use of copy construction and operator=
+  CRhJobSystem(const CRhJobSystem&);
+  CRhJobSystem& operator=(const CRhJobSystem&);
+
+private:
+  int m_worker_count;                           // threads started
+  int m_worker_queue_count;                     // threads attempted
+  CRhJobQueue* m_worker_queues;                 // one per attempted worker
+  CRhJobQueue* m_shared_queues;                 // one per priority
+
+  pthread_mutex_t m_lock;
+  pthread_cond_t  m_work_available;
+  unsigned int m_submit_count;                  // guarded by m_lock, counts Submit() calls
+};
+
+
+/*
+Description:
+  A set of jobs that are waited for, or cancelled, together.
+
+  Example:
+    CRhJobGroup group;
+    group.ParallelFor( curve_count, 16, TessellateCurves, this );
+    group.Wait();
+
+  The thread that waits runs queued jobs of the group's priority or
+  higher until the group is done, so a job may itself submit and wait
+  for a group.  It does not run lower priority jobs, so a frame waiting
+  for high priority work is not held up by a background preload.
+*/
+class CRhJobGroup
+{
+public:
+  CRhJobGroup( CRhJobSystem::priority p = CRhJobSystem::normal_priority );
+
+  // Waits for the jobs that are still queued or running
+  ~CRhJobGroup();
+
+  // Queues proc( context, first, last )
+  void Run( RhJobProc proc, void* context, int first = 0, int last = 1 );
+
+  // Queues jobs for items 0 to count-1, grain_size items per job
+  void ParallelFor( int count, int grain_size, RhJobProc proc, void* context );
+
+  // Returns when every job in the group has run or been skipped
+  void Wait();
+
+  /*
+  Description:
+    Jobs of the group that have not started are skipped.  Running jobs
+    can call IsCancelled() to stop early.  Wait() is still required.
+  */
+  void Cancel();
+  bool IsCancelled() const;
+
+  CRhJobSystem::priority Priority() const;
+
+private:
+  friend class CRhJobSystem;
+  void JobDone();
+
+  // prohibit use of copy construction and operator=
+  CRhJobGroup(const CRhJobGroup&);
+  CRhJobGroup& operator=(const CRhJobGroup&);
+
+private:
+  CRhJobSystem& m_system;
+  const CRhJobSystem::priority m_priority;
+
+  mutable pthread_mutex_t m_lock;
+  pthread_cond_t  m_job_done;
+  int  m_pending_count;         // queued or running jobs
+  bool m_bCancel;
+};
+
+#endif
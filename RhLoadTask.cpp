@@ -0,0 +1,214 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhLoadTask.h"
+#include "RhTrace.h"
+
+// One lock for every task: tasks are few and the priority rule needs to see all
+// of them at once.  g_task_changed is broadcast whenever a task starts, finishes,
+// changes priority or is cancelled.
+static pthread_mutex_t g_task_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_task_changed = PTHREAD_COND_INITIALIZER;
+static int g_running_foreground_count = 0;
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhLoadProgress::CRhLoadProgress()
+: m_bytes_read(0)
+, m_total_bytes(0)
+, m_objects_read(0)
+, m_total_objects(0)
+{
+}
+
+double CRhLoadProgress::Fraction() const
+{
+  double f;
+  if ( m_total_objects > 0 )
+    f = (double)m_objects_read/(double)m_total_objects;
+  else if ( m_total_bytes > 0 )
+    f = (double)m_bytes_read/(double)m_total_bytes;
+  else
+    return -1.0;
+  return f < 1.0 ? f : 1.0;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhLoadTask::CRhLoadTask( priority p )
+: m_ref_count(1)
+, m_priority(p)
+, m_status(queued)
+, m_bCancel(false)
+{
+}
+
+CRhLoadTask::~CRhLoadTask()
+{
+}
+
+void CRhLoadTask::AddRef()
+{
+  pthread_mutex_lock( &g_task_lock );
+  m_ref_count++;
+  pthread_mutex_unlock( &g_task_lock );
+}
+
+void CRhLoadTask::Release()
+{
+  pthread_mutex_lock( &g_task_lock );
+  const bool bDelete = ( --m_ref_count == 0 );
+  pthread_mutex_unlock( &g_task_lock );
+  if ( bDelete )
+    delete this;
+}
+
+void CRhLoadTask::Cancel()
+{
+  pthread_mutex_lock( &g_task_lock );
+  m_bCancel = true;
+  pthread_cond_broadcast( &g_task_changed );
+  pthread_mutex_unlock( &g_task_lock );
+}
+
+bool CRhLoadTask::IsCancelled() const
+{
+  pthread_mutex_lock( &g_task_lock );
+  const bool rc = m_bCancel;
+  pthread_mutex_unlock( &g_task_lock );
+  return rc;
+}
+
+void CRhLoadTask::SetPriority( priority p )
+{
+  pthread_mutex_lock( &g_task_lock );
+  if ( p != m_priority ) {
+    if ( m_status == running )
+      g_running_foreground_count += ( p == foreground_priority ) ? 1 : -1;
+    m_priority = p;
+    pthread_cond_broadcast( &g_task_changed );
+  }
+  pthread_mutex_unlock( &g_task_lock );
+}
+
+CRhLoadTask::priority CRhLoadTask::Priority() const
+{
+  pthread_mutex_lock( &g_task_lock );
+  const priority p = m_priority;
+  pthread_mutex_unlock( &g_task_lock );
+  return p;
+}
+
+CRhLoadTask::status CRhLoadTask::Status() const
+{
+  pthread_mutex_lock( &g_task_lock );
+  const status s = m_status;
+  pthread_mutex_unlock( &g_task_lock );
+  return s;
+}
+
+bool CRhLoadTask::IsFinished() const
+{
+  const status s = Status();
+  return s != queued && s != running;
+}
+
+CRhLoadProgress CRhLoadTask::Progress() const
+{
+  pthread_mutex_lock( &g_task_lock );
+  const CRhLoadProgress progress = m_progress;
+  pthread_mutex_unlock( &g_task_lock );
+  return progress;
+}
+
+CRhLoadTask::status CRhLoadTask::Wait() const
+{
+  pthread_mutex_lock( &g_task_lock );
+  while ( m_status == queued || m_status == running )
+    pthread_cond_wait( &g_task_changed, &g_task_lock );
+  const status s = m_status;
+  pthread_mutex_unlock( &g_task_lock );
+  return s;
+}
+
+// The caller holds g_task_lock
+bool CRhLoadTask::IsWaitingForForeground() const
+{
+  return m_priority == background_priority && g_running_foreground_count > 0 && !m_bCancel;
+}
+
+bool CRhLoadTask::Begin()
+{
+  pthread_mutex_lock( &g_task_lock );
+  if ( IsWaitingForForeground() ) {
+    RH_TRACE_SCOPE( "wait for foreground load" );
+    while ( IsWaitingForForeground() )
+      pthread_cond_wait( &g_task_changed, &g_task_lock );
+  }
+  const bool rc = !m_bCancel;
+  m_status = running;
+  if ( m_priority == foreground_priority )
+    g_running_foreground_count++;
+  pthread_cond_broadcast( &g_task_changed );
+  pthread_mutex_unlock( &g_task_lock );
+  return rc;
+}
+
+bool CRhLoadTask::ShouldContinue()
+{
+  pthread_mutex_lock( &g_task_lock );
+  if ( IsWaitingForForeground() ) {
+    RH_TRACE_SCOPE( "wait for foreground load" );
+    while ( IsWaitingForForeground() )
+      pthread_cond_wait( &g_task_changed, &g_task_lock );
+  }
+  const bool rc = !m_bCancel;
+  pthread_mutex_unlock( &g_task_lock );
+  return rc;
+}
+
+void CRhLoadTask::SetTotalBytes( ON__UINT64 total_bytes )
+{
+  pthread_mutex_lock( &g_task_lock );
+  m_progress.m_total_bytes = total_bytes;
+  pthread_mutex_unlock( &g_task_lock );
+}
+
+void CRhLoadTask::SetTotalObjects( int total_objects )
+{
+  pthread_mutex_lock( &g_task_lock );
+  m_progress.m_total_objects = total_objects;
+  pthread_mutex_unlock( &g_task_lock );
+}
+
+void CRhLoadTask::ObjectRead( ON__UINT64 bytes_read )
+{
+  pthread_mutex_lock( &g_task_lock );
+  m_progress.m_objects_read++;
+  m_progress.m_bytes_read = bytes_read;
+  pthread_mutex_unlock( &g_task_lock );
+}
+
+void CRhLoadTask::Finish( status s )
+{
+  pthread_mutex_lock( &g_task_lock );
+  if ( m_status == running && m_priority == foreground_priority )
+    g_running_foreground_count--;
+  m_status = s;
+  pthread_cond_broadcast( &g_task_changed );
+  pthread_mutex_unlock( &g_task_lock );
+}
@@ -0,0 +1,147 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_LOAD_TASK_INC_)
+#define RH_LOAD_TASK_INC_
+
+#include <pthread.h>
+
+// Snapshot of how far a load has come
+class CRhLoadProgress
+{
+public:
+  CRhLoadProgress();
+
+  /*
+  Returns:
+    0.0 to 1.0, by objects when the object count is known and by bytes
+    otherwise.  -1.0 when neither total is known yet.
+  */
+  double Fraction() const;
+
+  ON__UINT64 m_bytes_read;      // archive position, including records queued ahead of the objects
+  ON__UINT64 m_total_bytes;     // file size, 0 if unknown
+  int m_objects_read;           // object table records handed to EX_ONX_Model::ShouldKeepObject()
+  int m_total_objects;          // from the object table scan, 0 if unknown
+};
+
+
+/*
+Description:
+  Handle to one model load.  The loading thread reports progress to it
+  and calls ShouldContinue() between units of work; any other thread can
+  read the progress, cancel the load, change its priority or wait for it
+  to finish.
+
+  Foreground loads run as soon as they start.  Background loads, like
+  preloading the next model of a review, do not start and pause at their
+  next ShouldContinue() while any foreground load is running, so the
+  model the user is waiting for gets the cores, memory bandwidth and
+  the main thread to itself.
+
+  Tasks are reference counted because the loading thread and the caller
+  can each outlive the other.  new CRhLoadTask holds one reference.
+*/
+class CRhLoadTask
+{
+public:
+  enum priority
+  {
+    background_priority = 0,
+    foreground_priority = 1
+  };
+
+  enum status
+  {
+    queued = 0,       // Begin() not called or waiting for its turn
+    running,
+    succeeded,
+    failed,
+    cancelled
+  };
+
+  CRhLoadTask( priority p );
+
+  void AddRef();
+  void Release();     // deletes the task with the last reference
+
+  /////////////////////////////////////////////////////////////
+  // Any thread
+
+  // Asks the load to stop at its next ShouldContinue()
+  void Cancel();
+  bool IsCancelled() const;
+
+  void SetPriority( priority p );
+  priority Priority() const;
+
+  status Status() const;
+  bool IsFinished() const;
+  CRhLoadProgress Progress() const;
+
+  /*
+  Description:
+    Blocks until the loading thread calls Finish().
+  Returns:
+    Final status.
+  */
+  status Wait() const;
+
+  /////////////////////////////////////////////////////////////
+  // Loading thread
+
+  /*
+  Description:
+    Waits for the task's turn to run.
+  Returns:
+    false if the task was cancelled first.  Call Finish() either way.
+  */
+  bool Begin();
+
+  /*
+  Description:
+    Cancellation and priority point.  Call it between units of work
+    that take no more than a few milliseconds.
+  Returns:
+    false if the load should stop.  Background loads block here while
+    a foreground load is running.
+  */
+  bool ShouldContinue();
+
+  void SetTotalBytes( ON__UINT64 total_bytes );
+  void SetTotalObjects( int total_objects );
+  void ObjectRead( ON__UINT64 bytes_read );
+
+  // status is succeeded, failed or cancelled
+  void Finish( status s );
+
+private:
+  ~CRhLoadTask();
+  bool IsWaitingForForeground() const;
+
+  // prohibit use of copy construction and operator=
+  CRhLoadTask(const CRhLoadTask&);
+  CRhLoadTask& operator=(const CRhLoadTask&);
+
+private:
+  // m_lock and the priority bookkeeping are shared by all tasks, see RhLoadTask.cpp
+  int m_ref_count;
+  priority m_priority;
+  status m_status;
+  bool m_bCancel;
+  CRhLoadProgress m_progress;
+};
+
+#endif
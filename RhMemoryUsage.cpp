@@ -0,0 +1,145 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhMemoryUsage.h"
+#include "RhObjectReadPipeline.h"
+#include "RhTrace.h"
+
+// Rough bytes of memory per byte of object table record.  The load benchmark
+// reports the estimate next to the display buffer bytes, which is how these
+// should be tuned.  Mesh records are compressed about 2.5 to 1 and their display
+// buffers are about as big as the inflated mesh.  Render meshes are about half
+// of a brep record; the rest of the brep is thrown away.  Curves are kept in the
+// object table and also tessellated into line buffers.  Point clouds are drawn
+// from their octree cache within a fixed point budget.
+static const double MeshRecordFactor = 2.5;
+static const double BrepRecordFactor = 1.25;
+static const double CurveRecordFactor = 3.0;
+
+// While an object is read, its decoded object and a temporary ON_Mesh copy
+// of its render meshes can both be held.
+static const double DecodedRecordFactor = 5.0;
+
+// A point cloud is built into its cache from the record and the decoded
+// cloud, which is about as big as the record.  The octree is sorted in place.
+static const double PointCloudBuildFactor = 2.0;
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhMemoryUsage::CRhMemoryUsage()
+{
+  memset( this, 0, sizeof(*this) );
+}
+
+ON__UINT64 CRhMemoryUsage::Total() const
+{
+  return m_model_tables
+       + m_mesh_buffers
+       + m_mesh_buffer_data
+       + m_curve_buffers
+       + m_point_cloud_buffers
+       + m_pick_bitmaps
+       + m_preview_scene;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhLoadEstimate::CRhLoadEstimate()
+{
+  memset( this, 0, sizeof(*this) );
+}
+
+bool CRhLoadEstimate::ScanObjectTable( ON_BinaryArchive& archive )
+{
+  RH_TRACE_SCOPE( "scan object table" );
+  *this = CRhLoadEstimate();
+
+  // version 1 archives have no object records
+  if ( archive.Archive3dmVersion() < 2 )
+    return false;
+
+  const size_t start = archive.CurrentPosition();
+  const ON__INT64 sizeof_header = 4 + archive.SizeofChunkLength();
+  bool rc = true;
+
+  for (;;)
+  {
+    ON__UINT32 tcode = 0;
+    ON__INT64 length = 0;
+    if ( !archive.PeekAt3dmBigChunkType( &tcode, &length ) ) {
+      rc = false;
+      break;
+    }
+    if ( tcode != TCODE_OBJECT_RECORD )
+      break;      // end of table
+    if ( length <= 0 || !archive.BigSeekFromCurrentPosition( sizeof_header ) ) {
+      rc = false;
+      break;
+    }
+
+    // every record starts with its object type
+    ON__UINT32 type_tcode = 0;
+    ON__INT64 object_type = 0;
+    if ( !archive.PeekAt3dmBigChunkType( &type_tcode, &object_type ) || type_tcode != TCODE_OBJECT_RECORD_TYPE )
+      object_type = ON::unknown_object_type;
+
+    const ON__UINT64 record_bytes = (ON__UINT64)(sizeof_header + length);
+    switch ( object_type )
+    {
+    case ON::mesh_object:     m_mesh_bytes += record_bytes; break;
+    case ON::brep_object:     m_brep_bytes += record_bytes; break;
+    case ON::curve_object:    m_curve_bytes += record_bytes; break;
+    case ON::pointset_object: m_point_cloud_bytes += record_bytes; break;
+    default:                  m_other_bytes += record_bytes; break;
+    }
+    if ( record_bytes > m_largest_record )
+      m_largest_record = record_bytes;
+    m_record_count++;
+
+    if ( !archive.BigSeekFromCurrentPosition( length ) ) {
+      rc = false;
+      break;
+    }
+  }
+
+  if ( !archive.BigSeekFromStart( start ) )
+    rc = false;
+  if ( !rc )
+    *this = CRhLoadEstimate();
+  return rc;
+}
+
+ON__UINT64 CRhLoadEstimate::ModelBytes() const
+{
+  return (ON__UINT64)( MeshRecordFactor*m_mesh_bytes
+                     + BrepRecordFactor*m_brep_bytes
+                     + CurveRecordFactor*m_curve_bytes );
+}
+
+ON__UINT64 CRhLoadEstimate::PeakBytes() const
+{
+  // the read pipeline queues raw records ahead of the objects being decoded
+  ON__UINT64 queued_bytes = m_mesh_bytes + m_brep_bytes + m_curve_bytes + m_point_cloud_bytes + m_other_bytes;
+  if ( queued_bytes > CRhObjectReadPipeline::max_queued_bytes )
+    queued_bytes = CRhObjectReadPipeline::max_queued_bytes;
+  return ModelBytes() + queued_bytes + (ON__UINT64)( DecodedRecordFactor*m_largest_record );
+}
+
+ON__UINT64 CRhLoadEstimate::PointCloudBuildBytes( ON__UINT64 record_bytes )
+{
+  return (ON__UINT64)( PointCloudBuildFactor*record_bytes );
+}
@@ -0,0 +1,100 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_MEMORY_USAGE_INC_)
+#define RH_MEMORY_USAGE_INC_
+
+//
+// Memory accounting for a model: the bytes a loaded model holds, and an estimate
+// of what a model will need that is made before any of its objects are read.
+//
+
+// Bytes a model holds, by owner
+class CRhMemoryUsage
+{
+public:
+  CRhMemoryUsage();
+
+  /*
+  Returns:
+    Bytes the model holds now.  m_temporary_bytes is not included;
+    it was only held while the model was read.
+  */
+  ON__UINT64 Total() const;
+
+  ON__UINT64 m_model_tables;          // EX_ONX_Model tables and the objects kept in them
+  ON__UINT64 m_temporary_bytes;       // largest object and ON_Mesh copies held at once while reading
+  ON__UINT64 m_mesh_buffers;          // DisplayMesh OpenGL buffers
+  ON__UINT64 m_mesh_buffer_data;      // DisplayMesh VBO data kept for the mesh caches and previews
+  ON__UINT64 m_curve_buffers;         // DisplayCurves OpenGL buffers
+  ON__UINT64 m_point_cloud_buffers;   // DisplayPointCloud OpenGL buffers of the loaded nodes
+  ON__UINT64 m_pick_bitmaps;
+  ON__UINT64 m_preview_scene;         // CRhRasterScene, without the VBO data it draws
+};
+
+
+/*
+Description:
+  Estimates the memory a model needs from the sizes of its object table
+  records.  The records are not decoded; only their chunk headers and the
+  object type at the start of each record are read, so scanning the table
+  of a large file takes a small fraction of the time reading it does.
+*/
+class CRhLoadEstimate
+{
+public:
+  CRhLoadEstimate();
+
+  /*
+  Description:
+    Adds up the object table records by object type.
+  Parameters:
+    archive - [in] archive positioned at the first object table record,
+                   i.e. after a successful BeginRead3dmObjectTable().
+                   The position is restored before returning.
+  Returns:
+    false if the table could not be scanned.  The estimate is empty
+    and the archive may no longer be positioned at the first record.
+  */
+  bool ScanObjectTable( ON_BinaryArchive& archive );
+
+  // Bytes the model is expected to hold once it is loaded
+  ON__UINT64 ModelBytes() const;
+
+  // ModelBytes() plus the records and decoded objects held at once while reading
+  ON__UINT64 PeakBytes() const;
+
+  /*
+  Description:
+    Memory needed to build the octree cache of a point cloud.  The
+    whole cloud is decoded before CRhPointCloudOctree::Build() sorts
+    it, so a cloud too big for the device can never get a cache.
+  Parameters:
+    record_bytes - [in] size of the point cloud's object table record
+  */
+  static ON__UINT64 PointCloudBuildBytes( ON__UINT64 record_bytes );
+
+  int m_record_count;
+
+  // object table record bytes by object type
+  ON__UINT64 m_mesh_bytes;
+  ON__UINT64 m_brep_bytes;
+  ON__UINT64 m_curve_bytes;
+  ON__UINT64 m_point_cloud_bytes;
+  ON__UINT64 m_other_bytes;
+  ON__UINT64 m_largest_record;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+//
+// This class keeps the OpenGL buffers of a model's display meshes within a memory budget.
+// Meshes with a cache file can be evicted: their buffers are deleted and restored from the
+// file when the mesh comes back into view.  The least recently drawn meshes are evicted
+// first.  Meshes without a cache file are never evicted.
+//
+// The renderer brackets the meshes it draws with beginFrame and endFrame and asks useMesh:
+// before drawing each one.  A frame holds the residency lock, so meshes are never evicted
+// by another thread while they are being drawn.
+//
+
+@class DisplayMesh;
+
+
+@interface RhMeshResidency : NSObject {
+
+  NSLock* lock;
+  long long budget;               // bytes of mesh buffers allowed on the GPU
+  long long residentBytes;        // bytes of the buffers that exist now
+  NSMutableArray* evictableMeshes;
+
+  unsigned int frameNumber;
+  int frameRestoreCount;
+  BOOL frameNeedsRestores;        // some meshes in view were not restored this frame
+
+  long evictionCount;
+  long restoreCount;
+}
+
+@property (readonly) long long budget;
+@property (readonly) long long residentBytes;
+@property (readonly) long evictionCount;
+@property (readonly) long restoreCount;
+
+- (id) initWithBudget: (long long) bytes;
+
+// YES once the model uses half its budget; from then on new meshes should get a cache file
+- (BOOL) wantsCacheFiles;
+
+// Tracks a new mesh.  path is its cache file, nil if it can never be evicted.
+// May evict meshes, which is done on the main thread.
+- (void) addMesh: (DisplayMesh*) mesh cacheFile: (NSString*) path;
+
+// Render thread calls.  useMesh: returns YES if the mesh can be drawn and restores it
+// if needed; endFrame returns YES if meshes in view are still waiting to be restored.
+- (void) beginFrame;
+- (BOOL) useMesh: (DisplayMesh*) mesh;
+- (BOOL) endFrame;
+
+// Evicts meshes until about half of the current buffers are freed
+- (void) didReceiveMemoryWarning;
+
+@end
@@ -0,0 +1,180 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#import "RhMeshResidency.h"
+#import "DisplayMesh.h"
+#include "RhTrace.h"
+
+
+// Reading a mesh from its cache file takes a few milliseconds, so only this many are
+// restored per frame.  The rest are restored in the following frames.
+static const int MaxMeshRestoresPerFrame = 8;
+
+// Eviction goes a little below the budget so it does not run again for every new mesh
+static const double EvictionTarget = 0.9;
+
+
+@interface RhMeshResidency ()
+- (void) evictToBytes: (long long) targetBytes;
+- (void) evictOverBudget;
+@end
+
+
+@implementation RhMeshResidency
+
+@synthesize budget, residentBytes, evictionCount, restoreCount;
+
+- (id) initWithBudget: (long long) bytes
+{
+  self = [super init];
+  if (self) {
+    lock = [[NSLock alloc] init];
+    evictableMeshes = [[NSMutableArray alloc] init];
+    budget = bytes;
+  }
+  return self;
+}
+
+- (void) dealloc
+{
+  [lock release];
+  [evictableMeshes release];
+  [super dealloc];
+}
+
+
+#pragma mark Meshes
+
+- (BOOL) wantsCacheFiles
+{
+  [lock lock];
+  BOOL rc = 2*residentBytes > budget;
+  [lock unlock];
+  return rc;
+}
+
+- (void) addMesh: (DisplayMesh*) mesh cacheFile: (NSString*) path
+{
+  [lock lock];
+  residentBytes += [mesh gpuBytes];
+  if (path) {
+    mesh.cacheFile = path;
+    [evictableMeshes addObject: mesh];
+  }
+  BOOL overBudget = residentBytes > budget;
+  [lock unlock];
+
+  // OpenGL buffers are deleted on the thread that created them while reading: the
+  // reading thread when it has an upload context, otherwise the main thread
+  if (overBudget) {
+    if ([EAGLContext currentContext])
+      [self evictOverBudget];
+    else
+      [self performSelectorOnMainThread: @selector(evictOverBudget) withObject: nil waitUntilDone: YES];
+  }
+}
+
+static int CompareLastDrawn (const ON_2dex* a, const ON_2dex* b)
+{
+  return a->j - b->j;
+}
+
+// Evicts the least recently drawn meshes that were not drawn this frame until no
+// more than targetBytes are resident.  The caller holds the lock.
+- (void) evictToBytes: (long long) targetBytes
+{
+  if (residentBytes <= targetBytes)
+    return;
+  RH_TRACE_SCOPE( "evict meshes" );
+
+  ON_SimpleArray<ON_2dex> candidates;   // i = index in evictableMeshes, j = frame last drawn
+  const int meshCount = evictableMeshes.count;
+  for (int idx=0; idx<meshCount; idx++) {
+    DisplayMesh* mesh = [evictableMeshes objectAtIndex: idx];
+    if ([mesh isResident] && (mesh.lastDrawnFrame != frameNumber || frameNumber == 0)) {
+      ON_2dex& candidate = candidates.AppendNew();
+      candidate.i = idx;
+      candidate.j = (int) mesh.lastDrawnFrame;
+    }
+  }
+  candidates.QuickSort (CompareLastDrawn);
+
+  for (int idx=0; idx<candidates.Count() && residentBytes > targetBytes; idx++) {
+    DisplayMesh* mesh = [evictableMeshes objectAtIndex: candidates[idx].i];
+    residentBytes -= [mesh gpuBytes];
+    [mesh evictBuffers];
+    evictionCount++;
+  }
+}
+
+- (void) evictOverBudget
+{
+  [lock lock];
+  if (residentBytes > budget)
+    [self evictToBytes: (long long)(EvictionTarget*budget)];
+  [lock unlock];
+}
+
+- (void) didReceiveMemoryWarning
+{
+  [lock lock];
+  [self evictToBytes: residentBytes/2];
+  [lock unlock];
+}
+
+
+#pragma mark Drawing
+
+- (void) beginFrame
+{
+  [lock lock];
+  frameNumber++;
+  frameRestoreCount = 0;
+  frameNeedsRestores = NO;
+}
+
+- (BOOL) useMesh: (DisplayMesh*) mesh
+{
+  DisplayMesh* owner = [mesh bufferOwner];
+  owner.lastDrawnFrame = frameNumber;
+  if ([owner isResident])
+    return YES;
+  if (owner.cacheFile == nil)
+    return NO;
+
+  if (frameRestoreCount >= MaxMeshRestoresPerFrame) {
+    frameNeedsRestores = YES;
+    return NO;
+  }
+  frameRestoreCount++;
+
+  RH_TRACE_SCOPE( "restore mesh" );
+  if (![owner restoreBuffers])
+    return NO;
+  residentBytes += [owner gpuBytes];
+  restoreCount++;
+  return YES;
+}
+
+- (BOOL) endFrame
+{
+  if (residentBytes > budget)
+    [self evictToBytes: (long long)(EvictionTarget*budget)];
+  BOOL rc = frameNeedsRestores;
+  [lock unlock];
+  return rc;
+}
+
+@end
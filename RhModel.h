@@ -17,8 +17,16 @@
 #import <Foundation/Foundation.h>
 
 class EX_ONX_Model;
+class CRhMemoryUsage;
+class CRhLoadEstimate;
+class CRhLoadTask;
+class CRhRasterScene;
+class ON_ClippingRegion;
+struct RhMeshTree;
 @class GDataEntryDocBase;
 @class ScreenBitmap;
+@class RhMeshResidency;
+@class EAGLContext;
 
 
 typedef enum {
@@ -60,6 +68,7 @@ typedef enum {
   long geometryCount;
   long brepCount;
   long brepWithMeshCount;
+  long curveCount;
   BOOL tumbling;
   
   BOOL outOfMemoryWarning;
@@ -77,6 +86,21 @@ typedef enum {
   EX_ONX_Model* onMacModel;
   NSMutableArray* meshes;     // our DisplayMesh objects
   NSMutableArray* transmeshes;     // our DisplayMesh objects
+  NSMutableArray* curves;     // our DisplayCurves objects, one per wireframe color
+  NSMutableArray* pointClouds;     // our DisplayPointCloud objects
+  NSMutableDictionary* sharedMeshes;  // DisplayMesh objects by geometry key, only while reading
+  size_t sharedMeshKeyBytes;          // bytes of the keys in sharedMeshes, see SharedMeshKeyBudget
+  NSMutableDictionary* pointCloudKeys;  // record keys of point clouds without a cache by UUID, only while reading
+  ON__UINT64 pointCloudTooBigBytes;     // memory a point cloud without a cache needed to build one, stops the read
+  RhMeshResidency* meshResidency;     // keeps the DisplayMesh buffers within the memory budget
+  ON__UINT64 estimatedBytes;          // memory the model was expected to need, see CRhLoadEstimate
+  ON__UINT64 temporaryBytes;          // largest object and ON_Mesh copies held at once while reading
+  EAGLContext* uploadContext;         // current on the reading thread so it creates OpenGL buffers itself
+  CRhLoadTask* loadTask;              // progress, cancellation and priority of the last prepareModelWithDelegate:
+  CRhLoadTask* nextLoadTask;          // waits for a cancelled loadTask to finish, then replaces it
+  CRhRasterScene* previewScene;       // the meshes' VBO data for previews drawn without OpenGL
+  BOOL previewSceneTooBig;            // the meshes passed PreviewTriangleBudget and previewScene was deleted
+  RhMeshTree* meshTree;               // packed R-tree of the display meshes' boxes, made once reading is done
   
   ScreenBitmap* pickBitmap;
 }
@@ -96,6 +120,7 @@ typedef enum {
 @property (nonatomic) long geometryCount;
 @property (nonatomic) long brepCount;
 @property (nonatomic) long brepWithMeshCount;
+@property (nonatomic) long curveCount;
 @property (nonatomic, assign, getter=isDownloaded) BOOL downloaded;
 @property (nonatomic, assign) int source;
 
@@ -108,6 +133,11 @@ typedef enum {
 
 @property (retain) NSArray* meshes;
 @property (retain) NSArray* transmeshes;
+@property (retain) NSArray* curves;
+@property (retain) NSArray* pointClouds;
+@property (readonly) RhMeshResidency* meshResidency;
+@property (readonly) ON__UINT64 estimatedBytes;
+@property (readonly) ON__UINT64 pointCloudTooBigBytes;
 @property (retain) ScreenBitmap* pickBitmap;
 
 
@@ -127,6 +157,8 @@ typedef enum {
 - (BOOL) needsPassword;
 
 - (void) prepareModelWithDelegate: (id) delegate;
+- (CRhLoadTask*) prepareModelWithDelegate: (id) delegate inBackground: (BOOL) background;   // the model keeps a reference, AddRef() to keep it longer
+- (CRhLoadTask*) loadTask;
 - (void) cancelModelPreparation;
 
 - (NSString*) modelPath;              // full path of 3dm file on iPhone
@@ -136,8 +168,26 @@ typedef enum {
 - (BOOL) meshesInitialized;       // true if mesh VBOs are created
 - (void) deleteAll;               // delete everything, including our model and all cached data
 - (void) deleteCaches;            // delete all cached data but not the model
+- (void) didReceiveMemoryWarning; // evict mesh buffers that can be restored from caches
+- (void) getMemoryUsage: (CRhMemoryUsage&) usage;   // bytes held by the model, empty while reading
+
+// Draws the model with CRhSoftwareRasterizer on the calling thread and the job system,
+// with a transparent background.  Returns nil while reading or when the model was too
+// big to keep the VBO data of its meshes; the renderer's renderPreview:inViewport: draws those.
+- (UIImage*) previewImageInViewport: (const ON_Viewport&) viewport width: (int) width height: (int) height;
+
+// Render thread culling.  Finds the display meshes whose boxes may be seen in any of the
+// frustums with the model's mesh tree.  Returns an array of the opaque meshes followed
+// by the transparent ones, with the indexes of those found in ascending order, or nil
+// while reading or before the tree is made, when every mesh has to be tested.
+- (NSArray*) meshesInFrustums: (const ON_ClippingRegion* const*) frustums count: (int) frustumCount indexes: (ON_SimpleArray<int>&) indexes opaqueCount: (int*) opaqueCount;
+
+// Reading thread calls
+- (BOOL) shouldReadObjectsWithEstimate: (const CRhLoadEstimate&) estimate;    // may ask the user
+- (void) holdingTemporaryBytes: (size_t) bytes;
 
 - (void) undownload;              // revert to undownloaded status
+- (void) cleanUp;                 // release everything read from the model; caches are kept
 
 - (NSString*) cachesPathForName: (NSString*) fileOrDirectoryName;
 
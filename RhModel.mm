@@ -15,21 +15,65 @@
 
 #import "RhModel.h"
 #import "DisplayMesh.h"
+#import "DisplayCurves.h"
+#import "DisplayPointCloud.h"
+#import "RhMeshResidency.h"
+#import "ScreenBitmap.h"
+#import <OpenGLES/EAGL.h>
+#import <OpenGLES/ES1/gl.h>
+#include "RhCRC32.h"
+#include "RhDisplayData.h"
+#include "RhCurveTessellator.h"
+#include "RhPointCloudOctree.h"
+#include "RhMemoryUsage.h"
+#include "RhLoadTask.h"
+#include "RhSoftwareRasterizer.h"
+#include "RhPackedRTree.h"
+#include "RhTrace.h"
+
+// Models with more triangles than this do not keep the VBO data of their meshes for
+// previews; those are drawn with OpenGL on the render thread instead.
+static const ON__INT64 PreviewTriangleBudget = 250000;
+
+// Geometry keys hold a quantized copy of each mesh that other meshes may share
+// buffers with.  Past this many bytes of keys, new meshes are no longer offered
+// for sharing, though they can still share the buffers of earlier ones.
+static const size_t SharedMeshKeyBudget = 16*1024*1024;
+
+// Bytes at the start of a model that are hashed for its verified file key
+static const size_t VerifiedHeaderBytes = 64*1024;
+
+// The display meshes of a model that has been read, for culling on the render thread
+struct RhMeshTree
+{
+  CRhPackedRTree tree;                // element ids index meshes
+  ON_SimpleArray<int> unbounded;      // meshes without a valid box, never culled
+  NSArray* meshes;                    // the opaque meshes, then the transparent ones
+  int opaqueCount;
+};
 
 
 @interface RhModel ()
 - (void) meshPreparationProgress: (NSNumber*) progress;
+- (NSNumber*) loadProgress;
+- (BOOL) shouldContinueLoading;
 - (void) meshPreparationDidSucceed;
 - (void) meshPreparationDidFailWithError: (NSError*) error;
+- (BOOL) keepsPreviewBuffers: (ON__INT64) triangleCount;
+- (CRhJobSystem::priority) jobPriority;
+- (void) createMeshTree;
+- (void) deleteMeshTree;
+- (void) startLoadTask;
+- (void) startNextLoadTask;
 @end
 
 
 @implementation RhModel
 
 @synthesize title, description, source, urlString, cachesDirectoryName, documentsFilename, bundleName, isSample;
-@synthesize fileSize, meshObjectCount, renderMeshCount, geometryCount, brepCount, brepWithMeshCount, downloaded;
-@synthesize preparationCancelled, readingModel, continueReading, continueReadingLock, readSuccessfully, initializationFailed, meshes, transmeshes;
-@synthesize pickBitmap;
+@synthesize fileSize, meshObjectCount, renderMeshCount, geometryCount, brepCount, brepWithMeshCount, curveCount, downloaded;
+@synthesize preparationCancelled, readingModel, continueReading, continueReadingLock, readSuccessfully, initializationFailed, meshes, transmeshes, curves, pointClouds;
+@synthesize pickBitmap, meshResidency, estimatedBytes, pointCloudTooBigBytes;
 
 
 // Helper method for creating a full path from a file name that is in the ~/Library/Caches directory
@@ -104,7 +148,17 @@
   delete onMacModel;
   [meshes release];
   [transmeshes release];
+  [curves release];
+  [pointClouds release];
+  [meshResidency release];
+  [uploadContext release];
+  if (loadTask)
+    loadTask->Release();
+  if (nextLoadTask)
+    nextLoadTask->Release();
   [pickBitmap release];
+  delete previewScene;
+  [self deleteMeshTree];
 
   [title release];
   [description release];
@@ -244,7 +298,7 @@
 
 - (BOOL) meshesInitialized
 {
-  return (meshes != nil || transmeshes != nil) || !initializationFailed;
+  return (meshes != nil || transmeshes != nil || curves != nil || pointClouds != nil) || !initializationFailed;
 }
 
 // delete all cached data but not the model
@@ -270,8 +324,17 @@
   meshes = nil;
   [transmeshes release];
   transmeshes = nil;
+  [curves release];
+  curves = nil;
+  [pointClouds release];
+  pointClouds = nil;
+  [meshResidency release];
+  meshResidency = nil;
   [pickBitmap release];
   pickBitmap = nil;
+  delete previewScene;
+  previewScene = NULL;
+  [self deleteMeshTree];
 }
 
 // revert to undownloaded status
@@ -294,6 +357,38 @@
 
 #pragma mark Accessors
 
+// Called on the main thread when the application receives a memory warning
+- (void) didReceiveMemoryWarning
+{
+  [meshResidency didReceiveMemoryWarning];
+}
+
+- (void) getMemoryUsage: (CRhMemoryUsage&) usage
+{
+  usage = CRhMemoryUsage();
+  if (self.readingModel)
+    return;     // the tables and mesh arrays are still growing
+  
+  if (onMacModel)
+    usage.m_model_tables = onMacModel->SizeOfTables();
+  usage.m_temporary_bytes = temporaryBytes;
+  for (DisplayMesh* me in meshes) {
+    usage.m_mesh_buffers += [me gpuBytes];
+    usage.m_mesh_buffer_data += [me cpuBytes];
+  }
+  for (DisplayMesh* me in transmeshes) {
+    usage.m_mesh_buffers += [me gpuBytes];
+    usage.m_mesh_buffer_data += [me cpuBytes];
+  }
+  for (DisplayCurves* dc in curves)
+    usage.m_curve_buffers += [dc gpuBytes];
+  for (DisplayPointCloud* dpc in pointClouds)
+    usage.m_point_cloud_buffers += [dpc gpuBytes];
+  usage.m_pick_bitmaps = [pickBitmap byteCount];
+  if (previewScene)
+    usage.m_preview_scene = previewScene->SizeOf();
+}
+
 - (long) polygonCount
 {
   long triangles = 0;
@@ -329,16 +424,31 @@
 // We save the raw VBO data of a mesh in an archive after a mesh has been partitioned
 // and use that archive to create the VBOs next time we display the model.
 //
+// Once a model uses half its mesh memory budget, the VBO data of each new DisplayMesh
+// is also saved in a .vbo file so the RhMeshResidency can evict its VBOs and restore
+// them from that file when the mesh is drawn again.
+//
+
+- (NSString*) bufferCachePathForMesh: (ON_3dmObjectAttributes&) attr index: (int) idx
+{
+  return [self cachesPathForName: [NSString stringWithFormat: @"%@.%d.vbo", uuid2ns(attr.m_uuid), idx]];
+}
 
 - (BOOL) loadMeshCaches: (ON_Mesh*) mesh withAttributes: (ON_3dmObjectAttributes&) attr withMaterial: (ON_Material&) material
 {
+  RH_TRACE_SCOPE( "loadMeshCaches" );
   NSString* meshUUIDStr = uuid2ns(attr.m_uuid);
   NSString* meshCachePath = [self cachesPathForName: [meshUUIDStr stringByAppendingPathExtension: @"meshes"]];
   NSArray* displayMeshes = [NSKeyedUnarchiver unarchiveObjectWithFile: meshCachePath];
   if (displayMeshes == nil)
     return NO;
-  for (DisplayMesh* me in displayMeshes)
+  NSFileManager* fileManager = [NSFileManager defaultManager];
+  int idx = 0;
+  for (DisplayMesh* me in displayMeshes) {
     [me restoreUsingMesh: mesh material: material];
+    NSString* bufferCachePath = [self bufferCachePathForMesh: attr index: idx++];
+    [meshResidency addMesh: me cacheFile: [fileManager fileExistsAtPath: bufferCachePath] ? bufferCachePath : nil];
+  }
 
   if ( material.Transparency() == 0 )
     [meshes addObjectsFromArray: displayMeshes];
@@ -349,11 +459,226 @@
 
 - (void) saveDisplayMeshes: (NSArray*) cachedMeshes forMesh: (ON_Mesh*) mesh withAttributes: (ON_3dmObjectAttributes&) attr withMaterial: (ON_Material&) material
 {
+  RH_TRACE_SCOPE( "saveDisplayMeshes" );
   NSString* meshUUIDStr = uuid2ns(attr.m_uuid);
   NSString* meshCachePath = [self cachesPathForName: [meshUUIDStr stringByAppendingPathExtension: @"meshes"]];
   [NSKeyedArchiver archiveRootObject: cachedMeshes toFile: meshCachePath];
 }
 
+#pragma mark Point Cloud Caches
+
+//
+// Point clouds can have hundreds of millions of points, far more than we can draw or even
+// keep in memory.  The first time a point cloud is read we build a level of detail octree and
+// save it in a cache file next to the mesh caches.  The viewer streams points from that file.
+// When the model is read again, point clouds with a cache are skipped without being read.
+//
+// A cache is tied to the record it was built from by the record key, the length of the
+// record and the CRC stored at its end.  Another version of the model file only reuses
+// the caches of point clouds whose records did not change.
+//
+
+- (NSString*) pointCloudCachePath: (const ON_3dmObjectAttributes&) attr
+{
+  NSString* cloudUUIDStr = uuid2ns(attr.m_uuid);
+  return [self cachesPathForName: [cloudUUIDStr stringByAppendingPathExtension: @"points"]];
+}
+
+// Returns a point cloud drawn from its cache file, or nil if there is no cache file or it
+// was built from a different record.
+- (DisplayPointCloud*) newCachedPointCloud: (const ON_3dmObjectAttributes&) attr recordKey: (ON__UINT64) recordKey
+{
+  if (recordKey == 0)
+    return nil;
+  DisplayPointCloud* dpc = [[DisplayPointCloud alloc] initWithCacheFile: [self pointCloudCachePath: attr] color: onMacModel->WireframeColor (attr)];
+  if (dpc != nil && [dpc sourceKey] != recordKey) {
+    [dpc release];      // stale cache
+    dpc = nil;
+  }
+  return dpc;
+}
+
+// Called before the point cloud record is read.  Returns YES if the point cloud was added
+// from its cache and the record does not need to be read.  Otherwise the record key is
+// kept for the cache addPointCloud:withAttributes: builds.
+//
+// Building a cache needs the whole point cloud in memory.  A point cloud too big for that
+// is not read at all; the read stops and fails with pointCloudTooBigBytes.
+- (BOOL) addCachedPointCloud: (const ON_3dmObjectAttributes&) attr recordKey: (ON__UINT64) recordKey recordBytes: (ON__UINT64) recordBytes boundingBox: (ON_BoundingBox&) bbox
+{
+  RH_TRACE_SCOPE( "addCachedPointCloud" );
+  DisplayPointCloud* dpc = [self newCachedPointCloud: attr recordKey: recordKey];
+  if (dpc == nil) {
+    const ON__UINT64 buildBytes = CRhLoadEstimate::PointCloudBuildBytes (recordBytes);
+    if (estimatedBytes + buildBytes > (ON__UINT64) [RhinoApp modelMemoryLimit]) {
+      pointCloudTooBigBytes = buildBytes;
+      return YES;
+    }
+    if (recordKey != 0)
+      [pointCloudKeys setObject: [NSNumber numberWithUnsignedLongLong: recordKey] forKey: uuid2ns(attr.m_uuid)];
+    return NO;
+  }
+  
+  [self meshPreparationProgress: [self loadProgress]];
+  bbox = [dpc boundingBox];
+  [pointClouds addObject: dpc];
+  [dpc release];
+  return YES;
+}
+
+- (void) addPointCloud: (ON_PointCloud*) cloud withAttributes: (ON_3dmObjectAttributes&) attr
+{
+  RH_TRACE_SCOPE_ARG( "addPointCloud", cloud->PointCount() );
+  [self meshPreparationProgress: [self loadProgress]];
+  
+  NSString* cloudCachePath = [self pointCloudCachePath: attr];
+  
+  // Files too old to skip records give no record key.  Their caches are built with a key
+  // of 0, which is never reused, so the point cloud is read again next time.
+  NSString* cloudUUIDStr = uuid2ns(attr.m_uuid);
+  const ON__UINT64 recordKey = [[pointCloudKeys objectForKey: cloudUUIDStr] unsignedLongLongValue];
+  [pointCloudKeys removeObjectForKey: cloudUUIDStr];
+  
+  DisplayPointCloud* dpc = nil;
+  if (CRhPointCloudOctree::Build (*cloud, [cloudCachePath fileSystemRepresentation], recordKey))
+    dpc = [[DisplayPointCloud alloc] initWithCacheFile: cloudCachePath color: onMacModel->WireframeColor (attr)];
+  
+  if (dpc) {
+    [pointClouds addObject: dpc];
+    [dpc release];
+  }
+}
+
+#pragma mark Verified Files
+
+//
+// Checking the CRC of every chunk is a measurable part of reading a large model.
+// After a model has been read without CRC errors we remember the CRC of the whole
+// file.  If the user trusts verified models and the file still has that CRC, the
+// chunk CRCs are not checked again.
+//
+// The chunk CRCs are only skipped after the whole file is hashed and matches, since
+// damage past the first bytes keeps the length and modification time.  We also remember
+// a cheap key - the length, modification time and CRC of the first bytes - as a hint.
+// When the key matches, the file is hashed before it is read so the checks can be
+// skipped.  When it does not, the file has most likely changed; it is read with the
+// checks and hashed afterwards, while it is still in the file cache, to remember a
+// clean read.
+//
+
+- (NSDictionary*) verifiedFile
+{
+  return [NSDictionary dictionaryWithContentsOfFile: [self cachesPathForName: @"verified.plist"]];
+}
+
+- (BOOL) isVerifiedFileKey: (ON__UINT32) headerCRC length: (ON__UINT64) fileLength modified: (ON__INT64) modifiedTime
+{
+  RH_TRACE_SCOPE( "isVerifiedFileKey" );
+  NSDictionary* verified = [self verifiedFile];
+  if (verified == nil || [verified objectForKey: @"IRHeaderCRC"] == nil)
+    return NO;
+  return [[verified objectForKey: @"IRHeaderCRC"] unsignedIntValue] == headerCRC
+      && [[verified objectForKey: @"IRFileLength"] unsignedLongLongValue] == fileLength
+      && [[verified objectForKey: @"IRFileModified"] longLongValue] == modifiedTime;
+}
+
+- (BOOL) isVerifiedFile: (ON__UINT32) fileCRC length: (ON__UINT64) fileLength
+{
+  RH_TRACE_SCOPE( "isVerifiedFile" );
+  NSDictionary* verified = [self verifiedFile];
+  if (verified == nil)
+    return NO;
+  return [[verified objectForKey: @"IRFileCRC"] unsignedIntValue] == fileCRC
+      && [[verified objectForKey: @"IRFileLength"] unsignedLongLongValue] == fileLength;
+}
+
+- (void) saveVerifiedFile: (ON__UINT32) fileCRC length: (ON__UINT64) fileLength headerCRC: (ON__UINT32) headerCRC modified: (ON__INT64) modifiedTime
+{
+  RH_TRACE_SCOPE( "saveVerifiedFile" );
+  NSDictionary* verified = [NSDictionary dictionaryWithObjectsAndKeys:
+                            [NSNumber numberWithUnsignedInt: fileCRC], @"IRFileCRC",
+                            [NSNumber numberWithUnsignedLongLong: fileLength], @"IRFileLength",
+                            [NSNumber numberWithUnsignedInt: headerCRC], @"IRHeaderCRC",
+                            [NSNumber numberWithLongLong: modifiedTime], @"IRFileModified",
+                            nil];
+  [verified writeToFile: [self cachesPathForName: @"verified.plist"] atomically: YES];
+}
+
+#pragma mark Memory Estimate
+
+//
+// Before any objects are read, the sizes of the object table records give an estimate
+// of the memory the model will need.  If that is more than the device can give us,
+// the user is asked before we start a load that would get the application killed.
+//
+
+- (void) showLargeModelAlert: (NSNumber*) megabytes
+{
+  NSString* message = [NSString stringWithFormat: NSLocalizedString(@"This model needs about %d MB of memory, which is more than this device can provide.  Reading it may fail.", @"warning before reading a large 3DM file"), [megabytes intValue]];
+  UIAlertView* alert = [[UIAlertView alloc] initWithTitle: NSLocalizedString(@"Large Model", @"title for warning dialog")
+                                                  message: message
+                                                 delegate: self
+                                        cancelButtonTitle: NSLocalizedString(@"Continue", @"button title to continue reading a 3DM file")
+                                        otherButtonTitles: NSLocalizedString(@"Stop", @"button title to stop reading a 3DM file"), nil];
+  [alert show];
+  [alert release];
+}
+
+- (BOOL) shouldReadObjectsWithEstimate: (const CRhLoadEstimate&) estimate
+{
+  estimatedBytes = estimate.ModelBytes();
+  DLog (@"%d objects, estimated %llu MB, peak %llu MB", estimate.m_record_count, estimatedBytes/(1024*1024), estimate.PeakBytes()/(1024*1024));
+  
+  // nobody is waiting for a background load, so it stops instead of asking
+  if (loadTask && loadTask->Priority() == CRhLoadTask::background_priority) {
+    if (estimate.PeakBytes() <= (ON__UINT64) [RhinoApp prefetchMemoryBudget])
+      return YES;
+    preparationCancelled = YES;
+    return NO;
+  }
+  
+  if (estimate.PeakBytes() <= (ON__UINT64) [RhinoApp modelMemoryLimit])
+    return YES;
+  
+  // wait for the answer; the alert view delegate unlocks continueReadingLock
+  [continueReadingLock lock];
+  [self performSelectorOnMainThread: @selector(showLargeModelAlert:) withObject: [NSNumber numberWithLongLong: estimate.PeakBytes()/(1024*1024)] waitUntilDone: NO];
+  [continueReadingLock lock];
+  BOOL rc = (continueReading != 0);
+  [continueReadingLock unlock];
+  
+  if (!rc)
+    preparationCancelled = YES;
+  return rc;
+}
+
+- (void) holdingTemporaryBytes: (size_t) bytes
+{
+  if (bytes > temporaryBytes)
+    temporaryBytes = bytes;
+}
+
+// Cancellation and priority point for work that is not inside EX_ONX_Model::Read()
+- (BOOL) shouldContinueLoading
+{
+  return loadTask == NULL || loadTask->ShouldContinue();
+}
+
+// Preloads run their jobs at background priority
+- (CRhJobSystem::priority) jobPriority
+{
+  if (loadTask && loadTask->Priority() == CRhLoadTask::background_priority)
+    return CRhJobSystem::background_priority;
+  return CRhJobSystem::normal_priority;
+}
+
+// Fraction of the object table read so far, -1 if unknown
+- (NSNumber*) loadProgress
+{
+  return [NSNumber numberWithFloat: loadTask ? (float) loadTask->Progress().Fraction() : -1.0f];
+}
+
+
 #pragma mark Meshes
 
 -(NSError*) meshError: (NSString*) errorStr
@@ -367,12 +692,72 @@
   
 - (void) createDisplayMeshes: (ON_Mesh*) mesh withAttributes: (ON_3dmObjectAttributes&) attr withMaterial: (ON_Material&) material
 {
+  RH_TRACE_SCOPE_ARG( "createDisplayMeshes", mesh->VertexCount() );
+  
   // will we create more than one partition?
   int vertex_count = mesh->VertexCount();
   const int triangle_count = mesh->TriangleCount() + 2*mesh->QuadCount();
   BOOL multipleMeshPartitions = vertex_count > USHRT_MAX-3 || triangle_count > INT_MAX-3;
-  if (multipleMeshPartitions && [self loadMeshCaches: mesh withAttributes: attr withMaterial: material])
-    return;       // successfully created DisplayMesh objects from the cache.  We are done.
+  if (![self shouldContinueLoading])
+    return;
+  if (multipleMeshPartitions && [self loadMeshCaches: mesh withAttributes: attr withMaterial: material]) {
+    // successfully created DisplayMesh objects from the cache.  They have no VBO data
+    // left, so previews draw buffers of their own.
+    if ([self keepsPreviewBuffers: triangle_count])
+      previewScene->AddMesh (*mesh, material);
+    return;
+  }
+  
+  // Small models keep the VBO data of their meshes, which previews are drawn from.
+  // Meshes keeping it are not evicted, so it is only deleted by keepsPreviewBuffers:.
+  const BOOL keepForPreview = [self keepsPreviewBuffers: triangle_count];
+  
+  // Exploded blocks and arrays often contain many copies of the same mesh at different
+  // locations.  Copies share the VBOs of the first one and are drawn at their own offset.
+  if (!multipleMeshPartitions) {
+    ON_3fVector offset;
+    NSData* geometryKey = [DisplayMesh geometryKeyForMesh: mesh offset: &offset];
+    if (geometryKey) {
+      DisplayMesh* shared = [sharedMeshes objectForKey: geometryKey];
+      DisplayMesh* me;
+      NSString* bufferCachePath = nil;
+      BOOL captureBuffers = NO;
+      if (shared) {
+        me = [[DisplayMesh alloc] initWithMesh: mesh sharingBuffersOf: shared offset: offset material: material];
+        if (me && keepForPreview)
+          [me addToRasterScene: previewScene];
+      }
+      else {
+        bufferCachePath = [self bufferCachePathForMesh: attr index: 0];
+        BOOL cached = [[NSFileManager defaultManager] fileExistsAtPath: bufferCachePath];
+        captureBuffers = !cached && [meshResidency wantsCacheFiles];
+        if (!cached && !captureBuffers)
+          bufferCachePath = nil;
+        me = [[DisplayMesh alloc] initWithMesh: mesh offset: offset material: material saveVBOData: captureBuffers || keepForPreview];
+      }
+      if (me) {
+        if ( [me isOpaque] )
+          [meshes addObject: me];
+        else
+          [transmeshes addObject: me];
+        if (shared == nil) {
+          if (sharedMeshKeyBytes + [geometryKey length] <= SharedMeshKeyBudget) {
+            [sharedMeshes setObject: me forKey: geometryKey];
+            sharedMeshKeyBytes += [geometryKey length];
+          }
+          if (captureBuffers && ![me writeBuffersToFile: bufferCachePath])
+            bufferCachePath = nil;
+          if (keepForPreview && [me addToRasterScene: previewScene])
+            bufferCachePath = nil;
+          else
+            [me deleteVBOData];
+          [meshResidency addMesh: me cacheFile: bufferCachePath];
+        }
+        [me release];
+      }
+      return;
+    }
+  }
   
   const ON_MeshPartition* partition = mesh->CreatePartition(USHRT_MAX-3, INT_MAX-3);
   if (partition == NULL)
@@ -386,30 +771,46 @@
 //  DLog (@"partition has %d parts", partition->m_part.Count());
     
   for (int idx=0; idx<partCount; idx++) {
+    if (![self shouldContinueLoading])
+      break;
     
     const struct ON_MeshPart& part = partition->m_part[idx];
 //    DLog (@"m_V[%d] -> m_V[%d], m_F[%d] -> m_F[%d] vertexCount %d, triangleCount %d", part.vi[0], part.vi[1], part.fi[0], part.fi[1], part.vertex_count, part.triangle_count);
-    DisplayMesh* me = [[DisplayMesh alloc] initWithMesh: mesh index: idx material: material saveVBOData: multipleMeshPartitions];
+    NSString* bufferCachePath = [self bufferCachePathForMesh: attr index: idx];
+    BOOL cached = [[NSFileManager defaultManager] fileExistsAtPath: bufferCachePath];
+    BOOL captureBuffers = !cached && [meshResidency wantsCacheFiles];
+    if (!cached && !captureBuffers)
+      bufferCachePath = nil;
+    DisplayMesh* me = [[DisplayMesh alloc] initWithMesh: mesh index: idx material: material saveVBOData: multipleMeshPartitions || captureBuffers || keepForPreview];
     if (me) {
       if ( [me isOpaque] )
         [meshes addObject: me];
       else
         [transmeshes addObject: me];
       [displayMeshes addObject: me];
+      if (captureBuffers && ![me writeBuffersToFile: bufferCachePath])
+        bufferCachePath = nil;
+      if (keepForPreview && [me addToRasterScene: previewScene])
+        bufferCachePath = nil;
+      else if (!multipleMeshPartitions)
+        [me deleteVBOData];
+      [meshResidency addMesh: me cacheFile: bufferCachePath];
       [me release];
     }
   }
   if (multipleMeshPartitions) {
     [self saveDisplayMeshes: displayMeshes forMesh: mesh withAttributes: attr withMaterial: material];
-    for (DisplayMesh* me in displayMeshes)
-      [me deleteVBOData];
+    if (!keepForPreview) {
+      for (DisplayMesh* me in displayMeshes)
+        [me deleteVBOData];
+    }
   }
   [displayMeshes release];
 }
 
 - (void) addAnyMesh: (const ON_Mesh*) mesh withAttributes: (ON_3dmObjectAttributes&) attr
 {
-  [self meshPreparationProgress: [NSNumber numberWithFloat: -1.0]];
+  [self meshPreparationProgress: [self loadProgress]];
 
   ON_Material material;
   onMacModel->GetRenderMaterial ( attr, material );
@@ -436,45 +837,306 @@
 }
 
 
-// This potentially long-running process is run in a separate thread
-- (void) prepareMeshes
+#pragma mark Preview
+
+// Previews drawn without OpenGL rasterize the VBO data of the display meshes, which
+// is only kept for models that are small enough.  Returns NO once the meshes would
+// pass PreviewTriangleBudget, and the first time deletes the data kept so far.
+- (BOOL) keepsPreviewBuffers: (ON__INT64) triangleCount
+{
+  if (previewScene == NULL || previewSceneTooBig)
+    return NO;
+  if (previewScene->TriangleCount() + triangleCount <= PreviewTriangleBudget)
+    return YES;
+  
+  RH_TRACE_SCOPE( "deletePreviewBuffers" );
+  previewSceneTooBig = YES;
+  delete previewScene;      // before the data it points at
+  previewScene = NULL;
+  for (DisplayMesh* me in meshes)
+    [me deleteVBOData];
+  for (DisplayMesh* me in transmeshes)
+    [me deleteVBOData];
+  return NO;
+}
+
+- (UIImage*) previewImageInViewport: (const ON_Viewport&) viewport width: (int) width height: (int) height
+{
+  if (self.readingModel || previewScene == NULL)
+    return nil;
+  
+  CRhSoftwareRasterizer rasterizer;
+  if (!rasterizer.Render (*previewScene, viewport, width, height, ON_Color (0, 0, 0, 0)))
+    return nil;
+  
+  // the rows are top first, as UIImage wants them
+  NSData* data = [NSData dataWithBytes: rasterizer.Pixels() length: 4*width*height];
+  CGDataProviderRef provider = CGDataProviderCreateWithCFData ((CFDataRef) data);
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+  CGImageRef imageRef = CGImageCreate (width, height, 8, 32, 4*width, colorSpace, kCGBitmapByteOrderDefault|kCGImageAlphaLast, provider, NULL, true, kCGRenderingIntentDefault);
+  UIImage* image = [UIImage imageWithCGImage: imageRef];
+  CGImageRelease (imageRef);
+  CGColorSpaceRelease (colorSpace);
+  CGDataProviderRelease (provider);
+  return image;
+}
+
+
+#pragma mark Mesh Tree
+
+//
+// Once the model is read the boxes of its display meshes are packed into an R-tree,
+// so the renderers skip the meshes out of view a few nodes at a time instead of
+// testing every box every frame.
+//
+
+- (void) createMeshTree
+{
+  RH_TRACE_SCOPE( "createMeshTree" );
+  RhMeshTree* tree = new RhMeshTree;
+  tree->meshes = [[meshes arrayByAddingObjectsFromArray: transmeshes] retain];
+  tree->opaqueCount = (int) meshes.count;
+  
+  const int meshCount = (int) tree->meshes.count;
+  ON_SimpleArray<ON_RTreeLeaf> leaves (meshCount);
+  for (int i=0; i<meshCount; i++) {
+    ON_BoundingBox bbox = [[tree->meshes objectAtIndex: i] boundingBox];
+    if (!bbox.IsValid()) {
+      tree->unbounded.Append (i);
+      continue;
+    }
+    ON_RTreeLeaf& leaf = leaves.AppendNew();
+    for (int j=0; j<3; j++) {
+      leaf.m_rect.m_min[j] = bbox.m_min[j];
+      leaf.m_rect.m_max[j] = bbox.m_max[j];
+    }
+    leaf.m_id = i;
+  }
+  
+  if (!tree->tree.Create (leaves.Array(), leaves.Count(), true, [self jobPriority])) {
+    [tree->meshes release];
+    delete tree;
+    return;
+  }
+  
+  @synchronized (self) {
+    meshTree = tree;
+  }
+}
+
+- (void) deleteMeshTree
+{
+  RhMeshTree* tree = NULL;
+  @synchronized (self) {
+    tree = meshTree;
+    meshTree = NULL;
+  }
+  if (tree) {
+    [tree->meshes release];
+    delete tree;
+  }
+}
+
+- (NSArray*) meshesInFrustums: (const ON_ClippingRegion* const*) frustums count: (int) frustumCount indexes: (ON_SimpleArray<int>&) indexes opaqueCount: (int*) opaqueCount
+{
+  indexes.SetCount (0);
+  if (self.readingModel)
+    return nil;
+  
+  NSArray* treeMeshes = nil;
+  @synchronized (self) {
+    if (meshTree == NULL)
+      return nil;
+    meshTree->tree.Search (frustums, frustumCount, indexes);
+    indexes.Append (meshTree->unbounded.Count(), meshTree->unbounded.Array());
+    treeMeshes = [[meshTree->meshes retain] autorelease];
+    *opaqueCount = meshTree->opaqueCount;
+  }
+  
+  // keep the drawing order of the meshes
+  indexes.QuickSort (ON_CompareIncreasing<int>);
+  return treeMeshes;
+}
+
+
+#pragma mark Curves
+
+//
+// Curve objects are kept in the model's object table while the file is read.  Once
+// reading is done they are tessellated together, on all cores, and packed into one
+// vertex buffer per wireframe color.
+//
+
+- (void) createDisplayCurves
+{
+  RH_TRACE_SCOPE( "createDisplayCurves" );
+  ON_BoundingBox bbox = onMacModel->BoundingBox();
+  double chordTolerance = bbox.IsValid() ? 0.0005*bbox.Diagonal().Length() : 0.0;
+  CRhCurveTessellator tessellator (chordTolerance);
+  
+  ON_Material material;
+  const int objectCount = onMacModel->m_object_table.Count();
+  for (int i=0; i<objectCount; i++) {
+    const ON_Curve* curve = ON_Curve::Cast (onMacModel->m_object_table[i].m_object);
+    if (curve == NULL)
+      continue;
+    onMacModel->GetObjectMaterial (i, material);     // curves use an emissive wireframe material
+    tessellator.AddCurve (curve, material.Emission());
+  }
+  
+  if (![self shouldContinueLoading] || tessellator.Tessellate ([self jobPriority]) == 0)
+    return;
+  
+  for (int idx=0; idx<tessellator.BatchCount() && [self shouldContinueLoading]; idx++) {
+    DisplayCurves* dc = [[DisplayCurves alloc] initWithLines: tessellator.BatchLines(idx) color: tessellator.BatchColor(idx)];
+    if (dc) {
+      [curves addObject: dc];
+      [dc release];
+    }
+  }
+}
+
+// The curves are only kept in the object table until they are tessellated
+- (void) deleteCurveObjects
+{
+  RH_TRACE_SCOPE( "deleteCurveObjects" );
+  ON_ClassArray<EX_ONX_Model_Object>& table = onMacModel->m_object_table;
+  
+  // nothing but curves is kept, so this removes from the end of the table
+  for (int i = table.Count()-1; i >= 0; i--) {
+    if (ON_Curve::Cast (table[i].m_object))
+      table.Remove (i);
+  }
+  onMacModel->DestroyCache();   // the object id index refers to the removed rows
+}
+
+
+// This potentially long-running process is run in a separate thread.  The thread holds
+// its own reference to task.
+- (void) prepareMeshes: (NSValue*) taskValue
 {
   NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+  RhTraceSetThreadName( "read" );
+  CRhLoadTask* task = (CRhLoadTask*) [taskValue pointerValue];
+  
+  // background loads wait here while a foreground load runs
+  if (!task->Begin())
+    preparationCancelled = YES;
+  
+  if (uploadContext)
+    [EAGLContext setCurrentContext: uploadContext];
   self.readingModel = YES;
   [self.continueReadingLock lock];
   self.continueReading = 1;
   [self.continueReadingLock unlock];
   NSError* prepareMeshesError = nil;
   
-  if ([self isDownloaded]) {
+  if (preparationCancelled)
+    prepareMeshesError = [self meshError: NSLocalizedString(@"Initialization cancelled.", @"error message when reading 3DM file")];
+  else if ([self isDownloaded]) {
+    RH_TRACE_SCOPE( "prepareMeshes" );
+    
     // Use a helper class to read the 3DM file
     if (onMacModel == nil) {
       
+      [self deleteMeshTree];
       self.meshes = [NSMutableArray array];
       self.transmeshes = [NSMutableArray array];
+      self.curves = [NSMutableArray array];
+      self.pointClouds = [NSMutableArray array];
+      sharedMeshes = [[NSMutableDictionary alloc] init];
+      sharedMeshKeyBytes = 0;
+      pointCloudKeys = [[NSMutableDictionary alloc] init];
+      pointCloudTooBigBytes = 0;
+      delete previewScene;
+      previewScene = new CRhRasterScene;
+      previewSceneTooBig = NO;
+      [meshResidency release];
+      meshResidency = [[RhMeshResidency alloc] initWithBudget: [RhinoApp meshMemoryBudget]];
+      estimatedBytes = 0;
+      temporaryBytes = 0;
       renderMeshCount = 0;
       meshObjectCount = 0;
       brepCount = 0;
       brepWithMeshCount = 0;
+      curveCount = 0;
       
       // get the file size
       NSDictionary * attributes = [[NSFileManager defaultManager] attributesOfItemAtPath: [self modelPath] error:nil];
       NSNumber *theFileSize;
       if (theFileSize = [attributes objectForKey: NSFileSize])
         fileSize = [theFileSize intValue];
+      task->SetTotalBytes (fileSize);
       
       // show we have started reading the meshes
       [self meshPreparationProgress: [NSNumber numberWithFloat: -1.0]];
 
+      // Skip the chunk CRC checks only if the whole file still has the CRC of a verified
+      // read.  The cheap key only decides whether to hash the file first.
+      ON__UINT32 headerCRC = 0;
+      ON__UINT64 keyLength = 0;
+      ON__INT64 modifiedTime = 0;
+      ON__UINT32 fileCRC = 0;
+      ON__UINT64 fileLength = 0;
+      BOOL keyedFile = NO;
+      BOOL hashedFile = NO;
+      BOOL verifiedFile = NO;
+      if ([RhinoApp trustVerifiedModels]) {
+        keyedFile = RhFileQuickKey ([[self modelPath] UTF8String], VerifiedHeaderBytes, &headerCRC, &keyLength, &modifiedTime);
+        if (keyedFile && [self isVerifiedFileKey: headerCRC length: keyLength modified: modifiedTime]) {
+          hashedFile = RhFileCRC32 ([[self modelPath] UTF8String], &fileCRC, &fileLength);
+          verifiedFile = hashedFile && [self isVerifiedFile: fileCRC length: fileLength];
+        }
+      }
+      
       // The initWithFilename call will read the OpenNURBS file.  As each object is read,
       // the EX_ONX_Model::ShouldKeepObject() function in this source file is called to
       // inspect and perform any operations on the object.
       onMacModel = new EX_ONX_Model;
+      onMacModel->m_bSkipCRCCheck = verifiedFile;
+      onMacModel->m_load_task = task;
+      onMacModel->m_owner = self;
       ON_BOOL32 rc = onMacModel->initWithFilename ([[self modelPath] UTF8String]);
       
+      // Remember a clean read, unless the file changed while it was read
+      if (rc && keyedFile && !verifiedFile && onMacModel->m_crc_error_count == 0) {
+        if (!hashedFile)
+          hashedFile = RhFileCRC32 ([[self modelPath] UTF8String], &fileCRC, &fileLength);
+        ON__UINT32 readHeaderCRC = 0;
+        ON__UINT64 readLength = 0;
+        ON__INT64 readModifiedTime = 0;
+        if (hashedFile
+            && RhFileQuickKey ([[self modelPath] UTF8String], VerifiedHeaderBytes, &readHeaderCRC, &readLength, &readModifiedTime)
+            && readHeaderCRC == headerCRC && readLength == keyLength && readModifiedTime == modifiedTime)
+          [self saveVerifiedFile: fileCRC length: fileLength headerCRC: headerCRC modified: modifiedTime];
+      }
+      
+      // geometry keys are only needed while reading
+      [sharedMeshes release];
+      sharedMeshes = nil;
+      [pointCloudKeys release];
+      pointCloudKeys = nil;
+      
+      if (rc && curveCount > 0 && !preparationCancelled)
+        [self createDisplayCurves];
+      if (curveCount > 0)
+        [self deleteCurveObjects];
+      
+      onMacModel->m_load_task = NULL;
+      if (task->IsCancelled()) {
+        preparationCancelled = YES;     // cancelled through the task
+        rc = 0;
+      }
+      
+      if (pointCloudTooBigBytes > 0 && !preparationCancelled) {
+        NSString* message = [NSString stringWithFormat: NSLocalizedString(@"A point cloud in this model needs about %d MB of memory to prepare for display, which is more than this device can provide.  Save the model with fewer points and download again.", @"error message when reading 3DM file"), (int) (pointCloudTooBigBytes/(1024*1024))];
+        prepareMeshesError = [self meshError: message];
+        rc = 0;
+      }
+      
       if (rc) {
         // look for models that cannot be displayed
-        if ((meshes.count == 0) && (transmeshes.count == 0)) {
+        if ((meshes.count == 0) && (transmeshes.count == 0) && (curves.count == 0) && (pointClouds.count == 0)) {
           if (brepCount > 0 && brepWithMeshCount == 0)
             prepareMeshesError = [self meshError: NSLocalizedString(@"This model is only wireframes and cannot be displayed.  Save the model in shaded mode and download again.",@"error message when reading 3DM file")];
           else if (geometryCount > 0 && brepWithMeshCount == 0)
@@ -485,10 +1147,19 @@
           rc = 0;
         }
       }
+      
+      if (rc)
+        [self createMeshTree];
 
       if (!rc) {
         self.meshes = nil;
         self.transmeshes = nil;
+        self.curves = nil;
+        self.pointClouds = nil;
+        [meshResidency release];
+        meshResidency = nil;
+        delete previewScene;
+        previewScene = NULL;
         delete onMacModel;
         onMacModel = nil;
         if (preparationCancelled)
@@ -501,7 +1172,28 @@
       self.readSuccessfully = rc;
     }
   }
-  if (prepareMeshesError)
+  if (uploadContext) {
+    // the buffers are visible to the other contexts in the sharegroup once they are flushed
+    glFlush();
+    [EAGLContext setCurrentContext: nil];
+    [uploadContext release];
+    uploadContext = nil;
+  }
+  [RhinoApp writeTrace];
+  
+  BOOL restarting = NO;
+  @synchronized (self) {
+    if (prepareMeshesError)
+      task->Finish (preparationCancelled ? CRhLoadTask::cancelled : CRhLoadTask::failed);
+    else
+      task->Finish (CRhLoadTask::succeeded);
+    restarting = (nextLoadTask != NULL);
+  }
+  task->Release();
+  
+  if (restarting)
+    [self performSelectorOnMainThread: @selector(startNextLoadTask) withObject: nil waitUntilDone: NO];   // the delegate hears from the next task
+  else if (prepareMeshesError)
     [self meshPreparationDidFailWithError: prepareMeshesError];
   else
     [self meshPreparationDidSucceed];
@@ -512,6 +1204,12 @@
 - (void) cancelMeshInitialization
 {
   preparationCancelled = YES;
+  @synchronized (self) {
+    if (loadTask)
+      loadTask->Cancel();
+    if (nextLoadTask)
+      nextLoadTask->Cancel();
+  }
 }
 
 - (void) meshPreparationProgress: (NSNumber*) progress
@@ -541,27 +1239,92 @@
 
 - (void) prepareModelWithDelegate: (id) delegate
 {
-  preparationCancelled = NO;
-  preparationDelegate = delegate;
+  [self prepareModelWithDelegate: delegate inBackground: NO];
+}
+
+// Background preparation, e.g. of the next model in a review, only runs while no
+// foreground preparation is running.  becomeCurrentModel moves it to the foreground.
+- (CRhLoadTask*) prepareModelWithDelegate: (id) delegate inBackground: (BOOL) background
+{
+  @synchronized (self) {
+    CRhLoadTask* pending = nextLoadTask ? nextLoadTask : loadTask;
+    if (pending && !pending->IsFinished() && !pending->IsCancelled()) {
+      // already being prepared, e.g. by RhModelPrefetcher; take it over
+      preparationDelegate = delegate;
+      if (!background)
+        pending->SetPriority (CRhLoadTask::foreground_priority);
+      return pending;
+    }
+    
+    preparationDelegate = delegate;
+    CRhLoadTask* task = new CRhLoadTask (background ? CRhLoadTask::background_priority : CRhLoadTask::foreground_priority);
+    if (loadTask && !loadTask->IsFinished()) {
+      // cancelled, e.g. by RhModelPrefetcher, but its thread still reads the model;
+      // prepareMeshes: starts the new task when it finishes
+      if (nextLoadTask)
+        nextLoadTask->Release();
+      nextLoadTask = task;
+      return task;
+    }
+    if (loadTask)
+      loadTask->Release();
+    loadTask = task;
+  }
+  [self startLoadTask];
+  return loadTask;
+}
 
+// Called on the main thread when the cancelled task that nextLoadTask waited for finished
+- (void) startNextLoadTask
+{
+  @synchronized (self) {
+    if (loadTask)
+      loadTask->Release();
+    loadTask = nextLoadTask;
+    nextLoadTask = NULL;
+  }
+  [self startLoadTask];
+}
+
+- (void) startLoadTask
+{
+  preparationCancelled = NO;
+  initializationFailed = NO;
   self.downloaded = YES;
   
+  // Creating each mesh's OpenGL buffers on the main thread costs the reading thread a
+  // wait for the main run loop per mesh.  Instead the reading thread gets its own context
+  // in the renderer's sharegroup and creates them itself.
+  [uploadContext release];
+  uploadContext = nil;
+  EAGLContext* mainContext = [EAGLContext currentContext];
+  if (mainContext)
+    uploadContext = [[EAGLContext alloc] initWithAPI: mainContext.API sharegroup: mainContext.sharegroup];
+  
   // Start mesh initialization in a second thread.  We need the UI to stay alive so we can
   // cancel the mesh preparation and so we can receive low memory warnings.
-  [NSThread detachNewThreadSelector: @selector(prepareMeshes) toTarget: self withObject: nil];
+  loadTask->AddRef();     // released by the thread
+  [NSThread detachNewThreadSelector: @selector(prepareMeshes:) toTarget: self withObject: [NSValue valueWithPointer: loadTask]];
+}
+
+- (CRhLoadTask*) loadTask
+{
+  @synchronized (self) {
+    return nextLoadTask ? nextLoadTask : loadTask;
+  }
 }
 
 - (void) cancelModelPreparation
 {
   // The preparation commands will check this variable and return a NSError
-  preparationCancelled = YES;
+  [self cancelMeshInitialization];
 }
 
 
 - (void) cancelModelPreparationSilently
 {
   // The preparation commands will check this variable and return a NSError
-  preparationCancelled = YES;
+  [self cancelMeshInitialization];
 }
 
 
@@ -570,6 +1333,12 @@
 // we are becoming the current model
 - (BOOL) becomeCurrentModel
 {
+  @synchronized (self) {
+    if (loadTask)
+      loadTask->SetPriority (CRhLoadTask::foreground_priority);
+    if (nextLoadTask)
+      nextLoadTask->SetPriority (CRhLoadTask::foreground_priority);
+  }
   return [self isDownloaded];
 }
 
@@ -583,6 +1352,13 @@
 @end
 
 
+// The RhModel the objects of model are read for
+static RhModel* OwningModel (const EX_ONX_Model* model)
+{
+  return model->m_owner ? (RhModel*) model->m_owner : RhinoApp.currentModel;
+}
+
+
 // This function is called right after reading the 3DM properties.  We construct a
 // modelID string from the ON_3dmRevisionHistory and ON_3dmApplication objects with
 // the hope that this will uniquely identify the file contents.  If the user changes
@@ -602,7 +1378,7 @@ void EX_ONX_Model::InspectProperties (ON_3dmProperties& properties)
   if (appID == nil)
     appID = @"Name: Unknown\n";
   
-  RhModel* currentModel = RhinoApp.currentModel;
+  RhModel* currentModel = OwningModel (this);
   [currentModel setModelID: [revisionID stringByAppendingString: appID]];
 }
 
@@ -610,101 +1386,99 @@ void EX_ONX_Model::InspectProperties (ON_3dmProperties& properties)
 //
 // We create a DisplayMesh object for each render mesh object we find.  If we encounter an ON_Mesh object,
 // we create a DisplayMesh object from the ON_Mesh. For any ON_Brep objects, we create Displaymesh objects
-// from the render mesh.  To conserve memory, we always return 0 which tells the object reading code
-// to discard the object it has just read.
+// from the render mesh.  To conserve memory, we return 0 which tells the object reading code to discard
+// the object it has just read.  Curves are kept and tessellated after the whole file has been read.
 //
 // This function returns +1 to keep object; 0 to discard object; -1 to stop reading file
 //
-int EX_ONX_Model::ShouldKeepObject (ON_Object* pObject, ON_3dmObjectAttributes& attr)
+int EX_ONX_Model::ShouldReadObjectTable (const CRhLoadEstimate& estimate)
+{
+  RhModel* currentModel = OwningModel (this);
+  return [currentModel shouldReadObjectsWithEstimate: estimate] ? 1 : -1;
+}
+
+//
+// RhModel's side of EX_ONX_Model::KeepObject(), which decides what is kept and what is
+// turned into display data.  The load benchmark receives the same objects.
+//
+class CRhModelObjectReceiver : public CRhObjectReceiver
 {
-  RhModel* currentModel = RhinoApp.currentModel;
-  [currentModel.continueReadingLock lock];
-  int shouldContinue = currentModel.continueReading;
-  [currentModel.continueReadingLock unlock];
+public:
+  CRhModelObjectReceiver (RhModel* model) : m_model (model) {}
   
-  if (shouldContinue == 0) {
-    DLog (@"saw outOfMemoryWarning, quitting ShouldKeepObject");
-    return -1;
+  bool ShouldContinue()
+  {
+    [m_model.continueReadingLock lock];
+    int shouldContinue = m_model.continueReading;
+    [m_model.continueReadingLock unlock];
+    
+    if (shouldContinue == 0) {
+      DLog (@"saw outOfMemoryWarning, quitting ShouldKeepObject");
+      return false;
+    }
+    if ([m_model pointCloudTooBigBytes] > 0)
+      return false;       // the read fails, see addCachedPointCloud:
+    return ![m_model preparationCancelled];
   }
   
-  if ([currentModel preparationCancelled])
-    return -1;
-  
-  // ensure the object is visible
-  if (!attr.IsVisible())
-    return 0;
-  
-  // ensure the object's layer is visible
-  int layerIndex = attr.m_layer_index;
-  if (layerIndex >= 0 && layerIndex < m_layer_table.Count()) {
-    ON_Layer& layer =  m_layer_table[layerIndex];
-    if (!layer.IsVisible())
-      return 0;
+  void AddGeometry (const ON_Geometry&)
+  {
+    m_model.geometryCount++;
   }
   
-  // calculate bounding box as we read objects
-  const ON_Geometry* geo = ON_Geometry::Cast(pObject);
-  if ( geo ) {
-    currentModel.geometryCount++;
-    m__object_table_bbox.Union(geo->BoundingBox());
+  void AddMesh (ON_Mesh* mesh, ON_3dmObjectAttributes& attr)
+  {
+    [m_model addMeshObject: mesh withAttributes: attr];
+    [m_model holdingTemporaryBytes: mesh->SizeOf()];
   }
   
-  if (pObject->ObjectType() == ON::mesh_object) {
-    ON_Mesh* mesh = (ON_Mesh*) pObject;
-    if ( 0 == mesh->HiddenVertexCount() )
-      mesh->DestroyHiddenVertexArray();
-    
-    if ( !mesh->HasVertexNormals() && mesh->m_V.Count() > 0 && mesh->m_F.Count() > 0) {
-      // 26 September 2003 Dale Lear - 
-      //   Some 3dm files have meshes with no normals and this messes up the shading code.
-      mesh->ComputeVertexNormals();
-    }
+  void AddBrep (const ON_Brep* brep, const ON_Mesh* renderMesh, int renderMeshCount, ON_3dmObjectAttributes& attr)
+  {
+    m_model.brepCount++;
+    if (renderMeshCount > 0)
+      m_model.brepWithMeshCount++;
+    if (renderMesh)
+      [m_model addRenderMesh: renderMesh withAttributes: attr];
     
-    [currentModel addMeshObject: mesh withAttributes: attr];
-    return 0;       // do not keep ON::mesh_object
-  }
-  else if (pObject->ObjectType() == ON::brep_object) {
-    currentModel.brepCount++;
-    ON_Brep* pBrep = (ON_Brep*) pObject;
-    ON_SimpleArray< const ON_Mesh* > meshes;
-    int count = pBrep->GetMesh( ON::render_mesh, meshes );
-    if (count > 0)
-      currentModel.brepWithMeshCount++;
-    
-    if ( count == 1 )
-    {
-      if ( meshes[0] && meshes[0]->VertexCount() )
-        [currentModel addRenderMesh: meshes[0] withAttributes: attr];
-    }
-    else
-    {
-      ON_Mesh  m;
-      
-      // Sometimes it's possible to have lists of NULL ON_Meshes...Rhino
-      // can put them there as placeholders for badly formed/meshed breps.
-      // Therefore, we need to always make sure we're actually looking at
-      // a mesh that contains something and/or is not NULL.
-      for (int i = 0; i < count; i++)
-      {
-        // If we have a valid pointer, append the mesh to our accumulator mesh...
-        if ( meshes[i] )
-          m.Append( *meshes[i] );
-      }
-      
-      // See if the end result actually contains anything and add it to
-      // our model if it does...
-      if ( m.VertexCount() > 0 )
-        [currentModel addRenderMesh: &m withAttributes: attr];
-    }
-
-    return 0;       // do not keep ON::brep_object
+    // with more than one render mesh, renderMesh is a combined copy
+    size_t bytes = brep->SizeOf();
+    if (renderMesh && renderMeshCount > 1)
+      bytes += renderMesh->SizeOf();
+    [m_model holdingTemporaryBytes: bytes];
   }
-  else if (pObject->ObjectType() == ON::extrusion_object) {
-    // extrusion objects do not have a mesh
-    return 0;       // do not keep ON::extrusion_object
+  
+  void AddCurve (const ON_Curve*, ON_3dmObjectAttributes&)
+  {
+    m_model.curveCount++;     // tessellated by createDisplayCurves
+  }
+  
+  void AddPointCloud (ON_PointCloud* cloud, ON_3dmObjectAttributes& attr)
+  {
+    [m_model addPointCloud: cloud withAttributes: attr];
   }
-  else {
-    return 0;       // do not keep anything else
+  
+  bool AddCachedPointCloud (const ON_3dmObjectAttributes& attr, ON__UINT64 record_key, ON__UINT64 record_bytes, ON_BoundingBox& bbox)
+  {
+    if (![m_model addCachedPointCloud: attr recordKey: record_key recordBytes: record_bytes boundingBox: bbox])
+      return false;
+    m_model.geometryCount++;
+    return true;
   }
+  
+private:
+  RhModel* m_model;
+};
+
+int EX_ONX_Model::ShouldKeepObject (ON_Object* pObject, ON_3dmObjectAttributes& attr)
+{
+  CRhModelObjectReceiver receiver (OwningModel (this));
+  return KeepObject (pObject, attr, receiver);
+}
+
+bool EX_ONX_Model::ShouldSkipObject (ON::object_type type, const ON_3dmObjectAttributes& attr, ON__UINT64 record_key, ON__UINT64 record_bytes)
+{
+  RH_TRACE_SCOPE_ARG( "ShouldSkipObject", type );
+  CRhModelObjectReceiver receiver (OwningModel (this));
+  return SkipObject (type, attr, record_key, record_bytes, receiver);
 }
 
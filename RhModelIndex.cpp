@@ -0,0 +1,112 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <wctype.h>
+
+#include "RhModelIndex.h"
+
+// FNV-1a
+static const ON__UINT32 HashBasis = 2166136261U;
+static const ON__UINT32 HashPrime = 16777619U;
+
+static inline ON__UINT32 HashByte( ON__UINT32 hash, unsigned char b )
+{
+  return (hash ^ b) * HashPrime;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhTableIndex::CRhTableIndex()
+: m_used_count(0)
+, m_indexed_count(0)
+{
+}
+
+void CRhTableIndex::Empty()
+{
+  m_slots.Destroy();
+  m_used_count = 0;
+  m_indexed_count = 0;
+}
+
+int CRhTableIndex::IndexedCount() const
+{
+  return m_indexed_count;
+}
+
+void CRhTableIndex::SetIndexedCount( int count )
+{
+  m_indexed_count = count;
+}
+
+void CRhTableIndex::Add( ON__UINT32 hash, int table_index )
+{
+  // keep the table at most half full so probe runs stay short
+  if ( 2*(m_used_count+1) > m_slots.Count() )
+    Grow();
+
+  const unsigned int mask = m_slots.Count() - 1;
+  unsigned int i = hash & mask;
+  while ( m_slots[i].m_index >= 0 )
+    i = (i+1) & mask;
+  m_slots[i].m_hash = hash;
+  m_slots[i].m_index = table_index;
+  m_used_count++;
+}
+
+void CRhTableIndex::Grow()
+{
+  ON_SimpleArray<Slot> old_slots;
+  old_slots.Append( m_slots.Count(), m_slots.Array() );
+
+  int slot_count = m_slots.Count() > 0 ? 2*m_slots.Count() : 64;
+  m_slots.SetCapacity( slot_count );
+  m_slots.SetCount( slot_count );
+  for ( int i = 0; i < slot_count; i++ )
+    m_slots[i].m_index = -1;
+  m_used_count = 0;
+
+  for ( int i = 0; i < old_slots.Count(); i++ ) {
+    if ( old_slots[i].m_index >= 0 )
+      Add( old_slots[i].m_hash, old_slots[i].m_index );
+  }
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+ON__UINT32 RhHashName( const wchar_t* name )
+{
+  ON__UINT32 hash = HashBasis;
+  if ( name ) {
+    for ( ; *name; name++ ) {
+      ON__UINT32 c = (ON__UINT32) towlower( *name );
+      hash = HashByte( hash, (unsigned char)(c & 0xFF) );
+      hash = HashByte( hash, (unsigned char)((c >> 8) & 0xFF) );
+      hash = HashByte( hash, (unsigned char)((c >> 16) & 0xFF) );
+    }
+  }
+  return hash;
+}
+
+ON__UINT32 RhHashUuid( const ON_UUID& id )
+{
+  const unsigned char* b = (const unsigned char*) &id;
+  ON__UINT32 hash = HashBasis;
+  for ( size_t i = 0; i < sizeof(id); i++ )
+    hash = HashByte( hash, b[i] );
+  return hash;
+}
@@ -0,0 +1,86 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_MODEL_INDEX_INC_)
+#define RH_MODEL_INDEX_INC_
+
+/*
+Description:
+  Hash table from a key hash to an index in one of the EX_ONX_Model
+  tables.  Only hashes are stored, so the caller checks the candidates
+  against the table itself and entries left behind by a rename simply
+  fail that check.
+
+  The tables are only appended to while a model is read or imported,
+  so the caller adds entries for the table rows past IndexedCount()
+  before each lookup.  A table that got shorter has to be indexed again
+  from scratch.
+*/
+class CRhTableIndex
+{
+public:
+  CRhTableIndex();
+
+  void Empty();
+
+  // Table rows [0,IndexedCount()) have been added
+  int IndexedCount() const;
+  void SetIndexedCount( int count );
+
+  void Add( ON__UINT32 hash, int table_index );
+
+  /*
+  Description:
+    Finds the smallest table index with this hash that match accepts.
+  Parameters:
+    match - [in] bool match( int table_index )
+  Returns:
+    Table index or -1.
+  */
+  template <class MATCH>
+  int Find( ON__UINT32 hash, const MATCH& match ) const
+  {
+    int found = -1;
+    if ( m_slots.Count() == 0 )
+      return found;
+    const unsigned int mask = m_slots.Count() - 1;
+    for ( unsigned int i = hash & mask; m_slots[i].m_index >= 0; i = (i+1) & mask ) {
+      const Slot& slot = m_slots[i];
+      if ( slot.m_hash == hash && (found < 0 || slot.m_index < found) && match( slot.m_index ) )
+        found = slot.m_index;
+    }
+    return found;
+  }
+
+private:
+  struct Slot
+  {
+    ON__UINT32 m_hash;
+    int m_index;      // -1 for an empty slot
+  };
+
+  void Grow();
+
+  ON_SimpleArray<Slot> m_slots;     // open addressing, power of two count
+  int m_used_count;
+  int m_indexed_count;
+};
+
+// Hash of a name that ignores case the way on_wcsicmp() does
+ON__UINT32 RhHashName( const wchar_t* name );
+
+ON__UINT32 RhHashUuid( const ON_UUID& id );
+
+#endif
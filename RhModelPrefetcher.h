@@ -0,0 +1,53 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+//
+// This class prepares the models that follow the current one in the model list while the
+// current model is being viewed, so opening the next model in a review is nearly instant.
+//
+// Models are prepared one at a time as background loads (see CRhLoadTask), which step
+// aside whenever a model is prepared in the foreground.  Preparing a model writes its
+// display caches and verified file record.  A prepared model stays in memory while the
+// prepared models fit in the prefetch budget; otherwise it is cleaned up and only its
+// caches are kept.  Opening a model that is still being prepared moves its load to the
+// foreground instead of starting over.
+//
+
+@class RhModel;
+
+
+@interface RhModelPrefetcher : NSObject {
+
+  long long budget;               // bytes the prepared models may hold
+  int modelCount;                 // how many models after the current one to prepare
+  NSMutableArray* queuedModels;   // models waiting to be prepared, in list order
+  NSMutableArray* preparedModels; // models kept prepared in memory
+  RhModel* preparingModel;        // model being prepared now
+}
+
+@property (readonly) long long budget;
+
+- (id) initWithBudget: (long long) bytes modelCount: (int) count;
+
+// Cancels any earlier prefetch and prepares the modelCount models after model in models
+- (void) prefetchModelsAfter: (RhModel*) model inModels: (NSArray*) models;
+
+// Stops preparing and forgets the queued models.  Prepared models are kept.
+- (void) cancel;
+
+// Cancels, then cleans up the prepared models that are not current
+- (void) didReceiveMemoryWarning;
+
+@end
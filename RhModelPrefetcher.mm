@@ -0,0 +1,160 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#import "RhModelPrefetcher.h"
+#import "RhModel.h"
+#include "RhMemoryUsage.h"
+#include "RhLoadTask.h"
+
+
+@interface RhModelPrefetcher ()
+- (void) prepareNextModel;
+- (ON__UINT64) preparedBytes;
+@end
+
+
+@implementation RhModelPrefetcher
+
+@synthesize budget;
+
+- (id) initWithBudget: (long long) bytes modelCount: (int) count
+{
+  self = [super init];
+  if (self) {
+    budget = bytes;
+    modelCount = count;
+    queuedModels = [[NSMutableArray alloc] init];
+    preparedModels = [[NSMutableArray alloc] init];
+  }
+  return self;
+}
+
+- (void) dealloc
+{
+  [self cancel];
+  [queuedModels release];
+  [preparedModels release];
+  [super dealloc];
+}
+
+
+#pragma mark Prefetching
+
+- (void) prefetchModelsAfter: (RhModel*) model inModels: (NSArray*) models
+{
+  [self cancel];
+  if (budget <= 0 || modelCount <= 0)
+    return;
+  
+  NSUInteger index = [models indexOfObject: model];
+  if (index == NSNotFound)
+    return;
+  for (NSUInteger idx = index+1; idx < models.count && queuedModels.count < (NSUInteger) modelCount; idx++) {
+    RhModel* next = [models objectAtIndex: idx];
+    if ([next isDownloaded] && ![preparedModels containsObject: next])
+      [queuedModels addObject: next];
+  }
+  
+  // models that are not coming up any more give their memory back
+  for (NSInteger idx = preparedModels.count-1; idx >= 0; idx--) {
+    RhModel* prepared = [preparedModels objectAtIndex: idx];
+    NSUInteger preparedIndex = [models indexOfObject: prepared];
+    if (preparedIndex == NSNotFound || preparedIndex <= index || preparedIndex > index + modelCount) {
+      if (prepared != model)
+        [prepared cleanUp];
+      [preparedModels removeObjectAtIndex: idx];
+    }
+  }
+  
+  [self prepareNextModel];
+}
+
+- (void) prepareNextModel
+{
+  if (preparingModel || queuedModels.count == 0)
+    return;
+  preparingModel = [[queuedModels objectAtIndex: 0] retain];
+  [queuedModels removeObjectAtIndex: 0];
+  DLog (@"prefetching %@", preparingModel.title);
+  [preparingModel prepareModelWithDelegate: self inBackground: YES];
+}
+
+- (ON__UINT64) preparedBytes
+{
+  ON__UINT64 bytes = 0;
+  for (RhModel* model in preparedModels) {
+    CRhMemoryUsage usage;
+    [model getMemoryUsage: usage];
+    bytes += usage.Total();
+  }
+  return bytes;
+}
+
+- (void) cancel
+{
+  [queuedModels removeAllObjects];
+  if (preparingModel) {
+    // a model that was opened meanwhile now belongs to its view
+    CRhLoadTask* task = [preparingModel loadTask];
+    if (task && task->Priority() == CRhLoadTask::background_priority)
+      [preparingModel cancelModelPreparation];
+    [preparingModel release];
+    preparingModel = nil;
+  }
+}
+
+- (void) didReceiveMemoryWarning
+{
+  [self cancel];
+  for (RhModel* model in preparedModels) {
+    if (model != RhinoApp.currentModel)
+      [model cleanUp];
+  }
+  [preparedModels removeAllObjects];
+}
+
+
+#pragma mark RhModel preparation delegate methods
+
+- (void) preparationDidSucceed
+{
+  if (preparingModel == nil)
+    return;
+  
+  RhModel* model = preparingModel;
+  preparingModel = nil;
+  CRhMemoryUsage usage;
+  [model getMemoryUsage: usage];
+  if ([self preparedBytes] + usage.Total() <= (ON__UINT64) budget)
+    [preparedModels addObject: model];
+  else if (model != RhinoApp.currentModel)
+    [model cleanUp];      // too big to keep, but its caches are written
+  [model release];
+  
+  [self prepareNextModel];
+}
+
+- (void) preparationDidFailWithError: (NSError*) error
+{
+  if (preparingModel == nil)
+    return;
+  if (preparingModel != RhinoApp.currentModel)
+    [preparingModel cleanUp];
+  [preparingModel release];
+  preparingModel = nil;
+  [self prepareNextModel];
+}
+
+@end
@@ -897,7 +897,13 @@ static ON_3dVector Slerp( const ON_3dVector& v0, const ON_3dVector& v1, double n
 // capture a screen shot of the current model at full screen resolution and current orientation with a transparent background
 - (UIImage*) previewImage
 {
-  return [renderer renderPreview: rhinoModel inViewport: m_view.m_vp];
+  // drawn on this thread without waiting for the render thread when the display meshes kept their VBO data
+  CGSize size = [self bounds].size;
+  const CGFloat scale = self.contentScaleFactor;
+  UIImage* image = [rhinoModel previewImageInViewport: m_view.m_vp width: (int)(size.width*scale) height: (int)(size.height*scale)];
+  if (image == nil)
+    image = [renderer renderPreview: rhinoModel inViewport: m_view.m_vp];
+  return image;
 }
 
 - (void)displayLayer: (CALayer*) layer
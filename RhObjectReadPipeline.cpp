@@ -0,0 +1,445 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhObjectReadPipeline.h"
+#include "RhTrace.h"
+
+// Limit on how far the reading thread may run ahead of the caller,
+// along with CRhObjectReadPipeline::max_queued_bytes.  A single record
+// larger than the byte limit is still queued when nothing else is pending.
+static const int    MaxQueuedRecordsPerWorker = 4;
+
+// Records with a bogus length are left to the archive, which reports
+// them the same way it always has.
+static const ON__INT64 MaxRecordLength = 0x7FFFFFFF;
+
+// Skipped records are not copied, so they can be as long as the archive can seek.
+// A point cloud too big to queue can still be skipped instead of decoded.
+static const ON__UINT64 MaxSkippedRecordLength = ((size_t)-1) >> 1;
+
+
+//////////////////////////////////////////////////////////////
+//
+// One object table record copied out of the archive.  The buffer holds
+// a complete, single record object table so a worker can read it with
+// the normal BeginRead3dmObjectTable()/Read3dmObject() calls.
+//
+class CRhObjectRecord
+{
+public:
+  CRhObjectRecord()
+    : m_buffer(0), m_sizeof_buffer(0),
+      m_rc(-1), m_bad_crc_count(0), m_object(0),
+      m_bDecoded(false), m_next(0)
+  {
+  }
+
+  ~CRhObjectRecord()
+  {
+    onfree(m_buffer);
+    delete m_object;
+  }
+
+  unsigned char* m_buffer;
+  size_t m_sizeof_buffer;
+
+  // results filled in by a worker
+  int m_rc;
+  int m_bad_crc_count;
+  ON_Object* m_object;
+  ON_3dmObjectAttributes m_attributes;
+  bool m_bDecoded;
+
+  CRhObjectRecord* m_next;
+};
+
+
+// 3dm archives are little endian on disk
+static unsigned char* WriteLittleEndian( unsigned char* p, ON__UINT64 value, size_t sizeof_value )
+{
+  for ( size_t i = 0; i < sizeof_value; i++ ) {
+    *p++ = (unsigned char)(value & 0xFF);
+    value >>= 8;
+  }
+  return p;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhObjectReadPipeline::CRhObjectReadPipeline(
+                         ON_BinaryArchive& archive,
+                         int archive_3dm_version,
+                         int archive_opennurbs_version,
+                         bool bEnableCRC,
+                         CRhJobSystem::priority job_priority
+                         )
+  : m_archive(archive),
+    m_3dm_version(archive_3dm_version),
+    m_3dm_opennurbs_version(archive_opennurbs_version),
+    m_bEnableCRC(bEnableCRC),
+    m_worker_count(0),
+    m_decode_jobs(job_priority),
+    m_head(0), m_tail(0), m_decode(0),
+    m_queued_count(0), m_queued_bytes(0),
+    m_skip_object_types(0), m_skip_filter(0), m_skip_context(0),
+    m_bHold(false),
+    m_read_failure(0)
+{
+  pthread_mutex_init( &m_lock, NULL );
+  pthread_cond_init( &m_record_decoded, NULL );
+
+  // Version 1 archives do not store objects in self contained records.
+  if ( m_3dm_version < 2 )
+    return;
+
+  // The job system leaves one core for the reading thread, which also
+  // builds the display meshes.  With no workers there is nothing to
+  // overlap with, so read serially.
+  m_worker_count = CRhJobSystem::Shared().WorkerCount();
+}
+
+CRhObjectReadPipeline::~CRhObjectReadPipeline()
+{
+  // records no job has claimed yet are deleted undecoded below
+  m_decode_jobs.Cancel();
+  m_decode_jobs.Wait();
+
+  while ( m_head ) {
+    CRhObjectRecord* record = m_head;
+    m_head = record->m_next;
+    delete record;
+  }
+
+  pthread_cond_destroy( &m_record_decoded );
+  pthread_mutex_destroy( &m_lock );
+}
+
+int CRhObjectReadPipeline::WorkerCount() const
+{
+  return m_worker_count;
+}
+
+void CRhObjectReadPipeline::SetSkipFilter( unsigned int object_types, SKIP_FILTER filter, void* context )
+{
+  m_skip_object_types = object_types;
+  m_skip_filter = filter;
+  m_skip_context = context;
+}
+
+//////////////////////////////////////////////////////////////
+//
+bool CRhObjectReadPipeline::CanQueueRecord() const
+{
+  // caller holds m_lock
+  if ( m_worker_count == 0 || m_bHold || m_read_failure )
+    return false;
+  if ( m_queued_count == 0 )
+    return true;
+  return m_queued_count < MaxQueuedRecordsPerWorker*m_worker_count && m_queued_bytes < max_queued_bytes;
+}
+
+//////////////////////////////////////////////////////////////
+//
+// If the next record holds an object of a filtered type, read only its
+// attributes and ask the filter if the object is needed.  Returns true
+// with the archive past the record when it is not.  Otherwise the
+// archive is put back at the record header, or m_read_failure is set if
+// that is not possible.
+//
+bool CRhObjectReadPipeline::SkipNextRecord( ON_3dmObjectAttributes& attributes )
+{
+  if ( m_skip_filter == NULL || m_3dm_version < 2 )
+    return false;
+
+  ON__UINT32 tcode = 0;
+  ON__INT64 record_length = 0;
+  if (   !m_archive.PeekAt3dmBigChunkType( &tcode, &record_length )
+      || tcode != TCODE_OBJECT_RECORD
+      || record_length <= 0
+      || (ON__UINT64)record_length > MaxSkippedRecordLength )
+  {
+    return false;
+  }
+
+  // An object record is
+  //   TCODE_OBJECT_RECORD, length
+  //     TCODE_OBJECT_RECORD_TYPE, object type (a short chunk, no data)
+  //     TCODE_OPENNURBS_CLASS, length, the object
+  //     TCODE_OBJECT_RECORD_ATTRIBUTES, length, the attributes
+  //     ...
+  const size_t record_start = m_archive.CurrentPosition();
+  const ON__INT64 sizeof_header = 4 + m_archive.SizeofChunkLength();
+  ON__INT64 object_type = 0;
+  ON__INT64 length = 0;
+  bool bSkip =    m_archive.BigSeekFromCurrentPosition( sizeof_header )
+               && m_archive.PeekAt3dmBigChunkType( &tcode, &object_type )
+               && tcode == TCODE_OBJECT_RECORD_TYPE
+               && 0 != (object_type & m_skip_object_types)
+               && m_archive.BigSeekFromCurrentPosition( sizeof_header )
+               && m_archive.PeekAt3dmBigChunkType( &tcode, &length )
+               && tcode == TCODE_OPENNURBS_CLASS
+               && length > 0
+               && m_archive.BigSeekFromCurrentPosition( sizeof_header + length );
+  if ( bSkip ) {
+    bSkip =    m_archive.BeginRead3dmBigChunk( &tcode, &length )
+            && tcode == TCODE_OBJECT_RECORD_ATTRIBUTES;
+    if ( bSkip ) {
+      bSkip = attributes.Read( m_archive ) ? true : false;
+      if ( !m_archive.EndRead3dmChunk() )
+        bSkip = false;
+    }
+  }
+  // TCODE_OBJECT_RECORD has TCODE_CRC set, so its last 4 bytes are the CRC of the rest
+  unsigned int record_crc = 0;
+  if ( bSkip ) {
+    bSkip =    record_length >= 4
+            && m_archive.BigSeekFromStart( record_start + (size_t)(sizeof_header + record_length - 4) )
+            && m_archive.ReadInt( &record_crc );
+  }
+  if ( bSkip ) {
+    const ON__UINT64 record_key = ((ON__UINT64)record_crc << 32) | (ON__UINT32)record_length;
+    bSkip = m_skip_filter( m_skip_context, ON::ObjectType( (int)object_type ), attributes, record_key,
+                           (ON__UINT64)(sizeof_header + record_length) );
+  }
+
+  const size_t next = bSkip ? record_start + (size_t)(sizeof_header + record_length) : record_start;
+  if ( !m_archive.BigSeekFromStart( next ) )
+    m_read_failure = 1;
+  return bSkip;
+}
+
+//////////////////////////////////////////////////////////////
+//
+// Copy the next object record out of the archive and hand it to the
+// workers.  Returns false and sets m_bHold if the next chunk is not an
+// object record.
+//
+bool CRhObjectReadPipeline::QueueNextRecord()
+{
+  ON__UINT32 tcode = 0;
+  ON__INT64 big_value = 0;
+  if (   !m_archive.PeekAt3dmBigChunkType( &tcode, &big_value )
+      || tcode != TCODE_OBJECT_RECORD
+      || big_value <= 0
+      || big_value > MaxRecordLength )
+  {
+    m_bHold = true;
+    return false;
+  }
+
+  // chunk header = 4 byte typecode + 4 or 8 byte length
+  const size_t sizeof_length = m_archive.SizeofChunkLength();
+  const size_t sizeof_header = 4 + sizeof_length;
+  const size_t sizeof_record = sizeof_header + (size_t)big_value;
+
+  // Wrap the record in an object table:
+  //   TCODE_OBJECT_TABLE, length
+  //     TCODE_OBJECT_RECORD ... (copied from the archive)
+  //     TCODE_ENDOFTABLE, 0
+  const size_t sizeof_table = sizeof_record + sizeof_header;
+  CRhObjectRecord* record = new CRhObjectRecord;
+  if ( SkipNextRecord( record->m_attributes ) ) {
+    // nothing to decode; the record is handed back in file order like the others
+    record->m_rc = 2;
+  }
+  else if ( m_read_failure ) {
+    delete record;
+    return false;
+  }
+  else {
+    record->m_sizeof_buffer = sizeof_header + sizeof_table;
+    record->m_buffer = (unsigned char*)onmalloc( record->m_sizeof_buffer );
+    if ( record->m_buffer == NULL ) {
+      delete record;
+      m_bHold = true;
+      return false;
+    }
+
+    unsigned char* p = record->m_buffer;
+    p = WriteLittleEndian( p, TCODE_OBJECT_TABLE, 4 );
+    p = WriteLittleEndian( p, sizeof_table, sizeof_length );
+    const size_t record_start = m_archive.CurrentPosition();
+    if ( !m_archive.ReadByte( sizeof_record, p ) ) {
+      // The archive is truncated.  A failed read leaves the archive
+      // somewhere inside the record, so put it back at the record header
+      // and let the archive report the failure.  If that is not possible
+      // the rest of the table cannot be read at all.
+      delete record;
+      m_bHold = true;
+      if ( !m_archive.BigSeekFromStart( record_start ) )
+        m_read_failure = 1;
+      return false;
+    }
+    p += sizeof_record;
+    p = WriteLittleEndian( p, TCODE_ENDOFTABLE, 4 );
+    p = WriteLittleEndian( p, 0, sizeof_length );
+  }
+
+  pthread_mutex_lock( &m_lock );
+  if ( m_tail )
+    m_tail->m_next = record;
+  else
+    m_head = record;
+  m_tail = record;
+  if ( m_decode == NULL )
+    m_decode = record;
+  m_queued_count++;
+  m_queued_bytes += record->m_sizeof_buffer;
+  pthread_mutex_unlock( &m_lock );
+
+  m_decode_jobs.Run( DecodeJob, this );
+
+  return true;
+}
+
+//////////////////////////////////////////////////////////////
+//
+void CRhObjectReadPipeline::Decode( CRhObjectRecord* record ) const
+{
+  if ( record->m_buffer == NULL )
+    return;     // skipped, see SkipNextRecord()
+
+  RH_TRACE_SCOPE_ARG( "decode object", (int)record->m_sizeof_buffer );
+  ON_Read3dmBufferArchive archive( record->m_sizeof_buffer, record->m_buffer, false, m_3dm_version, m_3dm_opennurbs_version );
+  if ( !m_bEnableCRC )
+    archive.EnableCRCCalculation( false );
+
+  if ( archive.BeginRead3dmObjectTable() )
+  {
+    record->m_rc = archive.Read3dmObject( &record->m_object, &record->m_attributes, 0 );
+    if ( record->m_rc != 0 ) {
+      // consume the end of table marker
+      ON_Object* pExtra = NULL;
+      ON_3dmObjectAttributes extra_attributes;
+      if ( 0 != archive.Read3dmObject( &pExtra, &extra_attributes, 0 ) )
+        delete pExtra;
+    }
+    archive.EndRead3dmObjectTable();
+  }
+  record->m_bad_crc_count = archive.BadCRCCount();
+
+  // the raw bytes are no longer needed
+  onfree( record->m_buffer );
+  record->m_buffer = NULL;
+}
+
+//////////////////////////////////////////////////////////////
+//
+// Every queued record gets one job, which decodes the oldest record no
+// one has claimed.  The reading thread may have claimed it already, in
+// which case the job has nothing to do.
+void CRhObjectReadPipeline::DecodeNextRecord()
+{
+  pthread_mutex_lock( &m_lock );
+  CRhObjectRecord* record = m_decode;
+  if ( record )
+    m_decode = record->m_next;
+  pthread_mutex_unlock( &m_lock );
+  if ( record == NULL )
+    return;
+
+  Decode( record );
+
+  pthread_mutex_lock( &m_lock );
+  record->m_bDecoded = true;
+  pthread_cond_broadcast( &m_record_decoded );
+  pthread_mutex_unlock( &m_lock );
+}
+
+void CRhObjectReadPipeline::DecodeJob( void* pipeline, int, int )
+{
+  ((CRhObjectReadPipeline*)pipeline)->DecodeNextRecord();
+}
+
+//////////////////////////////////////////////////////////////
+//
+int CRhObjectReadPipeline::Read3dmObject(
+                             ON_Object** ppObject,
+                             ON_3dmObjectAttributes* pAttributes,
+                             int* bad_crc_count
+                             )
+{
+  *ppObject = NULL;
+  *bad_crc_count = 0;
+
+  // keep the workers busy
+  for(;;) {
+    pthread_mutex_lock( &m_lock );
+    bool bQueue = CanQueueRecord();
+    pthread_mutex_unlock( &m_lock );
+    if ( !bQueue || !QueueNextRecord() )
+      break;
+  }
+
+  pthread_mutex_lock( &m_lock );
+  CRhObjectRecord* record = m_head;
+  if ( record == NULL ) {
+    // Nothing is queued.  The next chunk is the end of the table or
+    // something we do not pipeline; the archive reads it directly.
+    m_bHold = false;
+    pthread_mutex_unlock( &m_lock );
+    ON_3dmObjectAttributes attributes;
+    if ( !m_read_failure && SkipNextRecord( attributes ) ) {
+      if ( pAttributes )
+        *pAttributes = attributes;
+      return 2;
+    }
+    if ( m_read_failure ) {
+      // report the damaged record once, then end the table
+      const int rc = ( 1 == m_read_failure ) ? -1 : 0;
+      m_read_failure = 2;
+      return rc;
+    }
+    return m_archive.Read3dmObject( ppObject, pAttributes, 0 );
+  }
+
+  // Hand back records in file order.  When the workers are busy with
+  // other jobs, decode the record here rather than wait for them.
+  while ( !record->m_bDecoded )
+  {
+    if ( m_decode == record )
+    {
+      m_decode = record->m_next;
+      pthread_mutex_unlock( &m_lock );
+      Decode( record );
+      pthread_mutex_lock( &m_lock );
+      record->m_bDecoded = true;
+    }
+    else
+      pthread_cond_wait( &m_record_decoded, &m_lock );
+  }
+  m_head = record->m_next;
+  if ( m_head == NULL )
+    m_tail = NULL;
+  m_queued_count--;
+  m_queued_bytes -= record->m_sizeof_buffer;
+  pthread_mutex_unlock( &m_lock );
+
+  int rc = record->m_rc;
+  *ppObject = record->m_object;
+  record->m_object = NULL;
+  if ( pAttributes )
+    *pAttributes = record->m_attributes;
+  *bad_crc_count = record->m_bad_crc_count;
+  delete record;
+
+  // The record was a complete table on its own; an empty table means
+  // the record could not be read.
+  if ( rc == 0 )
+    rc = -1;
+
+  return rc;
+}
@@ -0,0 +1,158 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_OBJECT_READ_PIPELINE_INC_)
+#define RH_OBJECT_READ_PIPELINE_INC_
+
+#include <pthread.h>
+#include "RhJobSystem.h"
+
+class CRhObjectRecord;
+
+/*
+Description:
+  Decodes object table records on CRhJobSystem workers while the
+  reading thread keeps pulling raw records from the archive.
+
+  Almost all of the time spent reading a large 3dm file goes into
+  inflating and decoding the compressed mesh and brep records in the
+  object table.  Each object record is a self contained chunk, so the
+  reading thread copies the raw chunk bytes out of the archive and a
+  worker decodes them from an ON_Read3dmBufferArchive.  Decoded objects
+  are handed back in file order, so the caller sees exactly the same
+  sequence it would get from ON_BinaryArchive::Read3dmObject().
+
+  Anything that is not a plain object record (the end of table marker,
+  damaged chunks, version 1 archives) is passed to the archive's own
+  Read3dmObject() after all queued records have been handed back.
+*/
+class CRhObjectReadPipeline
+{
+public:
+  // Raw record bytes the reading thread may queue ahead of the caller
+  enum { max_queued_bytes = 32*1024*1024 };
+
+  /*
+  Parameters:
+    archive - [in] archive positioned inside the object table, i.e.
+                   after a successful BeginRead3dmObjectTable().
+    archive_3dm_version - [in] EX_ONX_Model::m_3dm_file_version
+    archive_opennurbs_version - [in] EX_ONX_Model::m_3dm_opennurbs_version
+    bEnableCRC - [in] false to skip CRC verification of decoded records
+    job_priority - [in] priority of the decode jobs
+  */
+  CRhObjectReadPipeline(
+    ON_BinaryArchive& archive,
+    int archive_3dm_version,
+    int archive_opennurbs_version,
+    bool bEnableCRC,
+    CRhJobSystem::priority job_priority = CRhJobSystem::normal_priority
+    );
+
+  // Cancels the decode jobs and deletes any decoded objects that were
+  // never handed back (the caller stopped reading early).
+  ~CRhObjectReadPipeline();
+
+  /*
+  Description:
+    Same contract as ON_BinaryArchive::Read3dmObject() with no filter.
+  Parameters:
+    ppObject - [out] object read from the table; caller owns it
+    pAttributes - [out] object attributes
+    bad_crc_count - [out] number of CRC errors detected while a worker
+                    decoded this record.  These errors are not included
+                    in archive.BadCRCCount().
+  Returns:
+    0: at end of object table
+    1: successfully read an object
+    2: object skipped
+    3: object newer than this version of opennurbs
+   -1: corrupt record
+  */
+  int Read3dmObject(
+    ON_Object** ppObject,
+    ON_3dmObjectAttributes* pAttributes,
+    int* bad_crc_count
+    );
+
+  // Number of worker threads decoding records (0 = serial reading)
+  int WorkerCount() const;
+
+  /*
+  Description:
+    Lets the caller pass over records without reading the object in
+    them, e.g. point clouds that are drawn from a cache.  For records of
+    the filtered object types, only the attributes are read and passed
+    to the filter.  If it returns true the rest of the record is skipped
+    and Read3dmObject() returns 2 with the attributes and no object.
+  Parameters:
+    object_types - [in] ON::object_type bits of the records to filter
+    filter - [in] called on the reading thread, in file order, possibly
+                  before earlier records have been handed back.  Its
+                  record_key is the CRC stored at the end of the record
+                  in the high 32 bits and the record length in the low
+                  32 bits, which tells records apart without reading
+                  them.  record_bytes is the size of the record.
+    context - [in] passed to filter
+  */
+  typedef bool (*SKIP_FILTER)( void* context, ON::object_type object_type, const ON_3dmObjectAttributes& attributes,
+                               ON__UINT64 record_key, ON__UINT64 record_bytes );
+  void SetSkipFilter( unsigned int object_types, SKIP_FILTER filter, void* context );
+
+private:
+  bool QueueNextRecord();
+  bool SkipNextRecord( ON_3dmObjectAttributes& attributes );
+  bool CanQueueRecord() const;
+  void Decode( CRhObjectRecord* record ) const;
+  void DecodeNextRecord();
+
+  static void DecodeJob( void* pipeline, int, int );
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhObjectReadPipeline(const CRhObjectReadPipeline&);
+  CRhObjectReadPipeline& operator=(const CRhObjectReadPipeline&);
+
+private:
+  ON_BinaryArchive& m_archive;
+  const int m_3dm_version;
+  const int m_3dm_opennurbs_version;
+  const bool m_bEnableCRC;
+
+  int m_worker_count;
+  CRhJobGroup m_decode_jobs;          // one job per queued record
+
+  pthread_mutex_t m_lock;
+  pthread_cond_t  m_record_decoded;   // signaled when a worker finishes a record
+
+  // records in file order; m_decode points at the first record no worker has claimed
+  CRhObjectRecord* m_head;
+  CRhObjectRecord* m_tail;
+  CRhObjectRecord* m_decode;
+  int    m_queued_count;
+  size_t m_queued_bytes;
+
+  unsigned int m_skip_object_types;
+  SKIP_FILTER m_skip_filter;
+  void* m_skip_context;
+
+  bool m_bHold;     // next chunk is not an object record; drain the queue and let the archive read it
+
+  // 1 = a record could not be copied and the archive could not go back
+  // to it, 2 = that was reported and the rest of the table is skipped
+  int m_read_failure;
+};
+
+#endif
@@ -0,0 +1,599 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhPackedRTree.h"
+#include "RhTrace.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Sets smaller than this are sorted on the calling thread
+static const int ParallelSortCount = 8192;
+
+// Largest float <= d
+static float FloatBelow( double d )
+{
+  if ( d < -FLT_MAX )
+    return -HUGE_VALF;
+  if ( d > FLT_MAX )
+    return FLT_MAX;
+  float f = (float)d;
+  if ( f > d )
+    f = nextafterf( f, -HUGE_VALF );
+  return f;
+}
+
+// Smallest float >= d
+static float FloatAbove( double d )
+{
+  if ( d > FLT_MAX )
+    return HUGE_VALF;
+  if ( d < -FLT_MAX )
+    return -FLT_MAX;
+  float f = (float)d;
+  if ( f < d )
+    f = nextafterf( f, HUGE_VALF );
+  return f;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+// Sort-Tile-Recursive packing
+//
+
+// A box being packed into a node of the level above it
+struct RhPackItem
+{
+  float m_center[3];
+  int m_index;        // box index in the level being packed
+};
+
+struct RhPackBox
+{
+  float m_min[3];
+  float m_max[3];
+};
+
+// context is the axis.  Ties go by index so every sort gives the same order.
+static int ComparePackItems( void* context, const void* a, const void* b )
+{
+  const int axis = *(const int*)context;
+  const RhPackItem* pa = (const RhPackItem*)a;
+  const RhPackItem* pb = (const RhPackItem*)b;
+  if ( pa->m_center[axis] < pb->m_center[axis] )
+    return -1;
+  if ( pa->m_center[axis] > pb->m_center[axis] )
+    return 1;
+  return (pa->m_index < pb->m_index) ? -1 : (pa->m_index > pb->m_index ? 1 : 0);
+}
+
+static void SortPackItems( RhPackItem* items, int count, int axis )
+{
+  if ( count > 1 )
+    ON_qsort( items, count, sizeof(items[0]), ComparePackItems, &axis );
+}
+
+struct RhPackSort
+{
+  RhPackItem* m_items;
+  RhPackItem* m_scratch;
+  int m_count;
+  int m_dim;
+  int m_slab_size;      // items sorted on the second axis together
+  int m_run_size;       // items sorted on the third axis together
+  int m_chunk_size;     // items sorted by one job before the merges
+  int m_merge_width;    // length of the sorted runs being merged
+};
+
+static void SortChunksJob( void* context, int first, int last )
+{
+  RhPackSort& sort = *(RhPackSort*)context;
+  for ( int i = first; i < last; i++ ) {
+    const int start = i*sort.m_chunk_size;
+    const int count = (sort.m_count - start < sort.m_chunk_size) ? sort.m_count - start : sort.m_chunk_size;
+    SortPackItems( sort.m_items + start, count, 0 );
+  }
+}
+
+// Merges pairs of sorted runs from m_items into m_scratch
+static void MergeRunsJob( void* context, int first, int last )
+{
+  RhPackSort& sort = *(RhPackSort*)context;
+  int axis = 0;
+  for ( int i = first; i < last; i++ ) {
+    const int start = 2*i*sort.m_merge_width;
+    const int middle = (sort.m_count - start < sort.m_merge_width) ? sort.m_count : start + sort.m_merge_width;
+    const int end = (sort.m_count - middle < sort.m_merge_width) ? sort.m_count : middle + sort.m_merge_width;
+    const RhPackItem* a = sort.m_items + start;
+    const RhPackItem* a1 = sort.m_items + middle;
+    const RhPackItem* b = a1;
+    const RhPackItem* b1 = sort.m_items + end;
+    RhPackItem* out = sort.m_scratch + start;
+    while ( a < a1 && b < b1 )
+      *out++ = ( ComparePackItems( &axis, b, a ) < 0 ) ? *b++ : *a++;
+    while ( a < a1 )
+      *out++ = *a++;
+    while ( b < b1 )
+      *out++ = *b++;
+  }
+}
+
+static void SortSlabsJob( void* context, int first, int last )
+{
+  RhPackSort& sort = *(RhPackSort*)context;
+  for ( int i = first; i < last; i++ ) {
+    const int slab_start = i*sort.m_slab_size;
+    const int slab_count = (sort.m_count - slab_start < sort.m_slab_size) ? sort.m_count - slab_start : sort.m_slab_size;
+    SortPackItems( sort.m_items + slab_start, slab_count, 1 );
+    if ( sort.m_dim < 3 )
+      continue;
+    for ( int run_start = 0; run_start < slab_count; run_start += sort.m_run_size ) {
+      const int run_count = (slab_count - run_start < sort.m_run_size) ? slab_count - run_start : sort.m_run_size;
+      SortPackItems( sort.m_items + slab_start + run_start, run_count, 2 );
+    }
+  }
+}
+
+/*
+Description:
+  Puts items in Sort-Tile-Recursive order: sorted on x, cut into
+  slabs, each slab sorted on y and, in 3d, cut into runs sorted on z.
+  Every node_capacity items in a row after that are one node.
+*/
+static void PackOrder( RhPackItem* items, int count, int dim, bool bParallel, CRhJobSystem::priority job_priority )
+{
+  const int capacity = CRhPackedRTree::node_capacity;
+  const int node_count = (count + capacity - 1)/capacity;
+  if ( node_count <= 1 )
+    return;
+
+  // slices per axis
+  int s = (int)ceil( (3 == dim) ? pow( (double)node_count, 1.0/3.0 ) : sqrt( (double)node_count ) );
+  if ( s < 1 )
+    s = 1;
+  while ( (3 == dim ? (double)s*s*s : (double)s*s) < node_count )
+    s++;
+
+  RhPackSort sort;
+  memset( &sort, 0, sizeof(sort) );
+  sort.m_items = items;
+  sort.m_count = count;
+  sort.m_dim = dim;
+  sort.m_slab_size = (3 == dim) ? s*s*capacity : s*capacity;
+  sort.m_run_size = s*capacity;
+  const int slab_count = (count + sort.m_slab_size - 1)/sort.m_slab_size;
+
+  if ( !bParallel || count < ParallelSortCount ) {
+    SortPackItems( items, count, 0 );
+    SortSlabsJob( &sort, 0, slab_count );
+    return;
+  }
+
+  // x: chunks sorted in parallel, then merged a pair of runs per job
+  ON_SimpleArray<RhPackItem> scratch;
+  scratch.Reserve( count );
+  sort.m_scratch = scratch.Array();
+  const int thread_count = CRhJobSystem::Shared().WorkerCount() + 1;
+  sort.m_chunk_size = (count + 4*thread_count - 1)/(4*thread_count);
+  if ( sort.m_chunk_size < ParallelSortCount/2 )
+    sort.m_chunk_size = ParallelSortCount/2;
+
+  CRhJobGroup jobs( job_priority );
+  jobs.ParallelFor( (count + sort.m_chunk_size - 1)/sort.m_chunk_size, 1, SortChunksJob, &sort );
+  jobs.Wait();
+  for ( sort.m_merge_width = sort.m_chunk_size; sort.m_merge_width < count; sort.m_merge_width *= 2 ) {
+    const int pair_count = (int)(((ON__INT64)count + 2*(ON__INT64)sort.m_merge_width - 1)/(2*(ON__INT64)sort.m_merge_width));
+    jobs.ParallelFor( pair_count, 1, MergeRunsJob, &sort );
+    jobs.Wait();
+    RhPackItem* swap = sort.m_items;
+    sort.m_items = sort.m_scratch;
+    sort.m_scratch = swap;
+    if ( (ON__INT64)sort.m_merge_width*2 >= count )
+      break;
+  }
+  if ( sort.m_items != items ) {
+    memcpy( items, sort.m_items, count*sizeof(items[0]) );
+    sort.m_items = items;
+  }
+
+  // y and z: every slab on its own
+  jobs.ParallelFor( slab_count, 1, SortSlabsJob, &sort );
+  jobs.Wait();
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+// CRhPackedRTree
+//
+
+CRhPackedRTree::CRhPackedRTree()
+: m_dim(0)
+, m_depth(0)
+, m_first_leaf_node(0)
+{
+}
+
+CRhPackedRTree::~CRhPackedRTree()
+{
+}
+
+void CRhPackedRTree::Destroy()
+{
+  m_nodes.Destroy();
+  m_ids.Destroy();
+  m_dim = 0;
+  m_depth = 0;
+  m_first_leaf_node = 0;
+}
+
+bool CRhPackedRTree::Create( const ON_RTreeLeaf* leaves, int leaf_count, bool bParallel, CRhJobSystem::priority job_priority )
+{
+  return CreateHelper( leaves, leaf_count, 3, bParallel, job_priority );
+}
+
+bool CRhPackedRTree::Create2d( const ON_RTreeLeaf* leaves, int leaf_count, bool bParallel, CRhJobSystem::priority job_priority )
+{
+  return CreateHelper( leaves, leaf_count, 2, bParallel, job_priority );
+}
+
+bool CRhPackedRTree::CreateHelper( const ON_RTreeLeaf* leaves, int leaf_count, int dim,
+                                   bool bParallel, CRhJobSystem::priority job_priority )
+{
+  RH_TRACE_SCOPE( "pack rtree" );
+  Destroy();
+  if ( leaf_count <= 0 )
+    return true;
+  if ( NULL == leaves )
+    return false;
+
+  // boxes of the level being packed, elements first
+  ON_SimpleArray<RhPackBox> boxes;
+  ON_SimpleArray<RhPackItem> items;
+  boxes.Reserve( leaf_count );
+  items.Reserve( leaf_count );
+  for ( int i = 0; i < leaf_count; i++ ) {
+    const ON_RTreeBBox& rect = leaves[i].m_rect;
+    RhPackBox& box = boxes.AppendNew();
+    for ( int j = 0; j < 3; j++ ) {
+      if ( j >= dim ) {
+        box.m_min[j] = box.m_max[j] = 0.0f;
+        continue;
+      }
+      if ( !ON_IsValid( rect.m_min[j] ) || !ON_IsValid( rect.m_max[j] ) || rect.m_min[j] > rect.m_max[j] )
+        return false;
+      box.m_min[j] = FloatBelow( rect.m_min[j] );
+      box.m_max[j] = FloatAbove( rect.m_max[j] );
+    }
+  }
+
+  // levels are packed bottom up; levels[0] are the leaf nodes
+  ON_ClassArray< ON_SimpleArray<Node> > levels;
+  ON_SimpleArray<RhPackBox> parent_boxes;
+  int count = leaf_count;
+  for(;;) {
+    items.SetCount( 0 );
+    for ( int i = 0; i < count; i++ ) {
+      RhPackItem& item = items.AppendNew();
+      for ( int j = 0; j < 3; j++ )
+        item.m_center[j] = 0.5f*boxes[i].m_min[j] + 0.5f*boxes[i].m_max[j];
+      item.m_index = i;
+    }
+    PackOrder( items.Array(), count, dim, bParallel, job_priority );
+
+    // put the level below in packed order
+    if ( 0 == levels.Count() ) {
+      m_ids.Reserve( leaf_count );
+      for ( int i = 0; i < count; i++ )
+        m_ids.Append( leaves[items[i].m_index].m_id );
+    }
+    else {
+      const ON_SimpleArray<Node>& children = *levels.Last();
+      ON_SimpleArray<Node> packed( count );
+      for ( int i = 0; i < count; i++ )
+        packed.Append( children[items[i].m_index] );
+      *levels.Last() = packed;
+    }
+
+    const int node_count = (count + node_capacity - 1)/node_capacity;
+    ON_SimpleArray<Node>& level = levels.AppendNew();
+    parent_boxes.SetCount( 0 );
+    level.Reserve( node_count );
+    parent_boxes.Reserve( node_count );
+    for ( int n = 0; n < node_count; n++ ) {
+      Node& node = level.AppendNew();
+      node.m_first = n*node_capacity;
+      node.m_count = (count - node.m_first < node_capacity) ? count - node.m_first : node_capacity;
+      RhPackBox& parent = parent_boxes.AppendNew();
+      for ( int j = 0; j < 3; j++ ) {
+        parent.m_min[j] = HUGE_VALF;
+        parent.m_max[j] = -HUGE_VALF;
+      }
+      for ( int i = 0; i < node_capacity; i++ ) {
+        // unused children get boxes no search overlaps
+        const RhPackBox* box = (i < node.m_count) ? &boxes[items[node.m_first+i].m_index] : NULL;
+        for ( int j = 0; j < 3; j++ ) {
+          node.m_min[j][i] = box ? box->m_min[j] : HUGE_VALF;
+          node.m_max[j][i] = box ? box->m_max[j] : -HUGE_VALF;
+          if ( box && box->m_min[j] < parent.m_min[j] )
+            parent.m_min[j] = box->m_min[j];
+          if ( box && box->m_max[j] > parent.m_max[j] )
+            parent.m_max[j] = box->m_max[j];
+        }
+      }
+    }
+    if ( 1 == node_count )
+      break;
+    boxes = parent_boxes;
+    count = node_count;
+  }
+
+  // Root first, and each level in the order of the children of the level
+  // above.  Packing a level reorders the nodes of the level below after
+  // their own children were placed, so the levels are laid out again from
+  // the root down to keep everything below a node contiguous.
+  int node_count = 0;
+  for ( int i = 0; i < levels.Count(); i++ )
+    node_count += levels[i].Count();
+  m_nodes.Reserve( node_count );
+  ON_SimpleArray<int> order( 1 );       // nodes of levels[i] in layout order
+  ON_SimpleArray<int> child_order;
+  ON_SimpleArray<ON__INT_PTR> ids( m_ids.Count() );
+  order.Append( 0 );
+  for ( int i = levels.Count()-1; i >= 0; i-- ) {
+    const int next_level_start = m_nodes.Count() + order.Count();
+    if ( 0 == i )
+      m_first_leaf_node = m_nodes.Count();
+    child_order.SetCount( 0 );
+    for ( int n = 0; n < order.Count(); n++ ) {
+      Node& node = m_nodes.AppendNew();
+      node = levels[i][order[n]];
+      const int first = node.m_first;
+      node.m_first = (i > 0) ? next_level_start + child_order.Count() : ids.Count();
+      for ( int k = first; k < first + node.m_count; k++ ) {
+        if ( i > 0 )
+          child_order.Append( k );
+        else
+          ids.Append( m_ids[k] );
+      }
+    }
+    order = child_order;
+  }
+  m_ids = ids;
+  m_dim = dim;
+  m_depth = levels.Count();
+  return true;
+}
+
+bool CRhPackedRTree::CreateMeshFaceTree( const ON_Mesh* mesh, bool bParallel, CRhJobSystem::priority job_priority )
+{
+  Destroy();
+  if ( NULL == mesh )
+    return false;
+
+  const int vertex_count = mesh->m_V.Count();
+  const int face_count = mesh->m_F.Count();
+  ON_SimpleArray<ON_RTreeLeaf> leaves;
+  leaves.Reserve( face_count );
+  for ( int fi = 0; fi < face_count; fi++ ) {
+    const int* vi = mesh->m_F[fi].vi;
+    if ( vi[0] < 0 || vi[0] >= vertex_count || vi[1] < 0 || vi[1] >= vertex_count
+      || vi[2] < 0 || vi[2] >= vertex_count || vi[3] < 0 || vi[3] >= vertex_count )
+      continue;
+    ON_RTreeLeaf& leaf = leaves.AppendNew();
+    const ON_3fPoint& p = mesh->m_V[vi[0]];
+    leaf.m_rect.m_min[0] = leaf.m_rect.m_max[0] = p.x;
+    leaf.m_rect.m_min[1] = leaf.m_rect.m_max[1] = p.y;
+    leaf.m_rect.m_min[2] = leaf.m_rect.m_max[2] = p.z;
+    for ( int i = 1; i < 4; i++ ) {
+      const ON_3fPoint& q = mesh->m_V[vi[i]];
+      for ( int j = 0; j < 3; j++ ) {
+        if ( q[j] < leaf.m_rect.m_min[j] )
+          leaf.m_rect.m_min[j] = q[j];
+        else if ( q[j] > leaf.m_rect.m_max[j] )
+          leaf.m_rect.m_max[j] = q[j];
+      }
+    }
+    leaf.m_id = fi;
+  }
+  return Create( leaves.Array(), leaves.Count(), bParallel, job_priority );
+}
+
+bool CRhPackedRTree::SearchHelper( const double* a_min, const double* a_max, int dim,
+                                   bool ON_MSC_CDECL resultCallback(void*, ON__INT_PTR), void* a_context ) const
+{
+  if ( m_nodes.Count() == 0 || dim != m_dim || NULL == a_min || NULL == a_max )
+    return true;
+
+  float qmin[3] = { 0.0f, 0.0f, 0.0f };
+  float qmax[3] = { 0.0f, 0.0f, 0.0f };
+  for ( int j = 0; j < dim; j++ ) {
+    qmin[j] = FloatBelow( a_min[j] );
+    qmax[j] = FloatAbove( a_max[j] );
+  }
+
+  // each level pushes at most node_capacity nodes and pops one
+  int stack[32*node_capacity];
+  int stack_count = 0;
+  stack[stack_count++] = 0;
+  const Node* nodes = m_nodes.Array();
+  const ON__INT_PTR* ids = m_ids.Array();
+  while ( stack_count > 0 ) {
+    const int node_index = stack[--stack_count];
+    const Node& node = nodes[node_index];
+    const bool bLeaf = ( node_index >= m_first_leaf_node );
+    for ( int i = 0; i < node.m_count; i++ ) {
+      if ( node.m_min[0][i] > qmax[0] || node.m_max[0][i] < qmin[0]
+        || node.m_min[1][i] > qmax[1] || node.m_max[1][i] < qmin[1]
+        || node.m_min[2][i] > qmax[2] || node.m_max[2][i] < qmin[2] )
+        continue;
+      if ( !bLeaf )
+        stack[stack_count++] = node.m_first + i;
+      else if ( !resultCallback( a_context, ids[node.m_first + i] ) )
+        return false;
+    }
+  }
+  return true;
+}
+
+static bool ON_MSC_CDECL AppendIntId( void* a_context, ON__INT_PTR a_id )
+{
+  ((ON_SimpleArray<int>*)a_context)->Append( (int)a_id );
+  return true;
+}
+
+static bool ON_MSC_CDECL AppendPointerId( void* a_context, ON__INT_PTR a_id )
+{
+  ((ON_SimpleArray<void*>*)a_context)->Append( (void*)a_id );
+  return true;
+}
+
+bool CRhPackedRTree::Search( const double a_min[3], const double a_max[3],
+  bool ON_MSC_CDECL resultCallback(void* a_context, ON__INT_PTR a_id), void* a_context ) const
+{
+  return SearchHelper( a_min, a_max, 3, resultCallback, a_context );
+}
+
+bool CRhPackedRTree::Search( const double a_min[3], const double a_max[3], ON_SimpleArray<int>& a_result ) const
+{
+  return SearchHelper( a_min, a_max, 3, AppendIntId, &a_result );
+}
+
+bool CRhPackedRTree::Search( const double a_min[3], const double a_max[3], ON_SimpleArray<void*>& a_result ) const
+{
+  return SearchHelper( a_min, a_max, 3, AppendPointerId, &a_result );
+}
+
+bool CRhPackedRTree::Search2d( const double a_min[2], const double a_max[2],
+  bool ON_MSC_CDECL resultCallback(void* a_context, ON__INT_PTR a_id), void* a_context ) const
+{
+  return SearchHelper( a_min, a_max, 2, resultCallback, a_context );
+}
+
+bool CRhPackedRTree::Search2d( const double a_min[2], const double a_max[2], ON_SimpleArray<int>& a_result ) const
+{
+  return SearchHelper( a_min, a_max, 2, AppendIntId, &a_result );
+}
+
+bool CRhPackedRTree::Search2d( const double a_min[2], const double a_max[2], ON_SimpleArray<void*>& a_result ) const
+{
+  return SearchHelper( a_min, a_max, 2, AppendPointerId, &a_result );
+}
+
+void CRhPackedRTree::GetElementRange( int node_index, int* first, int* last ) const
+{
+  // the nodes below a node are contiguous on every level
+  int first_node = node_index;
+  int last_node = node_index;
+  while ( first_node < m_first_leaf_node ) {
+    first_node = m_nodes[first_node].m_first;
+    last_node = m_nodes[last_node].m_first + m_nodes[last_node].m_count - 1;
+  }
+  *first = m_nodes[first_node].m_first;
+  *last = m_nodes[last_node].m_first + m_nodes[last_node].m_count;
+}
+
+bool CRhPackedRTree::Search( const ON_ClippingRegion* const* frustums, int frustum_count,
+  bool ON_MSC_CDECL resultCallback(void* a_context, ON__INT_PTR a_id), void* a_context ) const
+{
+  if ( m_nodes.Count() == 0 || 3 != m_dim || NULL == frustums || frustum_count <= 0 )
+    return true;
+
+  int stack[32*node_capacity];
+  int stack_count = 0;
+  stack[stack_count++] = 0;
+  const Node* nodes = m_nodes.Array();
+  const ON__INT_PTR* ids = m_ids.Array();
+  while ( stack_count > 0 ) {
+    const int node_index = stack[--stack_count];
+    const Node& node = nodes[node_index];
+    const bool bLeaf = ( node_index >= m_first_leaf_node );
+    for ( int i = 0; i < node.m_count; i++ ) {
+      const ON_BoundingBox box( ON_3dPoint( node.m_min[0][i], node.m_min[1][i], node.m_min[2][i] ),
+                                ON_3dPoint( node.m_max[0][i], node.m_max[1][i], node.m_max[2][i] ) );
+      // 0 = out of view, 1 = partly in view, 2 = entirely in view
+      int in_view = 0;
+      for ( int f = 0; f < frustum_count && in_view < 2; f++ ) {
+        const int rc = frustums[f]->InViewFrustum( box );
+        if ( rc > in_view )
+          in_view = rc;
+      }
+      if ( 0 == in_view )
+        continue;
+      if ( bLeaf ) {
+        if ( !resultCallback( a_context, ids[node.m_first + i] ) )
+          return false;
+      }
+      else if ( 2 == in_view ) {
+        int first = 0, last = 0;
+        GetElementRange( node.m_first + i, &first, &last );
+        for ( int k = first; k < last; k++ ) {
+          if ( !resultCallback( a_context, ids[k] ) )
+            return false;
+        }
+      }
+      else
+        stack[stack_count++] = node.m_first + i;
+    }
+  }
+  return true;
+}
+
+bool CRhPackedRTree::Search( const ON_ClippingRegion* const* frustums, int frustum_count,
+  ON_SimpleArray<int>& a_result ) const
+{
+  return Search( frustums, frustum_count, AppendIntId, &a_result );
+}
+
+int CRhPackedRTree::Dimension() const
+{
+  return m_dim;
+}
+
+int CRhPackedRTree::ElementCount() const
+{
+  return m_ids.Count();
+}
+
+int CRhPackedRTree::NodeCount() const
+{
+  return m_nodes.Count();
+}
+
+int CRhPackedRTree::Depth() const
+{
+  return m_depth;
+}
+
+ON_BoundingBox CRhPackedRTree::BoundingBox() const
+{
+  ON_BoundingBox bbox;
+  if ( m_nodes.Count() == 0 )
+    return bbox;
+  const Node& root = m_nodes[0];
+  for ( int i = 0; i < root.m_count; i++ ) {
+    const ON_BoundingBox child( ON_3dPoint( root.m_min[0][i], root.m_min[1][i], root.m_min[2][i] ),
+                                ON_3dPoint( root.m_max[0][i], root.m_max[1][i], root.m_max[2][i] ) );
+    bbox.Union( child );
+  }
+  return bbox;
+}
+
+size_t CRhPackedRTree::SizeOf() const
+{
+  return m_nodes.Capacity()*sizeof(Node) + m_ids.Capacity()*sizeof(ON__INT_PTR);
+}
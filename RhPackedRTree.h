@@ -0,0 +1,197 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_PACKED_RTREE_INC_)
+#define RH_PACKED_RTREE_INC_
+
+#include "RhJobSystem.h"
+
+/*
+Description:
+  Read only R-tree built from all of its elements at once with the
+  Sort-Tile-Recursive packing, for the same searches ON_RTree does.
+
+  ON_RTree can only grow one Insert() at a time, and
+  ON_RTree::CreateMeshFaceTree() inserts the faces one by one.  That
+  splits nodes over and over and leaves them about half full.  Packing
+  sorts the elements once, fills every node but the last of each level
+  and puts elements that are close together in the same node, so a
+  search visits fewer and fuller nodes.
+
+  The nodes are one array, root first and each level after the one
+  above it, and the children of a node are next to each other in the
+  level below, so a node stores where its children start instead of a
+  pointer to each.  A node keeps the boxes of its children one axis at
+  a time in floats rounded outward, so a search tests every child of a
+  node from a few cache lines.  Because of the rounding a search can
+  find elements whose boxes miss the search region by less than float
+  precision; like with ON_RTree, callers test the elements they find.
+
+  The sorts are done by CRhJobSystem jobs when asked to.  The tree is
+  the same either way.
+
+  A 2d tree is made by Create2d() and searched with Search2d().
+*/
+class CRhPackedRTree
+{
+public:
+  enum
+  {
+    node_capacity = 8     // children per node
+  };
+
+  CRhPackedRTree();
+  ~CRhPackedRTree();
+
+  /*
+  Description:
+    Builds the tree of a set of elements, replacing any previous tree.
+  Parameters:
+    leaves - [in] element boxes and ids.  Create2d() ignores m_min[2]
+                  and m_max[2].
+    leaf_count - [in]
+    bParallel - [in] true to sort with CRhJobSystem jobs.  Small sets
+                     are sorted on the calling thread anyway.
+    job_priority - [in] priority of the jobs.
+  Returns:
+    false if a box is not valid.  An empty set makes an empty tree and
+    returns true.
+  */
+  bool Create(
+          const ON_RTreeLeaf* leaves,
+          int leaf_count,
+          bool bParallel = false,
+          CRhJobSystem::priority job_priority = CRhJobSystem::normal_priority
+          );
+  bool Create2d(
+          const ON_RTreeLeaf* leaves,
+          int leaf_count,
+          bool bParallel = false,
+          CRhJobSystem::priority job_priority = CRhJobSystem::normal_priority
+          );
+
+  /*
+  Description:
+    Builds a 3d tree with an element for each face in the mesh, like
+    ON_RTree::CreateMeshFaceTree().  The element id is the index of the
+    face.  Faces with vertex indexes out of range are left out.
+  */
+  bool CreateMeshFaceTree(
+          const ON_Mesh* mesh,
+          bool bParallel = false,
+          CRhJobSystem::priority job_priority = CRhJobSystem::normal_priority
+          );
+
+  void Destroy();
+
+  /*
+  Description:
+    Finds all elements whose boxes overlap (a_min, a_max).  Search()
+    searches 3d trees and Search2d() searches 2d trees.
+  Parameters:
+    resultCallback - [in] called with the id of each element found.
+                          Return true to keep searching and false to
+                          stop.
+  Returns:
+    true if the entire tree was searched.  It is possible no elements
+    were found.
+  */
+  bool Search( const double a_min[3], const double a_max[3],
+    bool ON_MSC_CDECL resultCallback(void* a_context, ON__INT_PTR a_id), void* a_context ) const;
+
+  bool Search( const double a_min[3], const double a_max[3],
+    ON_SimpleArray<int>& a_result ) const;
+
+  bool Search( const double a_min[3], const double a_max[3],
+    ON_SimpleArray<void*>& a_result ) const;
+
+  bool Search2d( const double a_min[2], const double a_max[2],
+    bool ON_MSC_CDECL resultCallback(void* a_context, ON__INT_PTR a_id), void* a_context ) const;
+
+  bool Search2d( const double a_min[2], const double a_max[2],
+    ON_SimpleArray<int>& a_result ) const;
+
+  bool Search2d( const double a_min[2], const double a_max[2],
+    ON_SimpleArray<void*>& a_result ) const;
+
+  /*
+  Description:
+    Finds all elements of a 3d tree whose boxes may be seen in any of
+    the view frustums, the way ON_ClippingRegion::InViewFrustum() tests
+    a box.  Nodes are tested the same way, so the parts of the tree out
+    of view are skipped, and every element below a node entirely in
+    view is found without testing it.
+  Parameters:
+    frustums - [in] frustum_count view frustums, for instance both eyes
+                    of a stereo pair.  Their clipping planes are tested
+                    too.
+    resultCallback - [in] called with the id of each element found.
+                          Return true to keep searching and false to
+                          stop.
+  Returns:
+    true if the entire tree was searched.
+  */
+  bool Search( const ON_ClippingRegion* const* frustums, int frustum_count,
+    bool ON_MSC_CDECL resultCallback(void* a_context, ON__INT_PTR a_id), void* a_context ) const;
+
+  bool Search( const ON_ClippingRegion* const* frustums, int frustum_count,
+    ON_SimpleArray<int>& a_result ) const;
+
+  // 2 or 3, 0 for an empty tree
+  int Dimension() const;
+
+  int ElementCount() const;
+  int NodeCount() const;
+
+  // Levels of nodes, 1 when the root holds every element
+  int Depth() const;
+
+  // Box of every element, rounded outward to floats
+  ON_BoundingBox BoundingBox() const;
+
+  // Bytes of heap memory the tree uses
+  size_t SizeOf() const;
+
+private:
+  struct Node
+  {
+    float m_min[3][node_capacity];    // child boxes, one row per axis
+    float m_max[3][node_capacity];
+    int m_first;                      // index of the first child node, or of the first element at leaf nodes
+    int m_count;                      // children
+  };
+
+  bool CreateHelper( const ON_RTreeLeaf* leaves, int leaf_count, int dim,
+                     bool bParallel, CRhJobSystem::priority job_priority );
+  bool SearchHelper( const double* a_min, const double* a_max, int dim,
+                     bool ON_MSC_CDECL resultCallback(void*, ON__INT_PTR), void* a_context ) const;
+
+  // m_ids[*first] to m_ids[*last-1] are the elements below the node
+  void GetElementRange( int node_index, int* first, int* last ) const;
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhPackedRTree(const CRhPackedRTree&);
+  CRhPackedRTree& operator=(const CRhPackedRTree&);
+
+private:
+  ON_SimpleArray<Node> m_nodes;         // root first, then one level after another
+  ON_SimpleArray<ON__INT_PTR> m_ids;    // element ids in leaf order
+  int m_dim;
+  int m_depth;
+  int m_first_leaf_node;                // nodes from here on are leaf nodes
+};
+
+#endif
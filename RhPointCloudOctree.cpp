@@ -0,0 +1,442 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "RhPointCloudOctree.h"
+#include "RhTrace.h"
+
+static const char OctreeSignature[8] = { 'R','h','P','t','O','c','t','r' };
+static const int  OctreeVersion = 2;
+
+// Most points a node holds before it is split.  Leaves at MaxDepth may
+// hold more when many points are (nearly) coincident.
+static const int NodeCapacity = 8192;
+static const int MaxDepth = 16;
+
+struct OctreeHeader
+{
+  char      m_signature[8];
+  ON__INT32 m_version;
+  ON__INT32 m_sizeof_node;
+  ON__INT32 m_node_count;
+  ON__INT32 m_bHasColors;
+  ON__INT64 m_point_count;
+  ON__UINT64 m_source_key;
+};
+
+
+//////////////////////////////////////////////////////////////
+//
+// Builds the node table in memory.  The points are sorted in place,
+// so no copy or index of them is needed; each node owns a contiguous
+// run of the cloud's points.
+//
+class CRhOctreeBuilder
+{
+public:
+  CRhOctreeBuilder( ON_PointCloud& cloud, bool bHasColors )
+    : m_P(cloud.m_P.Array()), m_C(bHasColors ? cloud.m_C.Array() : 0)
+  {
+  }
+
+  int BuildNode( int first, int count, int depth );
+
+  // Splits the points in [begin,end) so points below split come first
+  int Partition( int begin, int end, int axis, double split );
+
+  void Swap( int i, int j )
+  {
+    ON_3dPoint P = m_P[i]; m_P[i] = m_P[j]; m_P[j] = P;
+    if ( m_C ) {
+      ON_Color C = m_C[i]; m_C[i] = m_C[j]; m_C[j] = C;
+    }
+  }
+
+  ON_3dPoint* m_P;
+  ON_Color* m_C;                  // NULL when the points have no colors
+  ON_SimpleArray<CRhPointCloudOctree::Node> m_nodes;
+  ON_SimpleArray<int> m_first;    // first point of each node
+};
+
+int CRhOctreeBuilder::Partition( int begin, int end, int axis, double split )
+{
+  while ( begin < end ) {
+    if ( m_P[begin][axis] < split )
+      begin++;
+    else {
+      end--;
+      Swap( begin, end );
+    }
+  }
+  return begin;
+}
+
+int CRhOctreeBuilder::BuildNode( int first, int count, int depth )
+{
+  const ON_3dPoint* P = m_P;
+
+  ON_BoundingBox bbox;
+  bbox.m_min = bbox.m_max = P[first];
+  for ( int i = first+1; i < first+count; i++ )
+    bbox.Set( P[i], true );
+
+  const int node_index = m_nodes.Count();
+  CRhPointCloudOctree::Node& node = m_nodes.AppendNew();
+  memset( &node, 0, sizeof(node) );
+  for ( int k = 0; k < 3; k++ ) {
+    node.m_min[k] = (float)bbox.m_min[k];
+    node.m_max[k] = (float)bbox.m_max[k];
+  }
+  for ( int k = 0; k < 8; k++ )
+    node.m_child[k] = -1;
+  m_first.Append( first );
+
+  if ( count <= NodeCapacity || depth >= MaxDepth ) {
+    node.m_point_count = count;
+    return node_index;
+  }
+
+  // Keep every stride-th point in this node.  Scans are stored in
+  // scanning order, so this is an even sample of the node's region.
+  const int stride = (count + NodeCapacity - 1)/NodeCapacity;
+  int sample_count = 0;
+  for ( int i = 0; i < count; i += stride, sample_count++ )
+    Swap( first+sample_count, first+i );
+  node.m_point_count = sample_count;
+
+  // The rest goes to the children, split at the center of the bounding box
+  const ON_3dPoint C = bbox.Center();
+  int octant[9];
+  octant[0] = first + sample_count;
+  octant[8] = first + count;
+  octant[4] = Partition( octant[0], octant[8], 0, C.x );
+  octant[2] = Partition( octant[0], octant[4], 1, C.y );
+  octant[6] = Partition( octant[4], octant[8], 1, C.y );
+  octant[1] = Partition( octant[0], octant[2], 2, C.z );
+  octant[3] = Partition( octant[2], octant[4], 2, C.z );
+  octant[5] = Partition( octant[4], octant[6], 2, C.z );
+  octant[7] = Partition( octant[6], octant[8], 2, C.z );
+
+  for ( int k = 0; k < 8; k++ ) {
+    if ( octant[k+1] > octant[k] ) {
+      int child_index = BuildNode( octant[k], octant[k+1] - octant[k], depth+1 );
+      m_nodes[node_index].m_child[k] = child_index;   // m_nodes may have grown
+    }
+  }
+
+  return node_index;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhPointCloudOctree::CRhPointCloudOctree()
+  : m_fp(0), m_point_count(0), m_source_key(0), m_bHasColors(false)
+{
+}
+
+CRhPointCloudOctree::~CRhPointCloudOctree()
+{
+  Close();
+}
+
+bool CRhPointCloudOctree::Build( ON_PointCloud& cloud, const char* filename, ON__UINT64 source_key )
+{
+  RH_TRACE_SCOPE_ARG( "CRhPointCloudOctree::Build", cloud.m_P.Count() );
+  const int point_count = cloud.m_P.Count();
+  if ( point_count <= 0 || filename == NULL )
+    return false;
+  const bool bHasColors = cloud.m_C.Count() == point_count;
+
+  CRhOctreeBuilder builder( cloud, bHasColors );
+  builder.BuildNode( 0, point_count, 0 );
+
+  FILE* fp = ON::OpenFile( filename, "wb" );
+  if ( fp == NULL )
+    return false;
+
+  // header, node table, then the points (and colors) of each node
+  const int node_count = builder.m_nodes.Count();
+  ON__INT64 offset = sizeof(OctreeHeader) + node_count*sizeof(Node);
+  for ( int i = 0; i < node_count; i++ ) {
+    builder.m_nodes[i].m_offset = offset;
+    offset += builder.m_nodes[i].m_point_count*(ON__INT64)(sizeof(ON_3fPoint) + (bHasColors ? sizeof(ON_Color) : 0));
+  }
+
+  OctreeHeader header;
+  memset( &header, 0, sizeof(header) );
+  memcpy( header.m_signature, OctreeSignature, sizeof(header.m_signature) );
+  header.m_version = OctreeVersion;
+  header.m_sizeof_node = sizeof(Node);
+  header.m_node_count = node_count;
+  header.m_bHasColors = bHasColors;
+  header.m_point_count = point_count;
+  header.m_source_key = source_key;
+
+  bool rc =    1 == fwrite( &header, sizeof(header), 1, fp )
+            && node_count == (int)fwrite( builder.m_nodes.Array(), sizeof(Node), node_count, fp );
+
+  ON_SimpleArray<ON_3fPoint> points;
+  for ( int i = 0; rc && i < node_count; i++ ) {
+    const int first = builder.m_first[i];
+    const int count = builder.m_nodes[i].m_point_count;
+    points.SetCount( 0 );
+    points.Reserve( count );
+    for ( int j = first; j < first+count; j++ )
+      points.Append( ON_3fPoint(cloud.m_P[j]) );
+    rc = count == (int)fwrite( points.Array(), sizeof(ON_3fPoint), count, fp );
+    if ( rc && bHasColors )
+      rc = count == (int)fwrite( cloud.m_C.Array() + first, sizeof(ON_Color), count, fp );
+  }
+
+  ON::CloseFile( fp );
+
+  if ( !rc )
+    remove( filename );     // never leave a partial cache behind
+  return rc;
+}
+
+//////////////////////////////////////////////////////////////
+//
+bool CRhPointCloudOctree::Open( const char* filename )
+{
+  Close();
+
+  FILE* fp = ON::OpenFile( filename, "rb" );
+  if ( fp == NULL )
+    return false;
+
+  OctreeHeader header;
+  if (    1 != fread( &header, sizeof(header), 1, fp )
+       || 0 != memcmp( header.m_signature, OctreeSignature, sizeof(header.m_signature) )
+       || header.m_version != OctreeVersion
+       || header.m_sizeof_node != sizeof(Node)
+       || header.m_node_count <= 0 )
+  {
+    ON::CloseFile( fp );
+    return false;
+  }
+
+  m_nodes.SetCapacity( header.m_node_count );
+  m_nodes.SetCount( header.m_node_count );
+  if ( header.m_node_count != (int)fread( m_nodes.Array(), sizeof(Node), header.m_node_count, fp ) ) {
+    m_nodes.Destroy();
+    ON::CloseFile( fp );
+    return false;
+  }
+
+  m_fp = fp;
+  m_point_count = header.m_point_count;
+  m_source_key = header.m_source_key;
+  m_bHasColors = header.m_bHasColors ? true : false;
+  return true;
+}
+
+void CRhPointCloudOctree::Close()
+{
+  if ( m_fp )
+    ON::CloseFile( m_fp );
+  m_fp = 0;
+  m_nodes.Destroy();
+  m_point_count = 0;
+  m_source_key = 0;
+  m_bHasColors = false;
+}
+
+bool CRhPointCloudOctree::IsOpen() const
+{
+  return m_fp != 0;
+}
+
+int CRhPointCloudOctree::NodeCount() const
+{
+  return m_nodes.Count();
+}
+
+int CRhPointCloudOctree::NodePointCount( int node_index ) const
+{
+  return m_nodes[node_index].m_point_count;
+}
+
+ON__INT64 CRhPointCloudOctree::PointCount() const
+{
+  return m_point_count;
+}
+
+ON__UINT64 CRhPointCloudOctree::SourceKey() const
+{
+  return m_source_key;
+}
+
+bool CRhPointCloudOctree::HasColors() const
+{
+  return m_bHasColors;
+}
+
+ON_BoundingBox CRhPointCloudOctree::BoundingBox() const
+{
+  ON_BoundingBox bbox;
+  if ( m_nodes.Count() > 0 ) {
+    const Node& root = m_nodes[0];
+    bbox.m_min.Set( root.m_min[0], root.m_min[1], root.m_min[2] );
+    bbox.m_max.Set( root.m_max[0], root.m_max[1], root.m_max[2] );
+  }
+  return bbox;
+}
+
+//////////////////////////////////////////////////////////////
+//
+bool CRhPointCloudOctree::ReadNode(
+                            int node_index,
+                            ON_SimpleArray<ON_3fPoint>& points,
+                            ON_SimpleArray<ON_Color>& colors
+                            ) const
+{
+  RH_TRACE_SCOPE_ARG( "CRhPointCloudOctree::ReadNode", node_index );
+  points.SetCount( 0 );
+  colors.SetCount( 0 );
+  if ( m_fp == NULL || node_index < 0 || node_index >= m_nodes.Count() )
+    return false;
+
+  const Node& node = m_nodes[node_index];
+  if ( node.m_point_count <= 0 )
+    return true;
+  if ( 0 != fseeko( m_fp, (off_t)node.m_offset, SEEK_SET ) )
+    return false;
+
+  points.Reserve( node.m_point_count );
+  points.SetCount( node.m_point_count );
+  if ( node.m_point_count != (int)fread( points.Array(), sizeof(ON_3fPoint), node.m_point_count, m_fp ) ) {
+    points.SetCount( 0 );
+    return false;
+  }
+
+  if ( m_bHasColors ) {
+    colors.Reserve( node.m_point_count );
+    colors.SetCount( node.m_point_count );
+    if ( node.m_point_count != (int)fread( colors.Array(), sizeof(ON_Color), node.m_point_count, m_fp ) ) {
+      points.SetCount( 0 );
+      colors.SetCount( 0 );
+      return false;
+    }
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////////////////
+//
+// Projected size of a node in pixels.  Returns false if the node is
+// entirely outside the view.
+//
+static bool ProjectNode(
+              const CRhPointCloudOctree::Node& node,
+              const ON_Xform& world_to_clip,
+              int width,
+              int height,
+              double* pixel_size
+              )
+{
+  double x0 = 1.0e300, y0 = 1.0e300, x1 = -1.0e300, y1 = -1.0e300;
+  for ( int corner = 0; corner < 8; corner++ ) {
+    ON_4dPoint P( (corner&1) ? node.m_max[0] : node.m_min[0],
+                  (corner&2) ? node.m_max[1] : node.m_min[1],
+                  (corner&4) ? node.m_max[2] : node.m_min[2],
+                  1.0 );
+    P = world_to_clip*P;
+    if ( P.w <= 0.0 ) {
+      // the node straddles the camera plane; treat it as filling the view
+      *pixel_size = (width > height) ? width : height;
+      return true;
+    }
+    const double x = P.x/P.w;
+    const double y = P.y/P.w;
+    if ( x < x0 ) x0 = x;
+    if ( x > x1 ) x1 = x;
+    if ( y < y0 ) y0 = y;
+    if ( y > y1 ) y1 = y;
+  }
+
+  if ( x1 < -1.0 || x0 > 1.0 || y1 < -1.0 || y0 > 1.0 )
+    return false;
+
+  const double w = 0.5*(x1 - x0)*width;
+  const double h = 0.5*(y1 - y0)*height;
+  *pixel_size = (w > h) ? w : h;
+  return true;
+}
+
+int CRhPointCloudOctree::SelectNodes(
+                           const ON_Viewport& viewport,
+                           int width,
+                           int height,
+                           int point_budget,
+                           double point_spacing,
+                           ON_SimpleArray<int>& nodes
+                           ) const
+{
+  nodes.SetCount( 0 );
+  if ( m_nodes.Count() == 0 )
+    return 0;
+
+  ON_Xform world_to_clip;
+  if ( !viewport.GetXform( ON::world_cs, ON::clip_cs, world_to_clip ) )
+    return 0;
+
+  // Refine the nodes that are largest on screen first, so when the
+  // budget runs out the detail went where it is most visible.
+  ON_SimpleArray<int> candidates;
+  ON_SimpleArray<double> candidate_size;
+  double size;
+  if ( ProjectNode( m_nodes[0], world_to_clip, width, height, &size ) ) {
+    candidates.Append( 0 );
+    candidate_size.Append( size );
+  }
+
+  int selected_point_count = 0;
+  while ( candidates.Count() > 0 ) {
+    int best = 0;
+    for ( int i = 1; i < candidates.Count(); i++ ) {
+      if ( candidate_size[i] > candidate_size[best] )
+        best = i;
+    }
+    const int node_index = candidates[best];
+    size = candidate_size[best];
+    candidates.Remove( best );
+    candidate_size.Remove( best );
+
+    const Node& node = m_nodes[node_index];
+    if ( selected_point_count + node.m_point_count > point_budget )
+      break;
+    nodes.Append( node_index );
+    selected_point_count += node.m_point_count;
+
+    // average distance between neighboring points on screen
+    const double spacing = (node.m_point_count > 0) ? size/sqrt((double)node.m_point_count) : size;
+    if ( spacing <= point_spacing )
+      continue;
+
+    for ( int k = 0; k < 8; k++ ) {
+      const int child_index = node.m_child[k];
+      if ( child_index >= 0 && ProjectNode( m_nodes[child_index], world_to_clip, width, height, &size ) ) {
+        candidates.Append( child_index );
+        candidate_size.Append( size );
+      }
+    }
+  }
+
+  return selected_point_count;
+}
@@ -0,0 +1,136 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_POINT_CLOUD_OCTREE_INC_)
+#define RH_POINT_CLOUD_OCTREE_INC_
+
+#include <stdio.h>
+
+/*
+Description:
+  Level of detail octree for drawing very large point clouds.
+
+  The octree lives in a cache file and only the small node table is
+  kept in memory; the points of a node are read when the node is
+  drawn.  Every node holds an evenly spread sample of the points below
+  it and its children hold the rest, so drawing any node together with
+  all of its ancestors draws each point at most once and a coarse
+  version of the cloud is always available from the top few nodes.
+
+  Build() needs the whole ON_PointCloud in memory once.  After that the
+  cache file is opened with Open() and the cloud itself is not needed.
+  The file records a key of the source it was built from, so a cache
+  left over from a different version of the model can be told apart.
+*/
+class CRhPointCloudOctree
+{
+public:
+  CRhPointCloudOctree();
+  ~CRhPointCloudOctree();
+
+  /*
+  Description:
+    Builds the octree for a point cloud and writes it to a cache file.
+  Parameters:
+    cloud - [in/out] The points and colors are sorted into octree
+                     order in place.  Other per point arrays, like the
+                     normals, no longer match the points afterwards.
+    filename - [in]
+    source_key - [in] saved in the file, see SourceKey()
+  Returns:
+    true if the file was written.
+  */
+  static bool Build( ON_PointCloud& cloud, const char* filename, ON__UINT64 source_key );
+
+  /*
+  Description:
+    Opens a cache file written by Build() and reads its node table.
+  */
+  bool Open( const char* filename );
+  void Close();
+  bool IsOpen() const;
+
+  int NodeCount() const;
+  int NodePointCount( int node_index ) const;
+  ON__INT64 PointCount() const;
+
+  // source_key passed to Build()
+  ON__UINT64 SourceKey() const;
+
+  bool HasColors() const;
+  ON_BoundingBox BoundingBox() const;
+
+  /*
+  Description:
+    Picks the nodes to draw for a view.
+  Parameters:
+    viewport - [in] view to draw
+    width, height - [in] size of the view in pixels
+    point_budget - [in] maximum number of points to select
+    point_spacing - [in] nodes whose points are closer than this many
+                         pixels on screen are not refined
+    nodes - [out] selected nodes, parents before children
+  Returns:
+    Number of points in the selected nodes.
+  */
+  int SelectNodes(
+        const ON_Viewport& viewport,
+        int width,
+        int height,
+        int point_budget,
+        double point_spacing,
+        ON_SimpleArray<int>& nodes
+        ) const;
+
+  /*
+  Description:
+    Reads the points of a node from the cache file.  Not thread safe;
+    all reads must come from one thread at a time.
+  Parameters:
+    points - [out] node points
+    colors - [out] node point colors, empty if !HasColors()
+  */
+  bool ReadNode(
+        int node_index,
+        ON_SimpleArray<ON_3fPoint>& points,
+        ON_SimpleArray<ON_Color>& colors
+        ) const;
+
+public:
+  // On disk node record
+  struct Node
+  {
+    float     m_min[3];           // bounding box of every point in this node and below it
+    float     m_max[3];
+    ON__INT32 m_child[8];         // -1 = no child
+    ON__INT32 m_point_count;      // points stored in this node
+    ON__INT32 m_reserved;
+    ON__INT64 m_offset;           // file offset of this node's points
+  };
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhPointCloudOctree(const CRhPointCloudOctree&);
+  CRhPointCloudOctree& operator=(const CRhPointCloudOctree&);
+
+private:
+  FILE* m_fp;
+  ON_SimpleArray<Node> m_nodes;
+  ON__INT64 m_point_count;
+  ON__UINT64 m_source_key;
+  bool m_bHasColors;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+
+#include <math.h>
+
+#include "RhResolutionController.h"
+
+// Scales are multiples of ScaleStep so the size of the image, and the way
+// edges are filtered, does not change with every frame.
+static const double ScaleStep = 1.0/16.0;
+
+// Frames faster than this fraction of the budget raise the scale.  The gap
+// up to the budget keeps the scale from bouncing between two steps.
+static const double RaiseFraction = 0.7;
+
+// A frame is limited by the GPU when at least this fraction of it was
+// spent waiting for the GPU in presentRenderbuffer.
+static const double GpuBoundFraction = 0.4;
+
+// Largest cut in one frame, so one slow frame does not blur the view
+static const double MaxDropFactor = 0.75;
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhResolutionController::CRhResolutionController( double budget_ms, double min_scale )
+: m_budget_ms(budget_ms)
+, m_min_scale(min_scale > 0.0 && min_scale < 1.0 ? min_scale : 1.0)
+, m_scale(1.0)
+, m_average_ms(0.0)
+{
+}
+
+double CRhResolutionController::Scale() const
+{
+  return m_scale;
+}
+
+int CRhResolutionController::ScaledSize( int size ) const
+{
+  const int scaled_size = (int)floor( size*m_scale + 0.5 );
+  return scaled_size > 0 ? scaled_size : 1;
+}
+
+void CRhResolutionController::Reset()
+{
+  m_scale = 1.0;
+  m_average_ms = 0.0;
+}
+
+void CRhResolutionController::FrameDrawn( double frame_ms, double present_ms )
+{
+  if ( !(frame_ms > 0.0) )
+    return;
+
+  // a little smoothing so a single hitch does not change the scale
+  m_average_ms = ( m_average_ms > 0.0 ) ? 0.5*(m_average_ms + frame_ms) : frame_ms;
+
+  double scale = m_scale;
+  if ( m_average_ms > m_budget_ms )
+  {
+    if ( present_ms < GpuBoundFraction*frame_ms )
+      return;
+
+    // fill cost goes with the number of pixels, the square of the scale
+    double factor = sqrt( m_budget_ms/m_average_ms );
+    if ( factor < MaxDropFactor )
+      factor = MaxDropFactor;
+    scale = floor( m_scale*factor/ScaleStep )*ScaleStep;
+    if ( scale < m_min_scale )
+      scale = m_min_scale;
+  }
+  else if ( m_average_ms < RaiseFraction*m_budget_ms )
+  {
+    scale = m_scale + ScaleStep;
+    if ( scale > 1.0 )
+      scale = 1.0;
+  }
+
+  if ( scale != m_scale )
+  {
+    // frames drawn at the old scale say nothing about the new one
+    m_scale = scale;
+    m_average_ms = 0.0;
+  }
+}
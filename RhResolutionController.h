@@ -0,0 +1,72 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+
+#if !defined(RH_RESOLUTION_CONTROLLER_INC_)
+#define RH_RESOLUTION_CONTROLLER_INC_
+
+/*
+Description:
+  Picks the resolution of the frames drawn while the view is moving.
+
+  While RhinoApp.fastDrawing is set the renderers draw into part of their
+  offscreen texture, Scale() times the width and height of the view, and
+  stretch it over the view.  After every such frame they report what it
+  cost and the scale is lowered when the frames are over budget and raised
+  again, a step at a time, when there is time to spare.  Frames drawn when
+  the view stops moving are always drawn at full resolution and
+  antialiased; the scale is kept for the next gesture.
+
+  Only the render thread may use a controller.
+*/
+class CRhResolutionController
+{
+public:
+  /*
+  Parameters:
+    budget_ms - [in] frame time to aim for while the view is moving.
+    min_scale - [in] smallest Scale(), 0 < min_scale <= 1.
+  */
+  CRhResolutionController( double budget_ms = 1000.0/30.0, double min_scale = 0.5 );
+
+  // Scale of the width and height of the next moving frame, min_scale to 1.0
+  double Scale() const;
+
+  // size*Scale(), at least 1
+  int ScaledSize( int size ) const;
+
+  /*
+  Description:
+    Reports the cost of a moving frame drawn at Scale().
+  Parameters:
+    frame_ms - [in] submit plus present time of the frame.
+    present_ms - [in] time spent in presentRenderbuffer, which waits for
+                 the GPU.  When little of the frame was spent there the
+                 frame is limited by the CPU and a lower resolution would
+                 not help, so the scale is not lowered.
+  */
+  void FrameDrawn( double frame_ms, double present_ms );
+
+  // Back to full resolution, e.g. when the size of the view changes
+  void Reset();
+
+private:
+  const double m_budget_ms;
+  const double m_min_scale;
+  double m_scale;
+  double m_average_ms;      // smoothed frame time at m_scale, 0 until a frame is drawn
+};
+
+#endif
@@ -0,0 +1,122 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhScratchArena.h"
+
+// Every allocation is aligned for doubles and 16 byte vector loads
+static const size_t ArenaAlignment = 16;
+
+static inline size_t AlignedSize( size_t sz )
+{
+  return (sz + ArenaAlignment - 1) & ~(ArenaAlignment - 1);
+}
+
+// the block header is padded so the first allocation is aligned too
+static inline unsigned char* BlockMemory( void* block, size_t sizeof_header )
+{
+  return (unsigned char*)block + sizeof_header;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhScratchArena::CRhScratchArena( size_t block_size, size_t max_retained_size )
+: m_blocks(0)
+, m_block_size(AlignedSize(block_size))
+, m_max_retained_size(max_retained_size)
+, m_allocated_size(0)
+{
+}
+
+CRhScratchArena::~CRhScratchArena()
+{
+  FreeBlocks();
+}
+
+CRhScratchArena::Block* CRhScratchArena::NewBlock( size_t min_size )
+{
+  size_t size = m_block_size;
+  while ( size < min_size )
+    size *= 2;
+  Block* block = (Block*)malloc( AlignedSize(sizeof(Block)) + size );
+  if ( block == NULL )
+    return NULL;
+  block->m_next = m_blocks;
+  block->m_size = size;
+  block->m_used = 0;
+  m_blocks = block;
+  return block;
+}
+
+void CRhScratchArena::FreeBlocks()
+{
+  while ( m_blocks ) {
+    Block* next = m_blocks->m_next;
+    free( m_blocks );
+    m_blocks = next;
+  }
+}
+
+void* CRhScratchArena::Allocate( size_t sz )
+{
+  if ( sz == 0 )
+    return NULL;
+  sz = AlignedSize( sz );
+
+  Block* block = m_blocks;
+  if ( block == NULL || block->m_size - block->m_used < sz ) {
+    block = NewBlock( sz );
+    if ( block == NULL )
+      return NULL;
+  }
+
+  void* p = BlockMemory( block, AlignedSize(sizeof(Block)) ) + block->m_used;
+  block->m_used += sz;
+  m_allocated_size += sz;
+  return p;
+}
+
+void* CRhScratchArena::AllocateZeroed( size_t count, size_t sz )
+{
+  void* p = Allocate( count*sz );
+  if ( p )
+    memset( p, 0, count*sz );
+  return p;
+}
+
+void CRhScratchArena::Reset()
+{
+  if ( m_blocks && m_blocks->m_next == NULL && m_blocks->m_size <= m_max_retained_size ) {
+    // the usual case: everything fit in one block
+    m_blocks->m_used = 0;
+    m_allocated_size = 0;
+    return;
+  }
+
+  // Several blocks were needed.  Next time start with one block that holds
+  // them all, unless that is more than we are willing to keep around.
+  size_t total_size = 0;
+  for ( Block* block = m_blocks; block; block = block->m_next )
+    total_size += block->m_size;
+  FreeBlocks();
+  if ( total_size <= m_max_retained_size && total_size > m_block_size )
+    m_block_size = total_size;
+  m_allocated_size = 0;
+}
+
+size_t CRhScratchArena::AllocatedSize() const
+{
+  return m_allocated_size;
+}
@@ -0,0 +1,83 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_SCRATCH_ARENA_INC_)
+#define RH_SCRATCH_ARENA_INC_
+
+/*
+Description:
+  Bump allocator for buffers that only live while one object is turned
+  into display data, like the interleaved vertex and index buffers that
+  are handed to glBufferData() and thrown away.
+
+  Allocate() takes memory from the current block and Reset() releases
+  everything at once.  When a round of allocations needed more than one
+  block, Reset() replaces the blocks with a single block that is big
+  enough, so after the first few objects a round costs no heap calls.
+
+  An arena is not thread safe.  Use one per thread.
+*/
+class CRhScratchArena
+{
+public:
+  /*
+  Parameters:
+    block_size - [in] size of the first block.
+    max_retained_size - [in] Reset() frees blocks bigger than this so
+                   one huge object does not pin its memory for the rest
+                   of the load.
+  */
+  CRhScratchArena( size_t block_size = 256*1024, size_t max_retained_size = 4*1024*1024 );
+  ~CRhScratchArena();
+
+  /*
+  Returns:
+    sz bytes aligned for any type, or NULL if out of memory.  The memory
+    is valid until the next Reset().
+  */
+  void* Allocate( size_t sz );
+
+  // Like calloc()
+  void* AllocateZeroed( size_t count, size_t sz );
+
+  // Releases everything allocated since the last Reset()
+  void Reset();
+
+  // Bytes handed out since the last Reset()
+  size_t AllocatedSize() const;
+
+private:
+  struct Block
+  {
+    Block* m_next;
+    size_t m_size;      // usable bytes after the header
+    size_t m_used;
+  };
+
+  Block* NewBlock( size_t min_size );
+  void FreeBlocks();
+
+  Block* m_blocks;      // current block first
+  size_t m_block_size;
+  const size_t m_max_retained_size;
+  size_t m_allocated_size;
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhScratchArena(const CRhScratchArena&);
+  CRhScratchArena& operator=(const CRhScratchArena&);
+};
+
+#endif
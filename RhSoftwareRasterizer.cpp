@@ -0,0 +1,657 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhSoftwareRasterizer.h"
+#include "RhDisplayData.h"
+#include "RhTrace.h"
+
+// Meshes are claimed a few at a time; most are small
+static const int MeshesPerClaim = 4;
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhRasterScene::CRhRasterScene()
+: m_opaque_count(0)
+, m_triangle_count(0)
+, m_owned_bytes(0)
+{
+}
+
+CRhRasterScene::~CRhRasterScene()
+{
+  Destroy();
+}
+
+void CRhRasterScene::Destroy()
+{
+  for ( int i = 0; i < m_meshes.Count(); i++ )
+    delete m_meshes[i];
+  m_meshes.Destroy();
+  for ( int i = 0; i < m_owned_buffers.Count(); i++ )
+    onfree( m_owned_buffers[i] );
+  m_owned_buffers.Destroy();
+  m_owned_bytes = 0;
+  m_opaque_count = 0;
+  m_triangle_count = 0;
+  m_bbox.Destroy();
+}
+
+int CRhRasterScene::MeshCount() const
+{
+  return m_meshes.Count();
+}
+
+ON__INT64 CRhRasterScene::TriangleCount() const
+{
+  return m_triangle_count;
+}
+
+ON_BoundingBox CRhRasterScene::BoundingBox() const
+{
+  return m_bbox;
+}
+
+ON__UINT64 CRhRasterScene::SizeOf() const
+{
+  return m_meshes.SizeOfArray()
+       + m_meshes.Count()*sizeof(Mesh)
+       + m_owned_buffers.SizeOfArray()
+       + m_owned_bytes;
+}
+
+bool CRhRasterScene::AddDisplayBuffers(
+        const void* vertices,
+        int vertex_count,
+        bool bHasNormals,
+        bool bHasColors,
+        const unsigned short* indexes,
+        int triangle_count,
+        const ON_3fVector& offset,
+        const ON_Material& material
+        )
+{
+  if ( vertices == NULL || vertex_count <= 0 || indexes == NULL || triangle_count <= 0 )
+    return false;
+
+  for ( int i = 0; i < 3*triangle_count; i++ ) {
+    if ( indexes[i] >= vertex_count )
+      return false;
+  }
+
+  // the layouts DisplayMesh gives OpenGL, see drawMesh:
+  Mesh* mesh = new Mesh;
+  mesh->m_vertices = (const unsigned char*)vertices;
+  mesh->m_T = indexes;
+  mesh->m_vertex_count = vertex_count;
+  mesh->m_triangle_count = triangle_count;
+  if ( bHasColors )
+    mesh->m_stride = bHasNormals ? sizeof(VNCData) : sizeof(VCData);
+  else
+    mesh->m_stride = bHasNormals ? sizeof(VertexData) : sizeof(ON_3fPoint);
+  mesh->m_color_offset = bHasNormals ? sizeof(ON_3fPoint) + sizeof(ON_3fVector) : sizeof(ON_3fPoint);
+  mesh->m_bHasNormals = bHasNormals;
+  mesh->m_bHasColors = bHasColors;
+  mesh->m_offset = offset;
+  mesh->m_material = material;
+
+  const unsigned char* p = mesh->m_vertices;
+  for ( int i = 0; i < vertex_count; i++, p += mesh->m_stride )
+    m_bbox.Set( ON_3dPoint( *(const ON_3fPoint*)p + offset ), true );
+
+  // opaque meshes are drawn first, in the order they were added
+  if ( material.Transparency() > 0.0 )
+    m_meshes.Append( mesh );
+  else
+    m_meshes.Insert( m_opaque_count++, mesh );
+  m_triangle_count += triangle_count;
+  return true;
+}
+
+bool CRhRasterScene::AddMesh( ON_Mesh& mesh, const ON_Material& material )
+{
+  // the partitions DisplayMesh makes, so the mesh only gets partitioned once
+  const ON_MeshPartition* partition = mesh.CreatePartition( USHRT_MAX-3, INT_MAX-3 );
+  if ( partition == NULL )
+    return false;
+
+  const bool bHasNormals = mesh.HasVertexNormals() ? true : false;
+  const bool bHasColors = mesh.HasVertexColors() ? true : false;
+  size_t stride;
+  if ( bHasColors )
+    stride = bHasNormals ? sizeof(VNCData) : sizeof(VCData);
+  else
+    stride = bHasNormals ? sizeof(VertexData) : sizeof(ON_3fPoint);
+  const ON_3fVector offset( 0.0f, 0.0f, 0.0f );
+  bool rc = true;
+
+  for ( int idx = 0; idx < partition->m_part.Count() && rc; idx++ ) {
+    const struct ON_MeshPart& part = partition->m_part[idx];
+    const size_t vertex_bytes = part.vertex_count*stride;
+    const size_t index_bytes = 3*part.triangle_count*sizeof(unsigned short);
+    void* vertices = onmalloc( vertex_bytes );
+    unsigned short* indexes = (unsigned short*)onmalloc( index_bytes );
+    if ( vertices )
+      m_owned_buffers.Append( vertices );
+    if ( indexes )
+      m_owned_buffers.Append( indexes );
+    if ( vertices == NULL || indexes == NULL )
+      return false;
+    m_owned_bytes += vertex_bytes + index_bytes;
+
+    if ( bHasColors && bHasNormals )
+      RhGetVNCData( mesh, part, offset, (VNCData*)vertices );
+    else if ( bHasColors )
+      RhGetVCData( mesh, part, offset, (VCData*)vertices );
+    else if ( bHasNormals )
+      RhGetVertexData( mesh, part, offset, (VertexData*)vertices );
+    else
+      memcpy( vertices, &mesh.m_V[part.vi[0]], vertex_bytes );
+
+    const int triangle_count = RhGetTriangleIndexes( mesh, part, indexes );
+    rc = AddDisplayBuffers( vertices, part.vertex_count, bHasNormals, bHasColors,
+                            indexes, triangle_count, offset, material );
+  }
+  return rc;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+// A vertex before projection, while triangles are clipped
+struct RhClipVertex
+{
+  float clip[4];
+  float c[4];
+};
+
+// bit 1: in front of the near plane or at the eye, bit 2: behind the far plane
+static unsigned int ClipCode( const RhClipVertex& v )
+{
+  unsigned int code = 0;
+  if ( v.clip[3] + v.clip[2] < 0.0f || v.clip[3] <= 0.0f )
+    code |= 1;
+  if ( v.clip[3] - v.clip[2] < 0.0f )
+    code |= 2;
+  return code;
+}
+
+static float PlaneDistance( const RhClipVertex& v, int plane )
+{
+  return ( plane == 0 ) ? v.clip[3] + v.clip[2] : v.clip[3] - v.clip[2];
+}
+
+// One Sutherland-Hodgman pass; returns the new vertex count
+static int ClipPolygon( const RhClipVertex* in, int count, int plane, RhClipVertex* out )
+{
+  int out_count = 0;
+  for ( int i = 0; i < count; i++ ) {
+    const RhClipVertex& a = in[i];
+    const RhClipVertex& b = in[(i+1)%count];
+    const float da = PlaneDistance( a, plane );
+    const float db = PlaneDistance( b, plane );
+    if ( da >= 0.0f )
+      out[out_count++] = a;
+    if ( (da >= 0.0f) != (db >= 0.0f) ) {
+      const float t = da/(da - db);
+      RhClipVertex& v = out[out_count++];
+      for ( int k = 0; k < 4; k++ ) {
+        v.clip[k] = a.clip[k] + t*(b.clip[k] - a.clip[k]);
+        v.c[k] = a.c[k] + t*(b.c[k] - a.c[k]);
+      }
+    }
+  }
+  return out_count;
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhSoftwareRasterizer::CRhSoftwareRasterizer()
+: m_width(0)
+, m_height(0)
+, m_scene(NULL)
+, m_supersample(1)
+, m_tile_columns(0)
+, m_tile_rows(0)
+{
+}
+
+CRhSoftwareRasterizer::~CRhSoftwareRasterizer()
+{
+}
+
+int CRhSoftwareRasterizer::Width() const
+{
+  return m_width;
+}
+
+int CRhSoftwareRasterizer::Height() const
+{
+  return m_height;
+}
+
+const unsigned char* CRhSoftwareRasterizer::Pixels() const
+{
+  return m_pixels.Array();
+}
+
+bool CRhSoftwareRasterizer::Render(
+        const CRhRasterScene& scene,
+        const ON_Viewport& viewport,
+        int width,
+        int height,
+        const ON_Color& background,
+        int supersample,
+        CRhJobSystem::priority job_priority
+        )
+{
+  RH_TRACE_SCOPE_ARG( "CRhSoftwareRasterizer::Render", (int)scene.TriangleCount() );
+
+  m_width = 0;
+  m_height = 0;
+  m_pixels.SetCount( 0 );
+  if ( width <= 0 || height <= 0 || width > INT_MAX/4/height )
+    return false;
+  if ( !viewport.GetXform( ON::world_cs, ON::clip_cs, m_world_to_clip ) )
+    return false;
+  if ( !viewport.GetXform( ON::world_cs, ON::camera_cs, m_world_to_camera ) )
+    return false;
+
+  m_pixels.Reserve( 4*width*height );
+  m_pixels.SetCount( 4*width*height );
+  m_width = width;
+  m_height = height;
+  m_scene = &scene;
+  m_supersample = supersample < 1 ? 1 : ( supersample > max_supersample ? max_supersample : supersample );
+  m_background[0] = (float)background.FractionRed();
+  m_background[1] = (float)background.FractionGreen();
+  m_background[2] = (float)background.FractionBlue();
+  m_background[3] = (float)background.FractionAlpha();
+
+  // the light the renderers give their shaders in setupActiveShader:
+  ON_Light light;
+  light.Default();
+  light.m_direction.z = -light.m_direction.z;
+  m_light_direction = ON_3fVector( light.Direction() );
+  m_light_direction.Unitize();
+  m_half_vector = m_light_direction + ON_3fVector( 0.0f, 0.0f, 1.0f );
+  m_half_vector.Unitize();
+  m_light_diffuse[0] = (float)light.Diffuse().FractionRed();
+  m_light_diffuse[1] = (float)light.Diffuse().FractionGreen();
+  m_light_diffuse[2] = (float)light.Diffuse().FractionBlue();
+  m_light_specular[0] = (float)light.Specular().FractionRed();
+  m_light_specular[1] = (float)light.Specular().FractionGreen();
+  m_light_specular[2] = (float)light.Specular().FractionBlue();
+
+  const int mesh_count = scene.m_meshes.Count();
+  m_mesh_work.Destroy();
+  m_mesh_work.Reserve( mesh_count );
+  for ( int i = 0; i < mesh_count; i++ )
+    m_mesh_work.AppendNew();
+
+  {
+    RH_TRACE_SCOPE( "setup meshes" );
+    if ( mesh_count > MeshesPerClaim ) {
+      CRhJobGroup jobs( job_priority );
+      jobs.ParallelFor( mesh_count, MeshesPerClaim, SetupJob, this );
+      jobs.Wait();
+    }
+    else
+      SetupJob( this, 0, mesh_count );
+  }
+
+  m_tile_columns = (width + tile_size - 1)/tile_size;
+  m_tile_rows = (height + tile_size - 1)/tile_size;
+  BinTriangles();
+
+  {
+    RH_TRACE_SCOPE( "draw tiles" );
+    const int tile_count = m_tile_columns*m_tile_rows;
+    if ( tile_count > 1 ) {
+      CRhJobGroup jobs( job_priority );
+      jobs.ParallelFor( tile_count, 1, TileJob, this );
+      jobs.Wait();
+    }
+    else
+      TileJob( this, 0, tile_count );
+  }
+
+  m_mesh_work.Destroy();
+  m_tile_bins.Destroy();
+  m_scene = NULL;
+  return true;
+}
+
+//////////////////////////////////////////////////////////////
+//
+// Transforms, lights and clips one mesh the way the per vertex lighting
+// shader and OpenGL would.
+void CRhSoftwareRasterizer::SetupMesh( int mesh_index )
+{
+  const CRhRasterScene::Mesh& mesh = *m_scene->m_meshes[mesh_index];
+  MeshWork& work = m_mesh_work[mesh_index];
+  const int vertex_count = mesh.m_vertex_count;
+  const bool bHasNormals = mesh.m_bHasNormals;
+  const bool bHasColors = mesh.m_bHasColors;
+
+  // CRhGLShaderProgram::SetupMaterial()
+  const ON_Material& material = mesh.m_material;
+  const ON_Color diffuse = material.Diffuse();
+  const ON_Color specular = material.Specular();
+  const float shine = (float)(128.0*(material.Shine()/ON_Material::MaxShine()));
+  const float diff[3] = { (float)diffuse.FractionRed()*m_light_diffuse[0],
+                          (float)diffuse.FractionGreen()*m_light_diffuse[1],
+                          (float)diffuse.FractionBlue()*m_light_diffuse[2] };
+  float spec[3] = { 0.0f, 0.0f, 0.0f };
+  if ( shine > 0.0f ) {
+    spec[0] = (float)specular.FractionRed()*m_light_specular[0];
+    spec[1] = (float)specular.FractionGreen()*m_light_specular[1];
+    spec[2] = (float)specular.FractionBlue()*m_light_specular[2];
+  }
+  const float alpha = (float)(1.0 - material.Transparency());
+  work.m_ambient[0] = work.m_ambient[1] = work.m_ambient[2] = 0.0f;
+  if ( material.m_ambient.Alpha() > 0 ) {
+    work.m_ambient[0] = (float)material.Ambient().FractionRed();
+    work.m_ambient[1] = (float)material.Ambient().FractionGreen();
+    work.m_ambient[2] = (float)material.Ambient().FractionBlue();
+  }
+  work.m_bBlend = alpha < 1.0f;
+
+  const float sample_width = (float)(m_width*m_supersample);
+  const float sample_height = (float)(m_height*m_supersample);
+
+  ON_SimpleArray<RhClipVertex> clip_vertices( vertex_count );
+  ON_SimpleArray<unsigned char> clip_codes( vertex_count );
+  work.m_V.Reserve( vertex_count );
+  work.m_V.SetCount( vertex_count );
+  const unsigned char* p = mesh.m_vertices;
+  for ( int i = 0; i < vertex_count; i++, p += mesh.m_stride ) {
+    const ON_3dPoint P( *(const ON_3fPoint*)p + mesh.m_offset );
+    RhClipVertex& cv = clip_vertices.AppendNew();
+    const ON_4dPoint clip = m_world_to_clip*ON_4dPoint( P.x, P.y, P.z, 1.0 );
+    cv.clip[0] = (float)clip.x;
+    cv.clip[1] = (float)clip.y;
+    cv.clip[2] = (float)clip.z;
+    cv.clip[3] = (float)clip.w;
+
+    // PerVertexLighting.vsh
+    ON_3fVector N( 0.0f, 0.0f, 1.0f );
+    if ( bHasNormals ) {
+      const ON_3fPoint view( m_world_to_camera*P );
+      N = ON_3fVector( m_world_to_camera*ON_3dVector( *(const ON_3fVector*)(p + sizeof(ON_3fPoint)) ) );
+      if ( -(view.x*N.x + view.y*N.y + view.z*N.z) < 0.0f )
+        N = -N;
+      N.Unitize();
+    }
+    const float d = N*m_light_direction;
+    const float s = N*m_half_vector;
+    const float dfactor = d > 0.0f ? d : 0.0f;
+    const float sfactor = s > 0.0f ? (float)pow( s, shine ) : 0.0f;
+    for ( int k = 0; k < 3; k++ ) {
+      float c = diff[k]*dfactor;
+      if ( bHasColors )
+        c *= ((const float*)(p + mesh.m_color_offset))[k];
+      cv.c[k] = work.m_ambient[k] + c + spec[k]*sfactor;
+    }
+    cv.c[3] = alpha;
+    clip_codes.Append( (unsigned char)ClipCode( cv ) );
+
+    if ( clip_codes[i] == 0 ) {
+      ScreenVertex& sv = work.m_V[i];
+      sv.inv_w = 1.0f/cv.clip[3];
+      sv.x = (0.5f + 0.5f*cv.clip[0]*sv.inv_w)*sample_width;
+      sv.y = (0.5f - 0.5f*cv.clip[1]*sv.inv_w)*sample_height;
+      sv.z = 0.5f + 0.5f*cv.clip[2]*sv.inv_w;
+      for ( int k = 0; k < 4; k++ )
+        sv.c[k] = cv.c[k]*sv.inv_w;
+    }
+  }
+
+  const int triangle_count = mesh.m_triangle_count;
+  work.m_T.Reserve( triangle_count );
+  for ( int t = 0; t < triangle_count; t++ ) {
+    const int i0 = mesh.m_T[3*t], i1 = mesh.m_T[3*t+1], i2 = mesh.m_T[3*t+2];
+    const unsigned int c0 = clip_codes[i0], c1 = clip_codes[i1], c2 = clip_codes[i2];
+    if ( c0 & c1 & c2 )
+      continue;     // entirely in front of the near plane or behind the far plane
+    if ( (c0 | c1 | c2) == 0 ) {
+      AddTriangle( work, i0, i1, i2 );
+      continue;
+    }
+
+    // Clip against both planes and fan the polygon; the new vertices go on
+    // the end of work.m_V.
+    RhClipVertex polygon[8], clipped[8];
+    polygon[0] = clip_vertices[i0];
+    polygon[1] = clip_vertices[i1];
+    polygon[2] = clip_vertices[i2];
+    int count = ClipPolygon( polygon, 3, 0, clipped );
+    count = ClipPolygon( clipped, count, 1, polygon );
+    if ( count < 3 )
+      continue;
+    const int first = work.m_V.Count();
+    for ( int j = 0; j < count; j++ ) {
+      const RhClipVertex& cv = polygon[j];
+      ScreenVertex& sv = work.m_V.AppendNew();
+      sv.inv_w = cv.clip[3] > 0.0f ? 1.0f/cv.clip[3] : 0.0f;
+      sv.x = (0.5f + 0.5f*cv.clip[0]*sv.inv_w)*sample_width;
+      sv.y = (0.5f - 0.5f*cv.clip[1]*sv.inv_w)*sample_height;
+      sv.z = 0.5f + 0.5f*cv.clip[2]*sv.inv_w;
+      for ( int k = 0; k < 4; k++ )
+        sv.c[k] = cv.c[k]*sv.inv_w;
+    }
+    for ( int j = 1; j+1 < count; j++ )
+      AddTriangle( work, first, first+j, first+j+1 );
+  }
+}
+
+// Keeps triangles that cover a sample of the image, with their sample bounding box
+void CRhSoftwareRasterizer::AddTriangle( MeshWork& work, int i0, int i1, int i2 ) const
+{
+  const ScreenVertex& a = work.m_V[i0];
+  const ScreenVertex& b = work.m_V[i1];
+  const ScreenVertex& c = work.m_V[i2];
+  if ( a.inv_w <= 0.0f || b.inv_w <= 0.0f || c.inv_w <= 0.0f )
+    return;
+  const double area = ((double)b.x - a.x)*((double)c.y - a.y) - ((double)b.y - a.y)*((double)c.x - a.x);
+  if ( !(area != 0.0) || !ON_IsValid( area ) )
+    return;     // degenerate or not a number
+
+  const float minx = ON_Min( a.x, ON_Min( b.x, c.x ) );
+  const float maxx = ON_Max( a.x, ON_Max( b.x, c.x ) );
+  const float miny = ON_Min( a.y, ON_Min( b.y, c.y ) );
+  const float maxy = ON_Max( a.y, ON_Max( b.y, c.y ) );
+  const int sample_width = m_width*m_supersample;
+  const int sample_height = m_height*m_supersample;
+
+  if ( maxx < 0.0f || maxy < 0.0f || minx >= sample_width || miny >= sample_height )
+    return;     // off the image
+
+  // samples are at pixel centers
+  Triangle t;
+  t.bbox[0] = minx < 0.0f ? 0 : (int)floor( minx );
+  t.bbox[1] = miny < 0.0f ? 0 : (int)floor( miny );
+  t.bbox[2] = maxx > sample_width-1 ? sample_width-1 : (int)ceil( maxx );
+  t.bbox[3] = maxy > sample_height-1 ? sample_height-1 : (int)ceil( maxy );
+
+  // counterclockwise in sample coordinates, so inside is positive
+  t.vi[0] = i0;
+  t.vi[1] = area > 0.0 ? i1 : i2;
+  t.vi[2] = area > 0.0 ? i2 : i1;
+  work.m_T.Append( t );
+}
+
+// Lists the triangles of every tile in the order they are drawn
+void CRhSoftwareRasterizer::BinTriangles()
+{
+  RH_TRACE_SCOPE( "bin triangles" );
+  const int tile_samples = tile_size*m_supersample;
+  m_tile_bins.Destroy();
+  m_tile_bins.Reserve( m_tile_columns*m_tile_rows );
+  for ( int i = 0; i < m_tile_columns*m_tile_rows; i++ )
+    m_tile_bins.AppendNew();
+
+  for ( int mi = 0; mi < m_mesh_work.Count(); mi++ ) {
+    const MeshWork& work = m_mesh_work[mi];
+    for ( int ti = 0; ti < work.m_T.Count(); ti++ ) {
+      const Triangle& t = work.m_T[ti];
+      BinEntry entry;
+      entry.mesh_index = mi;
+      entry.triangle_index = ti;
+      const int x1 = t.bbox[2]/tile_samples;
+      const int y1 = t.bbox[3]/tile_samples;
+      for ( int y = t.bbox[1]/tile_samples; y <= y1; y++ ) {
+        for ( int x = t.bbox[0]/tile_samples; x <= x1; x++ )
+          m_tile_bins[y*m_tile_columns + x].Append( entry );
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////
+//
+// Draws the tile's triangles into its own color and depth samples and
+// averages them into the image.
+void CRhSoftwareRasterizer::DrawTile( int tile_index, float* color, float* depth )
+{
+  const int ss = m_supersample;
+  const int px0 = (tile_index % m_tile_columns)*tile_size;
+  const int py0 = (tile_index / m_tile_columns)*tile_size;
+  const int px1 = ON_Min( px0 + (int)tile_size, m_width );
+  const int py1 = ON_Min( py0 + (int)tile_size, m_height );
+  const int sx0 = px0*ss, sy0 = py0*ss;
+  const int sx1 = px1*ss - 1, sy1 = py1*ss - 1;
+  const int row_samples = sx1 - sx0 + 1;
+  const int sample_count = row_samples*(sy1 - sy0 + 1);
+
+  // glClear() with the renderers' clear depth of 0
+  for ( int i = 0; i < sample_count; i++ ) {
+    color[4*i]   = m_background[0];
+    color[4*i+1] = m_background[1];
+    color[4*i+2] = m_background[2];
+    color[4*i+3] = m_background[3];
+    depth[i] = 0.0f;
+  }
+
+  const ON_SimpleArray<BinEntry>& bin = m_tile_bins[tile_index];
+  for ( int bi = 0; bi < bin.Count(); bi++ ) {
+    const MeshWork& work = m_mesh_work[bin[bi].mesh_index];
+    const Triangle& t = work.m_T[bin[bi].triangle_index];
+    const ScreenVertex* v[3] = { &work.m_V[t.vi[0]], &work.m_V[t.vi[1]], &work.m_V[t.vi[2]] };
+
+    // Edge j is opposite vertex j and is positive inside.  Samples exactly on
+    // an edge belong to one side only, so shared edges are not drawn twice.
+    double A[3], B[3], C[3];
+    bool bInclusive[3];
+    for ( int j = 0; j < 3; j++ ) {
+      const ScreenVertex& p = *v[(j+1)%3];
+      const ScreenVertex& q = *v[(j+2)%3];
+      A[j] = (double)p.y - q.y;
+      B[j] = (double)q.x - p.x;
+      C[j] = (double)p.x*q.y - (double)p.y*q.x;
+      bInclusive[j] = A[j] > 0.0 || (A[j] == 0.0 && B[j] > 0.0);
+    }
+    const double inv_area = 1.0/(C[0] + C[1] + C[2]);
+
+    const int x0 = ON_Max( t.bbox[0], sx0 ), x1 = ON_Min( t.bbox[2], sx1 );
+    const int y0 = ON_Max( t.bbox[1], sy0 ), y1 = ON_Min( t.bbox[3], sy1 );
+    for ( int y = y0; y <= y1; y++ ) {
+      const double fy = y + 0.5;
+      const double fx = x0 + 0.5;
+      double e[3];
+      for ( int j = 0; j < 3; j++ )
+        e[j] = A[j]*fx + B[j]*fy + C[j];
+      int k = (y - sy0)*row_samples + (x0 - sx0);
+      for ( int x = x0; x <= x1; x++, k++, e[0] += A[0], e[1] += A[1], e[2] += A[2] ) {
+        if ( e[0] < 0.0 || e[1] < 0.0 || e[2] < 0.0 )
+          continue;
+        if ( (e[0] == 0.0 && !bInclusive[0]) || (e[1] == 0.0 && !bInclusive[1]) || (e[2] == 0.0 && !bInclusive[2]) )
+          continue;
+
+        const float l0 = (float)(e[0]*inv_area);
+        const float l1 = (float)(e[1]*inv_area);
+        const float l2 = 1.0f - l0 - l1;
+        const float z = l0*v[0]->z + l1*v[1]->z + l2*v[2]->z;
+        if ( z < depth[k] )
+          continue;     // GL_GEQUAL
+
+        const float w = 1.0f/(l0*v[0]->inv_w + l1*v[1]->inv_w + l2*v[2]->inv_w);
+        float src[4];
+        for ( int c = 0; c < 4; c++ ) {
+          const float s = (l0*v[0]->c[c] + l1*v[1]->c[c] + l2*v[2]->c[c])*w;
+          src[c] = s < 0.0f ? 0.0f : ( s > 1.0f ? 1.0f : s );
+        }
+
+        float* dst = color + 4*k;
+        if ( work.m_bBlend ) {
+          // glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA ) with depth writes off
+          const float a = src[3];
+          for ( int c = 0; c < 4; c++ )
+            dst[c] = src[c]*a + dst[c]*(1.0f - a);
+        }
+        else {
+          dst[0] = src[0];
+          dst[1] = src[1];
+          dst[2] = src[2];
+          dst[3] = src[3];
+          depth[k] = z;
+        }
+      }
+    }
+  }
+
+  // Average the samples of each pixel.  Colors are weighted by alpha so the
+  // background color does not bleed into the edges of a transparent image.
+  const float inv_count = 1.0f/(float)(ss*ss);
+  for ( int py = py0; py < py1; py++ ) {
+    unsigned char* out = m_pixels.Array() + 4*(py*m_width + px0);
+    for ( int px = px0; px < px1; px++, out += 4 ) {
+      float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for ( int j = 0; j < ss; j++ ) {
+        const float* s = color + 4*((py*ss + j - sy0)*row_samples + (px*ss - sx0));
+        for ( int i = 0; i < ss; i++, s += 4 ) {
+          sum[0] += s[0]*s[3];
+          sum[1] += s[1]*s[3];
+          sum[2] += s[2]*s[3];
+          sum[3] += s[3];
+        }
+      }
+      const float inv_alpha = sum[3] > 0.0f ? 1.0f/sum[3] : 0.0f;
+      for ( int c = 0; c < 3; c++ )
+        out[c] = (unsigned char)(255.0f*ON_Min( sum[c]*inv_alpha, 1.0f ) + 0.5f);
+      out[3] = (unsigned char)(255.0f*ON_Min( sum[3]*inv_count, 1.0f ) + 0.5f);
+    }
+  }
+}
+
+void CRhSoftwareRasterizer::SetupJob( void* arg, int first, int last )
+{
+  CRhSoftwareRasterizer* rasterizer = (CRhSoftwareRasterizer*)arg;
+  RH_TRACE_SCOPE_ARG( "setup raster meshes", first );
+  for ( int i = first; i < last; i++ )
+    rasterizer->SetupMesh( i );
+}
+
+void CRhSoftwareRasterizer::TileJob( void* arg, int first, int last )
+{
+  CRhSoftwareRasterizer* rasterizer = (CRhSoftwareRasterizer*)arg;
+  RH_TRACE_SCOPE_ARG( "draw raster tiles", first );
+  const int tile_samples = tile_size*rasterizer->m_supersample;
+  ON_SimpleArray<float> color( 4*tile_samples*tile_samples );
+  ON_SimpleArray<float> depth( tile_samples*tile_samples );
+  for ( int i = first; i < last; i++ )
+    rasterizer->DrawTile( i, color.Array(), depth.Array() );
+}
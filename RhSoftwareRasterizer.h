@@ -0,0 +1,238 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_SOFTWARE_RASTERIZER_INC_)
+#define RH_SOFTWARE_RASTERIZER_INC_
+
+#include "RhJobSystem.h"
+
+/*
+Description:
+  The meshes a CRhSoftwareRasterizer draws: the same interleaved display
+  buffers DisplayMesh hands to OpenGL, see RhDisplayData.h, with their
+  materials.
+
+  AddDisplayBuffers() does not copy the buffers.  The scene only keeps
+  where they are, so they must stay unchanged until the scene is
+  destroyed.  AddMesh() builds buffers the scene owns.
+
+  A scene is filled on one thread and can then be drawn by any number
+  of rasterizers at once.
+*/
+class CRhRasterScene
+{
+public:
+  CRhRasterScene();
+  ~CRhRasterScene();
+
+  /*
+  Description:
+    Adds the display buffers of one mesh partition.
+  Parameters:
+    vertices - [in] vertex_count VNCData, VCData, VertexData or ON_3fPoint,
+                    depending on bHasNormals and bHasColors, relative to offset.
+    indexes - [in] 3*triangle_count vertex indexes.
+    offset - [in] world location of the vertices' origin.
+    material - [in] render material.
+  Returns:
+    false if the buffers are empty or an index is out of range.
+  */
+  bool AddDisplayBuffers(
+          const void* vertices,
+          int vertex_count,
+          bool bHasNormals,
+          bool bHasColors,
+          const unsigned short* indexes,
+          int triangle_count,
+          const ON_3fVector& offset,
+          const ON_Material& material
+          );
+
+  /*
+  Description:
+    Builds the display buffers of every partition of mesh, the way
+    DisplayMesh does, and adds them.  The mesh keeps the partition, so
+    DisplayMesh does not make it again.  For meshes whose display
+    buffers are not kept anywhere else.
+  */
+  bool AddMesh( ON_Mesh& mesh, const ON_Material& material );
+
+  int MeshCount() const;
+  ON__INT64 TriangleCount() const;
+  ON_BoundingBox BoundingBox() const;
+
+  // Bytes the scene takes, including the buffers AddMesh() built
+  ON__UINT64 SizeOf() const;
+
+  void Destroy();
+
+private:
+  friend class CRhSoftwareRasterizer;
+
+  struct Mesh
+  {
+    const unsigned char* m_vertices;      // display buffer, m_stride bytes per vertex
+    const unsigned short* m_T;            // 3 per triangle
+    int m_vertex_count;
+    int m_triangle_count;
+    int m_stride;
+    int m_color_offset;                   // bytes from a vertex to its ON_4fPoint color
+    bool m_bHasNormals;                   // an ON_3fVector follows the vertex
+    bool m_bHasColors;
+    ON_3fVector m_offset;                 // world location of the vertices' origin
+    ON_Material m_material;
+  };
+
+  // opaque meshes first, so they are drawn before the transparent ones
+  ON_SimpleArray<Mesh*> m_meshes;
+  int m_opaque_count;
+  ON__INT64 m_triangle_count;
+  ON_BoundingBox m_bbox;
+
+  // buffers built by AddMesh(), freed with onfree()
+  ON_SimpleArray<void*> m_owned_buffers;
+  ON__UINT64 m_owned_bytes;
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhRasterScene(const CRhRasterScene&);
+  CRhRasterScene& operator=(const CRhRasterScene&);
+};
+
+
+/*
+Description:
+  Draws a CRhRasterScene into an image without OpenGL, so previews and
+  thumbnails can be made on any thread while the render thread keeps
+  drawing, and so images can be made where there is no GPU.
+
+  Shading matches the viewer's per vertex lighting shader: the default
+  headlight, the scene's materials, and meshes lit from both sides.
+  Transparent meshes are blended over the opaque ones without writing
+  depth.
+
+  The image is divided into tiles that are drawn in parallel by
+  CRhJobSystem jobs.  Each tile is drawn at supersample x supersample
+  samples per pixel into a small buffer of its own and averaged into
+  the image, so memory does not grow with the sample count.
+*/
+class CRhSoftwareRasterizer
+{
+public:
+  enum
+  {
+    tile_size = 32,         // pixels
+    max_supersample = 4
+  };
+
+  CRhSoftwareRasterizer();
+  ~CRhSoftwareRasterizer();
+
+  /*
+  Parameters:
+    scene - [in]
+    viewport - [in] view to draw.  Its frustum aspect should match
+                    width/height.
+    width, height - [in] image size in pixels.
+    background - [in] color of pixels no mesh covers.  Its alpha is
+                    used the way the renderers use glClearColor(), so
+                    ON_Color(0,0,0,0) is a transparent background.
+    supersample - [in] 1 to max_supersample samples in each direction.
+    job_priority - [in] priority of the tile jobs.
+  Returns:
+    false if the image could not be allocated or the view is invalid.
+  */
+  bool Render(
+          const CRhRasterScene& scene,
+          const ON_Viewport& viewport,
+          int width,
+          int height,
+          const ON_Color& background,
+          int supersample = 2,
+          CRhJobSystem::priority job_priority = CRhJobSystem::normal_priority
+          );
+
+  int Width() const;
+  int Height() const;
+
+  // Width()*Height() RGBA pixels, top row first, not premultiplied
+  const unsigned char* Pixels() const;
+
+private:
+  // A vertex in sample coordinates
+  struct ScreenVertex
+  {
+    float x, y;         // samples from the top left corner
+    float z;            // window depth, larger is closer like the renderers' GL_GEQUAL
+    float inv_w;        // 1/w for perspective correct colors
+    float c[4];         // lit RGBA divided by w
+  };
+
+  struct Triangle
+  {
+    int vi[3];          // indexes into MeshWork::m_V
+    int bbox[4];        // samples x0, y0, x1, y1 it may cover, inclusive
+  };
+
+  // A scene mesh transformed, lit and clipped by SetupMesh()
+  struct MeshWork
+  {
+    ON_SimpleArray<ScreenVertex> m_V;   // scene vertices, then vertices made by clipping
+    ON_SimpleArray<Triangle> m_T;
+    float m_ambient[3];
+    bool m_bBlend;
+  };
+
+  // One triangle drawn by a tile
+  struct BinEntry
+  {
+    int mesh_index;
+    int triangle_index;
+  };
+
+  void SetupMesh( int mesh_index );
+  void AddTriangle( MeshWork& work, int i0, int i1, int i2 ) const;
+  void BinTriangles();
+  void DrawTile( int tile_index, float* color, float* depth );
+  static void SetupJob( void* rasterizer, int first, int last );
+  static void TileJob( void* rasterizer, int first, int last );
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhSoftwareRasterizer(const CRhSoftwareRasterizer&);
+  CRhSoftwareRasterizer& operator=(const CRhSoftwareRasterizer&);
+
+private:
+  int m_width;
+  int m_height;
+  ON_SimpleArray<unsigned char> m_pixels;
+
+  // valid during Render()
+  const CRhRasterScene* m_scene;
+  ON_Xform m_world_to_clip;
+  ON_Xform m_world_to_camera;
+  ON_3fVector m_light_direction;      // camera coordinates, toward the light
+  ON_3fVector m_half_vector;
+  float m_light_diffuse[3];
+  float m_light_specular[3];
+  float m_background[4];
+  int m_supersample;
+  int m_tile_columns;
+  int m_tile_rows;
+  ON_ClassArray<MeshWork> m_mesh_work;
+  ON_ClassArray< ON_SimpleArray<BinEntry> > m_tile_bins;
+};
+
+#endif
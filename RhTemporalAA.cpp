@@ -0,0 +1,91 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+
+#include "RhTemporalAA.h"
+
+// Sub-pixel sample offsets in pixels, the 2,3 Halton sequence moved to
+// -0.5 .. 0.5.  The first is the pixel center so the first still frame is
+// a plain frame.
+static const double SampleOffsets[CRhTemporalAA::sample_count][2] =
+{
+  {  0.0,       0.0       },
+  { -0.25,      0.166667  },
+  {  0.25,     -0.388889  },
+  { -0.375,    -0.055556  },
+  {  0.125,     0.277778  },
+  { -0.125,    -0.277778  },
+  {  0.375,     0.055556  },
+  { -0.4375,    0.388889  },
+};
+
+
+//////////////////////////////////////////////////////////////
+//
+CRhTemporalAA::CRhTemporalAA()
+: m_sample_index(0)
+{
+}
+
+void CRhTemporalAA::Restart()
+{
+  m_sample_index = 0;
+}
+
+int CRhTemporalAA::SampleIndex() const
+{
+  return m_sample_index;
+}
+
+bool CRhTemporalAA::IsConverged() const
+{
+  return m_sample_index >= sample_count;
+}
+
+float CRhTemporalAA::SampleWeight() const
+{
+  return 1.0f/(float)(m_sample_index + 1);
+}
+
+void CRhTemporalAA::GetSampleViewport( const ON_Viewport& viewport, int width, int height, ON_Viewport& jittered ) const
+{
+  jittered = viewport;
+  if ( m_sample_index <= 0 || m_sample_index >= sample_count || width <= 0 || height <= 0 )
+    return;
+
+  double left, right, bottom, top, near_dist, far_dist;
+  if ( !viewport.GetFrustum( &left, &right, &bottom, &top, &near_dist, &far_dist ) )
+    return;
+
+  // a frustum shift of (right-left)/width moves the image one pixel
+  const double dx = SampleOffsets[m_sample_index][0]*(right - left)/width;
+  const double dy = SampleOffsets[m_sample_index][1]*(top - bottom)/height;
+
+  // the shifted frustum is no longer symmetric
+  jittered.UnlockFrustumSymmetry();
+  if ( !jittered.SetFrustum( left + dx, right + dx, bottom + dy, top + dy, near_dist, far_dist ) )
+    jittered = viewport;
+}
+
+void CRhTemporalAA::SampleDone()
+{
+  if ( m_sample_index < sample_count )
+    m_sample_index++;
+}
+
+void CRhTemporalAA::Stop()
+{
+  m_sample_index = sample_count;
+}
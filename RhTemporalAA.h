@@ -0,0 +1,78 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+
+#if !defined(RH_TEMPORAL_AA_INC_)
+#define RH_TEMPORAL_AA_INC_
+
+/*
+Description:
+  Bookkeeping of the progressive antialiasing the renderers do while the
+  view is still.
+
+  Every frame drawn after the view stops is one sample: the scene drawn at
+  native resolution with the camera frustum shifted by a fraction of a
+  pixel.  The renderers blend each sample into an accumulation texture with
+  weight SampleWeight(), so after n samples the texture holds their average,
+  and show that texture.  The first sample is not shifted, so the first
+  still frame looks like a plain frame and the edges smooth out over the
+  next sample_count-1 frames.
+
+  Call Restart() whenever the picture changes: the camera moved, the view
+  was resized or the scene is still loading.
+
+  Only the thread that draws may use it.
+*/
+class CRhTemporalAA
+{
+public:
+  enum { sample_count = 8 };
+
+  CRhTemporalAA();
+
+  // Next frame starts a new accumulation
+  void Restart();
+
+  // Samples in the accumulation texture, 0 to sample_count
+  int SampleIndex() const;
+
+  // true when all samples are in and no more frames are needed
+  bool IsConverged() const;
+
+  // Blend weight of the next sample, 1/(SampleIndex()+1)
+  float SampleWeight() const;
+
+  /*
+  Description:
+    Shifts the frustum of a copy of viewport by the sub-pixel offset of
+    the next sample.
+  Parameters:
+    viewport - [in] view being drawn.
+    width, height - [in] pixel size it is drawn at.
+    jittered - [out] viewport to draw the sample with.
+  */
+  void GetSampleViewport( const ON_Viewport& viewport, int width, int height, ON_Viewport& jittered ) const;
+
+  // Call after the sample has been blended into the accumulation texture
+  void SampleDone();
+
+  // Nothing to draw: no more samples are needed until Restart()
+  void Stop();
+
+private:
+  int m_sample_index;
+};
+
+#endif
@@ -0,0 +1,217 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <pthread.h>
+#include <sys/time.h>
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#endif
+
+#include "RhTrace.h"
+
+volatile bool g_rh_trace_enabled = false;
+
+struct CRhTraceEvent
+{
+  const char* m_name;
+  ON__UINT64 m_start;
+  ON__UINT64 m_end;
+  int m_arg;
+};
+
+// One per thread.  Only the owning thread writes events; m_count is
+// bumped after an event is complete so the exporter never sees a
+// half written newest event.
+struct CRhTraceBuffer
+{
+  int m_thread_id;
+  const char* m_thread_name;
+  bool m_bInUse;                  // false after the owning thread exits
+  volatile unsigned int m_count;  // number of events ever written
+  CRhTraceBuffer* m_next;
+  CRhTraceEvent m_events[RH_TRACE_BUFFER_CAPACITY];
+};
+
+static pthread_once_t g_trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_trace_key;
+static pthread_key_t g_trace_name_key;      // thread names are kept apart so naming a thread does not allocate its buffer
+static pthread_mutex_t g_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static CRhTraceBuffer* g_trace_buffers = 0;
+static int g_trace_thread_count = 0;
+static ON__UINT64 g_trace_origin = 0;
+
+
+// Threads come and go (read pipeline and tessellator workers are started
+// for every model), so the buffer of an exited thread is handed to the
+// next new thread instead of being freed.  The new thread starts it
+// empty under its own id, so the old spans are dropped rather than
+// shown under the new thread's name.
+static void ReleaseThreadBuffer( void* p )
+{
+  pthread_mutex_lock( &g_trace_lock );
+  ((CRhTraceBuffer*)p)->m_bInUse = false;
+  pthread_mutex_unlock( &g_trace_lock );
+}
+
+static void CreateTraceKey()
+{
+  pthread_key_create( &g_trace_key, ReleaseThreadBuffer );
+  pthread_key_create( &g_trace_name_key, NULL );
+}
+
+static CRhTraceBuffer* ThreadBuffer()
+{
+  pthread_once( &g_trace_once, CreateTraceKey );
+  CRhTraceBuffer* buffer = (CRhTraceBuffer*) pthread_getspecific( g_trace_key );
+  if ( buffer )
+    return buffer;
+
+  pthread_mutex_lock( &g_trace_lock );
+  for ( buffer = g_trace_buffers; buffer; buffer = buffer->m_next ) {
+    if ( !buffer->m_bInUse )
+      break;
+  }
+  if ( !buffer ) {
+    buffer = (CRhTraceBuffer*) malloc( sizeof(CRhTraceBuffer) );
+    if ( buffer ) {
+      buffer->m_next = g_trace_buffers;
+      g_trace_buffers = buffer;
+    }
+  }
+  if ( buffer ) {
+    buffer->m_thread_id = ++g_trace_thread_count;
+    buffer->m_count = 0;
+    buffer->m_thread_name = (const char*) pthread_getspecific( g_trace_name_key );
+    buffer->m_bInUse = true;
+#if defined(__APPLE__)
+    if ( !buffer->m_thread_name && pthread_main_np() )
+      buffer->m_thread_name = "main";
+#endif
+  }
+  pthread_mutex_unlock( &g_trace_lock );
+
+  if ( buffer )
+    pthread_setspecific( g_trace_key, buffer );
+  return buffer;
+}
+
+
+ON__UINT64 RhTraceTime()
+{
+#if defined(__APPLE__)
+  return mach_absolute_time();
+#else
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return ((ON__UINT64)tv.tv_sec)*1000000 + tv.tv_usec;
+#endif
+}
+
+// Microseconds since tracing was first enabled
+static double TraceMicroseconds( ON__UINT64 t )
+{
+  double ticks = (t > g_trace_origin) ? (double)(t - g_trace_origin) : 0.0;
+#if defined(__APPLE__)
+  static mach_timebase_info_data_t timebase;
+  if ( timebase.denom == 0 )
+    mach_timebase_info( &timebase );
+  return ticks*timebase.numer/timebase.denom/1000.0;
+#else
+  return ticks;
+#endif
+}
+
+
+void RhTraceEnable( bool bEnable )
+{
+  pthread_mutex_lock( &g_trace_lock );
+  if ( bEnable && g_trace_origin == 0 )
+    g_trace_origin = RhTraceTime();
+  g_rh_trace_enabled = bEnable;
+  pthread_mutex_unlock( &g_trace_lock );
+}
+
+void RhTraceClear()
+{
+  pthread_mutex_lock( &g_trace_lock );
+  for ( CRhTraceBuffer* buffer = g_trace_buffers; buffer; buffer = buffer->m_next )
+    buffer->m_count = 0;
+  pthread_mutex_unlock( &g_trace_lock );
+}
+
+void RhTraceSetThreadName( const char* name )
+{
+  pthread_once( &g_trace_once, CreateTraceKey );
+  pthread_setspecific( g_trace_name_key, name );
+  CRhTraceBuffer* buffer = (CRhTraceBuffer*) pthread_getspecific( g_trace_key );
+  if ( buffer )
+    buffer->m_thread_name = name;
+}
+
+void RhTraceAddSpan( const char* name, ON__UINT64 start, ON__UINT64 end, int arg )
+{
+  CRhTraceBuffer* buffer = ThreadBuffer();
+  if ( !buffer )
+    return;
+
+  const unsigned int count = buffer->m_count;
+  CRhTraceEvent& e = buffer->m_events[count % RH_TRACE_BUFFER_CAPACITY];
+  e.m_name = name;
+  e.m_start = start;
+  e.m_end = end;
+  e.m_arg = arg;
+  __sync_synchronize();
+  buffer->m_count = count + 1;
+}
+
+
+bool RhTraceWriteJSON( const char* filename )
+{
+  FILE* fp = ON::OpenFile( filename, "w" );
+  if ( !fp )
+    return false;
+
+  const char* separator = "";
+  fprintf( fp, "{\"traceEvents\":[" );
+
+  pthread_mutex_lock( &g_trace_lock );
+  for ( CRhTraceBuffer* buffer = g_trace_buffers; buffer; buffer = buffer->m_next ) {
+    if ( buffer->m_thread_name ) {
+      fprintf( fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+               separator, buffer->m_thread_id, buffer->m_thread_name );
+      separator = ",";
+    }
+
+    const unsigned int count = buffer->m_count;
+    const unsigned int first = count > RH_TRACE_BUFFER_CAPACITY ? count - RH_TRACE_BUFFER_CAPACITY : 0;
+    for ( unsigned int i = first; i < count; i++ ) {
+      const CRhTraceEvent& e = buffer->m_events[i % RH_TRACE_BUFFER_CAPACITY];
+      const double ts = TraceMicroseconds( e.m_start );
+      const double dur = TraceMicroseconds( e.m_end ) - ts;
+      fprintf( fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+               separator, e.m_name, buffer->m_thread_id, ts, dur );
+      if ( e.m_arg >= 0 )
+        fprintf( fp, ",\"args\":{\"arg\":%d}", e.m_arg );
+      fprintf( fp, "}" );
+      separator = ",";
+    }
+  }
+  pthread_mutex_unlock( &g_trace_lock );
+
+  fprintf( fp, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+  bool rc = ( 0 == ferror( fp ) );
+  ON::CloseFile( fp );
+  return rc;
+}
@@ -0,0 +1,162 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_TRACE_INC_)
+#define RH_TRACE_INC_
+
+//
+// Low overhead tracing of where load and draw time goes.
+//
+// Each thread records spans into its own ring buffer, so recording takes no locks.
+// When a buffer is full the oldest spans are overwritten.  RhTraceWriteJSON() writes
+// every buffer in the Chrome trace event format, which chrome://tracing and Perfetto
+// (ui.perfetto.dev) open directly.
+//
+// Tracing is compiled in unless RH_TRACE is defined as 0, and it records nothing until
+// RhTraceEnable(true) is called.
+//
+//   void LoadSomething()
+//   {
+//     RH_TRACE_SCOPE( "LoadSomething" );
+//     ...
+//     RH_TRACE_NEXT( "second half" );      // ends "LoadSomething", starts "second half"
+//     ...
+//   }
+//
+// Span names must be string literals (or other strings that live forever) without
+// quotes or backslashes.
+//
+
+#if !defined(RH_TRACE)
+#define RH_TRACE 1
+#endif
+
+// number of spans each thread keeps
+#define RH_TRACE_BUFFER_CAPACITY 32768
+
+extern volatile bool g_rh_trace_enabled;
+
+inline bool RhTraceIsEnabled()
+{
+  return g_rh_trace_enabled;
+}
+
+/*
+Description:
+  Starts or stops recording spans.  Starting does not clear spans
+  that were already recorded.
+*/
+void RhTraceEnable( bool bEnable );
+
+/*
+Description:
+  Discards all recorded spans.
+*/
+void RhTraceClear();
+
+/*
+Description:
+  Names the calling thread in exported traces.
+Parameters:
+  name - [in] string literal
+*/
+void RhTraceSetThreadName( const char* name );
+
+/*
+Returns:
+  Current time in trace clock ticks.
+*/
+ON__UINT64 RhTraceTime();
+
+/*
+Description:
+  Records a span on the calling thread.
+Parameters:
+  name - [in] string literal
+  start, end - [in] RhTraceTime() values
+  arg - [in] shown with the span in the trace viewer, -1 for none
+*/
+void RhTraceAddSpan( const char* name, ON__UINT64 start, ON__UINT64 end, int arg );
+
+/*
+Description:
+  Writes all recorded spans as Chrome trace event JSON.
+Returns:
+  True if the file was written.
+*/
+bool RhTraceWriteJSON( const char* filename );
+
+
+// Records a span from construction to destruction
+class CRhTraceSpan
+{
+public:
+  CRhTraceSpan( const char* name, int arg = -1 )
+  : m_name(name), m_arg(arg), m_start(RhTraceIsEnabled() ? RhTraceTime() : 0)
+  {
+  }
+
+  ~CRhTraceSpan()
+  {
+    End();
+  }
+
+  // Ends this span and starts another one
+  void Next( const char* name, int arg = -1 )
+  {
+    End();
+    m_name = name;
+    m_arg = arg;
+    m_start = RhTraceIsEnabled() ? RhTraceTime() : 0;
+  }
+
+  // Changes the argument shown with this span
+  void SetArg( int arg )
+  {
+    m_arg = arg;
+  }
+
+private:
+  void End()
+  {
+    if ( m_start )
+      RhTraceAddSpan( m_name, m_start, RhTraceTime(), m_arg );
+    m_start = 0;
+  }
+
+  const char* m_name;
+  int m_arg;
+  ON__UINT64 m_start;   // 0 when not recording
+
+private:
+  // prohibit use
+  CRhTraceSpan(const CRhTraceSpan&);
+  CRhTraceSpan& operator=(const CRhTraceSpan&);
+};
+
+
+#if RH_TRACE
+#define RH_TRACE_SCOPE(name)            CRhTraceSpan rh_trace_scope_( name )
+#define RH_TRACE_SCOPE_ARG(name,arg)    CRhTraceSpan rh_trace_scope_( name, arg )
+#define RH_TRACE_NEXT(name)             rh_trace_scope_.Next( name )
+#define RH_TRACE_SET_ARG(arg)           rh_trace_scope_.SetArg( arg )
+#else
+#define RH_TRACE_SCOPE(name)
+#define RH_TRACE_SCOPE_ARG(name,arg)
+#define RH_TRACE_NEXT(name)
+#define RH_TRACE_SET_ARG(arg)
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_TRIPLE_BUFFER_INC_)
+#define RH_TRIPLE_BUFFER_INC_
+
+#include <stdint.h>
+
+/*
+Description:
+  Hands the newest value of T from one producer thread to one consumer
+  thread without locks.  Neither side ever waits for the other.
+
+  There are three copies of T.  The producer owns one and fills it, the
+  consumer owns one and reads it, and the third is the one most recently
+  published.  Publish() swaps the producer's copy with the published one
+  and Acquire() swaps the published copy with the consumer's, each with
+  one compare and swap.  Values the consumer did not get to in time are
+  overwritten, which is what a view state wants: only the newest matters.
+
+  Example:
+    // producer
+    buffer.WriteBuffer() = state;
+    buffer.Publish();
+
+    // consumer
+    buffer.Acquire();
+    Draw( buffer.ReadBuffer() );
+*/
+template <class T>
+class CRhTripleBuffer
+{
+public:
+  CRhTripleBuffer()
+  : m_write_index(0)
+  , m_published(1)
+  , m_read_index(2)
+  {
+  }
+
+  /////////////////////////////////////////////////////////////
+  // Producer thread
+
+  /*
+  Returns:
+    The producer's copy.  It holds an older value, so set all of it
+    before calling Publish().
+  */
+  T& WriteBuffer()
+  {
+    return m_buffer[m_write_index];
+  }
+
+  // Makes WriteBuffer() the newest value
+  void Publish()
+  {
+    int32_t published;
+    do {
+      published = m_published;
+    } while ( !__sync_bool_compare_and_swap( &m_published, published, m_write_index | NewValueFlag ) );
+    m_write_index = published & IndexMask;
+  }
+
+  /////////////////////////////////////////////////////////////
+  // Consumer thread
+
+  /*
+  Description:
+    Takes the newest published value, if there is one the consumer has
+    not seen.
+  Returns:
+    true if ReadBuffer() changed.
+  */
+  bool Acquire()
+  {
+    if ( 0 == (m_published & NewValueFlag) )
+      return false;
+    int32_t published;
+    do {
+      published = m_published;
+    } while ( !__sync_bool_compare_and_swap( &m_published, published, m_read_index ) );
+    m_read_index = published & IndexMask;
+    return true;
+  }
+
+  // The value taken by the last Acquire()
+  const T& ReadBuffer() const
+  {
+    return m_buffer[m_read_index];
+  }
+
+private:
+  enum
+  {
+    IndexMask = 3,
+    NewValueFlag = 4      // set in m_published by Publish(), cleared by Acquire()
+  };
+
+  T m_buffer[3];
+  int32_t m_write_index;            // producer thread only
+  volatile int32_t m_published;     // index of the published copy | NewValueFlag
+  int32_t m_read_index;             // consumer thread only
+
+private:
+  // prohibit use of copy construction and operator=
+  CRhTripleBuffer(const CRhTripleBuffer&);
+  CRhTripleBuffer& operator=(const CRhTripleBuffer&);
+};
+
+#endif
@@ -0,0 +1,121 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "RhTest.h"
+#include "RhCRC32.h"
+
+// Bytes that are the same on every run
+static void FillBytes( unsigned char* buffer, size_t count, unsigned int seed )
+{
+  for ( size_t i = 0; i < count; i++ ) {
+    seed = seed*1103515245 + 12345;
+    buffer[i] = (unsigned char)(seed >> 16);
+  }
+}
+
+// Writes count bytes to a new temporary file and returns its path in path
+static bool WriteTempFile( const unsigned char* buffer, size_t count, char path[64] )
+{
+  strcpy( path, "/tmp/RhCRC32TestXXXXXX" );
+  const int fd = mkstemp( path );
+  if ( fd < 0 )
+    return false;
+  const bool rc = ( count == 0 || write( fd, buffer, count ) == (ssize_t)count );
+  close( fd );
+  return rc;
+}
+
+RH_TEST( CRC32_CheckValue )
+{
+  // the standard check value of the CRC-32 used by zlib
+  RH_CHECK( 0xCBF43926 == RhCRC32( 0, 9, "123456789" ) );
+  RH_CHECK( 0 == RhCRC32( 0, 0, NULL ) );
+  RH_CHECK( 0x12345678 == RhCRC32( 0x12345678, 0, NULL ) );
+}
+
+RH_TEST( CRC32_MatchesOpenNURBS )
+{
+  // every length around the 8 byte steps, at every alignment
+  unsigned char buffer[1024 + 8];
+  FillBytes( buffer, sizeof(buffer), 1 );
+  for ( size_t offset = 0; offset < 8; offset++ ) {
+    for ( size_t length = 0; length <= 64; length++ )
+      RH_CHECK( ON_CRC32( 7, length, buffer + offset ) == RhCRC32( 7, length, buffer + offset ) );
+    RH_CHECK( ON_CRC32( 0, 1024, buffer + offset ) == RhCRC32( 0, 1024, buffer + offset ) );
+  }
+}
+
+RH_TEST( CRC32_Continues )
+{
+  // hashing a buffer in pieces gives the CRC of the whole buffer
+  unsigned char buffer[4099];
+  FillBytes( buffer, sizeof(buffer), 2 );
+  const ON__UINT32 whole = RhCRC32( 0, sizeof(buffer), buffer );
+  const size_t splits[] = { 0, 1, 3, 8, 13, 4096, 4098 };
+  for ( size_t i = 0; i < sizeof(splits)/sizeof(splits[0]); i++ ) {
+    const ON__UINT32 first = RhCRC32( 0, splits[i], buffer );
+    RH_CHECK( whole == RhCRC32( first, sizeof(buffer) - splits[i], buffer + splits[i] ) );
+  }
+}
+
+RH_TEST( CRC32_File )
+{
+  // large enough to be read in more than one block
+  const size_t length = 3*1024*1024 + 5;
+  unsigned char* buffer = (unsigned char*)onmalloc( length );
+  RH_REQUIRE( buffer != NULL );
+  FillBytes( buffer, length, 3 );
+
+  char path[64];
+  if ( RH_CHECK( WriteTempFile( buffer, length, path ) ) ) {
+    ON__UINT32 crc = 0;
+    ON__UINT64 file_length = 0;
+    RH_CHECK( RhFileCRC32( path, &crc, &file_length ) );
+    RH_CHECK( length == file_length );
+    RH_CHECK( RhCRC32( 0, length, buffer ) == crc );
+    unlink( path );
+  }
+  onfree( buffer );
+
+  ON__UINT32 crc = 0;
+  ON__UINT64 file_length = 0;
+  RH_CHECK( !RhFileCRC32( "/tmp/RhCRC32Test-missing", &crc, &file_length ) );
+}
+
+RH_TEST( CRC32_FileQuickKey )
+{
+  unsigned char buffer[1000];
+  FillBytes( buffer, sizeof(buffer), 4 );
+  char path[64];
+  RH_REQUIRE( WriteTempFile( buffer, sizeof(buffer), path ) );
+
+  ON__UINT32 header_crc = 0;
+  ON__UINT64 file_length = 0;
+  ON__INT64 modified_time = 0;
+  RH_CHECK( RhFileQuickKey( path, 100, &header_crc, &file_length, &modified_time ) );
+  RH_CHECK( RhCRC32( 0, 100, buffer ) == header_crc );
+  RH_CHECK( sizeof(buffer) == file_length );
+  RH_CHECK( modified_time > 0 );
+
+  // a header longer than the file hashes the whole file
+  RH_CHECK( RhFileQuickKey( path, 4096, &header_crc, &file_length, &modified_time ) );
+  RH_CHECK( RhCRC32( 0, sizeof(buffer), buffer ) == header_crc );
+  unlink( path );
+
+  RH_CHECK( !RhFileQuickKey( path, 100, &header_crc, &file_length, &modified_time ) );
+}
@@ -0,0 +1,145 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <unistd.h>
+
+#include "RhTest.h"
+#include "RhFrameStats.h"
+
+// Counts a frame of draw_calls calls without presenting it
+static void DrawTestFrame( CRhFrameStats& stats, int draw_calls, int triangles_per_call, int culled_objects )
+{
+  stats.BeginFrame();
+  for ( int i = 0; i < draw_calls; i++ )
+    stats.CountDrawCall( triangles_per_call, 1, 2 );
+  stats.CountStateChanges( 3 );
+  stats.Frame().drawn_objects += draw_calls;
+  stats.Frame().culled_objects += culled_objects;
+  stats.EndFrame();
+}
+
+static int HistogramCount( const int histogram[CRhFrameStatsSummary::bucket_count] )
+{
+  int count = 0;
+  for ( int i = 0; i < CRhFrameStatsSummary::bucket_count; i++ )
+    count += histogram[i];
+  return count;
+}
+
+RH_TEST( FrameStats_Empty )
+{
+  CRhFrameStats stats;
+  CRhFrameStatsSummary summary;
+  stats.GetSummary( summary );
+  RH_CHECK( 0 == summary.m_frame_count );
+  RH_CHECK( 0 == summary.m_total_frame_count );
+  RH_CHECK( 0.0 == summary.m_frames_per_second );
+  RH_CHECK( 0 == HistogramCount( summary.m_frame_ms_histogram ) );
+  RH_CHECK( 0 == strcmp( "", summary.Bottleneck() ) );
+}
+
+RH_TEST( FrameStats_AverageAndMaximum )
+{
+  CRhFrameStats stats;
+  DrawTestFrame( stats, 10, 100, 4 );
+  DrawTestFrame( stats, 30, 100, 0 );
+  stats.CountCoalescedRequest();
+
+  CRhFrameStatsSummary summary;
+  stats.GetSummary( summary );
+  RH_CHECK( 2 == summary.m_frame_count );
+  RH_CHECK( 2 == summary.m_total_frame_count );
+  RH_CHECK( 1 == summary.m_coalesced_count );
+  RH_CHECK( 20 == summary.m_average.draw_calls );
+  RH_CHECK( 30 == summary.m_maximum.draw_calls );
+  RH_CHECK( 2000 == summary.m_average.triangles );
+  RH_CHECK( 3000 == summary.m_maximum.triangles );
+  RH_CHECK( 20 == summary.m_average.lines );
+  RH_CHECK( 40 == summary.m_average.points );
+  RH_CHECK( 3 == summary.m_average.state_changes );
+  RH_CHECK( 2 == summary.m_average.culled_objects );
+  RH_CHECK( 4 == summary.m_maximum.culled_objects );
+  RH_CHECK( 2 == HistogramCount( summary.m_frame_ms_histogram ) );
+  RH_CHECK( 2 == HistogramCount( summary.m_submit_ms_histogram ) );
+  RH_CHECK( summary.m_frame_ms_median <= summary.m_frame_ms_95th );
+}
+
+RH_TEST( FrameStats_KeepsRecentFrames )
+{
+  // the first frames are dropped from the summary but still counted
+  CRhFrameStats stats;
+  for ( int i = 0; i < 80; i++ )
+    DrawTestFrame( stats, 1000, 1, 0 );
+  for ( int i = 0; i < CRhFrameStats::history_size; i++ )
+    DrawTestFrame( stats, 10, 1, 0 );
+
+  CRhFrameStatsSummary summary;
+  stats.GetSummary( summary );
+  RH_CHECK( CRhFrameStats::history_size == summary.m_frame_count );
+  RH_CHECK( 80 + CRhFrameStats::history_size == summary.m_total_frame_count );
+  RH_CHECK( 10 == summary.m_maximum.draw_calls );
+  RH_CHECK( CRhFrameStats::history_size == HistogramCount( summary.m_frame_ms_histogram ) );
+}
+
+RH_TEST( FrameStats_Times )
+{
+  CRhFrameStats stats;
+  for ( int i = 0; i < 3; i++ ) {
+    stats.BeginFrame();
+    usleep( 10000 );
+    stats.BeginPresent();
+    usleep( 20000 );
+    stats.EndFrame();
+  }
+
+  // presenting took longer than submitting
+  CRhFrameStatsSummary summary;
+  stats.GetSummary( summary );
+  RH_CHECK( summary.m_average.submit_ms >= 9.0 );
+  RH_CHECK( summary.m_average.present_ms >= 19.0 );
+  RH_CHECK( summary.m_frame_ms_median >= 28.0 );
+  RH_CHECK( summary.m_frames_per_second > 0.0 && summary.m_frames_per_second < 1000.0/28.0 );
+  RH_CHECK( 0 == strcmp( "GPU", summary.Bottleneck() ) );
+
+  // the 30 ms frames are in the 16.7 to 33.3 ms bucket, or a slower one on a busy machine
+  const int frame_bucket = 3;
+  int slower_count = 0;
+  for ( int i = frame_bucket; i < CRhFrameStatsSummary::bucket_count; i++ )
+    slower_count += summary.m_frame_ms_histogram[i];
+  RH_CHECK( 3 == slower_count );
+}
+
+RH_TEST( FrameStats_Bottleneck )
+{
+  // submitting without presenting is never the GPU
+  CRhFrameStats stats;
+  DrawTestFrame( stats, 1000, 1, 0 );
+  CRhFrameStatsSummary summary;
+  stats.GetSummary( summary );
+  RH_CHECK( 0 == strcmp( "draw calls", summary.Bottleneck() ) );
+
+  CRhFrameStats few;
+  DrawTestFrame( few, 5, 1, 0 );
+  few.GetSummary( summary );
+  RH_CHECK( 0 == strcmp( "CPU", summary.Bottleneck() ) );
+}
+
+RH_TEST( FrameStats_BucketLimits )
+{
+  RH_CHECK( 0.0 == CRhFrameStatsSummary::BucketLimit( -1 ) );
+  RH_CHECK( 0.0 == CRhFrameStatsSummary::BucketLimit( CRhFrameStatsSummary::bucket_count ) );
+  for ( int i = 1; i < CRhFrameStatsSummary::bucket_count; i++ )
+    RH_CHECK( CRhFrameStatsSummary::BucketLimit( i - 1 ) < CRhFrameStatsSummary::BucketLimit( i ) );
+}
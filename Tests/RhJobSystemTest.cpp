@@ -0,0 +1,165 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <unistd.h>
+
+#include "RhTest.h"
+#include "RhJobSystem.h"
+
+// Adds one to every item it is given
+static void CountItems( void* context, int first, int last )
+{
+  int* counts = (int*)context;
+  for ( int i = first; i < last; i++ )
+    __sync_fetch_and_add( &counts[i], 1 );
+}
+
+RH_TEST( JobSystem_ParallelForRunsEveryItemOnce )
+{
+  const int grain_sizes[] = { 0, 1, 7, 1000, 5000 };
+  for ( int g = 0; g < (int)(sizeof(grain_sizes)/sizeof(grain_sizes[0])); g++ ) {
+    ON_SimpleArray<int> counts( 1000 );
+    counts.SetCount( 1000 );
+    counts.Zero();
+
+    CRhJobGroup group;
+    group.ParallelFor( counts.Count(), grain_sizes[g], CountItems, counts.Array() );
+    group.Wait();
+
+    int wrong_count = 0;
+    for ( int i = 0; i < counts.Count(); i++ )
+      if ( 1 != counts[i] )
+        wrong_count++;
+    RH_CHECK( 0 == wrong_count );
+  }
+}
+
+// Each item of the outer group waits for a group of its own
+static void RunNestedGroup( void* context, int first, int last )
+{
+  int* counts = (int*)context;
+  for ( int i = first; i < last; i++ ) {
+    CRhJobGroup inner;
+    inner.ParallelFor( 100, 3, CountItems, counts + 100*i );
+    inner.Wait();
+  }
+}
+
+RH_TEST( JobSystem_NestedGroups )
+{
+  ON_SimpleArray<int> counts( 64*100 );
+  counts.SetCount( 64*100 );
+  counts.Zero();
+
+  {
+    CRhJobGroup outer;
+    outer.ParallelFor( 64, 1, RunNestedGroup, counts.Array() );
+    // ~CRhJobGroup() waits
+  }
+
+  int wrong_count = 0;
+  for ( int i = 0; i < counts.Count(); i++ )
+    if ( 1 != counts[i] )
+      wrong_count++;
+  RH_CHECK( 0 == wrong_count );
+}
+
+RH_TEST( JobSystem_CancelSkipsQueuedJobs )
+{
+  ON_SimpleArray<int> counts( 100 );
+  counts.SetCount( 100 );
+  counts.Zero();
+
+  CRhJobGroup group;
+  RH_CHECK( !group.IsCancelled() );
+  group.Cancel();
+  RH_CHECK( group.IsCancelled() );
+  group.ParallelFor( counts.Count(), 1, CountItems, counts.Array() );
+  group.Wait();
+
+  int run_count = 0;
+  for ( int i = 0; i < counts.Count(); i++ )
+    run_count += counts[i];
+  RH_CHECK( 0 == run_count );
+}
+
+struct CRhPriorityTest
+{
+  pthread_t m_waiting_thread;
+  int m_bWaiting;                       // the waiting thread is in Wait()
+  int m_background_run_while_waiting;   // background jobs the waiting thread ran in Wait()
+  int m_background_done;
+  int m_high_done;
+};
+
+static void SlowBackgroundJob( void* context, int, int )
+{
+  CRhPriorityTest* test = (CRhPriorityTest*)context;
+  if ( pthread_equal( pthread_self(), test->m_waiting_thread ) && test->m_bWaiting )
+    test->m_background_run_while_waiting++;
+  usleep( 2000 );
+  __sync_fetch_and_add( &test->m_background_done, 1 );
+}
+
+static void HighJob( void* context, int, int )
+{
+  CRhPriorityTest* test = (CRhPriorityTest*)context;
+  usleep( 5000 );
+  __sync_fetch_and_add( &test->m_high_done, 1 );
+}
+
+RH_TEST( JobSystem_WaitDoesNotRunLowerPriorityJobs )
+{
+  // with no workers every job runs when it is submitted
+  if ( 0 == CRhJobSystem::Shared().WorkerCount() )
+    return;
+
+  CRhPriorityTest test;
+  memset( &test, 0, sizeof(test) );
+  test.m_waiting_thread = pthread_self();
+
+  CRhJobGroup background( CRhJobSystem::background_priority );
+  background.ParallelFor( 200, 1, SlowBackgroundJob, &test );
+
+  // the high jobs outlast the queue, so the waiting thread looks for
+  // more work while they run on workers
+  CRhJobGroup high( CRhJobSystem::high_priority );
+  high.ParallelFor( 8, 1, HighJob, &test );
+  test.m_bWaiting = 1;
+  high.Wait();
+  test.m_bWaiting = 0;
+
+  RH_CHECK( 8 == test.m_high_done );
+  RH_CHECK( 0 == test.m_background_run_while_waiting );
+
+  background.Wait();
+  RH_CHECK( 200 == test.m_background_done );
+}
+
+// Workers go to sleep between bursts of jobs and wake for the next one
+RH_TEST( JobSystem_WorkersWakeForLaterJobs )
+{
+  for ( int burst = 0; burst < 20; burst++ ) {
+    usleep( 1000 );
+    int counts[16] = { 0 };
+    CRhJobGroup group;
+    group.ParallelFor( 16, 1, CountItems, counts );
+    group.Wait();
+    int total = 0;
+    for ( int i = 0; i < 16; i++ )
+      total += counts[i];
+    RH_CHECK( 16 == total );
+  }
+}
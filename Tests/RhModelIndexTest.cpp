@@ -0,0 +1,124 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <wchar.h>
+
+#include "RhTest.h"
+#include "RhModelIndex.h"
+
+// Exact name match against a table of names, standing in for an EX_ONX_Model table
+struct CRhTestNameMatch
+{
+  CRhTestNameMatch( const wchar_t* const* table, const wchar_t* name ) : m_table(table), m_name(name) {}
+  bool operator()( int table_index ) const
+  {
+    return 0 == wcscmp( m_table[table_index], m_name );
+  }
+  const wchar_t* const* m_table;
+  const wchar_t* m_name;
+};
+
+// Accepts every candidate, or every one but a rejected index
+struct CRhTestIndexMatch
+{
+  CRhTestIndexMatch( int rejected_index = -1 ) : m_rejected_index(rejected_index) {}
+  bool operator()( int table_index ) const { return table_index != m_rejected_index; }
+  int m_rejected_index;
+};
+
+RH_TEST( TableIndex_Empty )
+{
+  CRhTableIndex index;
+  RH_CHECK( 0 == index.IndexedCount() );
+  RH_CHECK( -1 == index.Find( 1234, CRhTestIndexMatch() ) );
+}
+
+RH_TEST( TableIndex_FindsSmallestMatch )
+{
+  // equal hashes are all candidates; the smallest one accepted wins
+  CRhTableIndex index;
+  index.Add( 7, 5 );
+  index.Add( 7, 2 );
+  index.Add( 8, 1 );
+  index.Add( 7, 9 );
+  RH_CHECK( 2 == index.Find( 7, CRhTestIndexMatch() ) );
+  RH_CHECK( 5 == index.Find( 7, CRhTestIndexMatch( 2 ) ) );
+  RH_CHECK( 1 == index.Find( 8, CRhTestIndexMatch() ) );
+  RH_CHECK( -1 == index.Find( 8, CRhTestIndexMatch( 1 ) ) );
+  RH_CHECK( -1 == index.Find( 6, CRhTestIndexMatch() ) );
+}
+
+RH_TEST( TableIndex_Grows )
+{
+  // hashes that share their low bits land in one probe run
+  CRhTableIndex index;
+  const int count = 10000;
+  for ( int i = 0; i < count; i++ )
+    index.Add( (ON__UINT32)(i << 12), i );
+  int missing_count = 0;
+  for ( int i = 0; i < count; i++ ) {
+    if ( i != index.Find( (ON__UINT32)(i << 12), CRhTestIndexMatch() ) )
+      missing_count++;
+  }
+  RH_CHECK( 0 == missing_count );
+}
+
+RH_TEST( TableIndex_IndexedCount )
+{
+  // rows are added as the table grows, and all of them again after Empty()
+  const wchar_t* table[] = { L"Default", L"Walls", L"Roof", L"walls" };
+  CRhTableIndex index;
+  for ( int i = index.IndexedCount(); i < 2; i++ )
+    index.Add( RhHashName( table[i] ), i );
+  index.SetIndexedCount( 2 );
+  RH_CHECK( -1 == index.Find( RhHashName( L"Roof" ), CRhTestNameMatch( table, L"Roof" ) ) );
+
+  for ( int i = index.IndexedCount(); i < 4; i++ )
+    index.Add( RhHashName( table[i] ), i );
+  index.SetIndexedCount( 4 );
+  RH_CHECK( 4 == index.IndexedCount() );
+  RH_CHECK( 2 == index.Find( RhHashName( L"ROOF" ), CRhTestNameMatch( table, L"Roof" ) ) );
+  RH_CHECK( 3 == index.Find( RhHashName( L"walls" ), CRhTestNameMatch( table, L"walls" ) ) );   // row 1 has the same hash
+
+  index.Empty();
+  RH_CHECK( 0 == index.IndexedCount() );
+  RH_CHECK( -1 == index.Find( RhHashName( L"Roof" ), CRhTestNameMatch( table, L"Roof" ) ) );
+}
+
+RH_TEST( TableIndex_HashName )
+{
+  RH_CHECK( RhHashName( L"Layer 01" ) == RhHashName( L"LAYER 01" ) );
+  RH_CHECK( RhHashName( L"Layer 01" ) != RhHashName( L"Layer 02" ) );
+  RH_CHECK( RhHashName( L"ab" ) != RhHashName( L"ba" ) );
+  RH_CHECK( RhHashName( NULL ) == RhHashName( L"" ) );
+
+  // characters past the first byte count too
+  const wchar_t a[] = { 0x0100, 0 };
+  const wchar_t b[] = { 0x0200, 0 };
+  RH_CHECK( RhHashName( a ) != RhHashName( b ) );
+}
+
+RH_TEST( TableIndex_HashUuid )
+{
+  ON_UUID a, b;
+  memset( &a, 0, sizeof(a) );
+  memset( &b, 0, sizeof(b) );
+  RH_CHECK( RhHashUuid( a ) == RhHashUuid( b ) );
+  b.Data4[7] = 1;
+  RH_CHECK( RhHashUuid( a ) != RhHashUuid( b ) );
+  b.Data4[7] = 0;
+  b.Data1 = 1;
+  RH_CHECK( RhHashUuid( a ) != RhHashUuid( b ) );
+}
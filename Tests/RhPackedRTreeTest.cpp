@@ -0,0 +1,325 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhTest.h"
+#include "RhPackedRTree.h"
+
+// Deterministic random numbers, so a failure can be repeated
+class CRhTestRandom
+{
+public:
+  CRhTestRandom( ON__UINT32 seed ) : m_state(seed) {}
+  int Next( int count )
+  {
+    m_state = m_state*1664525u + 1013904223u;
+    return (int)((m_state >> 8) % (ON__UINT32)count);
+  }
+private:
+  ON__UINT32 m_state;
+};
+
+// Random boxes with integer corners, which floats hold exactly, so the
+// packed tree finds exactly what ON_RTree finds.  The id of a box is its
+// index.
+static void MakeRandomLeaves( int count, int dim, ON__UINT32 seed, ON_SimpleArray<ON_RTreeLeaf>& leaves )
+{
+  CRhTestRandom random( seed );
+  leaves.SetCount( 0 );
+  leaves.Reserve( count );
+  for ( int i = 0; i < count; i++ ) {
+    ON_RTreeLeaf& leaf = leaves.AppendNew();
+    for ( int j = 0; j < 3; j++ ) {
+      leaf.m_rect.m_min[j] = ( j < dim ) ? random.Next( 1000 ) : 0.0;
+      leaf.m_rect.m_max[j] = leaf.m_rect.m_min[j] + (( j < dim ) ? random.Next( 50 ) : 0.0);
+    }
+    leaf.m_id = i;
+  }
+}
+
+// Query boxes of every size, from points to all of the boxes
+static void MakeRandomQuery( CRhTestRandom& random, int query_index, double qmin[3], double qmax[3] )
+{
+  const int size = ( 0 == query_index ) ? 2000 : ( query_index % 4 == 1 ) ? 0 : random.Next( 300 );
+  for ( int j = 0; j < 3; j++ ) {
+    qmin[j] = ( 0 == query_index ) ? -500 : random.Next( 1100 ) - 50;
+    qmax[j] = qmin[j] + size;
+  }
+}
+
+// Sorts both results and compares them
+static bool SameIds( ON_SimpleArray<int>& a, ON_SimpleArray<int>& b )
+{
+  a.QuickSort( ON_CompareIncreasing<int> );
+  b.QuickSort( ON_CompareIncreasing<int> );
+  if ( a.Count() != b.Count() )
+    return false;
+  for ( int i = 0; i < a.Count(); i++ )
+    if ( a[i] != b[i] )
+      return false;
+  return true;
+}
+
+// Compares searches of a packed tree and an ON_RTree of the same boxes
+static void CompareWithRTree( int count, int dim, bool bParallel )
+{
+  ON_SimpleArray<ON_RTreeLeaf> leaves;
+  MakeRandomLeaves( count, dim, 1234u + count, leaves );
+
+  CRhPackedRTree packed;
+  ON_RTree rtree;
+  if ( 3 == dim ) {
+    RH_REQUIRE( packed.Create( leaves.Array(), leaves.Count(), bParallel ) );
+    for ( int i = 0; i < leaves.Count(); i++ )
+      rtree.Insert( leaves[i].m_rect.m_min, leaves[i].m_rect.m_max, (int)leaves[i].m_id );
+  }
+  else {
+    RH_REQUIRE( packed.Create2d( leaves.Array(), leaves.Count(), bParallel ) );
+    for ( int i = 0; i < leaves.Count(); i++ )
+      rtree.Insert2d( leaves[i].m_rect.m_min, leaves[i].m_rect.m_max, (int)leaves[i].m_id );
+  }
+  RH_CHECK( dim == packed.Dimension() );
+  RH_CHECK( count == packed.ElementCount() );
+
+  CRhTestRandom random( 99u );
+  int found_count = 0, wrong_count = 0;
+  for ( int q = 0; q < 200; q++ ) {
+    double qmin[3], qmax[3];
+    MakeRandomQuery( random, q, qmin, qmax );
+    ON_SimpleArray<int> packed_ids, rtree_ids;
+    if ( 3 == dim ) {
+      RH_CHECK( packed.Search( qmin, qmax, packed_ids ) );
+      rtree.Search( qmin, qmax, rtree_ids );
+    }
+    else {
+      RH_CHECK( packed.Search2d( qmin, qmax, packed_ids ) );
+      rtree.Search2d( qmin, qmax, rtree_ids );
+    }
+    if ( !SameIds( packed_ids, rtree_ids ) )
+      wrong_count++;
+    found_count += packed_ids.Count();
+  }
+  RH_CHECK( 0 == wrong_count );
+  RH_CHECK( found_count > 0 );
+}
+
+RH_TEST( PackedRTree_MatchesRTree )
+{
+  const int counts[] = { 1, 8, 9, 65, 1000 };
+  for ( int i = 0; i < (int)(sizeof(counts)/sizeof(counts[0])); i++ ) {
+    CompareWithRTree( counts[i], 3, false );
+    CompareWithRTree( counts[i], 2, false );
+  }
+}
+
+RH_TEST( PackedRTree_ParallelMatchesRTree )
+{
+  // 8192 or more elements are sorted by jobs
+  CompareWithRTree( 10000, 3, true );
+  CompareWithRTree( 10000, 2, true );
+}
+
+RH_TEST( PackedRTree_Levels )
+{
+  // 8 children per node: 9 elements need 2 leaf nodes and a root, 65
+  // need 9 leaf nodes, 2 nodes above them and a root
+  const int counts[] = { 1, 8, 9, 65 };
+  const int node_counts[] = { 1, 1, 3, 12 };
+  const int depths[] = { 1, 1, 2, 3 };
+  for ( int i = 0; i < 4; i++ ) {
+    ON_SimpleArray<ON_RTreeLeaf> leaves;
+    MakeRandomLeaves( counts[i], 3, 5u, leaves );
+    CRhPackedRTree tree;
+    RH_REQUIRE( tree.Create( leaves.Array(), leaves.Count() ) );
+    RH_CHECK( node_counts[i] == tree.NodeCount() );
+    RH_CHECK( depths[i] == tree.Depth() );
+    RH_CHECK( tree.SizeOf() > 0 );
+
+    ON_BoundingBox bbox;
+    for ( int k = 0; k < leaves.Count(); k++ )
+      bbox.Union( ON_BoundingBox( ON_3dPoint( leaves[k].m_rect.m_min ), ON_3dPoint( leaves[k].m_rect.m_max ) ) );
+    const ON_BoundingBox tree_bbox = tree.BoundingBox();
+    RH_CHECK( tree_bbox.m_min == bbox.m_min && tree_bbox.m_max == bbox.m_max );
+  }
+}
+
+RH_TEST( PackedRTree_ParallelBuildIsTheSame )
+{
+  ON_SimpleArray<ON_RTreeLeaf> leaves;
+  MakeRandomLeaves( 20000, 3, 77u, leaves );
+  CRhPackedRTree serial, parallel;
+  RH_REQUIRE( serial.Create( leaves.Array(), leaves.Count(), false ) );
+  RH_REQUIRE( parallel.Create( leaves.Array(), leaves.Count(), true ) );
+  RH_CHECK( serial.NodeCount() == parallel.NodeCount() );
+  RH_CHECK( serial.Depth() == parallel.Depth() );
+
+  // same tree, so the ids come back in the same order
+  CRhTestRandom random( 3u );
+  int wrong_count = 0;
+  for ( int q = 0; q < 100; q++ ) {
+    double qmin[3], qmax[3];
+    MakeRandomQuery( random, q, qmin, qmax );
+    ON_SimpleArray<int> a, b;
+    serial.Search( qmin, qmax, a );
+    parallel.Search( qmin, qmax, b );
+    bool bSame = ( a.Count() == b.Count() );
+    for ( int i = 0; bSame && i < a.Count(); i++ )
+      bSame = ( a[i] == b[i] );
+    if ( !bSame )
+      wrong_count++;
+  }
+  RH_CHECK( 0 == wrong_count );
+}
+
+// Counts the elements found and stops at the third
+static bool ON_MSC_CDECL StopAtThird( void* a_context, ON__INT_PTR )
+{
+  int* found_count = (int*)a_context;
+  return ++(*found_count) < 3;
+}
+
+RH_TEST( PackedRTree_CallbackStops )
+{
+  ON_SimpleArray<ON_RTreeLeaf> leaves;
+  MakeRandomLeaves( 100, 3, 11u, leaves );
+  CRhPackedRTree tree;
+  RH_REQUIRE( tree.Create( leaves.Array(), leaves.Count() ) );
+  const double qmin[3] = { -1.0, -1.0, -1.0 };
+  const double qmax[3] = { 2000.0, 2000.0, 2000.0 };
+  int found_count = 0;
+  RH_CHECK( !tree.Search( qmin, qmax, StopAtThird, &found_count ) );
+  RH_CHECK( 3 == found_count );
+
+  ON_SimpleArray<void*> pointers;
+  RH_CHECK( tree.Search( qmin, qmax, pointers ) );
+  RH_CHECK( 100 == pointers.Count() );
+}
+
+RH_TEST( PackedRTree_EmptyAndInvalid )
+{
+  CRhPackedRTree tree;
+  RH_CHECK( tree.Create( NULL, 0 ) );
+  RH_CHECK( 0 == tree.ElementCount() );
+  RH_CHECK( 0 == tree.NodeCount() );
+  const double qmin[3] = { -1.0, -1.0, -1.0 };
+  const double qmax[3] = { 1.0, 1.0, 1.0 };
+  ON_SimpleArray<int> ids;
+  RH_CHECK( tree.Search( qmin, qmax, ids ) );
+  RH_CHECK( 0 == ids.Count() );
+
+  // min above max
+  ON_RTreeLeaf leaf;
+  leaf.m_rect.m_min[0] = leaf.m_rect.m_min[1] = leaf.m_rect.m_min[2] = 1.0;
+  leaf.m_rect.m_max[0] = leaf.m_rect.m_max[1] = leaf.m_rect.m_max[2] = 0.0;
+  leaf.m_id = 0;
+  RH_CHECK( !tree.Create( &leaf, 1 ) );
+  RH_CHECK( 0 == tree.ElementCount() );
+
+  // a 2d tree is not searched in 3d
+  leaf.m_rect.m_max[0] = leaf.m_rect.m_max[1] = leaf.m_rect.m_max[2] = 2.0;
+  RH_REQUIRE( tree.Create2d( &leaf, 1 ) );
+  RH_CHECK( tree.Search2d( qmin, qmax, ids ) );
+  RH_CHECK( 1 == ids.Count() );
+  ids.SetCount( 0 );
+  RH_CHECK( tree.Search( qmin, qmax, ids ) );
+  RH_CHECK( 0 == ids.Count() );
+}
+
+// Maps the cube of half width 'size' around 'center' to the clipping cube
+static void SetFrustum( ON_ClippingRegion& frustum, const ON_3dPoint& center, double size )
+{
+  ON_Xform scale, move;
+  scale.Scale( ON_origin, 1.0/size );
+  move.Translation( ON_origin - center );
+  frustum.m_xform = scale*move;
+}
+
+// Compares frustum searches with testing every element
+static void CompareWithInViewFrustum( const CRhPackedRTree& tree, const ON_SimpleArray<ON_RTreeLeaf>& leaves,
+                                      const ON_ClippingRegion* const* frustums, int frustum_count )
+{
+  ON_SimpleArray<int> tree_ids, ids;
+  RH_CHECK( tree.Search( frustums, frustum_count, tree_ids ) );
+  for ( int i = 0; i < leaves.Count(); i++ ) {
+    const ON_BoundingBox bbox( ON_3dPoint( leaves[i].m_rect.m_min ), ON_3dPoint( leaves[i].m_rect.m_max ) );
+    for ( int f = 0; f < frustum_count; f++ ) {
+      if ( frustums[f]->InViewFrustum( bbox ) > 0 ) {
+        ids.Append( (int)leaves[i].m_id );
+        break;
+      }
+    }
+  }
+  RH_CHECK( ids.Count() > 0 && ids.Count() < leaves.Count() );
+  RH_CHECK( SameIds( tree_ids, ids ) );
+}
+
+RH_TEST( PackedRTree_FrustumSearch )
+{
+  ON_SimpleArray<ON_RTreeLeaf> leaves;
+  MakeRandomLeaves( 5000, 3, 21u, leaves );
+  CRhPackedRTree tree;
+  RH_REQUIRE( tree.Create( leaves.Array(), leaves.Count() ) );
+
+  ON_ClippingRegion left, right;
+  SetFrustum( left, ON_3dPoint( 300.0, 400.0, 500.0 ), 150.0 );
+  SetFrustum( right, ON_3dPoint( 700.0, 400.0, 500.0 ), 100.0 );
+  const ON_ClippingRegion* frustums[2] = { &left, &right };
+  CompareWithInViewFrustum( tree, leaves, frustums, 1 );
+  CompareWithInViewFrustum( tree, leaves, frustums + 1, 1 );
+  CompareWithInViewFrustum( tree, leaves, frustums, 2 );
+
+  // a frustum around everything finds everything
+  ON_ClippingRegion all;
+  SetFrustum( all, ON_3dPoint( 500.0, 500.0, 500.0 ), 2000.0 );
+  const ON_ClippingRegion* all_frustums[1] = { &all };
+  ON_SimpleArray<int> ids;
+  RH_CHECK( tree.Search( all_frustums, 1, ids ) );
+  RH_CHECK( leaves.Count() == ids.Count() );
+}
+
+RH_TEST( PackedRTree_MeshFaceTree )
+{
+  // 20 x 20 quads with integer vertexes, and a face with a bad vertex index
+  ON_Mesh mesh;
+  const int n = 20;
+  for ( int j = 0; j <= n; j++ )
+    for ( int i = 0; i <= n; i++ )
+      mesh.m_V.Append( ON_3fPoint( (float)i, (float)j, (float)((i*j) % 5) ) );
+  for ( int j = 0; j < n; j++ ) {
+    for ( int i = 0; i < n; i++ ) {
+      ON_MeshFace& face = mesh.m_F.AppendNew();
+      face.vi[0] = j*(n + 1) + i;
+      face.vi[1] = face.vi[0] + 1;
+      face.vi[2] = face.vi[1] + n + 1;
+      face.vi[3] = face.vi[0] + n + 1;
+    }
+  }
+  ON_MeshFace& bad_face = mesh.m_F.AppendNew();
+  bad_face.vi[0] = bad_face.vi[1] = bad_face.vi[2] = bad_face.vi[3] = mesh.m_V.Count();
+
+  CRhPackedRTree tree;
+  RH_REQUIRE( tree.CreateMeshFaceTree( &mesh ) );
+  RH_CHECK( n*n == tree.ElementCount() );
+
+  const double qmin[3] = { 4.5, 7.0, -1.0 };
+  const double qmax[3] = { 6.0, 7.5, 10.0 };
+  ON_SimpleArray<int> ids;
+  RH_CHECK( tree.Search( qmin, qmax, ids ) );
+  // columns 4 to 6 of rows 6 and 7
+  const int expected[] = { 6*n + 4, 6*n + 5, 6*n + 6, 7*n + 4, 7*n + 5, 7*n + 6 };
+  ids.QuickSort( ON_CompareIncreasing<int> );
+  RH_REQUIRE( 6 == ids.Count() );
+  for ( int i = 0; i < 6; i++ )
+    RH_CHECK( expected[i] == ids[i] );
+}
@@ -0,0 +1,226 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "RhTest.h"
+#include "RhPointCloudOctree.h"
+
+static const char* OctreeTestFile = "/tmp/RhPointCloudOctreeTest.points";
+
+// A point and its color, for comparing clouds in any order
+struct CRhTestPoint
+{
+  float m_P[3];
+  unsigned int m_color;
+};
+
+static int CompareTestPoints( const CRhTestPoint* a, const CRhTestPoint* b )
+{
+  for ( int i = 0; i < 3; i++ ) {
+    if ( a->m_P[i] < b->m_P[i] ) return -1;
+    if ( a->m_P[i] > b->m_P[i] ) return 1;
+  }
+  if ( a->m_color < b->m_color ) return -1;
+  if ( a->m_color > b->m_color ) return 1;
+  return 0;
+}
+
+// Integer coordinates in [0,1000], so the floats in the file are exact.
+// Every other point of a flat cloud has z = 5.
+static void MakeCloud( ON_PointCloud& cloud, int point_count, bool bColors, bool bFlat )
+{
+  unsigned int seed = (unsigned int)point_count;
+  for ( int i = 0; i < point_count; i++ ) {
+    double c[3];
+    for ( int j = 0; j < 3; j++ ) {
+      seed = seed*1103515245 + 12345;
+      c[j] = (double)((seed >> 8) % 1001);
+    }
+    if ( bFlat && (i & 1) )
+      c[2] = 5.0;
+    cloud.m_P.Append( ON_3dPoint( c[0], c[1], c[2] ) );
+    if ( bColors )
+      cloud.m_C.Append( ON_Color( i & 0xFF, (i >> 8) & 0xFF, (i >> 16) & 0xFF ) );
+  }
+}
+
+static void GetCloudPoints( const ON_PointCloud& cloud, ON_SimpleArray<CRhTestPoint>& points )
+{
+  points.SetCount( 0 );
+  for ( int i = 0; i < cloud.m_P.Count(); i++ ) {
+    CRhTestPoint& p = points.AppendNew();
+    p.m_P[0] = (float)cloud.m_P[i].x;
+    p.m_P[1] = (float)cloud.m_P[i].y;
+    p.m_P[2] = (float)cloud.m_P[i].z;
+    p.m_color = ( cloud.m_C.Count() > 0 ) ? (unsigned int)cloud.m_C[i] : 0;
+  }
+  points.QuickSort( CompareTestPoints );
+}
+
+// Reads every node of an open octree
+static bool GetOctreePoints( const CRhPointCloudOctree& octree, ON_SimpleArray<CRhTestPoint>& points )
+{
+  points.SetCount( 0 );
+  ON_SimpleArray<ON_3fPoint> P;
+  ON_SimpleArray<ON_Color> C;
+  for ( int node_index = 0; node_index < octree.NodeCount(); node_index++ ) {
+    if ( !octree.ReadNode( node_index, P, C ) || P.Count() != octree.NodePointCount( node_index ) )
+      return false;
+    if ( C.Count() != ( octree.HasColors() ? P.Count() : 0 ) )
+      return false;
+    for ( int i = 0; i < P.Count(); i++ ) {
+      CRhTestPoint& p = points.AppendNew();
+      p.m_P[0] = P[i].x;
+      p.m_P[1] = P[i].y;
+      p.m_P[2] = P[i].z;
+      p.m_color = ( C.Count() > 0 ) ? (unsigned int)C[i] : 0;
+    }
+  }
+  points.QuickSort( CompareTestPoints );
+  return true;
+}
+
+static void CheckOctreeRoundTrip( int point_count, bool bColors, bool bFlat )
+{
+  ON_PointCloud cloud;
+  MakeCloud( cloud, point_count, bColors, bFlat );
+  ON_SimpleArray<CRhTestPoint> expected;
+  GetCloudPoints( cloud, expected );
+
+  RH_REQUIRE( CRhPointCloudOctree::Build( cloud, OctreeTestFile, 0x1234567890ULL ) );
+  CRhPointCloudOctree octree;
+  RH_REQUIRE( octree.Open( OctreeTestFile ) );
+  RH_CHECK( octree.PointCount() == point_count );
+  RH_CHECK( octree.HasColors() == bColors );
+  RH_CHECK( octree.SourceKey() == 0x1234567890ULL );
+
+  // every point is stored once, with its own color
+  ON_SimpleArray<CRhTestPoint> found;
+  RH_REQUIRE( GetOctreePoints( octree, found ) );
+  RH_REQUIRE( found.Count() == expected.Count() );
+  int mismatch_count = 0;
+  for ( int i = 0; i < found.Count(); i++ ) {
+    if ( 0 != CompareTestPoints( &found[i], &expected[i] ) )
+      mismatch_count++;
+  }
+  RH_CHECK( 0 == mismatch_count );
+
+  // the cloud was sorted in place, colors along with their points
+  ON_SimpleArray<CRhTestPoint> sorted;
+  GetCloudPoints( cloud, sorted );
+  RH_CHECK( sorted.Count() == expected.Count() && 0 == memcmp( sorted.Array(), expected.Array(), sorted.Count()*sizeof(CRhTestPoint) ) );
+
+  ON_BoundingBox bbox = octree.BoundingBox();
+  int outside_count = 0;
+  for ( int i = 0; i < found.Count(); i++ ) {
+    for ( int j = 0; j < 3; j++ ) {
+      if ( found[i].m_P[j] < bbox.m_min[j] || found[i].m_P[j] > bbox.m_max[j] )
+        outside_count++;
+    }
+  }
+  RH_CHECK( 0 == outside_count );
+
+  octree.Close();
+  unlink( OctreeTestFile );
+}
+
+RH_TEST( Octree_RoundTrip )
+{
+  // one node, one node exactly full, one point past it, and several levels
+  CheckOctreeRoundTrip( 1, false, false );
+  CheckOctreeRoundTrip( 8192, true, false );
+  CheckOctreeRoundTrip( 8193, true, false );
+  CheckOctreeRoundTrip( 50000, false, false );
+  CheckOctreeRoundTrip( 50000, true, true );
+}
+
+RH_TEST( Octree_DuplicatePoints )
+{
+  // points that cannot be split apart stop at the depth limit
+  ON_PointCloud cloud;
+  for ( int i = 0; i < 40000; i++ )
+    cloud.m_P.Append( ON_3dPoint( 1.0, 2.0, 3.0 ) );
+  RH_REQUIRE( CRhPointCloudOctree::Build( cloud, OctreeTestFile, 1 ) );
+  CRhPointCloudOctree octree;
+  RH_REQUIRE( octree.Open( OctreeTestFile ) );
+  ON_SimpleArray<CRhTestPoint> found;
+  RH_CHECK( GetOctreePoints( octree, found ) );
+  RH_CHECK( 40000 == found.Count() );
+  octree.Close();
+  unlink( OctreeTestFile );
+}
+
+RH_TEST( Octree_OpenRejectsOtherFiles )
+{
+  CRhPointCloudOctree octree;
+  RH_CHECK( !octree.Open( "/tmp/RhPointCloudOctreeTest-missing.points" ) );
+  RH_CHECK( !octree.IsOpen() );
+
+  FILE* fp = fopen( OctreeTestFile, "wb" );
+  RH_REQUIRE( fp != NULL );
+  const char junk[256] = "not an octree";
+  fwrite( junk, 1, sizeof(junk), fp );
+  fclose( fp );
+  RH_CHECK( !octree.Open( OctreeTestFile ) );
+  RH_CHECK( !octree.IsOpen() );
+  RH_CHECK( 0 == octree.NodeCount() );
+  unlink( OctreeTestFile );
+}
+
+RH_TEST( Octree_SelectNodes )
+{
+  ON_PointCloud cloud;
+  MakeCloud( cloud, 100000, false, false );
+  RH_REQUIRE( CRhPointCloudOctree::Build( cloud, OctreeTestFile, 2 ) );
+  CRhPointCloudOctree octree;
+  RH_REQUIRE( octree.Open( OctreeTestFile ) );
+  RH_REQUIRE( octree.NodeCount() > 1 );
+
+  ON_Viewport viewport;
+  viewport.Extents( 0.25*ON_PI, octree.BoundingBox() );
+  viewport.SetScreenPort( 0, 99, 99, 0, 0, 0xff );
+
+  // selected nodes hold the points counted, root first, each node once
+  ON_SimpleArray<int> nodes;
+  const int budget = octree.NodePointCount( 0 ) + 20000;
+  const int selected_count = octree.SelectNodes( viewport, 100, 100, budget, 1.0, nodes );
+  RH_CHECK( selected_count <= budget );
+  RH_REQUIRE( nodes.Count() > 0 );
+  RH_CHECK( 0 == nodes[0] );
+  int sum = 0;
+  ON_SimpleArray<bool> bSelected( octree.NodeCount() );
+  bSelected.SetCount( octree.NodeCount() );
+  bSelected.Zero();
+  for ( int i = 0; i < nodes.Count(); i++ ) {
+    RH_REQUIRE( nodes[i] >= 0 && nodes[i] < octree.NodeCount() );
+    RH_CHECK( !bSelected[nodes[i]] );
+    bSelected[nodes[i]] = true;
+    sum += octree.NodePointCount( nodes[i] );
+  }
+  RH_CHECK( sum == selected_count );
+
+  // without a budget or a spacing every node of a cloud in view is drawn
+  RH_CHECK( octree.PointCount() == octree.SelectNodes( viewport, 100, 100, 1000000, 0.0, nodes ) );
+  RH_CHECK( nodes.Count() == octree.NodeCount() );
+
+  // a budget smaller than the root selects nothing
+  RH_CHECK( 0 == octree.SelectNodes( viewport, 100, 100, octree.NodePointCount( 0 ) - 1, 1.0, nodes ) );
+  RH_CHECK( 0 == nodes.Count() );
+
+  octree.Close();
+  unlink( OctreeTestFile );
+}
@@ -0,0 +1,117 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <math.h>
+
+#include "RhTest.h"
+#include "RhResolutionController.h"
+
+static bool IsScaleStep( double scale )
+{
+  return scale == floor( scale*16.0 )/16.0;
+}
+
+RH_TEST( Resolution_StartsAtFullSize )
+{
+  CRhResolutionController controller;
+  RH_CHECK( 1.0 == controller.Scale() );
+  RH_CHECK( 640 == controller.ScaledSize( 640 ) );
+  RH_CHECK( 1 == controller.ScaledSize( 0 ) );
+}
+
+RH_TEST( Resolution_GpuBoundFramesLowerTheScale )
+{
+  CRhResolutionController controller( 30.0, 0.5 );
+
+  // one very slow frame cuts at most a quarter
+  controller.FrameDrawn( 120.0, 100.0 );
+  RH_CHECK( 0.75 == controller.Scale() );
+  RH_CHECK( 480 == controller.ScaledSize( 640 ) );
+
+  // never below min_scale, always on a step
+  double previous_scale = controller.Scale();
+  for ( int i = 0; i < 20; i++ ) {
+    controller.FrameDrawn( 120.0, 100.0 );
+    RH_CHECK( controller.Scale() <= previous_scale );
+    RH_CHECK( IsScaleStep( controller.Scale() ) );
+    previous_scale = controller.Scale();
+  }
+  RH_CHECK( 0.5 == controller.Scale() );
+}
+
+RH_TEST( Resolution_CpuBoundFramesKeepTheScale )
+{
+  // drawing fewer pixels would not make these frames faster
+  CRhResolutionController controller( 30.0, 0.5 );
+  for ( int i = 0; i < 10; i++ )
+    controller.FrameDrawn( 60.0, 5.0 );
+  RH_CHECK( 1.0 == controller.Scale() );
+}
+
+RH_TEST( Resolution_FastFramesRaiseTheScale )
+{
+  CRhResolutionController controller( 30.0, 0.5 );
+  for ( int i = 0; i < 20; i++ )
+    controller.FrameDrawn( 120.0, 100.0 );
+  RH_REQUIRE( 0.5 == controller.Scale() );
+
+  // frames a little under budget leave the scale alone
+  for ( int i = 0; i < 10; i++ )
+    controller.FrameDrawn( 25.0, 20.0 );
+  RH_CHECK( 0.5 == controller.Scale() );
+
+  // fast frames raise it one step per frame, up to full size
+  controller.FrameDrawn( 10.0, 5.0 );
+  RH_CHECK( 0.5 + 1.0/16.0 == controller.Scale() );
+  for ( int i = 0; i < 20; i++ )
+    controller.FrameDrawn( 10.0, 5.0 );
+  RH_CHECK( 1.0 == controller.Scale() );
+}
+
+RH_TEST( Resolution_SmoothsHitches )
+{
+  // a slow frame between fast ones averages out under the budget
+  CRhResolutionController controller( 30.0, 0.5 );
+  controller.FrameDrawn( 20.0, 10.0 );
+  controller.FrameDrawn( 38.0, 30.0 );
+  RH_CHECK( 1.0 == controller.Scale() );
+}
+
+RH_TEST( Resolution_Reset )
+{
+  CRhResolutionController controller( 30.0, 0.5 );
+  controller.FrameDrawn( 120.0, 100.0 );
+  RH_REQUIRE( controller.Scale() < 1.0 );
+  controller.Reset();
+  RH_CHECK( 1.0 == controller.Scale() );
+
+  // frames that took no time are ignored
+  controller.FrameDrawn( 0.0, 0.0 );
+  controller.FrameDrawn( -1.0, 0.0 );
+  RH_CHECK( 1.0 == controller.Scale() );
+}
+
+RH_TEST( Resolution_InvalidMinimumScale )
+{
+  // a min_scale out of range keeps full resolution
+  CRhResolutionController zero( 30.0, 0.0 );
+  CRhResolutionController two( 30.0, 2.0 );
+  for ( int i = 0; i < 10; i++ ) {
+    zero.FrameDrawn( 120.0, 100.0 );
+    two.FrameDrawn( 120.0, 100.0 );
+  }
+  RH_CHECK( 1.0 == zero.Scale() );
+  RH_CHECK( 1.0 == two.Scale() );
+}
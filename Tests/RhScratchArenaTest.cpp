@@ -0,0 +1,138 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhTest.h"
+#include "RhScratchArena.h"
+
+// Allocates count buffers of sz bytes.  *bOneBlock tells whether they came
+// from one block, one after the other.
+static bool AllocateRound( CRhScratchArena& arena, int count, size_t sz, bool* bOneBlock )
+{
+  unsigned char* previous = NULL;
+  *bOneBlock = true;
+  for ( int i = 0; i < count; i++ ) {
+    unsigned char* p = (unsigned char*)arena.Allocate( sz );
+    if ( p == NULL )
+      return false;
+    if ( previous && p != previous + sz )
+      *bOneBlock = false;
+    previous = p;
+  }
+  return true;
+}
+
+RH_TEST( ScratchArena_Alignment )
+{
+  CRhScratchArena arena( 1024 );
+  RH_CHECK( NULL == arena.Allocate( 0 ) );
+  const size_t sizes[] = { 1, 3, 16, 17, 100, 5000 };
+  for ( int round = 0; round < 2; round++ ) {
+    for ( size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++ ) {
+      void* p = arena.Allocate( sizes[i] );
+      RH_REQUIRE( p != NULL );
+      RH_CHECK( 0 == ((size_t)p & 15) );
+    }
+    arena.Reset();
+  }
+}
+
+RH_TEST( ScratchArena_AllocationsDoNotOverlap )
+{
+  // fill each allocation with its own byte, across several blocks
+  CRhScratchArena arena( 256 );
+  unsigned char* buffers[200];
+  size_t sizes[200];
+  for ( int i = 0; i < 200; i++ ) {
+    sizes[i] = 1 + (i*37) % 300;
+    buffers[i] = (unsigned char*)arena.Allocate( sizes[i] );
+    RH_REQUIRE( buffers[i] != NULL );
+    memset( buffers[i], i, sizes[i] );
+  }
+  int bad_count = 0;
+  for ( int i = 0; i < 200; i++ ) {
+    for ( size_t j = 0; j < sizes[i]; j++ ) {
+      if ( buffers[i][j] != (unsigned char)i )
+        bad_count++;
+    }
+  }
+  RH_CHECK( 0 == bad_count );
+}
+
+RH_TEST( ScratchArena_AllocatedSize )
+{
+  CRhScratchArena arena( 1024 );
+  RH_CHECK( 0 == arena.AllocatedSize() );
+  arena.Allocate( 1 );
+  arena.Allocate( 20 );
+  RH_CHECK( 48 == arena.AllocatedSize() );    // rounded up to the alignment
+  arena.Allocate( 4096 );
+  RH_CHECK( 48 + 4096 == arena.AllocatedSize() );
+  arena.Reset();
+  RH_CHECK( 0 == arena.AllocatedSize() );
+}
+
+RH_TEST( ScratchArena_ResetReusesMemory )
+{
+  CRhScratchArena arena( 4096 );
+  void* first = arena.Allocate( 100 );
+  arena.Allocate( 200 );
+  arena.Reset();
+  RH_CHECK( first == arena.Allocate( 100 ) );
+
+  // zeroed memory is cleared even where earlier allocations wrote
+  arena.Reset();
+  unsigned char* p = (unsigned char*)arena.Allocate( 64 );
+  RH_REQUIRE( p != NULL );
+  memset( p, 0xAB, 64 );
+  arena.Reset();
+  unsigned char* z = (unsigned char*)arena.AllocateZeroed( 16, 4 );
+  RH_REQUIRE( z == p );
+  int nonzero_count = 0;
+  for ( int i = 0; i < 64; i++ ) {
+    if ( z[i] )
+      nonzero_count++;
+  }
+  RH_CHECK( 0 == nonzero_count );
+}
+
+RH_TEST( ScratchArena_GrowsToOneBlock )
+{
+  // a round that needed several blocks fits in one block after Reset()
+  CRhScratchArena arena( 1024 );
+  bool bOneBlock = false;
+  RH_REQUIRE( AllocateRound( arena, 100, 256, &bOneBlock ) );
+  RH_CHECK( !bOneBlock );
+  arena.Reset();
+  RH_REQUIRE( AllocateRound( arena, 100, 256, &bOneBlock ) );
+  RH_CHECK( bOneBlock );
+}
+
+RH_TEST( ScratchArena_DoesNotKeepHugeBlocks )
+{
+  // a round bigger than max_retained_size does not grow the first block
+  CRhScratchArena arena( 1024, 64*1024 );
+  bool bOneBlock = false;
+  RH_REQUIRE( AllocateRound( arena, 400, 256, &bOneBlock ) );
+  arena.Reset();
+  RH_REQUIRE( AllocateRound( arena, 400, 256, &bOneBlock ) );
+  RH_CHECK( !bOneBlock );
+
+  // and a single allocation bigger than a block still works
+  unsigned char* p = (unsigned char*)arena.Allocate( 1024*1024 );
+  RH_REQUIRE( p != NULL );
+  p[0] = 1;
+  p[1024*1024 - 1] = 2;
+  arena.Reset();
+}
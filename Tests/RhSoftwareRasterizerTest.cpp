@@ -0,0 +1,208 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include "RhTest.h"
+#include "RhSoftwareRasterizer.h"
+#include "RhDisplayData.h"
+
+// A square facing +z, from -half_size to half_size in x and y
+struct CRhTestSquare
+{
+  CRhTestSquare( float half_size, float z )
+  {
+    const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+    for ( int i = 0; i < 4; i++ ) {
+      m_V[i].vertex = ON_3fPoint( ON_3dPoint( half_size*corners[i][0], half_size*corners[i][1], z ) );
+      m_V[i].normal = ON_3fVector( 0.0f, 0.0f, 1.0f );
+    }
+    const unsigned short T[6] = { 0, 1, 2, 0, 2, 3 };
+    memcpy( m_T, T, sizeof(m_T) );
+  }
+
+  bool AddTo( CRhRasterScene& scene, const ON_Material& material, const ON_3fVector& offset = ON_3fVector( 0.0f, 0.0f, 0.0f ) ) const
+  {
+    return scene.AddDisplayBuffers( m_V, 4, true, false, m_T, 2, offset, material );
+  }
+
+  VertexData m_V[4];
+  unsigned short m_T[6];
+};
+
+// Camera on the z axis 10 units from the origin, seeing x and y from -10 to 10 at z = 0
+static void GetTestViewport( ON_Viewport& viewport )
+{
+  viewport.SetProjection( ON::perspective_view );
+  viewport.SetCameraLocation( ON_3dPoint( 0.0, 0.0, 10.0 ) );
+  viewport.SetCameraDirection( ON_3dVector( 0.0, 0.0, -1.0 ) );
+  viewport.SetCameraUp( ON_3dVector( 0.0, 1.0, 0.0 ) );
+  viewport.SetFrustum( -1.0, 1.0, -1.0, 1.0, 1.0, 100.0 );
+}
+
+static ON_Material TestMaterial( int red, int green, int blue, double transparency = 0.0 )
+{
+  ON_Material material;
+  material.m_diffuse = ON_Color( red, green, blue );
+  material.m_transparency = transparency;
+  return material;
+}
+
+static const unsigned char* TestPixel( const CRhSoftwareRasterizer& rasterizer, int x, int y )
+{
+  return rasterizer.Pixels() + 4*(y*rasterizer.Width() + x);
+}
+
+RH_TEST( RasterScene_AddDisplayBuffers )
+{
+  CRhRasterScene scene;
+  CRhTestSquare square( 5.0f, 0.0f );
+  const ON_Material material = TestMaterial( 200, 0, 0 );
+  RH_CHECK( 0 == scene.MeshCount() );
+  RH_CHECK( !scene.BoundingBox().IsValid() );
+
+  // empty buffers and indexes past the vertices are refused
+  RH_CHECK( !scene.AddDisplayBuffers( NULL, 4, true, false, square.m_T, 2, ON_3fVector( 0.0f, 0.0f, 0.0f ), material ) );
+  RH_CHECK( !scene.AddDisplayBuffers( square.m_V, 4, true, false, square.m_T, 0, ON_3fVector( 0.0f, 0.0f, 0.0f ), material ) );
+  RH_CHECK( !scene.AddDisplayBuffers( square.m_V, 3, true, false, square.m_T, 2, ON_3fVector( 0.0f, 0.0f, 0.0f ), material ) );
+  RH_CHECK( 0 == scene.MeshCount() );
+
+  RH_CHECK( square.AddTo( scene, material ) );
+  RH_CHECK( square.AddTo( scene, material, ON_3fVector( 100.0f, 0.0f, 0.0f ) ) );
+  RH_CHECK( 2 == scene.MeshCount() );
+  RH_CHECK( 4 == scene.TriangleCount() );
+
+  // the box includes the offsets
+  const ON_BoundingBox bbox = scene.BoundingBox();
+  RH_CHECK( -5.0 == bbox.m_min.x && 105.0 == bbox.m_max.x );
+  RH_CHECK( -5.0 == bbox.m_min.y && 5.0 == bbox.m_max.y );
+
+  scene.Destroy();
+  RH_CHECK( 0 == scene.MeshCount() );
+  RH_CHECK( 0 == scene.TriangleCount() );
+}
+
+RH_TEST( RasterScene_Coverage )
+{
+  // a square half the width of the view, over a transparent background
+  CRhRasterScene scene;
+  CRhTestSquare square( 5.0f, 0.0f );
+  RH_REQUIRE( square.AddTo( scene, TestMaterial( 200, 0, 0 ) ) );
+
+  ON_Viewport viewport;
+  GetTestViewport( viewport );
+  CRhSoftwareRasterizer rasterizer;
+  RH_REQUIRE( rasterizer.Render( scene, viewport, 64, 64, ON_Color( 0, 0, 0, 0 ) ) );
+  RH_REQUIRE( 64 == rasterizer.Width() && 64 == rasterizer.Height() );
+
+  const unsigned char* center = TestPixel( rasterizer, 32, 32 );
+  RH_CHECK( 255 == center[3] );
+  RH_CHECK( center[0] > 100 && center[1] < 30 && center[2] < 30 );
+  RH_CHECK( 0 == TestPixel( rasterizer, 2, 2 )[3] );
+  RH_CHECK( 0 == TestPixel( rasterizer, 61, 32 )[3] );
+
+  // the square covers about a quarter of the image
+  int covered_count = 0;
+  for ( int i = 0; i < 64*64; i++ ) {
+    if ( rasterizer.Pixels()[4*i+3] == 255 )
+      covered_count++;
+  }
+  RH_CHECK( covered_count >= 30*30 && covered_count <= 34*34 );
+
+  // nothing to draw into
+  RH_CHECK( !rasterizer.Render( scene, viewport, 0, 64, ON_Color( 0, 0, 0, 0 ) ) );
+}
+
+RH_TEST( RasterScene_Depth )
+{
+  // a small blue square in front of a big red one, added first
+  CRhRasterScene scene;
+  CRhTestSquare front( 2.0f, 1.0f );
+  CRhTestSquare back( 5.0f, 0.0f );
+  RH_REQUIRE( front.AddTo( scene, TestMaterial( 0, 0, 200 ) ) );
+  RH_REQUIRE( back.AddTo( scene, TestMaterial( 200, 0, 0 ) ) );
+
+  ON_Viewport viewport;
+  GetTestViewport( viewport );
+  CRhSoftwareRasterizer rasterizer;
+  RH_REQUIRE( rasterizer.Render( scene, viewport, 64, 64, ON_Color( 0, 0, 0, 0 ) ) );
+  const unsigned char* center = TestPixel( rasterizer, 32, 32 );
+  RH_CHECK( center[2] > 100 && center[0] < 30 );
+  const unsigned char* side = TestPixel( rasterizer, 20, 32 );
+  RH_CHECK( side[0] > 100 && side[2] < 30 );
+}
+
+RH_TEST( RasterScene_Transparency )
+{
+  // a half transparent green square blends over the red one behind it
+  CRhRasterScene scene;
+  CRhTestSquare glass( 2.0f, 1.0f );
+  CRhTestSquare back( 5.0f, 0.0f );
+  RH_REQUIRE( glass.AddTo( scene, TestMaterial( 0, 200, 0, 0.5 ) ) );
+  RH_REQUIRE( back.AddTo( scene, TestMaterial( 200, 0, 0 ) ) );
+
+  ON_Viewport viewport;
+  GetTestViewport( viewport );
+  CRhSoftwareRasterizer rasterizer;
+  RH_REQUIRE( rasterizer.Render( scene, viewport, 64, 64, ON_Color( 0, 0, 0, 0 ) ) );
+  // alpha blends too, like glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA )
+  const unsigned char* center = TestPixel( rasterizer, 32, 32 );
+  RH_CHECK( center[3] > 128 && center[3] < 255 );
+  RH_CHECK( center[0] > 40 && center[1] > 40 && center[2] < 30 );
+}
+
+RH_TEST( RasterScene_Deterministic )
+{
+  // tiles drawn on any thread give the same image, at any image size and sample count
+  CRhRasterScene scene;
+  CRhTestSquare front( 2.0f, 1.0f );
+  CRhTestSquare back( 5.0f, 0.0f );
+  RH_REQUIRE( front.AddTo( scene, TestMaterial( 0, 200, 0, 0.5 ) ) );
+  RH_REQUIRE( back.AddTo( scene, TestMaterial( 200, 0, 0 ) ) );
+
+  ON_Viewport viewport;
+  GetTestViewport( viewport );
+  for ( int supersample = 1; supersample <= CRhSoftwareRasterizer::max_supersample; supersample++ ) {
+    CRhSoftwareRasterizer first, second;
+    RH_REQUIRE( first.Render( scene, viewport, 101, 101, ON_Color( 255, 255, 255 ), supersample ) );
+    RH_REQUIRE( second.Render( scene, viewport, 101, 101, ON_Color( 255, 255, 255 ), supersample ) );
+    RH_CHECK( 0 == memcmp( first.Pixels(), second.Pixels(), 4*101*101 ) );
+    RH_CHECK( 0 != TestPixel( first, 50, 50 )[3] );
+  }
+}
+
+RH_TEST( RasterScene_AddMesh )
+{
+  // the scene builds and owns the display buffers of an ON_Mesh
+  ON_Mesh mesh( 1, 4, true, false );
+  mesh.SetVertex( 0, ON_3dPoint( -5.0, -5.0, 0.0 ) );
+  mesh.SetVertex( 1, ON_3dPoint(  5.0, -5.0, 0.0 ) );
+  mesh.SetVertex( 2, ON_3dPoint(  5.0,  5.0, 0.0 ) );
+  mesh.SetVertex( 3, ON_3dPoint( -5.0,  5.0, 0.0 ) );
+  mesh.SetQuad( 0, 0, 1, 2, 3 );
+  mesh.ComputeVertexNormals();
+
+  CRhRasterScene scene;
+  const ON__UINT64 empty_size = scene.SizeOf();
+  RH_REQUIRE( scene.AddMesh( mesh, TestMaterial( 200, 0, 0 ) ) );
+  RH_CHECK( 1 == scene.MeshCount() );
+  RH_CHECK( 2 == scene.TriangleCount() );
+  RH_CHECK( scene.SizeOf() >= empty_size + 4*sizeof(VertexData) + 6*sizeof(unsigned short) );
+
+  ON_Viewport viewport;
+  GetTestViewport( viewport );
+  CRhSoftwareRasterizer rasterizer;
+  RH_REQUIRE( rasterizer.Render( scene, viewport, 64, 64, ON_Color( 0, 0, 0, 0 ) ) );
+  RH_CHECK( 255 == TestPixel( rasterizer, 32, 32 )[3] );
+  RH_CHECK( 0 == TestPixel( rasterizer, 2, 2 )[3] );
+}
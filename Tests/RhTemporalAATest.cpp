@@ -0,0 +1,105 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <math.h>
+
+#include "RhTest.h"
+#include "RhTemporalAA.h"
+
+RH_TEST( TemporalAA_Samples )
+{
+  CRhTemporalAA aa;
+  RH_CHECK( 0 == aa.SampleIndex() );
+  RH_CHECK( !aa.IsConverged() );
+  RH_CHECK( 1.0f == aa.SampleWeight() );
+
+  for ( int i = 1; i <= CRhTemporalAA::sample_count; i++ ) {
+    RH_CHECK( !aa.IsConverged() );
+    aa.SampleDone();
+    RH_CHECK( i == aa.SampleIndex() );
+  }
+  RH_CHECK( aa.IsConverged() );
+
+  // no more samples than sample_count
+  aa.SampleDone();
+  RH_CHECK( CRhTemporalAA::sample_count == aa.SampleIndex() );
+
+  aa.Restart();
+  RH_CHECK( 0 == aa.SampleIndex() );
+  RH_CHECK( !aa.IsConverged() );
+
+  aa.SampleDone();
+  aa.Stop();
+  RH_CHECK( aa.IsConverged() );
+}
+
+RH_TEST( TemporalAA_WeightsAverage )
+{
+  // blending every sample with SampleWeight() leaves the average of the samples
+  CRhTemporalAA aa;
+  const float samples[CRhTemporalAA::sample_count] = { 1.0f, 0.0f, 0.5f, 0.25f, 1.0f, 0.75f, 0.0f, 0.5f };
+  float accumulated = 0.0f;
+  float sum = 0.0f;
+  for ( int i = 0; i < CRhTemporalAA::sample_count; i++ ) {
+    const float weight = aa.SampleWeight();
+    accumulated = weight*samples[i] + (1.0f - weight)*accumulated;
+    sum += samples[i];
+    aa.SampleDone();
+    RH_CHECK( fabs( accumulated - sum/(i+1) ) < 1.0e-6 );
+  }
+}
+
+RH_TEST( TemporalAA_SampleViewports )
+{
+  ON_Viewport viewport;
+  RH_REQUIRE( viewport.SetFrustum( -2.0, 2.0, -1.5, 1.5, 1.0, 100.0 ) );
+  const int width = 400;
+  const int height = 300;
+  const double pixel_width = 4.0/width;
+  const double pixel_height = 3.0/height;
+
+  // the first sample is the plain view; the others shift it by less than
+  // half a pixel, each by a different amount, without changing its size
+  CRhTemporalAA aa;
+  double offsets[CRhTemporalAA::sample_count][2];
+  for ( int i = 0; i < CRhTemporalAA::sample_count; i++ ) {
+    ON_Viewport jittered;
+    aa.GetSampleViewport( viewport, width, height, jittered );
+    double left, right, bottom, top, near_dist, far_dist;
+    RH_REQUIRE( jittered.GetFrustum( &left, &right, &bottom, &top, &near_dist, &far_dist ) );
+    RH_CHECK( fabs( (right - left) - 4.0 ) < 1.0e-12 );
+    RH_CHECK( fabs( (top - bottom) - 3.0 ) < 1.0e-12 );
+    RH_CHECK( 1.0 == near_dist && 100.0 == far_dist );
+
+    offsets[i][0] = (left + 2.0)/pixel_width;
+    offsets[i][1] = (bottom + 1.5)/pixel_height;
+    if ( i == 0 )
+      RH_CHECK( 0.0 == offsets[i][0] && 0.0 == offsets[i][1] );
+    RH_CHECK( fabs( offsets[i][0] ) < 0.5 && fabs( offsets[i][1] ) < 0.5 );
+    for ( int j = 0; j < i; j++ )
+      RH_CHECK( offsets[i][0] != offsets[j][0] || offsets[i][1] != offsets[j][1] );
+    aa.SampleDone();
+  }
+
+  // converged and empty views are not shifted
+  ON_Viewport jittered;
+  double left, right, bottom, top;
+  aa.GetSampleViewport( viewport, width, height, jittered );
+  RH_CHECK( jittered.GetFrustum( &left, &right, &bottom, &top ) && -2.0 == left && -1.5 == bottom );
+  aa.Restart();
+  aa.SampleDone();
+  aa.GetSampleViewport( viewport, 0, 0, jittered );
+  RH_CHECK( jittered.GetFrustum( &left, &right, &bottom, &top ) && -2.0 == left && -1.5 == bottom );
+}
@@ -0,0 +1,63 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#if !defined(RH_TEST_INC_)
+#define RH_TEST_INC_
+
+/*
+Description:
+  Minimal unit test registry for the host tests in this directory.
+
+  Example:
+    RH_TEST( CRC32_Empty )
+    {
+      RH_CHECK( 0 == RhCRC32( 0, 0, NULL ) );
+    }
+
+  Every RH_TEST in the linked files runs once.  RH_CHECK reports a
+  failed condition and lets the test go on; RH_REQUIRE returns from
+  the test.
+*/
+typedef void (*RhTestProc)();
+
+class CRhTest
+{
+public:
+  CRhTest( const char* name, RhTestProc proc );
+
+  // Runs the tests whose names contain filter, or all of them when filter is NULL
+  static int RunAll( const char* filter );
+
+  // Called by RH_CHECK
+  static bool Check( bool bOk, const char* condition, const char* file, int line );
+
+private:
+  const char* m_name;
+  RhTestProc m_proc;
+  CRhTest* m_next;
+};
+
+#define RH_TEST(name) \
+  static void RhTest_##name(); \
+  static CRhTest g_rh_test_##name( #name, RhTest_##name ); \
+  static void RhTest_##name()
+
+#define RH_CHECK(condition) \
+  CRhTest::Check( (condition) ? true : false, #condition, __FILE__, __LINE__ )
+
+#define RH_REQUIRE(condition) \
+  do { if ( !RH_CHECK(condition) ) return; } while(0)
+
+#endif
@@ -0,0 +1,81 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+//
+// Unit tests for the plain C++ parts of the viewer.
+//
+// usage: RhTests [name]
+//
+// Runs every test, or the tests whose names contain name.  Exits with 1
+// if a check failed.
+//
+
+#include "RhTest.h"
+
+static CRhTest* g_first_test = NULL;
+static int g_failure_count = 0;
+
+CRhTest::CRhTest( const char* name, RhTestProc proc )
+: m_name(name)
+, m_proc(proc)
+, m_next(g_first_test)
+{
+  g_first_test = this;
+}
+
+bool CRhTest::Check( bool bOk, const char* condition, const char* file, int line )
+{
+  if ( !bOk ) {
+    fflush( stdout );     // keep the report in order when both go to a terminal
+    fprintf( stderr, "%s:%d: check failed: %s\n", file, line, condition );
+    g_failure_count++;
+  }
+  return bOk;
+}
+
+int CRhTest::RunAll( const char* filter )
+{
+  // the registry is built in reverse; run the tests in link order
+  ON_SimpleArray<CRhTest*> tests;
+  for ( CRhTest* test = g_first_test; test; test = test->m_next )
+    tests.Append( test );
+
+  int run_count = 0;
+  int failed_count = 0;
+  for ( int i = tests.Count() - 1; i >= 0; i-- ) {
+    const CRhTest* test = tests[i];
+    if ( filter && !strstr( test->m_name, filter ) )
+      continue;
+    const int failures_before = g_failure_count;
+    test->m_proc();
+    run_count++;
+    if ( g_failure_count != failures_before ) {
+      failed_count++;
+      fflush( stdout );
+      fprintf( stderr, "FAILED %s\n", test->m_name );
+    }
+    else
+      printf( "ok     %s\n", test->m_name );
+  }
+
+  printf( "%d tests, %d failed\n", run_count, failed_count );
+  return failed_count;
+}
+
+int main( int argc, const char* argv[] )
+{
+  const char* filter = ( argc > 1 ) ? argv[1] : NULL;
+  return CRhTest::RunAll( filter ) ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+//
+// Prefix header for the unit tests.  It stands in for RhinoViewer_prefix.pch
+// when the plain C++ parts of the viewer are built outside of Xcode.
+//
+
+#include "opennurbs/opennurbs.h"
+
+#define DLog(...) /* */
+
+#if !defined(TRUE)
+#define TRUE 1
+#endif
+#if !defined(FALSE)
+#define FALSE 0
+#endif
@@ -0,0 +1,75 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "RhTest.h"
+#include "RhTrace.h"
+
+// Names the thread and records one span named after it
+static void* TraceThread( void* name )
+{
+  RhTraceSetThreadName( (const char*)name );
+  RhTraceAddSpan( (const char*)name, RhTraceTime(), RhTraceTime(), -1 );
+  return NULL;
+}
+
+static bool RunTraceThread( const char* name )
+{
+  pthread_t thread;
+  if ( pthread_create( &thread, NULL, TraceThread, (void*)name ) )
+    return false;
+  return 0 == pthread_join( thread, NULL );
+}
+
+// The number of times text occurs in the file
+static int CountInFile( const char* filename, const char* text )
+{
+  FILE* fp = fopen( filename, "r" );
+  if ( !fp )
+    return -1;
+  char line[1024];
+  int count = 0;
+  while ( fgets( line, sizeof(line), fp ) ) {
+    for ( const char* s = strstr( line, text ); s; s = strstr( s+1, text ) )
+      count++;
+  }
+  fclose( fp );
+  return count;
+}
+
+RH_TEST( Trace_ReusedBufferStartsEmpty )
+{
+  RhTraceEnable( true );
+  RhTraceClear();
+  RH_REQUIRE( RunTraceThread( "first_thread" ) );
+  RH_REQUIRE( RunTraceThread( "second_thread" ) );
+
+  char filename[] = "/tmp/RhTraceTestXXXXXX";
+  const int fd = mkstemp( filename );
+  RH_REQUIRE( fd >= 0 );
+  close( fd );
+  RH_CHECK( RhTraceWriteJSON( filename ) );
+  RhTraceEnable( false );
+
+  // the second thread got the first thread's buffer, without its span
+  RH_CHECK( 0 == CountInFile( filename, "\"first_thread\"" ) );
+  RH_CHECK( 2 == CountInFile( filename, "\"second_thread\"" ) );
+  unlink( filename );
+}
@@ -0,0 +1,117 @@
+/* $NoKeywords: $ */
+/*
+ //
+ // Copyright (c) 1993-2011 Robert McNeel & Associates. All rights reserved.
+ // Rhinoceros is a registered trademark of Robert McNeel & Assoicates.
+ //
+ // THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY.
+ // ALL IMPLIED WARRANTIES OF FITNESS FOR ANY PARTICULAR PURPOSE AND OF
+ // MERCHANTABILITY ARE HEREBY DISCLAIMED.
+ //
+ // For complete openNURBS copyright information see <http://www.opennurbs.org>.
+ //
+ ////////////////////////////////////////////////////////////////
+ */
+
+#include <pthread.h>
+
+#include "RhTest.h"
+#include "RhTripleBuffer.h"
+
+// A value whose parts all follow from m_serial, so a torn copy shows
+struct CRhTestState
+{
+  int m_serial;
+  int m_parts[15];
+};
+
+static void SetTestState( CRhTestState& state, int serial )
+{
+  state.m_serial = serial;
+  for ( int i = 0; i < 15; i++ )
+    state.m_parts[i] = serial*(i+1);
+}
+
+static bool IsTestStateWhole( const CRhTestState& state )
+{
+  for ( int i = 0; i < 15; i++ ) {
+    if ( state.m_parts[i] != state.m_serial*(i+1) )
+      return false;
+  }
+  return true;
+}
+
+RH_TEST( TripleBuffer_NewestValueWins )
+{
+  CRhTripleBuffer<int> buffer;
+  RH_CHECK( !buffer.Acquire() );
+
+  buffer.WriteBuffer() = 1;
+  buffer.Publish();
+  RH_CHECK( buffer.Acquire() );
+  RH_CHECK( 1 == buffer.ReadBuffer() );
+  RH_CHECK( !buffer.Acquire() );
+  RH_CHECK( 1 == buffer.ReadBuffer() );
+
+  // values the consumer missed are dropped
+  for ( int i = 2; i <= 5; i++ ) {
+    buffer.WriteBuffer() = i;
+    buffer.Publish();
+  }
+  RH_CHECK( buffer.Acquire() );
+  RH_CHECK( 5 == buffer.ReadBuffer() );
+  RH_CHECK( !buffer.Acquire() );
+}
+
+RH_TEST( TripleBuffer_WriteBufferIsNotRead )
+{
+  // the producer's copy is never the one the consumer reads
+  CRhTripleBuffer<int> buffer;
+  for ( int i = 0; i < 10; i++ ) {
+    buffer.WriteBuffer() = i;
+    buffer.Publish();
+    if ( i % 3 == 0 )
+      buffer.Acquire();
+    RH_CHECK( &buffer.WriteBuffer() != &buffer.ReadBuffer() );
+  }
+}
+
+static const int TestStateCount = 200000;
+
+static void* ProduceTestStates( void* arg )
+{
+  CRhTripleBuffer<CRhTestState>* buffer = (CRhTripleBuffer<CRhTestState>*)arg;
+  for ( int serial = 1; serial <= TestStateCount; serial++ ) {
+    SetTestState( buffer->WriteBuffer(), serial );
+    buffer->Publish();
+  }
+  return NULL;
+}
+
+RH_TEST( TripleBuffer_Threads )
+{
+  // the consumer only sees whole values, newer each time, and ends with the last
+  CRhTripleBuffer<CRhTestState> buffer;
+  pthread_t producer;
+  RH_REQUIRE( 0 == pthread_create( &producer, NULL, ProduceTestStates, &buffer ) );
+
+  int last_serial = 0;
+  int torn_count = 0;
+  int older_count = 0;
+  while ( last_serial < TestStateCount ) {
+    if ( !buffer.Acquire() )
+      continue;
+    const CRhTestState& state = buffer.ReadBuffer();
+    if ( !IsTestStateWhole( state ) )
+      torn_count++;
+    if ( state.m_serial <= last_serial )
+      older_count++;
+    last_serial = state.m_serial;
+  }
+  pthread_join( producer, NULL );
+
+  RH_CHECK( 0 == torn_count );
+  RH_CHECK( 0 == older_count );
+  RH_CHECK( TestStateCount == last_serial );
+  RH_CHECK( !buffer.Acquire() );
+}
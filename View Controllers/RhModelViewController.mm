@@ -16,6 +16,7 @@
 #import "RhModelViewController.h"
 #import "RhModelView.h"
 #import "RhModel.h"
+#import "RhModelPrefetcher.h"
 
 
 // forward declarations
@@ -435,6 +436,9 @@
   }
   
   [glView setNeedsDisplay];
+  
+  // get the next models ready while this one is viewed
+  [RhinoApp.modelPrefetcher prefetchModelsAfter: currentModel inModels: RhinoApp.models];
 }
 
 